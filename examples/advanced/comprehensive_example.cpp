@@ -55,7 +55,7 @@ private:
     void setupServer() {
         std::cout << "Setting up server...\n";
         
-        Endpoint bind_addr{"localhost", 12347};
+        auto bind_addr = Endpoint::resolve("localhost", 12347);
         HostConfig server_config{
             .maxPeers = 10,
             .maxChannels = 3,
@@ -66,7 +66,7 @@ private:
         
         server_host_->getDispatcher().onConnect([this](const ConnectEvent& event) {
             std::cout << "[SERVER] Client connected from " 
-                      << event.remoteEndpoint.host << ":" << event.remoteEndpoint.port
+                      << event.remoteEndpoint.toString()
                       << " (Total peers: " << server_host_->peerCount() << ")\n";
             
             // Send welcome message with client ID
@@ -121,14 +121,14 @@ private:
 
         server_host_->getDispatcher().onDisconnect([this](const DisconnectEvent& event) {
             std::cout << "[SERVER] Client disconnected from " 
-                      << event.remoteEndpoint.host << ":" << event.remoteEndpoint.port
+                      << event.remoteEndpoint.toString()
                       << " (Remaining peers: " << server_host_->peerCount() << ")\n";
             
             broadcastMessage("CLIENT_DISCONNECTED", nullptr);
         });
 
         server_host_->startServiceThread();
-        std::cout << "Server started on " << bind_addr.host << ":" << bind_addr.port << "\n";
+        std::cout << "Server started on " << bind_addr.toString() << "\n";
     }
 
     void setupClients() {
@@ -147,7 +147,7 @@ private:
             auto client_host = Host::createClient(client_config);
             const int client_id = i + 1;
             
-            client_host->getDispatcher().onConnect([client_id](const ConnectEvent& event) {
+            client_host->getDispatcher().onConnect([client_id](const ConnectEvent&) {
                 std::cout << "[CLIENT " << client_id << "] Connected to server\n";
             });
             
@@ -164,13 +164,13 @@ private:
                     } else if (msg_type == "BROADCAST_CHAT") {
                         auto sender_id = reader.readUint32();
                         auto message = reader.readString(reader.readUint32());
-                        if (sender_id != client_id) {  // Don't show own messages
+                        if (sender_id != static_cast<uint32_t>(client_id)) {  // Don't show own messages
                             std::cout << "[CLIENT " << client_id << "] Chat from client " << sender_id << ": " << message << "\n";
                         }
                         
                     } else if (msg_type == "PONG") {
                         auto sent_time = reader.readUint64();
-                        auto server_time = reader.readUint64();
+                        reader.readUint64();  // server time, unused here
                         auto now = std::chrono::steady_clock::now().time_since_epoch().count();
                         
                         auto rtt = now - sent_time;
@@ -189,13 +189,13 @@ private:
                 }
             });
             
-            client_host->getDispatcher().onDisconnect([client_id](const DisconnectEvent& event) {
+            client_host->getDispatcher().onDisconnect([client_id](const DisconnectEvent&) {
                 std::cout << "[CLIENT " << client_id << "] Disconnected from server\n";
             });
             
             client_host->startServiceThread();
             
-            Endpoint server_addr{"localhost", 12347};
+            auto server_addr = Endpoint::resolve("localhost", 12347);
             auto server_peer = client_host->connect(server_addr);
             
             client_hosts_.push_back(client_host);
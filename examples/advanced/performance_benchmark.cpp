@@ -1,345 +1,621 @@
 #include "../../include/icelander.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
 #include <string>
 #include <thread>
-#include <chrono>
-#include <atomic>
 #include <vector>
-#include <numeric>
-#include <algorithm>
-#include <iomanip>
 
 using namespace icelander;
-using namespace icelander::async;
 
-class PerformanceBenchmark {
+using Clock = std::chrono::steady_clock;
+
+// Load generator: a server that echoes every message and a pool of client threads, each
+// driving its own Host with many peers. Open-loop mode sends on a fixed schedule and
+// measures latency from the scheduled send time, so a stalled sender shows up as latency
+// instead of silently lowering the offered load (coordinated omission).
+
+// Log-linear histogram in the style of HdrHistogram: values below 2^SUB_BITS are exact,
+// larger ones keep SUB_BITS significant bits (under 1% relative error).
+class HdrHistogram {
+public:
+    static constexpr int SUB_BITS = 7;
+    static constexpr uint64_t SUB_COUNT = uint64_t{1} << SUB_BITS;
+    static constexpr uint64_t HALF_COUNT = SUB_COUNT / 2;
+    static constexpr int MAX_SHIFT = 40;
+
+    HdrHistogram() : counts_(SUB_COUNT + MAX_SHIFT * HALF_COUNT, 0) {}
+
+    void record(int64_t value) {
+        auto v = static_cast<uint64_t>(std::max<int64_t>(value, 0));
+        ++counts_[indexOf(v)];
+        ++count_;
+        sum_ += static_cast<double>(v);
+        min_ = std::min(min_, v);
+        max_ = std::max(max_, v);
+    }
+
+    void merge(const HdrHistogram& other) {
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    auto count() const -> uint64_t { return count_; }
+    auto min() const -> uint64_t { return count_ ? min_ : 0; }
+    auto max() const -> uint64_t { return max_; }
+    auto mean() const -> double { return count_ ? sum_ / static_cast<double>(count_) : 0.0; }
+
+    // Highest value equivalent to the sample at quantile q, clamped to the exact maximum.
+    auto percentile(double q) const -> uint64_t {
+        if (count_ == 0) {
+            return 0;
+        }
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count_))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(highestEquivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
 private:
-    std::shared_ptr<Host> server_host_;
-    std::shared_ptr<Host> client_host_;
-    std::shared_ptr<Peer> server_peer_;
-    
-    std::atomic<bool> benchmark_running_{false};
-    std::atomic<uint64_t> packets_sent_{0};
-    std::atomic<uint64_t> packets_received_{0};
-    std::atomic<uint64_t> bytes_sent_{0};
-    std::atomic<uint64_t> bytes_received_{0};
-    
-    std::vector<double> latency_measurements_;
-    std::mutex latency_mutex_;
-    
-    std::chrono::steady_clock::time_point benchmark_start_;
+    static auto indexOf(uint64_t v) -> size_t {
+        if (v < SUB_COUNT) {
+            return static_cast<size_t>(v);
+        }
+        int shift = std::min(static_cast<int>(std::bit_width(v)) - SUB_BITS, MAX_SHIFT);
+        uint64_t mantissa = std::min(v >> shift, SUB_COUNT - 1);
+        return static_cast<size_t>(SUB_COUNT + (shift - 1) * HALF_COUNT + (mantissa - HALF_COUNT));
+    }
+
+    static auto highestEquivalent(size_t index) -> uint64_t {
+        if (index < SUB_COUNT) {
+            return index;
+        }
+        auto shift = static_cast<int>((index - SUB_COUNT) / HALF_COUNT) + 1;
+        uint64_t mantissa = (index - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+        return ((mantissa + 1) << shift) - 1;
+    }
 
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    double sum_ = 0.0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+struct MessageKind {
+    size_t size = 64;
+    uint32_t weight = 1;
+    bool reliable = true;
+};
+
+struct BenchmarkConfig {
+    std::string host = "127.0.0.1";
+    uint16_t port = 12348;
+    size_t clients = 1000;
+    size_t threads = std::max<size_t>(1, std::min<size_t>(4, std::thread::hardware_concurrency()));
+    size_t serverShards = 1;
+    bool openLoop = true;
+    double rate = 20000.0;              // messages/s across all clients, open loop
+    size_t window = 1;                  // outstanding messages per client, closed loop
+    double duration = 10.0;             // seconds measured
+    double warmup = 2.0;                // seconds sent but not measured
+    double drain = 1.0;                 // seconds to wait for echoes after the run
+    double connectTimeout = 10.0;       // seconds allowed for every client to connect
+    uint64_t seed = 1;
+    std::vector<MessageKind> mix = {{64, 60, true}, {256, 30, true}, {1024, 10, false}};
+    std::string jsonPath;
+    std::string csvPath;
+    std::string baselinePath;
+    double tolerance = 0.10;            // allowed regression against the baseline
+};
+
+struct ThreadResult {
+    HdrHistogram latency;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesReceived = 0;
+    size_t connected = 0;
+};
+
+// Each message starts with its scheduled send time and the sending client.
+constexpr size_t HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+constexpr ChannelIdT RELIABLE_CHANNEL = 0;
+constexpr ChannelIdT UNRELIABLE_CHANNEL = 1;
+
+auto parseMix(const std::string& text) -> std::vector<MessageKind> {
+    std::vector<MessageKind> mix;
+    std::stringstream entries(text);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        MessageKind kind;
+        std::stringstream fields(entry);
+        std::string field;
+        std::getline(fields, field, ':');
+        kind.size = std::max<size_t>(HEADER_SIZE, std::stoul(field));
+        if (std::getline(fields, field, ':')) {
+            kind.weight = static_cast<uint32_t>(std::stoul(field));
+        }
+        if (std::getline(fields, field, ':')) {
+            if (field != "reliable" && field != "unreliable") {
+                throw std::runtime_error("Mix entries end in :reliable or :unreliable, got " + field);
+            }
+            kind.reliable = field == "reliable";
+        }
+        mix.push_back(kind);
+    }
+    if (mix.empty()) {
+        throw std::runtime_error("Message mix is empty");
+    }
+    return mix;
+}
+
+auto mixToString(const std::vector<MessageKind>& mix) -> std::string {
+    std::string text;
+    for (const auto& kind : mix) {
+        if (!text.empty()) {
+            text += ",";
+        }
+        text += std::to_string(kind.size) + ":" + std::to_string(kind.weight) + (kind.reliable ? ":reliable" : ":unreliable");
+    }
+    return text;
+}
+
+void printUsage() {
+    std::cout <<
+        "Usage: PerformanceBenchmark [options]\n"
+        "  --clients N          simulated clients (1000)\n"
+        "  --threads N          client threads, each with its own host (min(4, cores))\n"
+        "  --server-shards N    SO_REUSEPORT server shards (1)\n"
+        "  --mode open|closed   fixed-rate schedule or send-on-echo (open)\n"
+        "  --rate N             open loop: messages/s across all clients (20000)\n"
+        "  --window N           closed loop: outstanding messages per client (1)\n"
+        "  --duration S         measured seconds (10)\n"
+        "  --warmup S           unmeasured seconds before the run (2)\n"
+        "  --connect-timeout S  time allowed for all clients to connect (10)\n"
+        "  --mix LIST           size:weight[:reliable|unreliable],... (64:60,256:30,1024:10:unreliable)\n"
+        "  --seed N             random seed for message selection (1)\n"
+        "  --host ADDR --port N server address (127.0.0.1:12348)\n"
+        "  --json FILE          write results as JSON\n"
+        "  --csv FILE           append results as a CSV row\n"
+        "  --baseline FILE      compare with an earlier --json file; exit 2 on regression\n"
+        "  --tolerance F        allowed regression as a fraction (0.10)\n";
+}
+
+auto parseArgs(int argc, char** argv) -> BenchmarkConfig {
+    BenchmarkConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            throw std::runtime_error("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--clients") config.clients = std::stoul(value);
+        else if (arg == "--threads") config.threads = std::stoul(value);
+        else if (arg == "--server-shards") config.serverShards = std::stoul(value);
+        else if (arg == "--mode") config.openLoop = value != "closed";
+        else if (arg == "--rate") config.rate = std::stod(value);
+        else if (arg == "--window") config.window = std::stoul(value);
+        else if (arg == "--duration") config.duration = std::stod(value);
+        else if (arg == "--warmup") config.warmup = std::stod(value);
+        else if (arg == "--connect-timeout") config.connectTimeout = std::stod(value);
+        else if (arg == "--mix") config.mix = parseMix(value);
+        else if (arg == "--seed") config.seed = std::stoull(value);
+        else if (arg == "--host") config.host = value;
+        else if (arg == "--port") config.port = static_cast<uint16_t>(std::stoul(value));
+        else if (arg == "--json") config.jsonPath = value;
+        else if (arg == "--csv") config.csvPath = value;
+        else if (arg == "--baseline") config.baselinePath = value;
+        else if (arg == "--tolerance") config.tolerance = std::stod(value);
+        else throw std::runtime_error("Unknown option " + arg);
+    }
+
+    config.clients = std::max<size_t>(1, config.clients);
+    config.threads = std::clamp<size_t>(config.threads, 1, config.clients);
+    config.window = std::max<size_t>(1, config.window);
+    if ((config.clients + config.threads - 1) / config.threads > MAX_PEERS) {
+        throw std::runtime_error("Too many clients per thread; raise --threads");
+    }
+    return config;
+}
+
+class ClientThread {
 public:
-    void runBenchmark() {
-        std::cout << "=== Icelander Performance Benchmark ===\n";
-        std::cout << "This benchmark tests:\n";
-        std::cout << "- Throughput (packets/second, bytes/second)\n";
-        std::cout << "- Latency (round-trip time)\n";
-        std::cout << "- Memory efficiency\n";
-        std::cout << "- Connection stability\n\n";
+    ClientThread(const BenchmarkConfig& config, size_t index, size_t clientCount, Clock::time_point epoch)
+        : config_(config)
+        , epoch_(epoch)
+        , rng_(config.seed + index) {
+        std::vector<double> weights;
+        for (const auto& kind : config.mix) {
+            weights.push_back(kind.weight);
+        }
+        pick_ = std::discrete_distribution<size_t>(weights.begin(), weights.end());
 
-        if (!Library::initialize()) {
-            std::cerr << "Failed to initialize Icelander library\n";
-            return;
+        HostConfig hostConfig;
+        hostConfig.maxPeers = clientCount;
+        hostConfig.maxChannels = 2;
+        host_ = Host::createClient(hostConfig);
+        host_->getDispatcher().onReceive([this](const ReceiveEvent& event) { onEcho(event); });
+
+        auto server = Endpoint::resolve(config.host, config.port);
+        for (size_t i = 0; i < clientCount; ++i) {
+            peers_.push_back(host_->connect(server, 2));
         }
+    }
 
-        try {
-            setupNetworking();
-            
-            // Run different benchmark tests
-            runThroughputTest();
-            runLatencyTest();
-            runBurstTest();
-            
-        } catch (const std::exception& e) {
-            std::cerr << "Benchmark error: " << e.what() << "\n";
+    // Runs on this object's own thread; everything below touches only its host.
+    void run(Clock::time_point connectDeadline, std::atomic<size_t>& ready, Clock::time_point start) {
+        while (Clock::now() < connectDeadline && connectedCount() < peers_.size()) {
+            host_->serviceAll(TimeoutMs{1});
         }
+        result_.connected = connectedCount();
+        ready.fetch_add(1);
 
-        cleanup();
-        Library::deinitialize();
-        std::cout << "\nBenchmark completed.\n";
+        while (Clock::now() < start) {
+            host_->serviceAll(TimeoutMs{1});
+        }
+
+        measureFrom_ = nanosSinceEpoch(start + toDuration(config_.warmup));
+        end_ = start + toDuration(config_.warmup + config_.duration);
+
+        if (config_.openLoop) {
+            runOpenLoop(start);
+        } else {
+            runClosedLoop();
+        }
+
+        auto drainUntil = Clock::now() + toDuration(config_.drain);
+        while (Clock::now() < drainUntil && result_.received < result_.sent) {
+            host_->serviceAll(TimeoutMs{1});
+        }
+
+        for (auto& peer : peers_) {
+            peer->disconnectNow();
+        }
+        host_->flush();
     }
 
+    auto result() const -> const ThreadResult& { return result_; }
+
 private:
-    void setupNetworking() {
-        std::cout << "Setting up benchmark environment...\n";
-        
-        // Create server with optimized settings
-        Endpoint bind_addr{"localhost", 12348};
-        HostConfig server_config{
-            .maxPeers = 1,
-            .maxChannels = 1,
-            .enableCompression = false  // Disable compression for raw performance
-        };
-        
-        server_host_ = Host::createServer(bind_addr, server_config);
-        
-        // Server event handlers
-        server_host_->getDispatcher().onConnect([this](const ConnectEvent& event) {
-            std::cout << "Client connected for benchmark\n";
-        });
-        
-        server_host_->getDispatcher().onReceive([this](const ReceiveEvent& event) {
-            bytes_received_ += event.packetData->size();
-            packets_received_++;
-            
-            // Echo the packet back to client for latency testing
-            PacketBuilder echo_builder;
-            PacketReader reader(*event.packetData);
-            
-            // Check if this is a latency test packet
-            if (event.packetData->size() >= 8) {
-                echo_builder.write(event.packetData->data().data(), event.packetData->size());
-                auto echo_packet = echo_builder.build(static_cast<PacketFlagsT>(PacketFlag::reliable));
-                event.peerHandle->send(std::move(echo_packet));
+    static auto toDuration(double seconds) -> Clock::duration {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    auto nanosSinceEpoch(Clock::time_point time) const -> int64_t {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch_).count();
+    }
+
+    auto connectedCount() const -> size_t {
+        return static_cast<size_t>(std::count_if(peers_.begin(), peers_.end(),
+            [](const auto& peer) { return peer->isConnected(); }));
+    }
+
+    void runOpenLoop(Clock::time_point start) {
+        // This thread's share of the rate, on a schedule that never slips.
+        double threadRate = config_.rate * static_cast<double>(peers_.size()) / static_cast<double>(config_.clients);
+        auto interval = std::chrono::duration<double, std::nano>(1e9 / std::max(threadRate, 1e-3));
+        uint64_t scheduled = 0;
+        size_t nextClient = 0;
+
+        while (true) {
+            auto now = Clock::now();
+            if (now >= end_) {
+                break;
             }
-        });
-        
-        // Create client
-        HostConfig client_config{
-            .maxPeers = 1,
-            .maxChannels = 1,
-            .enableCompression = false
-        };
-        
-        client_host_ = Host::createClient(client_config);
-        
-        // Client event handlers
-        client_host_->getDispatcher().onReceive([this](const ReceiveEvent& event) {
-            bytes_received_ += event.packetData->size();
-            packets_received_++;
-            
-            // Check if this is a latency measurement echo
-            if (event.packetData->size() >= 16) {
-                PacketReader reader(*event.packetData);
-                try {
-                    auto sent_time = reader.readUint64();
-                    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
-                    auto latency = (now - sent_time) / 1000000.0; // Convert to milliseconds
-                    
-                    std::lock_guard<std::mutex> lock(latency_mutex_);
-                    latency_measurements_.push_back(latency);
-                } catch (...) {
-                    // Ignore malformed packets
-                }
+
+            auto due = start + std::chrono::duration_cast<Clock::duration>(interval * static_cast<double>(scheduled));
+            while (due <= now && due < end_) {
+                sendMessage(nextClient, nanosSinceEpoch(due));
+                nextClient = (nextClient + 1) % peers_.size();
+                ++scheduled;
+                due = start + std::chrono::duration_cast<Clock::duration>(interval * static_cast<double>(scheduled));
             }
-        });
-        
-        // Start service threads
-        server_host_->startServiceThread();
-        client_host_->startServiceThread();
-        
-        // Connect client to server
-        server_peer_ = client_host_->connect(bind_addr);
-        
-        // Wait for connection to establish
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        
-        if (!server_peer_->isConnected()) {
-            throw std::runtime_error("Failed to establish connection for benchmark");
-        }
-        
-        std::cout << "Benchmark environment ready\n";
+
+            // ENet waits in whole milliseconds; poll when the next send is sooner.
+            host_->serviceAll(due - Clock::now() >= std::chrono::milliseconds(1) ? TimeoutMs{1} : TimeoutMs{0});
+        }
     }
 
-    void runThroughputTest() {
-        std::cout << "\n=== Throughput Test ===\n";
-        
-        resetCounters();
-        const int test_duration_seconds = 10;
-        const int packet_size = 1024; // 1KB packets
-        
-        benchmark_running_ = true;
-        benchmark_start_ = std::chrono::steady_clock::now();
-        
-        // Start sender thread
-        std::thread sender_thread([this, packet_size, test_duration_seconds]() {
-            std::vector<uint8_t> test_data(packet_size, 0x42); // Fill with test pattern
-            
-            auto end_time = std::chrono::steady_clock::now() + std::chrono::seconds(test_duration_seconds);
-            
-            while (std::chrono::steady_clock::now() < end_time && benchmark_running_) {
-                PacketBuilder builder;
-                builder.write(test_data.data(), test_data.size());
-                auto packet = builder.build(static_cast<PacketFlagsT>(PacketFlag::reliable));
-                
-                if (server_peer_->send(std::move(packet))) {
-                    packets_sent_++;
-                    bytes_sent_ += packet_size;
-                }
-                
-                // Small delay to prevent overwhelming the network
-                std::this_thread::sleep_for(std::chrono::microseconds(10));
+    void runClosedLoop() {
+        for (size_t client = 0; client < peers_.size(); ++client) {
+            for (size_t i = 0; i < config_.window; ++i) {
+                sendMessage(client, nanosSinceEpoch(Clock::now()));
             }
-        });
-        
-        // Wait for test duration
-        std::this_thread::sleep_for(std::chrono::seconds(test_duration_seconds));
-        benchmark_running_ = false;
-        sender_thread.join();
-        
-        // Allow time for final packets to arrive
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        
-        // Calculate results
-        auto elapsed = std::chrono::steady_clock::now() - benchmark_start_;
-        auto elapsed_seconds = std::chrono::duration<double>(elapsed).count();
-        
-        auto packets_per_second = packets_received_ / elapsed_seconds;
-        auto bytes_per_second = bytes_received_ / elapsed_seconds;
-        auto mbps = (bytes_per_second * 8) / (1024 * 1024); // Convert to Mbps
-        
-        std::cout << std::fixed << std::setprecision(2);
-        std::cout << "Test Duration: " << elapsed_seconds << " seconds\n";
-        std::cout << "Packets Sent: " << packets_sent_ << "\n";
-        std::cout << "Packets Received: " << packets_received_ << "\n";
-        std::cout << "Packet Loss: " << std::setprecision(4) 
-                  << ((double)(packets_sent_ - packets_received_) / packets_sent_ * 100.0) << "%\n";
-        std::cout << "Throughput: " << std::setprecision(0) << packets_per_second << " packets/sec\n";
-        std::cout << "Bandwidth: " << std::setprecision(2) << (bytes_per_second / 1024) << " KB/sec (" 
-                  << mbps << " Mbps)\n";
+        }
+        while (Clock::now() < end_) {
+            host_->serviceAll(TimeoutMs{1});
+        }
     }
 
-    void runLatencyTest() {
-        std::cout << "\n=== Latency Test ===\n";
-        
-        resetCounters();
-        latency_measurements_.clear();
-        
-        const int num_pings = 100;
-        const int ping_interval_ms = 100;
-        
-        std::cout << "Sending " << num_pings << " ping packets...\n";
-        
-        for (int i = 0; i < num_pings; ++i) {
-            auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
-            
-            PacketBuilder ping_builder;
-            ping_builder.writeUint64(timestamp);
-            ping_builder.writeUint64(0); // Padding for echo
-            auto ping_packet = ping_builder.build(static_cast<PacketFlagsT>(PacketFlag::reliable));
-            
-            if (server_peer_->send(std::move(ping_packet))) {
-                packets_sent_++;
-            }
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(ping_interval_ms));
-        }
-        
-        // Wait for all responses
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        
-        // Calculate latency statistics
-        std::lock_guard<std::mutex> lock(latency_mutex_);
-        
-        if (latency_measurements_.empty()) {
-            std::cout << "No latency measurements received!\n";
+    void sendMessage(size_t client, int64_t scheduledNanos) {
+        const auto& kind = config_.mix[pick_(rng_)];
+        auto& peer = peers_[client];
+        if (!peer->isConnected()) {
             return;
         }
-        
-        std::sort(latency_measurements_.begin(), latency_measurements_.end());
-        
-        auto min_latency = latency_measurements_.front();
-        auto max_latency = latency_measurements_.back();
-        auto avg_latency = std::accumulate(latency_measurements_.begin(), latency_measurements_.end(), 0.0) 
-                          / latency_measurements_.size();
-        
-        auto p50_idx = latency_measurements_.size() / 2;
-        auto p95_idx = (latency_measurements_.size() * 95) / 100;
-        auto p99_idx = (latency_measurements_.size() * 99) / 100;
-        
-        auto p50_latency = latency_measurements_[p50_idx];
-        auto p95_latency = latency_measurements_[p95_idx];
-        auto p99_latency = latency_measurements_[p99_idx];
-        
-        std::cout << std::fixed << std::setprecision(2);
-        std::cout << "Ping Results (" << latency_measurements_.size() << " responses):\n";
-        std::cout << "  Min RTT: " << min_latency << " ms\n";
-        std::cout << "  Avg RTT: " << avg_latency << " ms\n";
-        std::cout << "  Max RTT: " << max_latency << " ms\n";
-        std::cout << "  P50 RTT: " << p50_latency << " ms\n";
-        std::cout << "  P95 RTT: " << p95_latency << " ms\n";
-        std::cout << "  P99 RTT: " << p99_latency << " ms\n";
-        std::cout << "  Packet Loss: " << std::setprecision(1) 
-                  << ((double)(num_pings - latency_measurements_.size()) / num_pings * 100.0) << "%\n";
-    }
 
-    void runBurstTest() {
-        std::cout << "\n=== Burst Test ===\n";
-        
-        resetCounters();
-        const int burst_size = 1000;
-        const int packet_size = 512;
-        
-        std::cout << "Sending burst of " << burst_size << " packets...\n";
-        
-        auto burst_start = std::chrono::steady_clock::now();
-        
-        // Send burst of packets as fast as possible
-        std::vector<uint8_t> test_data(packet_size, 0x55);
-        
-        for (int i = 0; i < burst_size; ++i) {
-            PacketBuilder builder;
-            builder.writeUint32(i); // Sequence number
-            builder.write(test_data.data(), test_data.size() - 4);
-            auto packet = builder.build(static_cast<PacketFlagsT>(PacketFlag::reliable));
-            
-            if (server_peer_->send(std::move(packet))) {
-                packets_sent_++;
-                bytes_sent_ += packet_size;
-            }
+        PacketBuilder builder(kind.size);
+        builder.writeUint64(static_cast<uint64_t>(scheduledNanos));
+        builder.writeUint32(static_cast<uint32_t>(client));
+        padding_.resize(kind.size - HEADER_SIZE, 0x5A);
+        builder.write(padding_.data(), padding_.size());
+
+        auto flags = kind.reliable ? static_cast<PacketFlagsT>(PacketFlag::reliable) : PacketFlagsT{0};
+        if (peer->send(kind.reliable ? RELIABLE_CHANNEL : UNRELIABLE_CHANNEL, builder.build(flags)) &&
+            scheduledNanos >= measureFrom_) {
+            ++result_.sent;
+            result_.bytesSent += kind.size;
         }
-        
-        auto burst_end = std::chrono::steady_clock::now();
-        auto burst_duration = std::chrono::duration<double>(burst_end - burst_start).count();
-        
-        // Wait for all packets to arrive
-        std::this_thread::sleep_for(std::chrono::seconds(3));
-        
-        auto send_rate = burst_size / burst_duration;
-        
-        std::cout << std::fixed << std::setprecision(0);
-        std::cout << "Burst sent in " << std::setprecision(4) << burst_duration << " seconds\n";
-        std::cout << "Send rate: " << std::setprecision(0) << send_rate << " packets/sec\n";
-        std::cout << "Packets received: " << packets_received_ << " / " << packets_sent_ << "\n";
-        std::cout << "Reception rate: " << std::setprecision(2) 
-                  << ((double)packets_received_ / packets_sent_ * 100.0) << "%\n";
     }
 
-    void resetCounters() {
-        packets_sent_ = 0;
-        packets_received_ = 0;
-        bytes_sent_ = 0;
-        bytes_received_ = 0;
+    void onEcho(const ReceiveEvent& event) {
+        PacketReader reader(*event.packetData);
+        auto scheduledNanos = static_cast<int64_t>(reader.readUint64());
+        auto client = reader.readUint32();
+        auto now = nanosSinceEpoch(Clock::now());
+
+        if (scheduledNanos >= measureFrom_) {
+            result_.latency.record(now - scheduledNanos);
+            ++result_.received;
+            result_.bytesReceived += event.packetData->size();
+        }
+
+        if (!config_.openLoop && Clock::now() < end_ && client < peers_.size()) {
+            sendMessage(client, now);
+        }
     }
 
-    void cleanup() {
-        std::cout << "\nCleaning up benchmark environment...\n";
-        
-        benchmark_running_ = false;
-        
-        if (server_peer_ && server_peer_->isConnected()) {
-            server_peer_->disconnect();
-        }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        
-        if (client_host_) {
-            client_host_->stopServiceThread();
-        }
-        
-        if (server_host_) {
-            server_host_->stopServiceThread();
-        }
-        
-        server_peer_.reset();
-        client_host_.reset();
-        server_host_.reset();
+    const BenchmarkConfig& config_;
+    Clock::time_point epoch_;
+    Clock::time_point end_;
+    int64_t measureFrom_ = 0;
+    std::mt19937_64 rng_;
+    std::discrete_distribution<size_t> pick_;
+    std::vector<uint8_t> padding_;
+    std::shared_ptr<Host> host_;
+    std::vector<std::shared_ptr<Peer>> peers_;
+    ThreadResult result_;
+};
+
+struct Summary {
+    double seconds = 0.0;
+    size_t connected = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesReceived = 0;
+    HdrHistogram latency;
+
+    auto throughput() const -> double { return seconds > 0 ? static_cast<double>(received) / seconds : 0.0; }
+    auto lossRatio() const -> double {
+        return sent ? static_cast<double>(sent - std::min(sent, received)) / static_cast<double>(sent) : 0.0;
     }
 };
 
-int main() {
-    PerformanceBenchmark benchmark;
-    benchmark.runBenchmark();
-    return 0;
+auto percentiles() -> const std::vector<std::pair<std::string, double>>& {
+    static const std::vector<std::pair<std::string, double>> points = {
+        {"p50", 0.50}, {"p90", 0.90}, {"p99", 0.99}, {"p999", 0.999}, {"p9999", 0.9999}};
+    return points;
+}
+
+auto toJson(const BenchmarkConfig& config, const Summary& summary) -> std::string {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n";
+    out << "  \"config\": {\"clients\": " << config.clients << ", \"threads\": " << config.threads
+        << ", \"server_shards\": " << config.serverShards << ", \"mode\": \"" << (config.openLoop ? "open" : "closed")
+        << "\", \"rate\": " << config.rate << ", \"window\": " << config.window << ", \"duration\": " << config.duration
+        << ", \"warmup\": " << config.warmup << ", \"seed\": " << config.seed << ", \"mix\": \"" << mixToString(config.mix)
+        << "\"},\n";
+    out << "  \"connected\": " << summary.connected << ",\n";
+    out << "  \"sent\": " << summary.sent << ",\n";
+    out << "  \"received\": " << summary.received << ",\n";
+    out << "  \"loss_ratio\": " << std::setprecision(6) << summary.lossRatio() << std::setprecision(3) << ",\n";
+    out << "  \"throughput\": " << summary.throughput() << ",\n";
+    out << "  \"bytes_per_second\": " << static_cast<double>(summary.bytesReceived) / summary.seconds << ",\n";
+    out << "  \"latency_ns\": {\"min\": " << summary.latency.min() << ", \"mean\": " << summary.latency.mean();
+    for (const auto& [name, q] : percentiles()) {
+        out << ", \"" << name << "\": " << summary.latency.percentile(q);
+    }
+    out << ", \"max\": " << summary.latency.max() << "}\n";
+    out << "}\n";
+    return out.str();
+}
+
+void appendCsv(const std::string& path, const BenchmarkConfig& config, const Summary& summary) {
+    bool exists = std::ifstream(path).good();
+    std::ofstream out(path, std::ios::app);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    if (!exists) {
+        out << "clients,threads,mode,rate,duration,sent,received,loss_ratio,throughput,min_ns,mean_ns";
+        for (const auto& [name, q] : percentiles()) {
+            out << "," << name << "_ns";
+        }
+        out << ",max_ns\n";
+    }
+    out << std::fixed << std::setprecision(3);
+    out << config.clients << "," << config.threads << "," << (config.openLoop ? "open" : "closed") << ","
+        << config.rate << "," << config.duration << "," << summary.sent << "," << summary.received << ","
+        << summary.lossRatio() << "," << summary.throughput() << "," << summary.latency.min() << ","
+        << summary.latency.mean();
+    for (const auto& [name, q] : percentiles()) {
+        out << "," << summary.latency.percentile(q);
+    }
+    out << "," << summary.latency.max() << "\n";
+}
+
+// Enough JSON to read back numbers this program wrote: the first "key": value after an
+// optional enclosing section.
+auto jsonNumber(const std::string& text, const std::string& key, const std::string& section = "") -> std::optional<double> {
+    size_t from = 0;
+    if (!section.empty()) {
+        from = text.find("\"" + section + "\"");
+        if (from == std::string::npos) {
+            return std::nullopt;
+        }
+    }
+    auto at = text.find("\"" + key + "\":", from);
+    if (at == std::string::npos) {
+        return std::nullopt;
+    }
+    return std::strtod(text.c_str() + at + key.size() + 3, nullptr);
+}
+
+auto compareBaseline(const std::string& path, const Summary& summary, double tolerance) -> bool {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open baseline " + path);
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    bool passed = true;
+    auto check = [&](const std::string& name, std::optional<double> baseline, double current, bool higherIsBetter) {
+        if (!baseline || *baseline <= 0) {
+            return;
+        }
+        double change = (current - *baseline) / *baseline;
+        bool regressed = higherIsBetter ? change < -tolerance : change > tolerance;
+        std::cout << "  " << std::left << std::setw(12) << name << std::right << std::setw(14) << *baseline
+                  << " -> " << std::setw(14) << current << "  (" << std::showpos << change * 100.0 << std::noshowpos
+                  << "%)" << (regressed ? "  REGRESSION" : "") << "\n";
+        passed = passed && !regressed;
+    };
+
+    std::cout << std::fixed << std::setprecision(1) << "\nBaseline comparison (tolerance "
+              << tolerance * 100.0 << "%):\n";
+    check("throughput", jsonNumber(text, "throughput"), summary.throughput(), true);
+    check("p50", jsonNumber(text, "p50", "latency_ns"), static_cast<double>(summary.latency.percentile(0.50)), false);
+    check("p99", jsonNumber(text, "p99", "latency_ns"), static_cast<double>(summary.latency.percentile(0.99)), false);
+    check("p999", jsonNumber(text, "p999", "latency_ns"), static_cast<double>(summary.latency.percentile(0.999)), false);
+    return passed;
+}
+
+void printSummary(const BenchmarkConfig& config, const Summary& summary) {
+    auto micros = [](uint64_t nanos) { return static_cast<double>(nanos) / 1000.0; };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "\n=== Results (" << (config.openLoop ? "open" : "closed") << " loop, " << summary.seconds << " s) ===\n";
+    std::cout << "Clients connected: " << summary.connected << " / " << config.clients << "\n";
+    std::cout << "Messages: " << summary.received << " echoed of " << summary.sent << " sent ("
+              << summary.lossRatio() * 100.0 << "% lost)\n";
+    std::cout << "Throughput: " << std::setprecision(0) << summary.throughput() << " msg/s, " << std::setprecision(2)
+              << static_cast<double>(summary.bytesReceived) * 8.0 / summary.seconds / 1e6 << " Mbit/s\n";
+    std::cout << "Latency (us): min " << micros(summary.latency.min()) << ", mean " << summary.latency.mean() / 1000.0;
+    for (const auto& [name, q] : percentiles()) {
+        std::cout << ", " << name << " " << micros(summary.latency.percentile(q));
+    }
+    std::cout << ", max " << micros(summary.latency.max()) << "\n";
+}
+
+int main(int argc, char** argv) {
+    try {
+        auto config = parseArgs(argc, argv);
+
+        if (!Library::initialize()) {
+            std::cerr << "Failed to initialize Icelander library\n";
+            return 1;
+        }
+
+        ShardConfig shardConfig;
+        shardConfig.shardCount = std::max<size_t>(1, config.serverShards);
+        shardConfig.pinThreads = false;
+        shardConfig.host.maxPeers = (config.clients + shardConfig.shardCount - 1) / shardConfig.shardCount;
+        shardConfig.host.maxChannels = 2;
+        auto server = ShardedHost::create(Endpoint::resolve(config.host, config.port), shardConfig);
+
+        // Echo on the channel the message came in on, with its reliability.
+        server->getDispatcher().onReceive([](const ReceiveEvent& event) {
+            auto flags = event.channel == RELIABLE_CHANNEL ? static_cast<PacketFlagsT>(PacketFlag::reliable) : PacketFlagsT{0};
+            event.peerHandle->send(event.channel, Packet::create(event.packetData->data(), flags));
+        });
+        server->start();
+
+        std::cout << "Load: " << config.clients << " clients on " << config.threads << " threads, "
+                  << (config.openLoop ? std::to_string(static_cast<uint64_t>(config.rate)) + " msg/s open loop"
+                                      : std::to_string(config.window) + " outstanding per client, closed loop")
+                  << ", mix " << mixToString(config.mix) << "\n";
+
+        auto epoch = Clock::now();
+        std::vector<std::unique_ptr<ClientThread>> clients;
+        for (size_t i = 0; i < config.threads; ++i) {
+            size_t count = config.clients / config.threads + (i < config.clients % config.threads ? 1 : 0);
+            clients.push_back(std::make_unique<ClientThread>(config, i, count, epoch));
+        }
+
+        // Every thread starts its schedule at the same instant, after the connect phase.
+        auto connectDeadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(config.connectTimeout));
+        auto start = connectDeadline + std::chrono::milliseconds(100);
+        std::atomic<size_t> ready{0};
+        std::vector<std::thread> threads;
+        for (auto& client : clients) {
+            threads.emplace_back([&client, connectDeadline, &ready, start] { client->run(connectDeadline, ready, start); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        server->stop();
+
+        Summary summary;
+        summary.seconds = config.duration;
+        for (const auto& client : clients) {
+            const auto& result = client->result();
+            summary.connected += result.connected;
+            summary.sent += result.sent;
+            summary.received += result.received;
+            summary.bytesSent += result.bytesSent;
+            summary.bytesReceived += result.bytesReceived;
+            summary.latency.merge(result.latency);
+        }
+        clients.clear();
+        server.reset();
+        Library::deinitialize();
+
+        printSummary(config, summary);
+
+        if (!config.jsonPath.empty()) {
+            std::ofstream(config.jsonPath) << toJson(config, summary);
+        }
+        if (!config.csvPath.empty()) {
+            appendCsv(config.csvPath, config, summary);
+        }
+        if (summary.connected < config.clients) {
+            std::cerr << "Only " << summary.connected << " of " << config.clients << " clients connected\n";
+            return 1;
+        }
+        if (!config.baselinePath.empty() && !compareBaseline(config.baselinePath, summary, config.tolerance)) {
+            return 2;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark error: " << e.what() << "\n";
+        return 1;
+    }
 }
\ No newline at end of file
@@ -1,8 +1,7 @@
 #include "../../include/icelander.hpp"
 #include <iostream>
 #include <string>
-#include <thread>
-#include <chrono>
+#include <vector>
 
 using namespace icelander;
 
@@ -15,7 +14,7 @@ int main() {
     }
 
     try {
-        Endpoint bind_addr{"localhost", 12346};
+        auto bind_addr = Endpoint::resolve("localhost", 12346);
         auto server_host = Host::createServer(bind_addr);
         auto client_host = Host::createClient();
 
@@ -32,7 +31,7 @@ int main() {
             std::cout << "Server received: " << reader.asString() << "\n";
         });
 
-        client_host->getDispatcher().onConnect([](const ConnectEvent& event) {
+        client_host->getDispatcher().onConnect([](const ConnectEvent&) {
             std::cout << "Client: Connected to server\n";
         });
 
@@ -47,22 +46,22 @@ int main() {
         std::cout << "Starting synchronous communication...\n";
         auto server_peer = client_host->connect(bind_addr);
 
-        // Service both hosts synchronously
-        for (int i = 0; i < 10; ++i) {
-            server_host->service(std::chrono::milliseconds(100));
-            client_host->service(std::chrono::milliseconds(100));
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
+        // Service both hosts from this thread at a fixed 20 Hz tick
+        std::vector<std::shared_ptr<Host>> hosts{server_host, client_host};
+        TickConfig tick_config;
+        tick_config.rate = 20.0;
+        auto stats = Host::runTickLoop(hosts, tick_config, [](const TickInfo& tick) {
+            return tick.tick < 40;
+        });
 
         std::cout << "Disconnecting...\n";
         server_peer->disconnect();
 
         // Allow time for graceful disconnect
-        for (int i = 0; i < 5; ++i) {
-            server_host->service(std::chrono::milliseconds(100));
-            client_host->service(std::chrono::milliseconds(100));
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
+        stats = Host::runTickLoop(hosts, tick_config, [](const TickInfo& tick) {
+            return tick.tick < 20;
+        });
+        std::cout << "Ticks: " << stats.ticks << ", overruns: " << stats.overruns << "\n";
 
         std::cout << "Sync example completed successfully!\n";
 
@@ -0,0 +1,276 @@
+#include "../../include/icelander.hpp"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace icelander;
+
+// Every benchmark reports heap_allocs/op (global operator new) and pool_allocs/op
+// (Icelander's packet pool, which also backs ENet packets and Packet wrappers).
+
+namespace {
+    std::atomic<uint64_t> heapAllocations{0};
+
+    auto poolAllocations() -> uint64_t {
+        auto stats = Library::allocatorStats();
+        return stats.hits + stats.misses + stats.oversized;
+    }
+
+    // Attaches per-iteration allocation counts when it goes out of scope. In threaded
+    // benchmarks only thread 0 reports, since the counters are process-wide.
+    class AllocationCounter {
+    public:
+        explicit AllocationCounter(benchmark::State& state)
+            : state_(state)
+            , heap_(heapAllocations.load(std::memory_order_relaxed))
+            , pool_(poolAllocations()) {}
+
+        ~AllocationCounter() {
+            if (state_.thread_index() != 0) {
+                return;
+            }
+            auto heap = heapAllocations.load(std::memory_order_relaxed) - heap_;
+            auto pool = poolAllocations() - pool_;
+            state_.counters["heap_allocs/op"] = benchmark::Counter(static_cast<double>(heap), benchmark::Counter::kAvgIterations);
+            state_.counters["pool_allocs/op"] = benchmark::Counter(static_cast<double>(pool), benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        benchmark::State& state_;
+        uint64_t heap_;
+        uint64_t pool_;
+    };
+
+    // Fake ENet slots so registry lookups run without sockets or a Host.
+    struct PeerTable {
+        explicit PeerTable(size_t count) : nativePeers(count), registry(count) {
+            for (size_t i = 0; i < count; ++i) {
+                nativePeers[i].incomingPeerID = static_cast<enet_uint16>(i);
+                nativePeers[i].connectID = static_cast<enet_uint32>(1000 + i);
+                nativePeers[i].address = Endpoint::parse("10.0.0.1", static_cast<uint16_t>(20000 + i)).toEnetAddress();
+                registry.insert(std::make_shared<Peer>(&nativePeers[i], nullptr));
+            }
+        }
+
+        std::vector<ENetPeer> nativePeers;
+        PeerRegistry registry;
+        std::mutex mutex;   // stands in for the peer lock Host holds around its lookups
+    };
+}
+
+auto operator new(size_t size) -> void* {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator new[](size_t size) -> void* {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+static void BM_BuilderWriteScalars(benchmark::State& state) {
+    PacketBuilder builder(256);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        builder.clear();
+        for (int i = 0; i < 8; ++i) {
+            builder.writeUint8(0x12).writeUint16(0x1234).writeUint32(0x12345678).writeUint64(0x123456789ABCDEF0);
+        }
+        benchmark::DoNotOptimize(builder.data().data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * 8 * 15);
+}
+BENCHMARK(BM_BuilderWriteScalars);
+
+static void BM_BuilderWriteVarUint(benchmark::State& state) {
+    PacketBuilder builder(256);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        builder.clear();
+        for (uint64_t value = 1; value < (uint64_t{1} << 56); value <<= 7) {
+            builder.writeVarUint(value);
+        }
+        benchmark::DoNotOptimize(builder.data().data());
+    }
+}
+BENCHMARK(BM_BuilderWriteVarUint);
+
+static void BM_BuilderWriteBytes(benchmark::State& state) {
+    std::vector<uint8_t> payload(static_cast<size_t>(state.range(0)), 0xAB);
+    PacketBuilder builder(payload.size());
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        builder.clear();
+        builder.write(payload.data(), payload.size());
+        benchmark::DoNotOptimize(builder.data().data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_BuilderWriteBytes)->Arg(64)->Arg(512)->Arg(1200);
+
+// build() hands its buffer to the packet, so each iteration also allocates the next one.
+static void BM_BuilderBuild(benchmark::State& state) {
+    std::vector<uint8_t> payload(static_cast<size_t>(state.range(0)), 0xAB);
+    PacketBuilder builder(payload.size());
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        builder.write(payload.data(), payload.size());
+        auto packet = builder.build();
+        benchmark::DoNotOptimize(packet.get());
+    }
+}
+BENCHMARK(BM_BuilderBuild)->Arg(64)->Arg(1200);
+
+static void BM_ReaderScalars(benchmark::State& state) {
+    PacketBuilder builder(256);
+    for (int i = 0; i < 8; ++i) {
+        builder.writeUint8(0x12).writeUint16(0x1234).writeUint32(0x12345678).writeUint64(0x123456789ABCDEF0);
+    }
+    auto packet = builder.build();
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        PacketReader reader(*packet);
+        uint64_t sum = 0;
+        for (int i = 0; i < 8; ++i) {
+            sum += reader.readUint8() + reader.readUint16() + reader.readUint32() + reader.readUint64();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(packet->size()));
+}
+BENCHMARK(BM_ReaderScalars);
+
+static void BM_ReaderVarUint(benchmark::State& state) {
+    PacketBuilder builder(256);
+    size_t count = 0;
+    for (uint64_t value = 1; value < (uint64_t{1} << 56); value <<= 7, ++count) {
+        builder.writeVarUint(value);
+    }
+    auto packet = builder.build();
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        PacketReader reader(*packet);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < count; ++i) {
+            sum += reader.readVarUint();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+BENCHMARK(BM_ReaderVarUint);
+
+static void BM_PacketCreateDestroy(benchmark::State& state) {
+    std::vector<uint8_t> payload(static_cast<size_t>(state.range(0)), 0xCD);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        auto packet = Packet::create(static_cast<const void*>(payload.data()), payload.size());
+        benchmark::DoNotOptimize(packet.get());
+    }
+}
+BENCHMARK(BM_PacketCreateDestroy)->Arg(64)->Arg(1200)->Arg(8192);
+
+static void BM_DispatchReceive(benchmark::State& state) {
+    EventDispatcher dispatcher;
+    uint64_t calls = 0;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        dispatcher.onReceive([&calls](const ReceiveEvent&) { ++calls; });
+    }
+    ReceiveEvent event;
+    event.channel = 0;
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        dispatcher.dispatchReceive(event);
+    }
+    benchmark::DoNotOptimize(calls);
+}
+BENCHMARK(BM_DispatchReceive)->Arg(1)->Arg(4)->Arg(16);
+
+// PeerRegistry::find under a mutex, the core of Host::findPeerByNative. Measures the
+// registry only; the host and ENet are not involved.
+static void BM_PeerRegistryFind(benchmark::State& state) {
+    PeerTable table(static_cast<size_t>(state.range(0)));
+    size_t next = 0;
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        std::lock_guard<std::mutex> lock(table.mutex);
+        auto peer = table.registry.find(&table.nativePeers[next]);
+        benchmark::DoNotOptimize(peer.get());
+        next = next + 1 == table.nativePeers.size() ? 0 : next + 1;
+    }
+}
+BENCHMARK(BM_PeerRegistryFind)->Arg(32)->Arg(1024)->Arg(4096);
+
+// PeerRegistry::snapshot under a mutex, the core of Host::getPeers. Measures the
+// registry only; the host and ENet are not involved.
+static void BM_PeerRegistrySnapshot(benchmark::State& state) {
+    PeerTable table(static_cast<size_t>(state.range(0)));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        std::lock_guard<std::mutex> lock(table.mutex);
+        auto peers = table.registry.snapshot();
+        benchmark::DoNotOptimize(peers.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_PeerRegistrySnapshot)->Arg(32)->Arg(1024)->Arg(4096);
+
+// schedule() from several producer threads while the workers drain. Producers pause
+// untimed every batch so the queue cannot grow without bound.
+static void BM_ScheduleContended(benchmark::State& state) {
+    auto& scheduler = async::TaskScheduler::instance();
+    constexpr int64_t batch = 4096;
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        scheduler.schedule([] {});
+        if (state.iterations() % batch == 0) {
+            state.PauseTiming();
+            while (scheduler.pendingTasks() > static_cast<size_t>(batch * state.threads())) {
+                std::this_thread::yield();
+            }
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_ScheduleContended)->ThreadRange(1, 8)->UseRealTime();
+
+int main(int argc, char** argv) {
+    // Pooled, as a production host would run; ENet allocations then show in pool_allocs/op.
+    if (!Library::initialize(AllocatorConfig{})) {
+        return 1;
+    }
+    async::TaskScheduler::instance().start();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    async::TaskScheduler::instance().stop();
+    Library::deinitialize();
+    return 0;
+}
\ No newline at end of file
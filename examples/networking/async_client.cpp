@@ -7,6 +7,22 @@
 using namespace icelander;
 using namespace icelander::async;
 
+Task<std::shared_ptr<Peer>> connect_to_server(std::shared_ptr<Host> host, Endpoint server_addr) {
+    auto peer = co_await host->connectAsync(server_addr, 2);
+    if (!peer) {
+        throw std::runtime_error("Connection to server failed");
+    }
+    co_return peer;
+}
+
+Task<> print_messages(std::shared_ptr<Peer> server_peer) {
+    while (auto pkt = co_await server_peer->receive(0)) {
+        PacketReader reader(*pkt);
+        std::cout << "Server says: " << reader.asString() << "\n";
+    }
+    std::cout << "Receive loop finished\n";
+}
+
 int main() {
     std::cout << "=== Async Client Example ===\n";
     
@@ -22,25 +38,21 @@ int main() {
         };
 
         auto client_host = Host::createClient(config);
-        Endpoint server_addr{"localhost", 12345};
-
-        client_host->getDispatcher().onReceive([](const ReceiveEvent& event) {
-            PacketReader reader(*event.packetData);
-            auto message = reader.asString();
-            std::cout << "Server says: " << message << "\n";
-        });
+        auto server_addr = Endpoint::resolve("localhost", 12345);
 
-        client_host->getDispatcher().onDisconnect([](const DisconnectEvent& event) {
+        client_host->getDispatcher().onDisconnect([](const DisconnectEvent&) {
             std::cout << "Disconnected from server\n";
         });
 
-        std::cout << "Connecting to server at " << server_addr.host << ":" << server_addr.port << "\n";
-        auto server_peer = client_host->connect(server_addr);
-        std::cout << "Connected to server\n";
-
         TaskScheduler::instance().start();
         client_host->startServiceThread();
 
+        std::cout << "Connecting to server at " << server_addr.toString() << "\n";
+        auto server_peer = connect_to_server(client_host, server_addr).get();
+        std::cout << "Connected to server\n";
+
+        TaskScheduler::instance().scheduleTask(print_messages(server_peer));
+
         std::string input;
         std::cout << "Enter messages (type 'quit' to exit):\n";
         while (std::getline(std::cin, input)) {
@@ -16,7 +16,7 @@ int main() {
     }
 
     try {
-        Endpoint bind_addr{"localhost", 12345};
+        auto bind_addr = Endpoint::resolve("localhost", 12345);
         HostConfig config{
             .maxPeers = 32,
             .maxChannels = 2,
@@ -24,11 +24,10 @@ int main() {
         };
 
         auto server_host = Host::createServer(bind_addr, config);
-        std::cout << "Server started on " << bind_addr.host << ":" << bind_addr.port << "\n";
+        std::cout << "Server started on " << bind_addr.toString() << "\n";
 
         server_host->getDispatcher().onConnect([](const ConnectEvent& event) {
-            std::cout << "Client connected from " << event.remoteEndpoint.host
-                      << ":" << event.remoteEndpoint.port << "\n";
+            std::cout << "Client connected from " << event.remoteEndpoint.toString() << "\n";
             event.peerHandle->send(Packet::create("Welcome to the server!", 
                 static_cast<PacketFlagsT>(PacketFlag::reliable)));
         });
@@ -49,8 +48,7 @@ int main() {
         });
 
         server_host->getDispatcher().onDisconnect([](const DisconnectEvent& event) {
-            std::cout << "Client disconnected from " << event.remoteEndpoint.host
-                      << ":" << event.remoteEndpoint.port << "\n";
+            std::cout << "Client disconnected from " << event.remoteEndpoint.toString() << "\n";
         });
 
         TaskScheduler::instance().start();
@@ -1,7 +1,26 @@
 #include "icelander.hpp"
+#include "accept_guard.hpp"
+#include "capture.hpp"
+#include "channel_scheduler.hpp"
+#include "compressor.hpp"
+#include "stream.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <new>
 #include <string>
 #include <thread>
+#include <vector>
 
 using namespace icelander;
 
@@ -35,6 +54,69 @@ void test_packet_operations() {
     std::cout << "Read message: " << message << "\n";
     std::cout << "Read number: " << number << "\n";
     std::cout << "Read byte: " << static_cast<int>(byte_val) << "\n";
+
+    // Builder storage is handed to the packet and the builder stays reusable
+    PacketBuilder reusable(16);
+    for (uint32_t round = 0; round < 3; ++round) {
+        for (uint32_t i = 0; i < 100; ++i) {
+            reusable.writeUint32(round * 1000 + i);
+        }
+        auto built = reusable.build();
+        PacketReader check(*built);
+        if (built->size() != 400 || check.readUint32() != round * 1000 || !reusable.empty()) {
+            throw std::runtime_error("Reusable builder produced wrong packet");
+        }
+    }
+
+    reusable.writeUint64(1).reset();
+    if (reusable.size() != 0 || reusable.capacity() < 400 || reusable.build()->size() != 0) {
+        throw std::runtime_error("Builder reset did not keep its storage");
+    }
+    std::cout << "Zero-copy builder reuse passed\n";
+
+    // Coalesced layout: uint16 length + bytes, with a truncated entry at the end
+    PacketBuilder batch;
+    batch.writeUint16(4).writeUint32(7).writeUint16(2).writeUint16(9).writeUint16(50).writeUint8(1);
+    auto coalesced = batch.build();
+    std::vector<uint32_t> values;
+    for (auto sub : SubMessages(*coalesced)) {
+        values.push_back(sub.size() == 4 ? sub.readUint32() : sub.readUint16());
+    }
+    if (values != std::vector<uint32_t>{7, 9}) {
+        throw std::runtime_error("Sub-message iteration returned wrong messages");
+    }
+    std::cout << "Sub-message iteration passed\n";
+
+    // Compact encodings: varints, bit fields, quantized floats and bulk arrays
+    PacketBuilder compact;
+    compact.writeVarUint(300).writeVarInt(-2).writeVarUint(UINT64_MAX).writeVarString("hi");
+    BitWriter bits(compact);
+    bits.writeBits(5, 3).writeBool(true).writeQuantized(0.25f, -1.0f, 1.0f, 12).flush();
+    const std::array<float, 3> floats{1.5f, -2.0f, 3.25f};
+    compact.writeArray(floats.data(), floats.size()).writeUint16(0xBEEF);
+    auto encoded = compact.build();
+
+    PacketReader decoder(*encoded);
+    if (encoded->data()[0] != 0xAC || encoded->data()[1] != 0x02) {
+        throw std::runtime_error("Varint is not LEB128");
+    }
+    if (decoder.readVarUint() != 300 || decoder.readVarInt() != -2 || decoder.readVarUint() != UINT64_MAX ||
+        decoder.readVarString() != "hi") {
+        throw std::runtime_error("Varint round trip failed");
+    }
+    BitReader bitReader(decoder);
+    auto field = bitReader.readBits(3);
+    auto flag = bitReader.readBool();
+    auto quantized = bitReader.readQuantized(-1.0f, 1.0f, 12);
+    bitReader.align();
+    if (field != 5 || !flag || quantized < 0.249f || quantized > 0.251f) {
+        throw std::runtime_error("Bit field round trip failed");
+    }
+    if (decoder.readArray<float>(3) != std::vector<float>(floats.begin(), floats.end()) ||
+        decoder.readUint16() != 0xBEEF || !decoder.atEnd()) {
+        throw std::runtime_error("Array round trip failed");
+    }
+    std::cout << "Compact encoding round trip passed (" << encoded->size() << " bytes)\n";
 }
 
 void test_library_functions() {
@@ -50,16 +132,321 @@ void test_library_functions() {
     } else {
         std::cout << "Failed to initialize library\n";
     }
+
+    if (!Library::supportsCompression(CompressionAlgorithm::rangeCoder)) {
+        throw std::runtime_error("Range coder should always be available");
+    }
+    std::cout << "LZ4 compression: " << (Library::supportsCompression(CompressionAlgorithm::lz4) ? "Yes" : "No") << "\n";
+    std::cout << "zstd compression: " << (Library::supportsCompression(CompressionAlgorithm::zstd) ? "Yes" : "No") << "\n";
+    if (!Library::supportsSocketBackend(SocketBackend::standard)) {
+        throw std::runtime_error("Standard socket backend should always be available");
+    }
+    std::cout << "Batched sockets: " << (Library::supportsSocketBackend(SocketBackend::batched) ? "Yes" : "No") << "\n";
 }
 
 void test_endpoint_operations() {
     std::cout << "=== Testing Endpoint Operations ===\n";
     
-    Endpoint ep1{"localhost", 8080};
-    std::cout << "Created endpoint: " << ep1.host << ":" << ep1.port << "\n";
+    auto ep1 = Endpoint::any(8080);
+    std::cout << "Created endpoint: " << ep1.toString() << "\n";
     
-    Endpoint ep2{"127.0.0.1", 12345};
-    std::cout << "Created endpoint: " << ep2.host << ":" << ep2.port << "\n";
+    auto ep2 = Endpoint::parse("127.0.0.1", 12345);
+    std::cout << "Created endpoint: " << ep2.toString() << "\n";
+
+    if (ep2.toString() != "127.0.0.1:12345") {
+        throw std::runtime_error("Numeric endpoint formatting failed");
+    }
+    if (Endpoint::fromEnetAddress(ep2.toEnetAddress()) != ep2 ||
+        std::hash<Endpoint>{}(ep2) != std::hash<Endpoint>{}(Endpoint::parse("127.0.0.1", 12345))) {
+        throw std::runtime_error("Endpoint round trip or hash mismatch");
+    }
+}
+
+void test_peer_registry() {
+    std::cout << "=== Testing Peer Registry ===\n";
+
+    ENetPeer nativePeers[4] = {};
+    for (uint16_t i = 0; i < 4; ++i) {
+        nativePeers[i].incomingPeerID = i;
+        nativePeers[i].connectID = 100 + i;
+    }
+
+    for (uint16_t i = 0; i < 4; ++i) {
+        nativePeers[i].address = Endpoint::parse("10.0.0.1", static_cast<uint16_t>(5000 + i)).toEnetAddress();
+    }
+
+    PeerRegistry registry(4);
+    auto peer = std::make_shared<Peer>(&nativePeers[2], nullptr);
+    auto handle = registry.insert(peer);
+
+    if (registry.size() != 1 || registry.find(&nativePeers[2]) != peer || registry.find(handle) != peer) {
+        throw std::runtime_error("Registry lookup failed");
+    }
+    if (registry.get(&nativePeers[2]) != peer.get() || registry.get(&nativePeers[1]) != nullptr) {
+        throw std::runtime_error("Registry raw lookup failed");
+    }
+    if (registry.find(&nativePeers[1]) != nullptr) {
+        throw std::runtime_error("Registry returned peer for empty slot");
+    }
+
+    if (registry.find(Endpoint::parse("10.0.0.1", 5002)) != peer || registry.find(Endpoint::parse("10.0.0.1", 5001))) {
+        throw std::runtime_error("Registry endpoint index failed");
+    }
+
+    // A new connection on the same slot must not resolve to the old wrapper.
+    nativePeers[2].connectID = 200;
+    if (registry.findConnection(&nativePeers[2]) != nullptr || registry.find(&nativePeers[2]) != peer) {
+        throw std::runtime_error("Registry connection check failed after reconnect");
+    }
+
+    registry.remove(&nativePeers[2]);
+    if (registry.size() != 0 || registry.find(handle) != nullptr || peer->handle().valid() ||
+        registry.find(Endpoint::parse("10.0.0.1", 5002)) != nullptr) {
+        throw std::runtime_error("Registry kept removed peer");
+    }
+
+    std::cout << "Slot lookup, stale-connection and generation checks passed\n";
+}
+
+void test_event_dispatch() {
+    std::cout << "=== Testing Event Dispatch ===\n";
+
+    EventDispatcher dispatcher;
+    int any = 0;
+    int onThree = 0;
+    dispatcher.onReceive([&any](const ReceiveEvent&) { ++any; });
+    dispatcher.onReceive(3, [&onThree](const ReceiveEvent&) { ++onThree; });
+
+    ReceiveEvent event;
+    event.channel = 3;
+    dispatcher.dispatchReceive(event);
+    event.channel = 1;
+    dispatcher.dispatchReceive(event);
+
+    if (any != 2 || onThree != 1) {
+        throw std::runtime_error("Channel handlers dispatched incorrectly");
+    }
+
+    int connects = 0;
+    int staticOnThree = 0;
+    StaticDispatcher typed(
+        [&connects](const ConnectEvent&) { ++connects; },
+        onChannel<3>([&staticOnThree](const ReceiveEvent&) { ++staticOnThree; }));
+    static_assert(EventSink<decltype(typed)>);
+
+    typed.dispatchConnect(ConnectEvent{});
+    typed.dispatchReceive(event);
+    event.channel = 3;
+    typed.dispatchReceive(event);
+
+    if (connects != 1 || staticOnThree != 1) {
+        throw std::runtime_error("Static dispatcher routed events incorrectly");
+    }
+
+    EventRef ref;
+    if (ref.type != EventType::none || ref.peer.valid() || !ref.packet.empty() || ref.packet.retain()) {
+        throw std::runtime_error("Default EventRef should be empty");
+    }
+    std::cout << "Dynamic and static dispatch routed by channel\n";
+}
+
+enum class Team : uint8_t { red = 1, blue = 2 };
+
+struct PlayerInfoV1 {
+    uint32_t id = 0;
+    std::string name;
+    std::vector<uint16_t> items;
+};
+
+struct PlayerInfo {
+    uint32_t id = 0;
+    std::string name;
+    std::vector<uint16_t> items;
+    Team team = Team::red;
+};
+
+struct Position {
+    std::array<float, 3> xyz{};
+    uint16_t zone = 0;
+};
+
+struct Seat {
+    bool ready = false;
+    uint8_t slot = 0;
+};
+
+template<> struct icelander::Schema<PlayerInfoV1> {
+    static constexpr uint16_t version = 1;
+    using Fields = FieldList<Field<&PlayerInfoV1::id>, Field<&PlayerInfoV1::name>, Field<&PlayerInfoV1::items>>;
+};
+
+template<> struct icelander::Schema<PlayerInfo> {
+    static constexpr uint16_t version = 2;
+    using Fields = FieldList<Field<&PlayerInfo::id>, Field<&PlayerInfo::name>, Field<&PlayerInfo::items>,
+                             Field<&PlayerInfo::team, 2>>;
+};
+
+template<> struct icelander::Schema<Position> {
+    static constexpr uint16_t version = 1;
+    using Fields = FieldList<Field<&Position::xyz>, Field<&Position::zone>>;
+};
+
+template<> struct icelander::Schema<Seat> {
+    static constexpr uint16_t version = 1;
+    using Fields = FieldList<Field<&Seat::ready>, Field<&Seat::slot>>;
+};
+
+// bool fields get their own codec; bool is not an array element, so vector<bool> is rejected
+template<typename T>
+concept HasFieldCodec = requires { icelander::detail::FieldCodec<T>::wireSize; };
+static_assert(!WireScalar<bool> && HasFieldCodec<bool> && HasFieldCodec<std::vector<uint8_t>>);
+static_assert(!HasFieldCodec<std::vector<bool>> && !HasFieldCodec<std::array<bool, 4>>);
+
+void test_schema_serialization() {
+    std::cout << "=== Testing Schema Serialization ===\n";
+
+    PacketBuilder builder;
+    builder.writeSchema(PlayerInfo{7, "ada", {3, 5, 8}, Team::blue});
+    auto current = builder.build();
+
+    PacketView<PlayerInfo> view(*current);
+    if (!view || view.get<&PlayerInfo::id>() != 7 || view.get<&PlayerInfo::name>() != "ada" ||
+        view.get<&PlayerInfo::items>().size() != 3 || view.get<&PlayerInfo::items>()[2] != 8 ||
+        view.get<&PlayerInfo::team>() != Team::blue) {
+        throw std::runtime_error("Packet view read wrong fields");
+    }
+
+    // A v1 reader ignores the newer field; a v2 reader of a v1 packet keeps the default
+    PacketReader newer(*current);
+    auto asV1 = newer.readSchema<PlayerInfoV1>();
+    builder.writeSchema(PlayerInfoV1{9, "bob", {}});
+    auto previous = builder.build();
+    PacketReader older(*previous);
+    auto asV2 = older.readSchema<PlayerInfo>();
+    if (!asV1 || asV1->name != "ada" || asV1->items != std::vector<uint16_t>{3, 5, 8} || !newer.atEnd() ||
+        !asV2 || asV2->id != 9 || asV2->team != Team::red || !older.atEnd()) {
+        throw std::runtime_error("Schema versions did not interoperate");
+    }
+
+    // Truncation is caught by the up-front validation
+    auto truncated = current->toVector();
+    truncated.pop_back();
+    if (PacketView<PlayerInfo>(Span<const uint8_t>(truncated.data(), truncated.size()))) {
+        throw std::runtime_error("Truncated packet passed validation");
+    }
+
+    builder.writeSchema(Position{{1.0f, 2.0f, 3.0f}, 4});
+    auto fixed = builder.build();
+    PacketView<Position> position(*fixed);
+    if (fixed->size() != 16 || !position || position.get<&Position::xyz>()[1] != 2.0f || position.get<&Position::zone>() != 4) {
+        throw std::runtime_error("Fixed-layout schema read wrong fields");
+    }
+
+    builder.writeSchema(Seat{true, 3});
+    auto seat = builder.build();
+    auto seatBytes = seat->toVector();
+    seatBytes[2] = 0x7F;
+    PacketReader seatReader(Span<const uint8_t>(seatBytes.data(), seatBytes.size()));
+    auto decodedSeat = seatReader.readSchema<Seat>();
+    if (seat->size() != 4 || !PacketView<Seat>(*seat).get<&Seat::ready>() || !decodedSeat ||
+        !decodedSeat->ready || decodedSeat->slot != 3) {
+        throw std::runtime_error("bool field did not round trip as one byte");
+    }
+    std::cout << "Schema round trip, versioning and validation passed\n";
+}
+
+struct ReplicatedState {
+    float position[3];
+    uint32_t health;
+    uint8_t inventory[60];
+};
+
+void test_delta_replication() {
+    std::cout << "=== Testing Delta Replication ===\n";
+
+    SnapshotSender<ReplicatedState> sender;
+    SnapshotReceiver<ReplicatedState> receiver;
+
+    ReplicatedState state{};
+    state.position[0] = 1.0f;
+    state.health = 100;
+    for (size_t i = 0; i < sizeof(state.inventory); ++i) {
+        state.inventory[i] = static_cast<uint8_t>(i + 1);
+    }
+
+    auto full = sender.encode(state);
+    auto decoded = receiver.decode(*full);
+    if (!decoded || std::memcmp(&*decoded, &state, sizeof(state)) != 0) {
+        throw std::runtime_error("Initial snapshot did not round-trip");
+    }
+    sender.acknowledge(*receiver.makeAck());
+
+    state.health = 90;
+    auto delta = sender.encode(state);
+    decoded = receiver.decode(*delta);
+    if (!decoded || decoded->health != 90 || std::memcmp(&*decoded, &state, sizeof(state)) != 0) {
+        throw std::runtime_error("Delta snapshot did not round-trip");
+    }
+    if (delta->size() >= full->size() / 4) {
+        throw std::runtime_error("Delta snapshot was not smaller than the full state");
+    }
+
+    // Late and duplicate snapshots are rejected
+    if (receiver.decode(*full)) {
+        throw std::runtime_error("Stale snapshot was accepted");
+    }
+
+    std::cout << "Full snapshot " << full->size() << " bytes, delta " << delta->size() << " bytes\n";
+}
+
+void test_allocator_pool() {
+    std::cout << "=== Testing Pooled Allocator ===\n";
+
+    AllocatorConfig config;
+    config.maxPooledSize = 2048;
+    if (!Library::initialize(config)) {
+        throw std::runtime_error("Failed to initialize library with pooled allocator");
+    }
+
+    auto before = Library::allocatorStats();
+    for (int round = 0; round < 4; ++round) {
+        std::vector<std::unique_ptr<Packet>> packets;
+        for (int i = 0; i < 200; ++i) {
+            packets.push_back(Packet::create("pooled payload"));
+        }
+        packets.push_back(Packet::create(std::string(8192, 'x')));
+    }
+    auto after = Library::allocatorStats();
+
+    std::cout << "Pool hits: " << (after.hits - before.hits)
+              << ", misses: " << (after.misses - before.misses)
+              << ", oversized: " << (after.oversized - before.oversized) << "\n";
+
+    if (after.hits - before.hits <= after.misses - before.misses || after.oversized == before.oversized) {
+        throw std::runtime_error("Pooled allocator did not recycle blocks");
+    }
+
+    // Constructed before the thread's cache, so destroyed after it: these blocks must
+    // bypass the dead cache.
+    struct LateFree {
+        std::unique_ptr<Packet> packet;
+        ~LateFree() {
+            packet.reset();
+            auto again = Packet::create("allocated after the cache");
+        }
+    };
+    auto retired = Library::allocatorStats();
+    std::thread([] {
+        thread_local LateFree late;
+        late.packet = Packet::create("freed after the cache");
+    }).join();
+    auto exited = Library::allocatorStats();
+    if (exited.hits + exited.misses == retired.hits + retired.misses) {
+        throw std::runtime_error("Exited thread's cache was not retired");
+    }
+    std::cout << "Blocks freed after the thread cache was destroyed went to the shared lists\n";
+
+    Library::deinitialize();
 }
 
 void test_async_scheduler() {
@@ -81,23 +468,1813 @@ void test_async_scheduler() {
     scheduler.stop();
     
     std::cout << "Task was " << (task_executed ? "" : "not ") << "executed\n";
+
+    // stop() must run everything queued, including tasks spawned by tasks
+    std::atomic<int> completed{0};
+    std::array<char, 128> large{};
+    scheduler.start(async::SchedulerConfig{.threadCount = 2});
+    for (int i = 0; i < 1000; ++i) {
+        scheduler.schedule([&scheduler, &completed] {
+            scheduler.schedule([&completed] { completed.fetch_add(1); });
+            completed.fetch_add(1);
+        });
+    }
+    scheduler.schedule([&completed, large] { completed.fetch_add(1 + large[0]); });
+    scheduler.stop();
+
+    if (completed.load() != 2001 || scheduler.pendingTasks() != 0) {
+        throw std::runtime_error("Scheduler stopped before draining its queue");
+    }
+    std::cout << "Drained " << completed.load() << " tasks on stop\n";
 }
 
-int main() {
-    std::cout << "Icelander Library Test Suite\n";
-    std::cout << "============================\n\n";
-    
+void test_metrics() {
+    std::cout << "=== Testing Metrics ===\n";
+
+    LatencyHistogram histogram;
+    histogram.buckets[3] = 90;    // [4, 8) us
+    histogram.buckets[10] = 10;   // [512, 1024) us
+    histogram.count = 100;
+    histogram.total = std::chrono::microseconds(10000);
+    if (histogram.quantile(0.5) != std::chrono::microseconds(8) ||
+        histogram.quantile(0.99) != std::chrono::microseconds(1024) ||
+        histogram.mean() != std::chrono::microseconds(100)) {
+        throw std::runtime_error("Latency histogram quantiles are wrong");
+    }
+
+    LatencyHistogram recorded;
+    recorded.record(std::chrono::microseconds(5));
+    recorded.record(std::chrono::microseconds(600));
+    if (recorded.count != 2 || recorded.buckets[3] != 1 || recorded.buckets[10] != 1) {
+        throw std::runtime_error("Latency histogram recorded into the wrong buckets");
+    }
+
+    HostMetrics hostMetrics;
+    hostMetrics.channels.resize(2);
+    hostMetrics.channels[1] = ChannelMetrics{3, 300, 1, 50};
+    hostMetrics.serviceTime = histogram;
+    auto text = hostMetrics.toPrometheus("test");
+    if (text.find("test_bytes_received_total{channel=\"1\"} 300\n") == std::string::npos ||
+        text.find("test_service_seconds_count 100\n") == std::string::npos ||
+        text.find("{channel=\"0\"}") != std::string::npos) {
+        throw std::runtime_error("Prometheus output is missing series");
+    }
+
+    if constexpr (METRICS_ENABLED) {
+        auto& scheduler = async::TaskScheduler::instance();
+        scheduler.start(async::SchedulerConfig{.threadCount = 2});
+        for (int i = 0; i < 100; ++i) {
+            scheduler.schedule([] {});
+        }
+        auto schedulerMetrics = scheduler.metrics();
+        for (int i = 0; i < 200 && schedulerMetrics.tasksExecuted < 100; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            schedulerMetrics = scheduler.metrics();
+        }
+        scheduler.stop();
+
+        if (schedulerMetrics.workers != 2 || schedulerMetrics.tasksExecuted != 100) {
+            throw std::runtime_error("Scheduler metrics did not count executed tasks");
+        }
+        std::cout << "Scheduler ran " << schedulerMetrics.tasksExecuted << " tasks, "
+                  << schedulerMetrics.tasksStolen << " stolen\n";
+    }
+}
+
+async::Task<int> add_after_sleep(int a, int b) {
+    co_await async::sleepFor(std::chrono::milliseconds(5));
+    co_return a + b;
+}
+
+async::Task<int> sum_chain() {
+    int first = co_await add_after_sleep(1, 2);
+    int second = co_await add_after_sleep(first, 4);
+    co_return second;
+}
+
+async::Task<> throw_after_sleep() {
+    co_await async::sleepFor(std::chrono::milliseconds(1));
+    throw std::runtime_error("expected");
+}
+
+void test_coroutine_tasks() {
+    std::cout << "=== Testing Coroutine Tasks ===\n";
+
+    // Resumed inline by the timer thread while the scheduler is stopped
+    if (sum_chain().get() != 7) {
+        throw std::runtime_error("Coroutine chain returned the wrong value");
+    }
+
+    bool caught = false;
     try {
-        test_library_functions();
-        std::cout << "\n";
-        
-        test_endpoint_operations();
-        std::cout << "\n";
-        
-        test_packet_operations();
-        std::cout << "\n";
-        
-        test_async_scheduler();
+        throw_after_sleep().get();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    if (!caught) {
+        throw std::runtime_error("Coroutine exception was not propagated");
+    }
+
+    // Started by resume() and parked on the timer: get() must only wait for it.
+    auto started = add_after_sleep(2, 3);
+    started.resume();
+    started.resume();
+    if (started.get() != 5 || !started.done()) {
+        throw std::runtime_error("get() on a running task returned the wrong value");
+    }
+
+    auto& scheduler = async::TaskScheduler::instance();
+    scheduler.start(async::SchedulerConfig{.threadCount = 2});
+
+    std::atomic<int> result{0};
+    auto detached = [](std::atomic<int>& out) -> async::Task<> {
+        out = co_await sum_chain();
+    };
+    scheduler.scheduleTask(detached(result));
+
+    for (int i = 0; i < 200 && result.load() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    scheduler.stop();
+
+    if (result.load() != 7) {
+        throw std::runtime_error("Scheduled coroutine did not complete");
+    }
+    std::cout << "Coroutine chain completed on the scheduler\n";
+}
+
+// A CONNECT datagram laid out the way enet_host_connect sends it.
+std::vector<uint8_t> connect_datagram(uint32_t channelCount, uint32_t mtu, uint32_t windowSize, uint16_t headerFlags = 0, bool checksum = false) {
+    ENetProtocolConnect connect{};
+    connect.header.command = static_cast<enet_uint8>(ENET_PROTOCOL_COMMAND_CONNECT) | static_cast<enet_uint8>(ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE);
+    connect.channelCount = ENET_HOST_TO_NET_32(channelCount);
+    connect.mtu = ENET_HOST_TO_NET_32(mtu);
+    connect.windowSize = ENET_HOST_TO_NET_32(windowSize);
+
+    uint16_t peerId = ENET_HOST_TO_NET_16(static_cast<uint16_t>(ENET_PROTOCOL_MAXIMUM_PEER_ID | headerFlags));
+    size_t headerSize = (headerFlags & ENET_PROTOCOL_HEADER_FLAG_SENT_TIME) ? sizeof(ENetProtocolHeader) : sizeof(peerId);
+    if (checksum) {
+        headerSize += sizeof(uint32_t);
+    }
+    std::vector<uint8_t> datagram(headerSize + sizeof(connect));
+    std::memcpy(datagram.data(), &peerId, sizeof(peerId));
+    std::memcpy(datagram.data() + headerSize, &connect, sizeof(connect));
+    return datagram;
+}
+
+// Runs the host's intercept hook on a datagram; true when it was dropped.
+bool intercepted(ENetHost& nativeHost, std::vector<uint8_t> datagram, uint32_t address = 0x0100007f) {
+    nativeHost.receivedData = datagram.data();
+    nativeHost.receivedDataLength = datagram.size();
+    nativeHost.receivedAddress.host = address;
+    ENetEvent event{};
+    return nativeHost.intercept(&nativeHost, &event) == 1;
+}
+
+enet_uint32 ENET_CALLBACK zero_checksum(const ENetBuffer*, size_t) {
+    return 0;
+}
+
+// Services both hosts until done() holds or about a second passes.
+template<typename Done>
+bool service_pair(Host& first, Host& second, Done done) {
+    auto ignore = [](const EventRef&) {};
+    for (int i = 0; i < 500 && !done(); ++i) {
+        first.serviceEvents(ignore, TimeoutMs{1});
+        second.serviceEvents(ignore, TimeoutMs{1});
+    }
+    return done();
+}
+
+void test_accept_guard() {
+    std::cout << "=== Testing Accept Guard ===\n";
+
+    auto nativeHost = std::make_unique<ENetHost>();
+    if (detail::AcceptGuard::install(nativeHost.get(), AcceptConfig{.validateHandshake = false}) != nullptr) {
+        throw std::runtime_error("Guard installed with nothing to enforce");
+    }
+
+    {
+        auto guard = detail::AcceptGuard::install(nativeHost.get(), AcceptConfig{});
+        if (!guard || !nativeHost->intercept) {
+            throw std::runtime_error("Guard did not install its intercept hook");
+        }
+
+        const uint32_t mtu = ENET_HOST_DEFAULT_MTU;
+        const uint32_t window = ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE;
+        if (intercepted(*nativeHost, connect_datagram(2, mtu, window)) ||
+            intercepted(*nativeHost, connect_datagram(ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT, ENET_PROTOCOL_MINIMUM_MTU,
+                                                      ENET_PROTOCOL_MINIMUM_WINDOW_SIZE, ENET_PROTOCOL_HEADER_FLAG_SENT_TIME))) {
+            throw std::runtime_error("Guard dropped a valid CONNECT");
+        }
+        // Compressed bodies are only readable after ENet decompresses them.
+        if (intercepted(*nativeHost, connect_datagram(0, 0, 0, ENET_PROTOCOL_HEADER_FLAG_COMPRESSED))) {
+            throw std::runtime_error("Guard inspected a compressed datagram");
+        }
+        if (!intercepted(*nativeHost, connect_datagram(0, mtu, window)) ||
+            !intercepted(*nativeHost, connect_datagram(ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT + 1, mtu, window)) ||
+            !intercepted(*nativeHost, connect_datagram(2, ENET_PROTOCOL_MINIMUM_MTU - 1, window)) ||
+            !intercepted(*nativeHost, connect_datagram(2, ENET_PROTOCOL_MAXIMUM_MTU + 1, window)) ||
+            !intercepted(*nativeHost, connect_datagram(2, mtu, ENET_PROTOCOL_MINIMUM_WINDOW_SIZE - 1)) ||
+            !intercepted(*nativeHost, connect_datagram(2, mtu, ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE + 1))) {
+            throw std::runtime_error("Guard let an out-of-range CONNECT through");
+        }
+
+        // A sentTime flag or a checksum moves the command; a datagram too short for it is dropped.
+        auto shortSentTime = connect_datagram(2, mtu, window, ENET_PROTOCOL_HEADER_FLAG_SENT_TIME);
+        shortSentTime.pop_back();
+        auto notConnect = connect_datagram(2, mtu, window);
+        notConnect[sizeof(uint16_t)] = ENET_PROTOCOL_COMMAND_VERIFY_CONNECT;
+        if (!intercepted(*nativeHost, shortSentTime) || !intercepted(*nativeHost, notConnect)) {
+            throw std::runtime_error("Guard accepted a truncated or foreign command");
+        }
+        nativeHost->checksum = zero_checksum;
+        if (!intercepted(*nativeHost, connect_datagram(2, mtu, window)) ||
+            intercepted(*nativeHost, connect_datagram(2, mtu, window, 0, true))) {
+            throw std::runtime_error("Guard ignored the checksum field");
+        }
+        nativeHost->checksum = nullptr;
+
+        // Datagrams for existing peers are left to ENet uncounted.
+        auto established = connect_datagram(0, 0, 0);
+        established[0] = 0;
+        established[1] = 3;
+        if (intercepted(*nativeHost, established)) {
+            throw std::runtime_error("Guard dropped traffic for an existing peer");
+        }
+
+        auto stats = guard->stats();
+        if (stats.accepted != 4 || stats.malformed != 9 || stats.rateLimited != 0) {
+            throw std::runtime_error("Guard miscounted handshakes");
+        }
+    }
+    if (nativeHost->intercept) {
+        throw std::runtime_error("Guard left its intercept hook installed");
+    }
+
+    // The host-wide bucket refills at its rate but never beyond the burst.
+    const auto valid = connect_datagram(2, ENET_HOST_DEFAULT_MTU, ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE);
+    {
+        auto guard = detail::AcceptGuard::install(nativeHost.get(), AcceptConfig{.connectsPerSecond = 50, .connectBurst = 2});
+        for (int round = 0; round < 2; ++round) {
+            if (intercepted(*nativeHost, valid) || intercepted(*nativeHost, valid) || !intercepted(*nativeHost, valid)) {
+                throw std::runtime_error("Host-wide bucket did not hold its burst");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (guard->stats().accepted != 4 || guard->stats().rateLimited != 2) {
+            throw std::runtime_error("Host-wide bucket miscounted");
+        }
+    }
+
+    // Per-address buckets live in hashed slots; a colliding address evicts the old bucket.
+    {
+        AcceptConfig config;
+        config.connectsPerSecondPerAddress = 0.001;
+        config.connectBurstPerAddress = 1;
+        config.addressSlots = 2;
+        auto guard = detail::AcceptGuard::install(nativeHost.get(), config);
+        const uint32_t first = 0x0100000a;
+        if (intercepted(*nativeHost, valid, first) || !intercepted(*nativeHost, valid, first)) {
+            throw std::runtime_error("Per-address bucket did not limit its address");
+        }
+        bool evicted = false;
+        for (uint32_t other = first + 1; other < first + 64 && !evicted; ++other) {
+            if (intercepted(*nativeHost, valid, other)) {
+                throw std::runtime_error("Per-address bucket limited a fresh address");
+            }
+            evicted = !intercepted(*nativeHost, valid, first);
+        }
+        if (!evicted) {
+            throw std::runtime_error("Colliding address never evicted the bucket");
+        }
+    }
+
+    // A wrapper the application let go of is rebound to the slot's next connection.
+    HostConfig serverConfig;
+    serverConfig.maxPeers = 1;
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), serverConfig);
+    auto client = Host::createClient();
+    auto serverEndpoint = Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port);
+
+    auto clientPeer = client->connect(serverEndpoint);
+    if (!service_pair(*client, *server, [&] { return clientPeer->isConnected() && server->peerCount() == 1; })) {
+        throw std::runtime_error("Loopback connection failed");
+    }
+    auto first = server->getPeers().front();
+    auto firstWrapper = first.get();
+    auto firstHandle = first->handle();
+    // takePeer only counts strong references, so a weak_ptr the application kept
+    // follows the wrapper to the slot's next connection.
+    std::weak_ptr<Peer> watcher = first;
+    first.reset();
+
+    clientPeer->disconnect();
+    if (!service_pair(*client, *server, [&] { return clientPeer->isDisconnected() && server->peerCount() == 0; })) {
+        throw std::runtime_error("Loopback disconnect failed");
+    }
+    clientPeer = client->connect(serverEndpoint);
+    if (!service_pair(*client, *server, [&] { return clientPeer->isConnected() && server->peerCount() == 1; })) {
+        throw std::runtime_error("Loopback reconnect failed");
+    }
+    auto second = server->getPeers().front();
+    if (second.get() != firstWrapper || second->handle() == firstHandle || !second->isConnected() ||
+        server->findPeer(firstHandle) != nullptr || watcher.lock() != second) {
+        throw std::runtime_error("Released wrapper was not rebound to the new connection");
+    }
+
+    // One the application still holds keeps the old connection; a fresh wrapper takes the slot.
+    clientPeer->disconnect();
+    if (!service_pair(*client, *server, [&] { return clientPeer->isDisconnected() && server->peerCount() == 0; })) {
+        throw std::runtime_error("Loopback disconnect failed");
+    }
+    clientPeer = client->connect(serverEndpoint);
+    if (!service_pair(*client, *server, [&] { return clientPeer->isConnected() && server->peerCount() == 1; })) {
+        throw std::runtime_error("Loopback reconnect failed");
+    }
+    auto third = server->getPeers().front();
+    if (third.get() == second.get() || second->handle().valid() || third->handle() == firstHandle) {
+        throw std::runtime_error("Held wrapper was recycled");
+    }
+
+    std::cout << "Handshake validation, rate limits and wrapper recycling checks passed\n";
+}
+
+// Tags of the packets ENet destroyed, in order.
+std::vector<intptr_t> destroyedPackets;
+
+void record_destroyed(ENetPacket* nativePacket) {
+    destroyedPackets.push_back(reinterpret_cast<intptr_t>(nativePacket->userData));
+}
+
+ENetPacket* tagged_packet(intptr_t tag, size_t size, PacketFlagsT flags = 0) {
+    auto nativePacket = enet_packet_create(nullptr, size, flags);
+    nativePacket->userData = reinterpret_cast<void*>(tag);
+    nativePacket->freeCallback = record_destroyed;
+    return nativePacket;
+}
+
+void expect_destroyed(std::vector<intptr_t> expected, const char* what) {
+    if (destroyedPackets != expected) {
+        throw std::runtime_error(what);
+    }
+    destroyedPackets.clear();
+}
+
+void test_channel_scheduler() {
+    std::cout << "=== Testing Channel Scheduler ===\n";
+
+    auto host = Host::createClient();
+    std::vector<ChannelConfig> channels(3);
+    channels[1] = ChannelConfig{5, 100, false};
+    channels[2] = ChannelConfig{1, 10, true};
+    auto scheduler = detail::ChannelScheduler::create(channels, 4);
+    if (detail::ChannelScheduler::create({}, 4) != nullptr || !scheduler->schedules(2) || scheduler->schedules(3)) {
+        throw std::runtime_error("Scheduler covers the wrong channels");
+    }
+
+    // Without channels ENet refuses every send, so each released packet is destroyed
+    // right away and the destroy order is the send order.
+    ENetPeer nativePeer{};
+    nativePeer.incomingPeerID = 1;
+    nativePeer.connectID = 42;
+    nativePeer.state = ENET_PEER_STATE_CONNECTED;
+    auto& outgoing = nativePeer.outgoingCommands.sentinel;
+    outgoing.next = outgoing.previous = &outgoing;
+
+    scheduler->enqueue(&nativePeer, 0, 0, tagged_packet(1, 10));
+    scheduler->enqueue(&nativePeer, 2, 7, tagged_packet(2, 10));
+    scheduler->enqueue(&nativePeer, 1, 0, tagged_packet(3, 10));
+    scheduler->release(*host);
+    expect_destroyed({3, 2, 1}, "Scheduler did not release by priority");
+
+    // The budget stops a channel once the next packet would exceed it, but a packet
+    // over the budget still goes out alone.
+    scheduler->enqueue(&nativePeer, 1, 0, tagged_packet(10, 60));
+    scheduler->enqueue(&nativePeer, 1, 0, tagged_packet(11, 30));
+    scheduler->enqueue(&nativePeer, 1, 0, tagged_packet(12, 30));
+    scheduler->enqueue(&nativePeer, 1, 0, tagged_packet(13, 200));
+    scheduler->release(*host);
+    expect_destroyed({10, 11}, "Scheduler ignored the byte budget");
+    scheduler->release(*host);
+    expect_destroyed({12}, "Scheduler sent past the byte budget");
+    scheduler->release(*host);
+    expect_destroyed({13}, "Scheduler held a packet larger than the budget");
+
+    // Latest value wins, including after the queue head has moved past sent entries.
+    scheduler->enqueue(&nativePeer, 2, 1, tagged_packet(20, 10));
+    scheduler->enqueue(&nativePeer, 2, 2, tagged_packet(21, 10));
+    scheduler->enqueue(&nativePeer, 2, 1, tagged_packet(22, 10));
+    expect_destroyed({20}, "Scheduler did not replace the unsent value");
+    if (scheduler->queued() != 2) {
+        throw std::runtime_error("Replacing a value changed the queue length");
+    }
+    scheduler->release(*host);
+    expect_destroyed({22}, "Replacement lost its queue position");
+    scheduler->enqueue(&nativePeer, 2, 2, tagged_packet(23, 10));
+    scheduler->enqueue(&nativePeer, 2, 1, tagged_packet(24, 10));
+    expect_destroyed({21}, "Key index went stale after the head advanced");
+    scheduler->enqueue(&nativePeer, 2, 2, tagged_packet(25, 10, ENET_PACKET_FLAG_RELIABLE));
+    scheduler->release(*host);
+    scheduler->release(*host);
+    scheduler->release(*host);
+    expect_destroyed({23, 24, 25}, "Latest-value channel released the wrong packets");
+
+    // Latest-value channels wait while ENet still holds older commands; others do not.
+    ENetListNode backlog{&outgoing, &outgoing};
+    outgoing.next = outgoing.previous = &backlog;
+    scheduler->enqueue(&nativePeer, 2, 5, tagged_packet(30, 10));
+    scheduler->enqueue(&nativePeer, 0, 0, tagged_packet(31, 10));
+    scheduler->release(*host);
+    expect_destroyed({31}, "Latest-value channel did not wait for ENet's backlog");
+    outgoing.next = outgoing.previous = &outgoing;
+    scheduler->release(*host);
+    expect_destroyed({30}, "Latest-value channel stayed blocked after the backlog cleared");
+
+    // A reconnect on the slot drops what the old connection had queued.
+    scheduler->enqueue(&nativePeer, 0, 0, tagged_packet(40, 10));
+    nativePeer.connectID = 43;
+    scheduler->release(*host);
+    scheduler->enqueue(&nativePeer, 0, 0, tagged_packet(41, 10));
+    scheduler.reset();
+    expect_destroyed({40, 41}, "Scheduler leaked queued packets");
+
+    std::cout << "Priority, budget, latest-value and backlog checks passed\n";
+}
+
+void test_scheduled_service_events() {
+    std::cout << "=== Testing Scheduled Sends Through serviceEvents ===\n";
+
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0));
+    HostConfig config;
+    config.channels.resize(1);
+    auto client = Host::createClient(config);
+    auto peer = client->connect(Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port));
+
+    std::string received;
+    auto ignore = [](const EventRef&) {};
+    auto collect = [&received](const EventRef& event) {
+        if (event.type == EventType::receive) {
+            auto bytes = event.packet.data();
+            received.assign(bytes.begin(), bytes.end());
+        }
+    };
+    bool sent = false;
+    for (int i = 0; i < 1000 && received.empty(); ++i) {
+        client->serviceEvents(ignore, TimeoutMs{1});
+        server->serviceEvents(collect, TimeoutMs{1});
+        if (!sent && peer->isConnected()) {
+            sent = peer->send(0, std::string("scheduled"), ENET_PACKET_FLAG_RELIABLE);
+        }
+    }
+
+    if (!sent || received != "scheduled") {
+        throw std::runtime_error("Scheduled send never left through serviceEvents");
+    }
+    std::cout << "Scheduled packet delivered\n";
+}
+
+void test_tick_loop() {
+    std::cout << "=== Testing Tick Loop ===\n";
+
+    auto host = Host::createClient();
+    std::vector<uint64_t> seen;
+    bool owned = false;
+    auto stats = host->runTickLoop(1000.0, [&](const TickInfo& info) {
+        seen.push_back(info.tick);
+        owned = owned || host->isServiceThreadRunning();
+        return info.tick < 4;
+    });
+    if (stats.ticks != 5 || seen != std::vector<uint64_t>{0, 1, 2, 3, 4} || stats.updateTime.count != 5) {
+        throw std::runtime_error("Tick loop ran the wrong number of ticks");
+    }
+    if (!owned) {
+        throw std::runtime_error("Tick loop did not stand in for the service thread");
+    }
+
+    // A tick that overruns skips the deadlines it missed instead of replaying them.
+    TickConfig config;
+    config.rate = 200.0;
+    std::vector<Timestamp> deadlines;
+    uint64_t skippedBefore = 0;
+    stats = host->runTickLoop(config, [&](const TickInfo& info) {
+        deadlines.push_back(info.deadline);
+        if (info.tick == 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(23));
+        } else if (info.tick == 2) {
+            skippedBefore = info.stats->skippedTicks;
+        }
+        return info.tick < 3;
+    });
+    if (stats.ticks != 4 || stats.overruns < 1 || skippedBefore < 3 ||
+        deadlines[2] - deadlines[1] != std::chrono::milliseconds(5) * static_cast<int64_t>(1 + skippedBefore)) {
+        throw std::runtime_error("Tick loop did not skip missed deadlines after an overrun");
+    }
+
+    host->startServiceThread();
+    bool rejected = false;
+    try {
+        host->runTickLoop(1000.0, [](const TickInfo&) { return false; });
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    host->stopServiceThread();
+    if (!rejected) {
+        throw std::runtime_error("Tick loop ran alongside the service thread");
+    }
+
+    // Ownership is handed back, so calls from this thread run directly again.
+    host->runTickLoop(1000.0, [](const TickInfo&) { return false; });
+    if (host->isServiceThreadRunning()) {
+        throw std::runtime_error("Tick loop kept the service thread role");
+    }
+    auto peer = host->connect(Endpoint::parse("127.0.0.1", 9));
+    if (!peer || host->pendingCommands() != 0 || host->peerCount() != 1) {
+        throw std::runtime_error("Host calls were queued after the tick loop returned");
+    }
+
+    std::cout << "Ran " << stats.ticks << " ticks with " << stats.skippedTicks << " skipped after an overrun\n";
+}
+
+std::vector<PeerHandle> sorted_handles(std::vector<PeerHandle> handles) {
+    std::sort(handles.begin(), handles.end(), [](const PeerHandle& a, const PeerHandle& b) {
+        return a.slot != b.slot ? a.slot < b.slot : a.generation < b.generation;
+    });
+    return handles;
+}
+
+std::vector<PeerHandle> near(const InterestGrid& grid, const InterestGrid::Position& center, float radius) {
+    std::vector<PeerHandle> found;
+    if (grid.query(center, radius, found) != found.size()) {
+        throw std::runtime_error("Query count does not match its results");
+    }
+    return sorted_handles(found);
+}
+
+std::vector<PeerHandle> within(const InterestGrid& grid, const InterestGrid::Position& min, const InterestGrid::Position& max) {
+    std::vector<PeerHandle> found;
+    if (grid.queryRegion(min, max, found) != found.size()) {
+        throw std::runtime_error("Region query count does not match its results");
+    }
+    return sorted_handles(found);
+}
+
+void test_interest_grid() {
+    std::cout << "=== Testing Interest Grid ===\n";
+
+    bool rejected = false;
+    try {
+        InterestGrid orphan(nullptr);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    if (!rejected) {
+        throw std::runtime_error("Interest grid accepted a null host");
+    }
+
+    auto host = Host::createClient();
+    InterestGrid grid(host, 10.0f);
+    const PeerHandle a{1, 1};
+    const PeerHandle b{2, 1};
+    const PeerHandle c{3, 1};
+    grid.update(a, {1, 1, 0});
+    grid.update(b, {2, 2, 0});
+    grid.update(c, {3, 3, 0});
+    grid.update(PeerHandle{}, {0, 0, 0});
+    if (grid.size() != 3 || near(grid, {2, 2, 0}, 5) != std::vector<PeerHandle>{a, b, c} ||
+        near(grid, {1, 1, 0}, 1.5f) != std::vector<PeerHandle>{a, b}) {
+        throw std::runtime_error("Grid query returned the wrong peers");
+    }
+
+    // Removing the first member of a cell moves the last one into its place; that one
+    // must still unlink cleanly afterwards.
+    if (!grid.remove(a) || grid.remove(a)) {
+        throw std::runtime_error("Grid removal misreported");
+    }
+    grid.update(c, {55, 3, 0});
+    if (near(grid, {2, 2, 0}, 5) != std::vector<PeerHandle>{b} || near(grid, {55, 3, 0}, 1) != std::vector<PeerHandle>{c}) {
+        throw std::runtime_error("Swap-remove left a stale cell index");
+    }
+    if (!grid.remove(c) || !grid.remove(b) || grid.size() != 0 || !near(grid, {0, 0, 0}, 100).empty()) {
+        throw std::runtime_error("Grid kept removed peers");
+    }
+
+    // Moving within a cell or across cells is found at the new position only.
+    grid.update(a, {5, 5, 5});
+    grid.update(a, {6, 5, 5});
+    if (grid.position(a)->x != 6 || near(grid, {5, 5, 5}, 0.5f).size() != 0) {
+        throw std::runtime_error("Move within a cell was not stored");
+    }
+    grid.update(a, {-25, 5, 5});
+    if (!near(grid, {6, 5, 5}, 1).empty() || near(grid, {-25, 5, 5}, 1) != std::vector<PeerHandle>{a}) {
+        throw std::runtime_error("Peer crossing cells was found at its old position");
+    }
+
+    // A newer connection on the slot replaces the old handle's entry.
+    const PeerHandle reused{a.slot, 2};
+    grid.update(reused, {-25, 5, 5});
+    if (grid.size() != 1 || grid.contains(a) || !grid.contains(reused) || grid.position(a) || grid.remove(a) ||
+        near(grid, {-25, 5, 5}, 1) != std::vector<PeerHandle>{reused}) {
+        throw std::runtime_error("Newer generation did not take over the slot");
+    }
+
+    // A volume spanning more cells than are occupied scans the occupied cells instead;
+    // both paths apply the exact bounds.
+    grid.update(b, {95, 0, 0});
+    grid.update(c, {-95, 0, 0});
+    if (near(grid, {0, 0, 0}, 1000) != std::vector<PeerHandle>{reused, b, c} ||
+        within(grid, {-30, -1000, -1000}, {1000, 1000, 1000}) != std::vector<PeerHandle>{reused, b} ||
+        within(grid, {-100, 0, 0}, {100, 0, 0}) != std::vector<PeerHandle>{b, c} ||
+        within(grid, {90, -1, -1}, {100, 1, 1}) != std::vector<PeerHandle>{b} ||
+        !within(grid, {1, 1, 1}, {0, 0, 0}).empty() || !near(grid, {0, 0, 0}, -1).empty()) {
+        throw std::runtime_error("Sparse scan and cell walk disagree");
+    }
+
+    // Far-off coordinates clamp to the border cells and NaN lands in cell 0; neither is lost.
+    const PeerHandle far{4, 1};
+    const PeerHandle farther{5, 1};
+    const PeerHandle lost{6, 1};
+    grid.update(far, {1e30f, 0, 0});
+    grid.update(farther, {1e31f, 0, 0});
+    grid.update(lost, {std::nanf(""), 0, 0});
+    if (near(grid, {1e30f, 0, 0}, 1) != std::vector<PeerHandle>{far} ||
+        within(grid, {1e29f, -1, -1}, {std::numeric_limits<float>::infinity(), 1, 1}) != std::vector<PeerHandle>{far, farther} ||
+        !grid.contains(lost) || !grid.remove(lost) || !grid.remove(farther)) {
+        throw std::runtime_error("Clamped or NaN positions were mishandled");
+    }
+
+    // The counts include handles without a live peer behind them.
+    if (grid.broadcastNear({0, 0, 0}, 100, 0, std::string("near")) != 3 ||
+        grid.broadcastRegion({-30, -1, -1}, {100, 1, 1}, 0, std::string("region")) != 1 ||
+        grid.broadcastRegion({-1, -1, -1}, {1, 1, 1}, 0, std::string("nobody")) != 0) {
+        throw std::runtime_error("Grid broadcast addressed the wrong peers");
+    }
+
+    std::cout << "Cell moves, slot reuse, sparse scans and clamping checks passed\n";
+}
+
+std::string temp_capture(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::vector<CaptureLog::Entry> read_capture(const CaptureLog& log) {
+    std::vector<CaptureLog::Entry> entries;
+    for (const auto& entry : log) {
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+// Records count receives whose payload bytes are all index & 0xFF.
+void record_filled(detail::Recorder& recorder, size_t first, size_t count, size_t size) {
+    for (size_t i = first; i < first + count; ++i) {
+        std::vector<uint8_t> payload(size, static_cast<uint8_t>(i));
+        recorder.record(CaptureType::receive, 0, 0, 0, 0, Span<const uint8_t>(payload.data(), payload.size()));
+    }
+}
+
+void test_capture_replay() {
+    std::cout << "=== Testing Capture And Replay ===\n";
+
+    // Records are stored little-endian whatever the host order.
+    CaptureRecord record;
+    record.length = 0x01020304;
+    record.type = CaptureType::send;
+    record.channel = 9;
+    record.peer = 0x0506;
+    record.time = 0x0708090A0B0C0D0E;
+    record.data = 0x11121314;
+    record.flags = 0x15161718;
+    record.size = 0x191A1B1C;
+    record.packetSize = 0x1D1E1F20;
+    std::array<uint8_t, sizeof(CaptureRecord)> bytes;
+    auto encoded = detail::littleEndianRecord(record);
+    std::memcpy(bytes.data(), &encoded, sizeof(encoded));
+    const std::array<uint8_t, sizeof(CaptureRecord)> expectedBytes{
+        0x04, 0x03, 0x02, 0x01, 4, 9, 0x06, 0x05, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09, 0x08, 0x07,
+        0x14, 0x13, 0x12, 0x11, 0x18, 0x17, 0x16, 0x15, 0x1C, 0x1B, 0x1A, 0x19, 0x20, 0x1F, 0x1E, 0x1D};
+    auto decoded = detail::littleEndianRecord(encoded);
+    if (bytes != expectedBytes || std::memcmp(&decoded, &record, sizeof(record)) != 0) {
+        throw std::runtime_error("Capture records are not little-endian");
+    }
+
+    auto path = temp_capture("icelander_test.cap");
+    {
+        detail::Recorder recorder(path, CaptureConfig{});
+        const std::string hello = "hello";
+        const std::string odd(13, 'x');
+        recorder.record(CaptureType::connect, 3, 0, 77, 0, {nullptr, 0});
+        recorder.record(CaptureType::receive, 3, 2, 0, ENET_PACKET_FLAG_RELIABLE,
+                        Span<const uint8_t>(reinterpret_cast<const uint8_t*>(hello.data()), hello.size()));
+        recorder.record(CaptureType::broadcast, CAPTURE_ALL_PEERS, 1, 0, 0,
+                        Span<const uint8_t>(reinterpret_cast<const uint8_t*>(odd.data()), odd.size()));
+        recorder.record(CaptureType::disconnect, 3, 0, 5, 0, {nullptr, 0});
+        auto stats = recorder.close();
+        if (stats.records != 4 || stats.dropped != 0 || stats.bytes != std::filesystem::file_size(path) ||
+            stats.bytes != CAPTURE_FILE_HEADER_SIZE + 32 + 40 + 48 + 32) {
+            throw std::runtime_error("Recorder miscounted the capture");
+        }
+
+        CaptureLog log(path);
+        auto entries = read_capture(log);
+        if (entries.size() != 4 ||
+            entries[0].record.type != CaptureType::connect || entries[0].record.peer != 3 || entries[0].record.data != 77 ||
+            entries[1].record.type != CaptureType::receive || entries[1].record.channel != 2 ||
+            entries[1].record.flags != ENET_PACKET_FLAG_RELIABLE || entries[1].record.size != 5 || entries[1].record.packetSize != 5 ||
+            std::string(entries[1].payload.begin(), entries[1].payload.end()) != hello ||
+            entries[2].record.type != CaptureType::broadcast || entries[2].record.peer != CAPTURE_ALL_PEERS ||
+            entries[2].record.length != 48 || std::string(entries[2].payload.begin(), entries[2].payload.end()) != odd ||
+            entries[3].record.type != CaptureType::disconnect || entries[3].record.data != 5 || entries[3].payload.size() != 0 ||
+            entries[3].record.time < entries[0].record.time) {
+            throw std::runtime_error("Capture did not read back as recorded");
+        }
+    }
+
+    // A record that does not fit before the end of the ring is preceded by padding,
+    // which never reaches the file.
+    {
+        CaptureConfig config;
+        config.ringSize = 0;
+        config.flushInterval = std::chrono::milliseconds(1);
+        detail::Recorder recorder(path, config);
+        record_filled(recorder, 0, 63, 1000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        record_filled(recorder, 63, 5, 1000);
+        auto stats = recorder.close();
+
+        CaptureLog log(path);
+        auto entries = read_capture(log);
+        bool intact = entries.size() == 68;
+        for (size_t i = 0; intact && i < entries.size(); ++i) {
+            const auto& payload = entries[i].payload;
+            intact = entries[i].record.type == CaptureType::receive && payload.size() == 1000 &&
+                     std::all_of(payload.begin(), payload.end(), [i](uint8_t b) { return b == static_cast<uint8_t>(i); });
+        }
+        if (!intact || stats.records != 68 || stats.dropped != 0) {
+            throw std::runtime_error("Records were lost or torn where the ring wrapped");
+        }
+    }
+
+    // A full ring drops the record rather than blocking the servicing thread.
+    {
+        CaptureConfig config;
+        config.ringSize = 0;
+        config.flushInterval = std::chrono::milliseconds(300);
+        detail::Recorder recorder(path, config);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));    // past the writer's first drain
+        record_filled(recorder, 0, 64, 1000);
+        auto stats = recorder.close();
+        if (stats.records != 63 || stats.dropped != 1) {
+            throw std::runtime_error("Full ring did not drop the record");
+        }
+    }
+
+    // So does a full file, and the records before it survive.
+    {
+        CaptureConfig config;
+        config.ringSize = 0;
+        config.maxFileSize = 0;
+        config.flushInterval = std::chrono::milliseconds(1);
+        detail::Recorder recorder(path, config);
+        for (size_t batch = 0; batch < 7; ++batch) {
+            record_filled(recorder, batch * 10, 10, 1000);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        auto stats = recorder.close();
+        CaptureLog log(path);
+        if (stats.records != 63 || stats.dropped != 7 || stats.bytes != CAPTURE_FILE_HEADER_SIZE + 63 * 1032 ||
+            read_capture(log).size() != 63) {
+            throw std::runtime_error("Full file did not drop the overflow");
+        }
+    }
+
+    // Iteration stops at an unwritten (zero) tail and at a truncated record.
+    auto writeFile = [&path](const std::vector<uint8_t>& contents) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+    };
+    std::vector<uint8_t> contents(CAPTURE_FILE_HEADER_SIZE + sizeof(CaptureRecord));
+    std::memcpy(contents.data(), CAPTURE_MAGIC.data(), CAPTURE_MAGIC.size());
+    auto version = detail::littleEndian(CAPTURE_VERSION);
+    std::memcpy(contents.data() + CAPTURE_MAGIC.size(), &version, sizeof(version));
+    CaptureRecord connectRecord;
+    connectRecord.length = sizeof(CaptureRecord);
+    connectRecord.type = CaptureType::connect;
+    connectRecord = detail::littleEndianRecord(connectRecord);
+    std::memcpy(contents.data() + CAPTURE_FILE_HEADER_SIZE, &connectRecord, sizeof(connectRecord));
+
+    auto zeroTail = contents;
+    zeroTail.resize(contents.size() + 4096);
+    auto shortTail = contents;
+    shortTail.resize(contents.size() + sizeof(CaptureRecord) - 8, 0xFF);
+    auto overlong = contents;
+    overlong.insert(overlong.end(), contents.begin() + CAPTURE_FILE_HEADER_SIZE, contents.end());
+    overlong[CAPTURE_FILE_HEADER_SIZE + sizeof(CaptureRecord)] = 64;
+    for (const auto* file : {&zeroTail, &shortTail, &overlong}) {
+        writeFile(*file);
+        CaptureLog log(path);
+        auto entries = read_capture(log);
+        if (entries.size() != 1 || entries[0].record.type != CaptureType::connect) {
+            throw std::runtime_error("Capture iteration ran past the last whole record");
+        }
+    }
+    contents[0] = 'X';
+    writeFile(contents);
+    bool rejected = false;
+    try {
+        CaptureLog log(path);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    if (!rejected) {
+        throw std::runtime_error("CaptureLog opened a file without the capture magic");
+    }
+
+    // Without payloads, replay sends zeros of each recorded size.
+    {
+        CaptureConfig config;
+        config.recordPayloads = false;
+        detail::Recorder recorder(path, config);
+        std::vector<uint8_t> payload(100, 0xAB);
+        recorder.record(CaptureType::connect, 0, 0, 0, 0, {nullptr, 0});
+        recorder.record(CaptureType::receive, 0, 0, 0, ENET_PACKET_FLAG_RELIABLE, Span<const uint8_t>(payload.data(), 100));
+        recorder.record(CaptureType::receive, 0, 1, 0, ENET_PACKET_FLAG_RELIABLE, Span<const uint8_t>(payload.data(), 40));
+        recorder.record(CaptureType::disconnect, 0, 0, 0, 0, {nullptr, 0});
+        auto stats = recorder.close();
+        if (stats.bytes != CAPTURE_FILE_HEADER_SIZE + 4 * sizeof(CaptureRecord)) {
+            throw std::runtime_error("Recorder stored payloads it was told to leave out");
+        }
+    }
+
+    HostConfig serverConfig;
+    serverConfig.maxChannels = 2;
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), serverConfig);
+    std::mutex receivedMutex;
+    std::vector<std::pair<ChannelIdT, std::vector<uint8_t>>> received;
+    server->getDispatcher().onReceive([&](const ReceiveEvent& event) {
+        auto packetBytes = event.packetData->data();
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        received.emplace_back(event.channel, std::vector<uint8_t>(packetBytes.begin(), packetBytes.end()));
+    });
+    server->startServiceThread();
+
+    ReplayStats replayed;
+    {
+        CaptureLog log(path);
+        replayed = replayCapture(log, Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port));
+    }
+    auto receivedCount = [&] {
+        std::lock_guard<std::mutex> lock(receivedMutex);
+        return received.size();
+    };
+    for (int i = 0; i < 200 && receivedCount() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    server->stopServiceThread();
+    std::filesystem::remove(path);
+
+    if (replayed.sessions != 1 || replayed.packets != 2 || replayed.bytes != 140 || replayed.skipped != 0 ||
+        received.size() != 2 || received[0].first != 0 || received[0].second != std::vector<uint8_t>(100, 0) ||
+        received[1].first != 1 || received[1].second != std::vector<uint8_t>(40, 0)) {
+        throw std::runtime_error("Replay did not send zero-filled payloads of the recorded sizes");
+    }
+
+    std::cout << "Round trip, ring wrap, drops, truncation and zero-filled replay checks passed\n";
+}
+
+// Services every host until done() holds or about a second passes.
+template<typename Done>
+bool service_hosts(std::span<const std::shared_ptr<Host>> hosts, Done done) {
+    auto ignore = [](const EventRef&) {};
+    for (int i = 0; i < 500 && !done(); ++i) {
+        for (const auto& host : hosts) {
+            host->serviceEvents(ignore, TimeoutMs{1});
+        }
+    }
+    return done();
+}
+
+void test_service_all() {
+    std::cout << "=== Testing serviceAll Drain ===\n";
+
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0));
+    auto target = Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port);
+    std::vector<std::shared_ptr<Host>> hosts{server, Host::createClient(), Host::createClient()};
+    auto first = hosts[1]->connect(target);
+    auto second = hosts[2]->connect(target);
+    if (!service_hosts(hosts, [&] { return server->peerCount() == 2 && first->isConnected() && second->isConnected(); })) {
+        throw std::runtime_error("Clients never connected");
+    }
+
+    int received = 0;
+    server->getDispatcher().onReceive([&received](const ReceiveEvent&) { ++received; });
+    first->send(0, std::string("one"), ENET_PACKET_FLAG_RELIABLE);
+    second->send(0, std::string("two"), ENET_PACKET_FLAG_RELIABLE);
+    second->send(0, std::string("three"), ENET_PACKET_FLAG_RELIABLE);
+    hosts[1]->flush();
+    hosts[2]->flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    int drained = server->serviceAll(TimeoutMs{100});
+    if (drained != 3 || received != 3) {
+        throw std::runtime_error("serviceAll should dispatch every queued receive in one call");
+    }
+    if (server->serviceAll(TimeoutMs{0}) != 0) {
+        throw std::runtime_error("serviceAll left events behind");
+    }
+    std::cout << "One serviceAll call dispatched " << drained << " receives from two peers\n";
+}
+
+void test_cross_thread_commands() {
+    std::cout << "=== Testing Cross-Thread Sends and Disconnects ===\n";
+
+    HostConfig serverConfig;
+    serverConfig.maxPeers = 1;
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), serverConfig);
+    auto target = Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port);
+    auto client = Host::createClient();
+    auto peer = client->connect(target);
+    if (!service_pair(*server, *client, [&] { return server->peerCount() == 1 && peer->isConnected(); })) {
+        throw std::runtime_error("Client never connected");
+    }
+    auto remote = server->getPeers().front();
+
+    // Queued from this thread while the service thread owns the host.
+    std::vector<std::string> received;
+    bool disconnected = false;
+    auto collect = [&](const EventRef& event) {
+        if (event.type == EventType::receive) {
+            auto bytes = event.packet.data();
+            received.emplace_back(bytes.begin(), bytes.end());
+        } else if (event.type == EventType::disconnect) {
+            disconnected = true;
+        }
+    };
+    constexpr int COUNT = 50;
+    server->startServiceThread();
+    for (int i = 0; i < COUNT; ++i) {
+        if (!remote->send(0, std::to_string(i), ENET_PACKET_FLAG_RELIABLE)) {
+            throw std::runtime_error("Cross-thread send was refused");
+        }
+    }
+    remote->disconnectLater();
+    for (int i = 0; i < 2000 && !disconnected; ++i) {
+        client->serviceEvents(collect, TimeoutMs{1});
+    }
+    server->stopServiceThread();
+
+    if (!disconnected || received.size() != COUNT) {
+        throw std::runtime_error("Cross-thread sends or disconnect were lost");
+    }
+    for (int i = 0; i < COUNT; ++i) {
+        if (received[i] != std::to_string(i)) {
+            throw std::runtime_error("Cross-thread sends arrived out of order");
+        }
+    }
+
+    // A new connection takes the only slot; the old wrapper must not reach it.
+    auto next = Host::createClient();
+    auto nextPeer = next->connect(target);
+    if (!service_pair(*server, *next, [&] { return server->peerCount() == 1 && nextPeer->isConnected(); })) {
+        throw std::runtime_error("Second client never connected");
+    }
+
+    std::vector<uint8_t> blob(4096, 7);
+    if (remote->send(0, std::string("stale"), ENET_PACKET_FLAG_RELIABLE) || remote->sendStream(0, Span<const uint8_t>(blob.data(), blob.size())) != 0) {
+        throw std::runtime_error("Direct send through a stale peer was accepted");
+    }
+    remote->disconnect();
+
+    server->startServiceThread();
+    remote->send(0, std::string("stale"), ENET_PACKET_FLAG_RELIABLE);
+    remote->disconnectNow();
+    received.clear();
+    disconnected = false;
+    for (int i = 0; i < 100; ++i) {
+        next->serviceEvents(collect, TimeoutMs{1});
+    }
+    server->stopServiceThread();
+
+    if (!received.empty() || disconnected || !nextPeer->isConnected()) {
+        throw std::runtime_error("A stale peer reached the connection that reused its slot");
+    }
+    std::cout << COUNT << " cross-thread sends delivered in order; stale peer rejected on both paths\n";
+}
+
+void test_service_thread_wakeup() {
+    std::cout << "=== Testing Service Thread Wakeup ===\n";
+
+    HostConfig serverConfig;
+    serverConfig.serviceTimeout = TimeoutMs{2000};
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), serverConfig);
+    auto client = Host::createClient();
+    auto peer = client->connect(Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port));
+    if (!service_pair(*server, *client, [&] { return server->peerCount() == 1 && peer->isConnected(); })) {
+        throw std::runtime_error("Client never connected");
+    }
+    auto remote = server->getPeers().front();
+
+    bool received = false;
+    auto collect = [&received](const EventRef& event) { received = received || event.type == EventType::receive; };
+    server->startServiceThread();
+    // Let the service thread settle into its two-second wait.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto sent = std::chrono::steady_clock::now();
+    remote->send(0, std::string("wake"), ENET_PACKET_FLAG_RELIABLE);
+    while (!received && std::chrono::steady_clock::now() - sent < std::chrono::seconds(3)) {
+        client->serviceEvents(collect, TimeoutMs{1});
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sent);
+    server->stopServiceThread();
+
+    if (!received || latency > std::chrono::milliseconds(250)) {
+        throw std::runtime_error("Cross-thread send did not wake the service thread");
+    }
+    std::cout << "Send from another thread delivered in " << latency.count() << " ms against a 2000 ms wait\n";
+}
+
+void test_sharded_host() {
+    std::cout << "=== Testing Sharded Host ===\n";
+
+    ShardConfig config;
+    config.shardCount = 2;
+    auto sharded = ShardedHost::create(Endpoint::parse("127.0.0.1", 0), config);
+    auto port = sharded->shard(0)->nativeHandle()->address.port;
+    if (sharded->shardCount() != 2 || sharded->shard(1)->nativeHandle()->address.port != port) {
+        throw std::runtime_error("Shards should share one port");
+    }
+
+    std::atomic<int> connects{0};
+    std::atomic<int> receives{0};
+    sharded->getDispatcher().onConnect([&connects](const ConnectEvent&) { ++connects; });
+    sharded->getDispatcher().onReceive([&receives](const ReceiveEvent&) { ++receives; });
+    sharded->start();
+
+    // The kernel hashes each client to a shard, so add clients until both have some.
+    std::vector<std::shared_ptr<Host>> clients;
+    std::vector<std::shared_ptr<Peer>> peers;
+    auto ignore = [](const EventRef&) {};
+    auto spread = [&] {
+        return sharded->shard(0)->peerCount() > 0 && sharded->shard(1)->peerCount() > 0;
+    };
+    while (clients.size() < 32 && (clients.size() < 4 || !spread())) {
+        clients.push_back(Host::createClient());
+        peers.push_back(clients.back()->connect(Endpoint::parse("127.0.0.1", port)));
+        for (int i = 0; i < 500 && !peers.back()->isConnected(); ++i) {
+            clients.back()->serviceEvents(ignore, TimeoutMs{1});
+        }
+    }
+    auto total = static_cast<int>(clients.size());
+    for (int i = 0; i < 500 && connects < total; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!spread() || connects != total || sharded->peerCount() != clients.size()) {
+        throw std::runtime_error("Clients did not reach both shards' shared dispatcher");
+    }
+
+    for (auto& peer : peers) {
+        peer->send(0, std::string("hello"), ENET_PACKET_FLAG_RELIABLE);
+    }
+    std::vector<int> broadcasts(clients.size());
+    bool sentBroadcast = false;
+    auto everyone = [&] {
+        return std::all_of(broadcasts.begin(), broadcasts.end(), [](int count) { return count > 0; });
+    };
+    for (int round = 0; round < 1000 && !(receives == total && everyone()); ++round) {
+        if (!sentBroadcast && receives == total) {
+            sharded->broadcast(0, std::string("all"), ENET_PACKET_FLAG_RELIABLE);
+            sentBroadcast = true;
+        }
+        for (size_t i = 0; i < clients.size(); ++i) {
+            clients[i]->serviceEvents([&broadcasts, i](const EventRef& event) {
+                if (event.type == EventType::receive) {
+                    ++broadcasts[i];
+                }
+            }, TimeoutMs{0});
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    sharded->stop();
+
+    if (receives != total || !everyone()) {
+        throw std::runtime_error("Sharded receive or broadcast missed a shard");
+    }
+    std::cout << total << " clients over shards of " << sharded->shard(0)->peerCount() << " and "
+              << sharded->shard(1)->peerCount() << " peers; broadcast reached all\n";
+}
+
+void test_parallel_dispatch() {
+    std::cout << "=== Testing Parallel Dispatch Strands ===\n";
+
+    auto& scheduler = async::TaskScheduler::instance();
+    scheduler.start(async::SchedulerConfig{.threadCount = 4});
+
+    HostConfig serverConfig;
+    serverConfig.parallelDispatch = true;
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), serverConfig);
+    auto target = Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port);
+    std::vector<std::shared_ptr<Host>> clients{Host::createClient(), Host::createClient(), Host::createClient()};
+    std::vector<std::shared_ptr<Peer>> peers;
+    for (auto& client : clients) {
+        peers.push_back(client->connect(target));
+    }
+
+    struct PeerLog {
+        std::atomic<int> inside{0};
+        std::vector<int> seen;
+    };
+    std::mutex logsMutex;
+    std::map<const Peer*, PeerLog> logs;
+    std::atomic<int> received{0};
+    std::atomic<int> concurrent{0};
+    std::atomic<int> mostConcurrent{0};
+    std::atomic<bool> overlapped{false};
+    server->getDispatcher().onReceive([&](const ReceiveEvent& event) {
+        PeerLog* log;
+        {
+            std::lock_guard<std::mutex> lock(logsMutex);
+            log = &logs[event.peerHandle.get()];
+        }
+        if (log->inside.fetch_add(1) != 0) {
+            overlapped = true;
+        }
+        int now = ++concurrent;
+        int most = mostConcurrent.load();
+        while (now > most && !mostConcurrent.compare_exchange_weak(most, now)) {
+        }
+        // Widen the window in which a second handler for this peer could slip in.
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        auto bytes = event.packetData->data();
+        log->seen.push_back(std::stoi(std::string(bytes.begin(), bytes.end())));
+        --concurrent;
+        log->inside.fetch_sub(1);
+        ++received;
+    });
+
+    std::vector<std::shared_ptr<Host>> all{server};
+    all.insert(all.end(), clients.begin(), clients.end());
+    if (!service_hosts(all, [&] { return server->peerCount() == 3 && std::all_of(peers.begin(), peers.end(), [](const auto& peer) { return peer->isConnected(); }); })) {
+        throw std::runtime_error("Clients never connected");
+    }
+
+    constexpr int COUNT = 100;
+    for (int i = 0; i < COUNT; ++i) {
+        for (auto& peer : peers) {
+            peer->send(0, std::to_string(i), ENET_PACKET_FLAG_RELIABLE);
+        }
+    }
+    auto ignore = [](const EventRef&) {};
+    for (int round = 0; round < 2000 && received < 3 * COUNT; ++round) {
+        for (auto& client : clients) {
+            client->serviceEvents(ignore, TimeoutMs{0});
+        }
+        server->serviceAll(TimeoutMs{1});
+    }
+    scheduler.stop();
+
+    if (received != 3 * COUNT || logs.size() != 3) {
+        throw std::runtime_error("Parallel dispatch lost packets");
+    }
+    if (overlapped) {
+        throw std::runtime_error("Handlers for one peer overlapped");
+    }
+    for (const auto& [peer, log] : logs) {
+        for (int i = 0; i < COUNT; ++i) {
+            if (log.seen[i] != i) {
+                throw std::runtime_error("Parallel dispatch reordered one peer's packets");
+            }
+        }
+    }
+    std::cout << 3 * COUNT << " packets from 3 peers dispatched in order per peer, up to "
+              << mostConcurrent.load() << " handlers at once\n";
+}
+
+void test_peer_group() {
+    std::cout << "=== Testing Peer Groups ===\n";
+
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0));
+    PeerGroup handles(server);
+    if (handles.add(PeerHandle{}) || !handles.add(PeerHandle{1, 10}) || handles.add(PeerHandle{1, 10}) ||
+        !handles.add(PeerHandle{2, 20}) || !handles.add(PeerHandle{3, 30}) || handles.size() != 3) {
+        throw std::runtime_error("PeerGroup add should take each handle once");
+    }
+    // Slot 1 reconnected: the new generation replaces the stale entry in place.
+    if (!handles.add(PeerHandle{1, 11}) || handles.size() != 3 || handles.contains(PeerHandle{1, 10}) ||
+        !handles.contains(PeerHandle{1, 11}) || handles.remove(PeerHandle{1, 10})) {
+        throw std::runtime_error("PeerGroup did not replace a stale slot");
+    }
+    // Removing the first entry moves the last one into its place.
+    if (!handles.remove(PeerHandle{1, 11}) || handles.members().front() != PeerHandle{3, 30} ||
+        !handles.remove(PeerHandle{3, 30}) || !handles.contains(PeerHandle{2, 20}) || handles.size() != 1) {
+        throw std::runtime_error("PeerGroup swap-remove lost a position");
+    }
+
+    auto target = Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port);
+    std::vector<std::shared_ptr<Host>> hosts{server, Host::createClient(), Host::createClient()};
+    auto first = hosts[1]->connect(target);
+    auto second = hosts[2]->connect(target);
+    if (!service_hosts(hosts, [&] { return server->peerCount() == 2 && first->isConnected() && second->isConnected(); })) {
+        throw std::runtime_error("Clients never connected");
+    }
+    auto remotes = server->getPeers();
+    PeerGroup group(server);
+    group.add(*remotes[0]);
+    group.add(*remotes[1]);
+
+    // Park the service thread in a handler so the group send below stays queued.
+    std::atomic<bool> parked{false};
+    std::atomic<bool> release{false};
+    server->getDispatcher().onReceive([&](const ReceiveEvent&) {
+        parked = true;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    server->startServiceThread();
+    first->send(0, std::string("park"), ENET_PACKET_FLAG_RELIABLE);
+    hosts[1]->flush();
+    for (int i = 0; i < 1000 && !parked; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!parked) {
+        server->stopServiceThread();
+        throw std::runtime_error("Service thread never ran the handler");
+    }
+
+    const auto* queued = &group.members();
+    group.send(0, std::string("group"), ENET_PACKET_FLAG_RELIABLE);
+    group.remove(*remotes[1]);
+    bool copied = &group.members() != queued && group.size() == 1;
+    release = true;
+
+    std::array<int, 2> received{};
+    auto counter = [&received](int index) {
+        return [&received, index](const EventRef& event) {
+            if (event.type == EventType::receive) {
+                ++received[index];
+            }
+        };
+    };
+    for (int i = 0; i < 1000 && (received[0] == 0 || received[1] == 0); ++i) {
+        hosts[1]->serviceEvents(counter(0), TimeoutMs{0});
+        hosts[2]->serviceEvents(counter(1), TimeoutMs{1});
+    }
+    server->stopServiceThread();
+
+    if (!copied) {
+        throw std::runtime_error("Removing from a group with a queued send did not copy the members");
+    }
+    if (received[0] != 1 || received[1] != 1) {
+        throw std::runtime_error("Queued group send did not keep the members it was issued with");
+    }
+    std::cout << "Add, stale replacement, swap-remove and copy-on-write under a queued send checked\n";
+}
+
+// Compresses a datagram handed over in two buffers, as ENet passes header and commands.
+size_t compress_datagram(detail::Compressor& compressor, const std::vector<uint8_t>& datagram, std::vector<uint8_t>& out) {
+    ENetBuffer buffers[2];
+    buffers[0].data = const_cast<uint8_t*>(datagram.data());
+    buffers[0].dataLength = datagram.size() / 3;
+    buffers[1].data = const_cast<uint8_t*>(datagram.data()) + buffers[0].dataLength;
+    buffers[1].dataLength = datagram.size() - buffers[0].dataLength;
+    out.resize(datagram.size());
+    return compressor.compress(buffers, 2, datagram.size(), out.data(), out.size());
+}
+
+bool round_trips(detail::Compressor& compressor, const std::vector<uint8_t>& datagram) {
+    std::vector<uint8_t> packed;
+    size_t written = compress_datagram(compressor, datagram, packed);
+    if (written == 0 || written >= datagram.size()) {
+        return false;
+    }
+    std::vector<uint8_t> unpacked(datagram.size());
+    return compressor.decompress(packed.data(), written, unpacked.data(), unpacked.size()) == datagram.size() &&
+           unpacked == datagram;
+}
+
+void test_compressor() {
+    std::cout << "=== Testing Datagram Compressors ===\n";
+
+    std::vector<uint8_t> compressible;
+    for (int i = 0; i < 12; ++i) {
+        std::string run = "position update " + std::to_string(i % 3) + std::string(40, static_cast<char>('a' + i % 3));
+        compressible.insert(compressible.end(), run.begin(), run.end());
+    }
+    std::vector<uint8_t> noise(compressible.size());
+    uint32_t seed = 12345;
+    for (auto& byte : noise) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(seed >> 24);
+    }
+
+    size_t tested = 0;
+    for (auto algorithm : {CompressionAlgorithm::rangeCoder, CompressionAlgorithm::lz4, CompressionAlgorithm::zstd}) {
+        if (!detail::Compressor::supports(algorithm)) {
+            continue;
+        }
+        ++tested;
+        CompressorConfig config;
+        config.algorithm = algorithm;
+        config.backoffDatagrams = 4;
+
+        auto compressor = detail::Compressor::create(config);
+        if (!round_trips(*compressor, compressible) || !round_trips(*compressor, compressible)) {
+            throw std::runtime_error("Compressor round trip failed");
+        }
+
+        std::vector<uint8_t> packed;
+        std::vector<uint8_t> small(compressible.begin(), compressible.begin() + 32);
+        if (compress_datagram(*compressor, small, packed) != 0) {
+            throw std::runtime_error("Datagrams under minimumSize should be sent as-is");
+        }
+        uint8_t garbage[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+        uint8_t unpacked[16];
+        compressor->decompress(garbage, 0, unpacked, sizeof(unpacked));
+
+        auto stats = compressor->stats();
+        if (stats.datagramsCompressed != 2 || stats.datagramsSkipped != 1 || stats.datagramsDecompressed != 2 ||
+            stats.decompressFailures != 1 || stats.ratio() >= 1.0) {
+            throw std::runtime_error("Compressor stats do not match the datagrams seen");
+        }
+
+        // Eight poor results in a row skip the next backoffDatagrams, however compressible.
+        for (int i = 0; i < 8; ++i) {
+            if (compress_datagram(*compressor, noise, packed) != 0) {
+                throw std::runtime_error("Incompressible datagram should be rejected by maximumRatio");
+            }
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (compress_datagram(*compressor, compressible, packed) != 0) {
+                throw std::runtime_error("Compressor did not back off after a poor streak");
+            }
+        }
+        if (!round_trips(*compressor, compressible) || compressor->stats().datagramsSkipped != 13) {
+            throw std::runtime_error("Compressor did not resume after backing off");
+        }
+
+        if (algorithm == CompressionAlgorithm::rangeCoder) {
+            continue;
+        }
+        // Both ends load the same dictionary; datagrams resembling it shrink further.
+        auto plain = detail::Compressor::create(config);
+        config.dictionary.assign(compressible.begin(), compressible.end());
+        auto primed = detail::Compressor::create(config);
+        std::vector<uint8_t> plainOut;
+        std::vector<uint8_t> primedOut;
+        size_t plainSize = compress_datagram(*plain, compressible, plainOut);
+        size_t primedSize = compress_datagram(*primed, compressible, primedOut);
+        if (!round_trips(*primed, compressible) || primedSize == 0 || primedSize >= plainSize) {
+            throw std::runtime_error("Dictionary compression did not help on matching data");
+        }
+    }
+    std::cout << tested << " compressor(s) round-tripped; minimum size, ratio backoff"
+              << (tested > 1 ? " and dictionaries" : "") << " checked\n";
+}
+
+void test_batched_socket() {
+    std::cout << "=== Testing Batched Socket Backend ===\n";
+
+    if (!Library::supportsSocketBackend(SocketBackend::batched)) {
+        std::cout << "Batched sockets unsupported here, skipped\n";
+        return;
+    }
+
+    // Messages over one datagram leave as equal-sized fragments, which GSO merges.
+    std::vector<std::string> messages;
+    for (size_t size : {16, 900, 5000, 40000, 64}) {
+        messages.emplace_back(size, static_cast<char>('a' + messages.size()));
+    }
+
+    for (bool offload : {true, false}) {
+        HostConfig config;
+        config.socketBackend = SocketBackend::batched;
+        config.socketBatchSize = 8;
+        config.udpOffload = offload;
+        auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), config);
+        auto target = Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port);
+        auto client = Host::createClient(config);
+        auto peer = client->connect(target);
+        if (!service_pair(*server, *client, [&] { return server->peerCount() == 1 && peer->isConnected(); })) {
+            throw std::runtime_error("Batched client never connected");
+        }
+        auto remote = server->getPeers().front();
+
+        auto echo = [&](const EventRef& event) {
+            if (event.type == EventType::receive) {
+                remote->send(0, event.packet.retain());
+            }
+        };
+        std::vector<std::string> echoed;
+        auto collect = [&](const EventRef& event) {
+            if (event.type == EventType::receive) {
+                auto bytes = event.packet.data();
+                echoed.emplace_back(bytes.begin(), bytes.end());
+            }
+        };
+        for (const auto& message : messages) {
+            peer->send(0, message, ENET_PACKET_FLAG_RELIABLE);
+        }
+        for (int i = 0; i < 1000 && echoed.size() < messages.size(); ++i) {
+            client->serviceEvents(collect, TimeoutMs{1});
+            server->serviceEvents(echo, TimeoutMs{1});
+        }
+        if (echoed != messages) {
+            throw std::runtime_error(std::string("Batched echo lost or reordered data, offload ") + (offload ? "on" : "off"));
+        }
+    }
+    std::cout << messages.size() << " messages echoed over batched sockets with and without UDP offload\n";
+}
+
+// Counts global operator new so tests can check a path does not touch the heap.
+std::atomic<uint64_t> heapAllocations{0};
+
+auto operator new(size_t size) -> void* {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator new[](size_t size) -> void* {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+int releasedPackets = 0;
+
+void count_release(ENetPacket*) {
+    ++releasedPackets;
+}
+
+auto pool_allocations() -> uint64_t {
+    auto stats = Library::allocatorStats();
+    return stats.hits + stats.misses + stats.oversized;
+}
+
+void test_borrowed_service_events() {
+    std::cout << "=== Testing Borrowed Packets Through serviceEvents ===\n";
+
+    if (!Library::initialize(AllocatorConfig{})) {
+        throw std::runtime_error("Failed to initialize library with pooled allocator");
+    }
+    {
+        auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0));
+        auto client = Host::createClient();
+        auto peer = client->connect(Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port));
+        if (!service_pair(*server, *client, [&] { return server->peerCount() == 1 && peer->isConnected(); })) {
+            throw std::runtime_error("Client never connected");
+        }
+
+        constexpr int COUNT = 32;
+        auto send_all = [&] {
+            for (int i = 0; i < COUNT; ++i) {
+                peer->send(0, "payload " + std::to_string(i), ENET_PACKET_FLAG_RELIABLE);
+            }
+            client->flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        };
+
+        // Each handler sees its packet in place; the host frees it once the handler returns.
+        int received = 0;
+        bool inOrder = true;
+        bool heldDuringHandler = true;
+        std::unique_ptr<Packet> kept;
+        auto borrow = [&](const EventRef& event) {
+            if (event.type != EventType::receive) {
+                return;
+            }
+            auto expected = "payload " + std::to_string(received);
+            auto bytes = event.packet.data();
+            inOrder = inOrder && std::string(bytes.begin(), bytes.end()) == expected && event.packet.size() == expected.size();
+            heldDuringHandler = heldDuringHandler && releasedPackets == received - (kept ? 1 : 0);
+            event.packet.nativeHandle()->freeCallback = count_release;
+            if (++received == COUNT) {
+                kept = event.packet.retain();
+            }
+        };
+
+        send_all();
+        releasedPackets = 0;
+        auto heap = heapAllocations.load();
+        auto pool = pool_allocations();
+        for (int i = 0; i < 200 && received < COUNT; ++i) {
+            server->serviceEvents(borrow, TimeoutMs{1});
+        }
+        auto borrowedHeap = heapAllocations.load() - heap;
+        auto borrowedPool = pool_allocations() - pool;
+
+        if (received != COUNT || !inOrder || !heldDuringHandler) {
+            throw std::runtime_error("serviceEvents did not lend each packet to the handler");
+        }
+        if (releasedPackets != COUNT - 1 || !kept || kept->asString() != "payload 31") {
+            throw std::runtime_error("serviceEvents did not release borrowed packets after the handler");
+        }
+        kept.reset();
+        if (releasedPackets != COUNT) {
+            throw std::runtime_error("Retained packet was not freed with its Packet");
+        }
+        if (borrowedHeap != 0) {
+            throw std::runtime_error("serviceEvents allocated on the heap: " + std::to_string(borrowedHeap));
+        }
+
+        // The dispatcher path wraps every packet, so it allocates once more per event; the
+        // borrowed run's only wrapper was the one retain() made.
+        int dispatched = 0;
+        server->getDispatcher().onReceive([&dispatched](const ReceiveEvent&) { ++dispatched; });
+        send_all();
+        pool = pool_allocations();
+        for (int i = 0; i < 200 && dispatched < COUNT; ++i) {
+            server->serviceAll(TimeoutMs{1});
+        }
+        auto dispatchedPool = pool_allocations() - pool;
+        if (dispatched != COUNT || dispatchedPool < borrowedPool - 1 + COUNT) {
+            throw std::runtime_error("serviceEvents allocated as much as the dispatcher path");
+        }
+        std::cout << COUNT << " packets borrowed with no heap allocation; pool allocations "
+                  << borrowedPool << " borrowed vs " << dispatchedPool << " dispatched\n";
+    }
+    Library::deinitialize();
+}
+
+void test_resolver() {
+    std::cout << "=== Testing Resolver ===\n";
+
+    auto& resolver = Resolver::instance();
+    auto& scheduler = async::TaskScheduler::instance();
+    resolver.clear();
+    resolver.configure(ResolverConfig{});
+    scheduler.start(async::SchedulerConfig{.threadCount = 2});
+
+    // Waits for a lookup that went to a worker; false if it answered straight away.
+    auto lookup_later = [&resolver](const std::string& name, std::optional<Endpoint>& result) {
+        std::promise<std::optional<Endpoint>> done;
+        Endpoint endpoint;
+        auto status = resolver.lookup(name, 80, endpoint, [&done](std::optional<Endpoint> found) { done.set_value(found); });
+        if (status != Resolver::Lookup::pending) {
+            return false;
+        }
+        result = done.get_future().get();
+        return true;
+    };
+
+    // Dotted quads are parsed in place: no worker, no cache entry.
+    Endpoint numeric;
+    bool called = false;
+    auto status = resolver.lookup("10.1.2.3", 80, numeric, [&called](std::optional<Endpoint>) { called = true; });
+    if (status != Resolver::Lookup::resolved || numeric != Endpoint::parse("10.1.2.3", 80) || called ||
+        resolver.cached("10.1.2.3", 80)) {
+        throw std::runtime_error("Numeric address did not bypass the resolver");
+    }
+
+    // An empty name fails without a DNS server; the failure is remembered for negativeTtl.
+    bool threw = false;
+    try {
+        resolver.resolve("", 80).get();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    if (!threw || resolver.lookup("", 80, numeric, [](std::optional<Endpoint>) {}) != Resolver::Lookup::failed) {
+        throw std::runtime_error("Failed lookup was not reported or not cached");
+    }
+
+    // "127.1" is numeric to getaddrinfo but not a dotted quad, so it takes the query path.
+    auto loopback = Endpoint::parse("127.0.0.1", 7777);
+    if (resolver.resolve("127.1", 7777).get() != loopback || resolver.cached("127.1", 80) != Endpoint{loopback.host, 80} ||
+        resolver.lookup("127.1", 80, numeric, [](std::optional<Endpoint>) {}) != Resolver::Lookup::resolved) {
+        throw std::runtime_error("Resolved name was not cached");
+    }
+    ResolverConfig expiring;
+    expiring.ttl = std::chrono::seconds{0};
+    resolver.configure(expiring);
+    resolver.clear();
+    resolver.resolve("127.1", 7777).get();
+    std::optional<Endpoint> found;
+    if (resolver.cached("127.1", 80) || !lookup_later("127.1", found) || found != Endpoint{loopback.host, 80}) {
+        throw std::runtime_error("Expired entry was reused instead of queried again");
+    }
+    resolver.configure(ResolverConfig{});
+
+    // connectAsync by name: resolved on a worker, connected by whoever services the host.
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0));
+    auto port = server->nativeHandle()->address.port;
+    auto client = Host::createClient();
+    std::atomic<int> outcome{0};
+    auto connect = [](std::shared_ptr<Host> host, std::string name, uint16_t target, std::atomic<int>& out) -> async::Task<> {
+        try {
+            auto peer = co_await host->connectAsync(name, target);
+            out = peer && peer->isConnected() ? 1 : -1;
+        } catch (const std::runtime_error&) {
+            out = -1;
+        }
+    };
+    scheduler.scheduleTask(connect(client, "127.1", port, outcome));
+    bool connected = service_pair(*server, *client, [&] { return outcome.load() != 0 && server->peerCount() == 1; });
+    scheduler.stop();
+    resolver.clear();
+
+    if (!connected || outcome.load() != 1) {
+        throw std::runtime_error("connectAsync by name did not connect");
+    }
+    std::cout << "Numeric, failed, cached and expired lookups checked; connectAsync resolved 127.1\n";
+}
+
+void test_streams() {
+    std::cout << "=== Testing Streams Between Two Hosts ===\n";
+
+    HostConfig config;
+    config.maxChannels = 2;
+    auto server = Host::createServer(Endpoint::parse("127.0.0.1", 0), config);
+    auto client = Host::createClient(config);
+    auto peer = client->connect(Endpoint::parse("127.0.0.1", server->nativeHandle()->address.port), 2);
+    if (!service_pair(*server, *client, [&] { return server->peerCount() == 1 && peer->isConnected(); })) {
+        throw std::runtime_error("Client never connected");
+    }
+
+    // The receiver rebuilds each stream from its chunks, which must arrive in order.
+    std::map<uint32_t, std::vector<uint8_t>> assembled;
+    std::map<uint32_t, uint32_t> tags;
+    std::map<uint32_t, bool> ended;
+    bool ordered = true;
+    size_t largestChunk = 0;
+    server->onStream(1, [&](const StreamChunk& chunk) {
+        auto& bytes = assembled[chunk.streamId];
+        ordered = ordered && chunk.offset == bytes.size() && !ended[chunk.streamId];
+        bytes.insert(bytes.end(), chunk.data.begin(), chunk.data.end());
+        tags[chunk.streamId] = chunk.tag;
+        ended[chunk.streamId] = chunk.last();
+        largestChunk = std::max(largestChunk, chunk.data.size());
+    });
+
+    std::vector<uint8_t> blob(300 * 1024 + 123);
+    for (size_t i = 0; i < blob.size(); ++i) {
+        blob[i] = static_cast<uint8_t>(i * 31 + i / 251);
+    }
+    auto path = temp_capture("icelander_stream_test.bin");
+    std::vector<uint8_t> fileBytes(blob.rbegin(), blob.rbegin() + 100 * 1024);
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(fileBytes.data()), static_cast<std::streamsize>(fileBytes.size()));
+
+    constexpr size_t WINDOW = 64 * 1024;
+    std::vector<int> completions;
+    StreamOptions options;
+    options.tag = 7;
+    options.window = WINDOW;
+    options.onComplete = [&completions](bool ok) { completions.push_back(ok ? 1 : 0); };
+    auto blobId = peer->sendStream(1, Span<const uint8_t>(blob.data(), blob.size()), options);
+    if (blobId == 0 || client->activeStreams() != 1) {
+        throw std::runtime_error("Buffer stream did not start");
+    }
+
+    // Reliable data in transit stays within the window plus the chunk that crossed it.
+    uint32_t peakInTransit = 0;
+    auto ignore = [](const EventRef&) {};
+    auto run = [&](size_t streams) {
+        for (int i = 0; i < 2000 && completions.size() < streams; ++i) {
+            client->serviceEvents(ignore, TimeoutMs{0});
+            peakInTransit = std::max(peakInTransit, peer->nativeHandle()->reliableDataInTransit);
+            server->serviceEvents(ignore, TimeoutMs{1});
+        }
+    };
+    run(1);
+    options.tag = 8;
+    auto fileId = peer->sendFile(1, path, options);
+    if (fileId == 0 || fileId == blobId) {
+        throw std::runtime_error("File stream did not start");
+    }
+    run(2);
+    std::filesystem::remove(path);
+
+    if (completions != std::vector<int>{1, 1} || client->activeStreams() != 0) {
+        throw std::runtime_error("Streams did not complete");
+    }
+    if (!ordered || assembled[blobId] != blob || assembled[fileId] != fileBytes || !ended[blobId] || !ended[fileId] ||
+        tags[blobId] != 7 || tags[fileId] != 8) {
+        throw std::runtime_error("Stream data was not reassembled");
+    }
+    if (largestChunk != StreamOptions{}.chunkSize || peakInTransit == 0 || peakInTransit > WINDOW + largestChunk + detail::STREAM_HEADER_SIZE) {
+        throw std::runtime_error("Stream ignored its chunk size or window: " + std::to_string(peakInTransit));
+    }
+
+    // A stream cut off by a disconnect completes with false once ENet frees its chunks.
+    std::vector<uint8_t> large(4 * 1024 * 1024, 0x5A);
+    options.window = 32 * 1024;
+    completions.clear();
+    auto cutId = peer->sendStream(1, Span<const uint8_t>(large.data(), large.size()), options);
+    for (int i = 0; i < 500 && assembled[cutId].empty(); ++i) {
+        client->serviceEvents(ignore, TimeoutMs{0});
+        server->serviceEvents(ignore, TimeoutMs{1});
+    }
+    server->getPeers().front()->disconnectNow();
+    for (int i = 0; i < 500 && completions.empty(); ++i) {
+        client->serviceEvents(ignore, TimeoutMs{1});
+    }
+    if (assembled[cutId].empty() || assembled[cutId].size() >= large.size() || completions != std::vector<int>{0} ||
+        client->activeStreams() != 0) {
+        throw std::runtime_error("Interrupted stream did not report failure");
+    }
+    std::cout << "Buffer and file streams reassembled, peak " << peakInTransit
+              << " bytes in transit; interrupted stream failed cleanly\n";
+}
+
+int main() {
+    std::cout << "Icelander Library Test Suite\n";
+    std::cout << "============================\n\n";
+    
+    try {
+        test_library_functions();
+        std::cout << "\n";
+        
+        test_endpoint_operations();
+        std::cout << "\n";
+        
+        test_packet_operations();
+        std::cout << "\n";
+
+        test_peer_registry();
+        std::cout << "\n";
+
+        test_event_dispatch();
+        std::cout << "\n";
+
+        test_allocator_pool();
+        std::cout << "\n";
+
+        test_schema_serialization();
+        std::cout << "\n";
+
+        test_delta_replication();
+        std::cout << "\n";
+        
+        test_async_scheduler();
+        std::cout << "\n";
+
+        test_coroutine_tasks();
+        std::cout << "\n";
+
+        test_metrics();
+        std::cout << "\n";
+
+        test_accept_guard();
+        std::cout << "\n";
+
+        test_channel_scheduler();
+        std::cout << "\n";
+
+        test_scheduled_service_events();
+        std::cout << "\n";
+
+        test_tick_loop();
+        std::cout << "\n";
+
+        test_interest_grid();
+        std::cout << "\n";
+
+        test_capture_replay();
+        std::cout << "\n";
+
+        test_service_all();
+        std::cout << "\n";
+
+        test_cross_thread_commands();
+        std::cout << "\n";
+
+        test_service_thread_wakeup();
+        std::cout << "\n";
+
+        test_sharded_host();
+        std::cout << "\n";
+
+        test_parallel_dispatch();
+        std::cout << "\n";
+
+        test_peer_group();
+        std::cout << "\n";
+
+        test_compressor();
+        std::cout << "\n";
+        test_batched_socket();
+        std::cout << "\n";
+        test_borrowed_service_events();
+        std::cout << "\n";
+        test_resolver();
+        std::cout << "\n";
+        test_streams();
         std::cout << "\n";
         
         std::cout << "All tests completed successfully!\n";
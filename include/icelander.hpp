@@ -11,14 +11,34 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <future>
 #include <unordered_map>
 #include <optional>
+#include <span>
 #include <type_traits>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <cstdint>
 #include <stdexcept>
+#include <utility>
+#include <array>
+#include <tuple>
+#include <bit>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <cstddef>
+#include <iterator>
+#include <concepts>
+#include <cstring>
+#include <algorithm>
+
+// Build with ICELANDER_METRICS=0 (CMake: ICELANDER_ENABLE_METRICS=OFF) to compile out all
+// metric recording; snapshots then come back empty.
+#ifndef ICELANDER_METRICS
+#define ICELANDER_METRICS 1
+#endif
 
 namespace icelander {
     using AddressT = ENetAddress;
@@ -31,6 +51,7 @@ namespace icelander {
     using Timestamp = std::chrono::steady_clock::time_point;
 
     constexpr size_t MAX_CHANNELS = ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT;
+    constexpr bool METRICS_ENABLED = ICELANDER_METRICS != 0;
     constexpr size_t MAX_PEERS = 4096;
     constexpr PacketFlagsT DEFAULT_FLAGS = ENET_PACKET_FLAG_RELIABLE;
     constexpr TimeoutMs DEFAULT_TIMEOUT{1000};
@@ -63,17 +84,156 @@ namespace icelander {
         receive = ENET_EVENT_TYPE_RECEIVE
     };
 
+    // Numeric IPv4 address and port. `host` is in network byte order, exactly as in
+    // ENetAddress. Nothing here touches DNS except resolve() and lookupHostName().
     struct Endpoint {
-        std::string host;
-        uint16_t port;
+        uint32_t host = ENET_HOST_ANY;
+        uint16_t port = 0;
 
-        auto toEnetAddress() const -> AddressT;
+        static auto resolve(const std::string& hostName, uint16_t port) -> Endpoint;
+        static auto parse(const std::string& address, uint16_t port) -> Endpoint;
+        static auto any(uint16_t port) -> Endpoint;
         static auto fromEnetAddress(const AddressT& addr) -> Endpoint;
+
+        auto toEnetAddress() const -> AddressT;
+        auto hostString() const -> std::string;
+        auto toString() const -> std::string;
+        auto lookupHostName() const -> std::string;
+
+        auto operator==(const Endpoint& other) const -> bool = default;
+    };
+
+    struct EndpointHash {
+        auto operator()(const Endpoint& endpoint) const noexcept -> size_t {
+            return std::hash<uint64_t>{}((static_cast<uint64_t>(endpoint.host) << 16) | endpoint.port);
+        }
+    };
+
+    static_assert(std::is_trivially_copyable_v<Endpoint>);
+
+    struct ResolverConfig {
+        std::chrono::seconds ttl{60};           // how long a resolved address is reused
+        std::chrono::seconds negativeTtl{5};    // how long a failed lookup is remembered
+        size_t maxEntries = 1024;               // when full, the entry closest to expiry goes
+    };
+
+    // Hostname lookups on TaskScheduler workers, so a slow DNS server stalls neither the
+    // caller nor the service thread. Concurrent lookups of one name share a single query.
+    // ENet's resolver reports no record TTL, so results are kept for ResolverConfig::ttl.
+    // With the scheduler stopped, queries run on the calling thread.
+    class Resolver {
+    public:
+        enum class Lookup { resolved, failed, pending };
+        using Callback = std::function<void(std::optional<Endpoint>)>;
+
+        static auto instance() -> Resolver&;
+
+        void configure(const ResolverConfig& config);
+        // Answers from the cache or a numeric address when it can, filling `endpoint`.
+        // Otherwise returns pending and calls `done` on a worker once the query finishes.
+        auto lookup(const std::string& hostName, uint16_t port, Endpoint& endpoint, Callback done) -> Lookup;
+        auto resolve(const std::string& hostName, uint16_t port) -> std::future<Endpoint>;
+        auto cached(const std::string& hostName, uint16_t port) const -> std::optional<Endpoint>;
+        void clear();
+
+    private:
+        struct Waiter {
+            uint16_t port;
+            Callback done;
+        };
+
+        struct Entry {
+            uint32_t host = 0;
+            bool resolved = false;
+            bool pending = false;
+            Timestamp expires{};
+            std::vector<Waiter> waiters;
+        };
+
+        Resolver() = default;
+
+        auto query(const std::string& hostName) -> std::optional<uint32_t>;
+        auto finish(const std::string& hostName, std::optional<uint32_t> host) -> void;
+        auto evict(Timestamp now) -> void;
+
+        mutable std::mutex mutex_;
+        ResolverConfig config_;
+        std::unordered_map<std::string, Entry> entries_;
     };
 
     template<typename T>
     concept Serializable = std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>;
 
+    // Element types for the bulk array APIs, sent little-endian. bool is left out: its
+    // object representation is unspecified and std::vector<bool> has no data().
+    template<typename T>
+    concept WireScalar = std::is_arithmetic_v<T> && !std::is_same_v<std::remove_cv_t<T>, bool>;
+
+    // Wire schema for T, declared next to it by specializing Schema<T>. Fields are encoded
+    // in list order after a uint16 version. A field added later names the version it
+    // arrived in and goes after the older ones, so peers on either version can read each
+    // other: missing fields decode as their defaults and unknown trailing ones are ignored.
+    //
+    //     template<> struct icelander::Schema<PlayerState> {
+    //         static constexpr uint16_t version = 2;
+    //         using Fields = FieldList<Field<&PlayerState::id>, Field<&PlayerState::name>,
+    //                                  Field<&PlayerState::score, 2>>;
+    //     };
+    //
+    // Supported field types: arithmetic and enum scalars, bool, std::array of scalars,
+    // std::string and std::vector of scalars (the last two varint-prefixed). bool is not a
+    // scalar for the array types.
+    template<typename T>
+    struct Schema;
+
+    namespace detail {
+        template<typename M>
+        struct MemberTraits;
+
+        template<typename C, typename V>
+        struct MemberTraits<V C::*> {
+            using Class = C;
+            using Value = V;
+        };
+    }
+
+    template<auto Member, uint16_t Since = 1>
+    struct Field {
+        using Class = typename detail::MemberTraits<decltype(Member)>::Class;
+        using Value = typename detail::MemberTraits<decltype(Member)>::Value;
+        static constexpr auto member = Member;
+        static constexpr uint16_t since = Since;
+    };
+
+    template<typename... Fields>
+    using FieldList = std::tuple<Fields...>;
+
+    template<typename T>
+    concept HasSchema = requires {
+        { Schema<T>::version } -> std::convertible_to<uint16_t>;
+        typename Schema<T>::Fields;
+    };
+
+    namespace detail {
+        // Converts between host order and little-endian wire order; a no-op on little-endian hosts.
+        template<std::unsigned_integral T>
+        constexpr auto littleEndian(T value) -> T {
+            if constexpr (std::endian::native == std::endian::little || sizeof(T) == 1) {
+                return value;
+            } else {
+                T swapped = 0;
+                for (size_t i = 0; i < sizeof(T); ++i) {
+                    swapped = static_cast<T>((swapped << 8) | (value & 0xFF));
+                    value = static_cast<T>(value >> 8);
+                }
+                return swapped;
+            }
+        }
+
+        // Reverses the bytes of each `width`-byte element in place.
+        void swapElementBytes(uint8_t* data, size_t count, size_t width);
+    }
+
     template<typename T>
     struct Span {
         const T* data_;
@@ -88,12 +248,45 @@ namespace icelander {
         const T& operator[](size_t i) const { return data_[i]; }
     };
 
+    struct AllocatorConfig {
+        bool enablePooling = true;
+        size_t maxPooledSize = 4096;    // larger requests go straight to malloc (max 64 KiB)
+        size_t threadCacheLimit = 256;  // free blocks per size class kept by each thread
+    };
+
+    struct AllocatorStats {
+        uint64_t hits = 0;          // served from a thread cache or the shared free lists
+        uint64_t misses = 0;        // needed a fresh slab from the system allocator
+        uint64_t oversized = 0;     // above maxPooledSize, bypassed the pools
+        uint64_t frees = 0;         // blocks returned to the pools
+        uint64_t bytesReserved = 0; // slab memory owned by the pools
+    };
+
+    enum class CompressionAlgorithm {
+        none,
+        rangeCoder,     // ENet's built-in adaptive range coder
+        lz4,            // requires building with liblz4
+        zstd            // requires building with libzstd
+    };
+
+    enum class SocketBackend {
+        standard,       // ENet's socket layer, one syscall per datagram
+        batched         // Linux recvmmsg/sendmmsg with UDP GSO/GRO when linked with
+                        // LandingPad::IcelanderBatchedIO; standard otherwise
+    };
+
     class Library {
     public:
         static bool initialize();
+        // Installs the pooled allocator for ENet and Packet wrappers. Call before any
+        // packet is created; ENet cannot switch allocators once memory is in flight.
+        static bool initialize(const AllocatorConfig& config);
         static void deinitialize();
         static auto version() -> uint32_t;
         static bool isInitialized();
+        static auto allocatorStats() -> AllocatorStats;
+        static auto supportsCompression(CompressionAlgorithm algorithm) -> bool;
+        static auto supportsSocketBackend(SocketBackend backend) -> bool;
 
     private:
         static inline bool initialized_ = false;
@@ -137,17 +330,71 @@ namespace icelander {
         bool hasFlag(PacketFlag flag) const;
 
         auto nativeHandle() const -> ENetPacket*;
+        auto release() -> ENetPacket*;
         static auto fromNative(ENetPacket* nativePacket) -> std::unique_ptr<Packet>;
 
+        static auto operator new(size_t size) -> void*;
+        static void operator delete(void* memory) noexcept;
+
     private:
         explicit Packet(ENetPacket* nativePacket);
         ENetPacket* nativePacket_;
     };
 
+    namespace detail {
+        // Owns a received packet while a handler borrows it; PacketRef::retain() takes it.
+        struct PacketLoan {
+            ENetPacket* packet = nullptr;
+
+            ~PacketLoan() {
+                if (packet) {
+                    enet_packet_destroy(packet);
+                }
+            }
+        };
+    }
+
+    // Borrowed, trivially copyable view of a received packet, as carried by EventRef.
+    // Valid until the handler it was passed to returns; the host then destroys the packet
+    // unless retain() took it.
+    class PacketRef {
+    public:
+        PacketRef() = default;
+
+        auto data() const -> Span<const uint8_t>;
+        auto size() const -> size_t;
+        auto flags() const -> PacketFlagsT;
+        auto empty() const -> bool;
+
+        template<Serializable T>
+        auto as() const -> const T&;
+
+        // Takes ownership without copying, e.g. to forward with Peer::send. nullptr if
+        // there is no packet or some copy of this ref already retained it.
+        auto retain() const -> std::unique_ptr<Packet>;
+        auto nativeHandle() const -> ENetPacket*;
+
+    private:
+        friend class Host;
+
+        PacketRef(ENetPacket* nativePacket, detail::PacketLoan* loan) : nativePacket_(nativePacket), loan_(loan) {}
+
+        ENetPacket* nativePacket_ = nullptr;
+        detail::PacketLoan* loan_ = nullptr;
+    };
+
+    // Serializes straight into an ENetPacket it owns; build() hands that packet over
+    // without copying. Storage grows geometrically and survives reset().
     class PacketBuilder {
     public:
         PacketBuilder();
         explicit PacketBuilder(size_t initialCapacity);
+        ~PacketBuilder();
+
+        PacketBuilder(const PacketBuilder&) = delete;
+        PacketBuilder& operator=(const PacketBuilder&) = delete;
+        PacketBuilder(PacketBuilder&& other) noexcept;
+        PacketBuilder& operator=(PacketBuilder&& other) noexcept;
 
         template<Serializable T>
         auto write(const T& value) -> PacketBuilder&;
@@ -156,15 +403,30 @@ namespace icelander {
         auto write(const std::string& packetData) -> PacketBuilder&;
         auto write(const void* packetData, size_t size) -> PacketBuilder&;
 
+        // Fixed-width integers are little-endian on the wire; write<T>() copies raw bytes.
         auto writeUint8(uint8_t value) -> PacketBuilder&;
         auto writeUint16(uint16_t value) -> PacketBuilder&;
         auto writeUint32(uint32_t value) -> PacketBuilder&;
         auto writeUint64(uint64_t value) -> PacketBuilder&;
 
+        // LEB128, 1-10 bytes; writeVarInt zigzag-encodes so small negatives stay short.
+        auto writeVarUint(uint64_t value) -> PacketBuilder&;
+        auto writeVarInt(int64_t value) -> PacketBuilder&;
+
+        // writeString prefixes a uint32 length, writeVarString a varint length.
         auto writeString(const std::string& str) -> PacketBuilder&;
+        auto writeVarString(const std::string& str) -> PacketBuilder&;
+
+        // Little-endian elements without a count; one memcpy on little-endian hosts.
+        template<WireScalar T>
+        auto writeArray(const T* values, size_t count) -> PacketBuilder&;
+
+        template<HasSchema T>
+        auto writeSchema(const T& value) -> PacketBuilder&;
 
         auto reserve(size_t capacity) -> PacketBuilder&;
         auto clear() -> PacketBuilder&;
+        auto reset() -> PacketBuilder&;
 
         auto size() const -> size_t;
         auto capacity() const -> size_t;
@@ -174,7 +436,15 @@ namespace icelander {
         auto data() const -> Span<const uint8_t>;
 
     private:
-        std::vector<uint8_t> buffer_;
+        static constexpr size_t minimumCapacity = 64;
+
+        auto append(size_t bytes) -> uint8_t*;
+        void grow(size_t required);
+
+        ENetPacket* packet_ = nullptr;
+        size_t size_ = 0;
+        size_t capacity_ = 0;
+        size_t nextCapacity_ = 0;
     };
 
     class PacketReader {
@@ -190,7 +460,20 @@ namespace icelander {
         auto readUint16() -> uint16_t;
         auto readUint32() -> uint32_t;
         auto readUint64() -> uint64_t;
+        auto readVarUint() -> uint64_t;
+        auto readVarInt() -> int64_t;
         auto readString(size_t length) -> std::string;
+        auto readVarString() -> std::string;
+
+        template<WireScalar T>
+        auto readArray(T* values, size_t count) -> bool;
+        template<WireScalar T>
+        auto readArray(size_t count) -> std::vector<T>;
+
+        // nullopt if the data does not hold a valid encoding. A value from a newer schema
+        // version consumes the rest of the reader, since its extra fields cannot be sized.
+        template<HasSchema T>
+        auto readSchema() -> std::optional<T>;
 
         auto remaining() const -> size_t;
         auto position() const -> size_t;
@@ -202,13 +485,392 @@ namespace icelander {
         void reset();
 
         auto asString() const -> std::string;
+        // Borrows the next `size` bytes without copying; nullopt if fewer remain.
+        auto readView(size_t size) -> std::optional<Span<const uint8_t>>;
 
     private:
         Span<const uint8_t> data_;
         size_t position_;
     };
 
+    // Packs sub-byte fields LSB-first into a PacketBuilder, emitting whole bytes as they
+    // fill. Call flush() when done: it pads the last byte with zero bits, after which
+    // byte-level writes to the builder may continue.
+    class BitWriter {
+    public:
+        explicit BitWriter(PacketBuilder& builder) : builder_(builder) {}
+
+        BitWriter(const BitWriter&) = delete;
+        BitWriter& operator=(const BitWriter&) = delete;
+
+        auto writeBits(uint64_t value, unsigned bits) -> BitWriter&;
+        auto writeBool(bool value) -> BitWriter&;
+        // Maps [minimum, maximum] onto `bits` (1-32) bits; out-of-range values are clamped.
+        auto writeQuantized(float value, float minimum, float maximum, unsigned bits) -> BitWriter&;
+        auto flush() -> BitWriter&;
+
+        auto bitsWritten() const -> size_t;
+
+    private:
+        PacketBuilder& builder_;
+        uint64_t scratch_ = 0;
+        unsigned pending_ = 0;
+        size_t bitsWritten_ = 0;
+    };
+
+    // Reads fields written by BitWriter, pulling bytes from the PacketReader on demand.
+    // align() drops the rest of the current byte so byte-level reads can resume.
+    class BitReader {
+    public:
+        explicit BitReader(PacketReader& reader) : reader_(reader) {}
+
+        auto readBits(unsigned bits) -> uint64_t;
+        auto readBool() -> bool;
+        auto readQuantized(float minimum, float maximum, unsigned bits) -> float;
+        void align();
+
+    private:
+        PacketReader& reader_;
+        uint64_t scratch_ = 0;
+        unsigned available_ = 0;
+    };
+
+    // Sub-messages of a packet built by Peer::queueMessage(): each is a uint16 length
+    // followed by that many bytes. Yields a PacketReader over each one in place;
+    // iteration stops at the end or at a truncated entry.
+    class SubMessages {
+    public:
+        class Iterator {
+        public:
+            using value_type = PacketReader;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() : reader_(Span<const uint8_t>(nullptr, 0)) {}
+            explicit Iterator(Span<const uint8_t> packetData);
+
+            auto operator*() const -> PacketReader { return *current_; }
+            auto operator++() -> Iterator&;
+            auto operator++(int) -> Iterator;
+            auto operator==(std::default_sentinel_t) const -> bool { return !current_; }
+
+        private:
+            void advance();
+
+            PacketReader reader_;
+            std::optional<PacketReader> current_;
+        };
+
+        explicit SubMessages(const Packet& pkt) : data_(pkt.data()) {}
+        explicit SubMessages(Span<const uint8_t> packetData) : data_(packetData) {}
+
+        auto begin() const -> Iterator { return Iterator(data_); }
+        auto end() const -> std::default_sentinel_t { return {}; }
+
+    private:
+        Span<const uint8_t> data_;
+    };
+
+    // Little-endian scalar array borrowed from a packet buffer; elements convert on access.
+    template<WireScalar T>
+    class WireArray {
+    public:
+        WireArray() = default;
+        WireArray(const uint8_t* data, size_t count) : data_(data), count_(count) {}
+
+        auto size() const -> size_t { return count_; }
+        auto empty() const -> bool { return count_ == 0; }
+        auto operator[](size_t index) const -> T;
+        auto toVector() const -> std::vector<T>;
+
+    private:
+        const uint8_t* data_ = nullptr;
+        size_t count_ = 0;
+    };
+
+    namespace detail {
+        // Bytes consumed, or 0 if the varint is truncated or longer than 10 bytes.
+        inline auto parseVarUint(const uint8_t* data, size_t available, uint64_t& value) -> size_t {
+            value = 0;
+            for (size_t i = 0; i < available && i < 10; ++i) {
+                value |= static_cast<uint64_t>(data[i] & 0x7F) << (7 * i);
+                if (!(data[i] & 0x80)) {
+                    return i + 1;
+                }
+            }
+            return 0;
+        }
+
+        template<typename T>
+        auto loadScalar(const uint8_t* data) -> T {
+            if constexpr (std::is_enum_v<T>) {
+                return static_cast<T>(loadScalar<std::underlying_type_t<T>>(data));
+            } else {
+                T value;
+                std::memcpy(&value, data, sizeof(T));
+                if constexpr (std::endian::native != std::endian::little && sizeof(T) > 1) {
+                    swapElementBytes(reinterpret_cast<uint8_t*>(&value), 1, sizeof(T));
+                }
+                return value;
+            }
+        }
+
+        template<typename T>
+        void storeScalar(PacketBuilder& builder, const T& value) {
+            if constexpr (std::is_enum_v<T>) {
+                auto raw = static_cast<std::underlying_type_t<T>>(value);
+                builder.writeArray(&raw, 1);
+            } else {
+                builder.writeArray(&value, 1);
+            }
+        }
+
+        // Per-type wire format. Fixed fields have a constant wireSize; variable ones report
+        // their length through measure(), which is the only place they are bounds-checked.
+        template<typename T>
+        struct FieldCodec;
+
+        template<typename T>
+            requires WireScalar<T> || std::is_enum_v<T>
+        struct FieldCodec<T> {
+            using View = T;
+            static constexpr bool fixed = true;
+            static constexpr size_t wireSize = sizeof(T);
+
+            static void write(PacketBuilder& builder, const T& value) { storeScalar(builder, value); }
+            static auto view(const uint8_t* data) -> View { return loadScalar<T>(data); }
+            static auto decode(const uint8_t* data) -> T { return view(data); }
+        };
+
+        // One byte, 0 or 1; any non-zero byte reads back as true.
+        template<>
+        struct FieldCodec<bool> {
+            using View = bool;
+            static constexpr bool fixed = true;
+            static constexpr size_t wireSize = 1;
+
+            static void write(PacketBuilder& builder, const bool& value) { builder.writeUint8(value ? 1 : 0); }
+            static auto view(const uint8_t* data) -> View { return data[0] != 0; }
+            static auto decode(const uint8_t* data) -> bool { return view(data); }
+        };
+
+        template<WireScalar T, size_t N>
+        struct FieldCodec<std::array<T, N>> {
+            using View = std::array<T, N>;
+            static constexpr bool fixed = true;
+            static constexpr size_t wireSize = sizeof(T) * N;
+
+            static void write(PacketBuilder& builder, const View& value) { builder.writeArray(value.data(), N); }
+            static auto view(const uint8_t* data) -> View {
+                View value;
+                for (size_t i = 0; i < N; ++i) {
+                    value[i] = loadScalar<T>(data + i * sizeof(T));
+                }
+                return value;
+            }
+            static auto decode(const uint8_t* data) -> View { return view(data); }
+        };
+
+        template<>
+        struct FieldCodec<std::string> {
+            using View = std::string_view;
+            static constexpr bool fixed = false;
+            static constexpr size_t wireSize = 0;
+
+            static void write(PacketBuilder& builder, const std::string& value) { builder.writeVarString(value); }
+            static auto measure(const uint8_t* data, size_t available) -> size_t {
+                uint64_t length;
+                size_t prefix = parseVarUint(data, available, length);
+                return prefix && length <= available - prefix ? prefix + static_cast<size_t>(length) : 0;
+            }
+            static auto view(const uint8_t* data) -> View {
+                uint64_t length;
+                size_t prefix = parseVarUint(data, 10, length);
+                return View(reinterpret_cast<const char*>(data + prefix), static_cast<size_t>(length));
+            }
+            static auto decode(const uint8_t* data) -> std::string { return std::string(view(data)); }
+        };
+
+        template<WireScalar T>
+        struct FieldCodec<std::vector<T>> {
+            using View = WireArray<T>;
+            static constexpr bool fixed = false;
+            static constexpr size_t wireSize = 0;
+
+            static void write(PacketBuilder& builder, const std::vector<T>& value) {
+                builder.writeVarUint(value.size()).writeArray(value.data(), value.size());
+            }
+            static auto measure(const uint8_t* data, size_t available) -> size_t {
+                uint64_t count;
+                size_t prefix = parseVarUint(data, available, count);
+                return prefix && count <= (available - prefix) / sizeof(T) ? prefix + static_cast<size_t>(count) * sizeof(T) : 0;
+            }
+            static auto view(const uint8_t* data) -> View {
+                uint64_t count;
+                size_t prefix = parseVarUint(data, 10, count);
+                return View(data + prefix, static_cast<size_t>(count));
+            }
+            static auto decode(const uint8_t* data) -> std::vector<T> { return view(data).toVector(); }
+        };
+
+        template<HasSchema T>
+        struct SchemaTraits {
+            using Fields = typename Schema<T>::Fields;
+            static constexpr uint16_t version = Schema<T>::version;
+            static constexpr size_t count = std::tuple_size_v<Fields>;
+
+            template<size_t I>
+            using FieldAt = std::tuple_element_t<I, Fields>;
+            template<size_t I>
+            using CodecAt = FieldCodec<typename FieldAt<I>::Value>;
+
+            static constexpr bool fixed = []<size_t... I>(std::index_sequence<I...>) {
+                return (CodecAt<I>::fixed && ...);
+            }(std::make_index_sequence<count>{});
+
+            static constexpr auto since = []<size_t... I>(std::index_sequence<I...>) {
+                return std::array<uint16_t, count>{FieldAt<I>::since...};
+            }(std::make_index_sequence<count>{});
+
+            // Offset of each fixed field from the start of the fields, plus the total at the end.
+            static constexpr auto offsets = []<size_t... I>(std::index_sequence<I...>) {
+                std::array<size_t, count + 1> result{};
+                size_t sizes[] = {CodecAt<I>::wireSize..., 0};
+                for (size_t i = 0; i < count; ++i) {
+                    result[i + 1] = result[i] + sizes[i];
+                }
+                return result;
+            }(std::make_index_sequence<count>{});
+
+            static_assert(count > 0, "Schema needs at least one field");
+            static_assert(std::is_default_constructible_v<T>, "Schema types must be default constructible");
+            static_assert([] {
+                for (size_t i = 0; i < count; ++i) {
+                    if (since[i] == 0 || since[i] > version || (i > 0 && since[i] < since[i - 1])) {
+                        return false;
+                    }
+                }
+                return true;
+            }(), "Field versions must be between 1 and the schema version, in non-decreasing order");
+
+            // Fields carried by a packet of the given version.
+            static constexpr auto presentFields(uint16_t packetVersion) -> size_t {
+                size_t present = 0;
+                while (present < count && since[present] <= packetVersion) {
+                    ++present;
+                }
+                return present;
+            }
+
+            template<size_t I, auto Member>
+            static constexpr auto matches() -> bool {
+                if constexpr (std::is_same_v<std::remove_cv_t<decltype(FieldAt<I>::member)>, decltype(Member)>) {
+                    return FieldAt<I>::member == Member;
+                } else {
+                    return false;
+                }
+            }
+
+            template<auto Member>
+            static constexpr auto indexOf() -> size_t {
+                return []<size_t... I>(std::index_sequence<I...>) {
+                    size_t index = count;
+                    ((matches<I, Member>() ? (index = I, true) : false) || ...);
+                    return index;
+                }(std::make_index_sequence<count>{});
+            }
+        };
+
+        template<typename T, auto Member>
+        using FieldView = typename SchemaTraits<T>::template CodecAt<SchemaTraits<T>::template indexOf<Member>()>::View;
+    }
+
+    // Zero-copy reader for a schema-encoded T. The constructor validates the layout once
+    // (a single size compare when every field is fixed-size); get<&T::field>() afterwards
+    // reads straight from the buffer without further checks. Strings come back as
+    // string_views and vectors as WireArrays into the same buffer, so the packet must
+    // outlive the view. Fields newer than the packet's version read as value-initialized.
+    template<HasSchema T>
+    class PacketView {
+    public:
+        explicit PacketView(const Packet& pkt) : PacketView(pkt.data()) {}
+        explicit PacketView(Span<const uint8_t> packetData);
+
+        auto valid() const -> bool { return data_ != nullptr; }
+        explicit operator bool() const { return valid(); }
+
+        auto version() const -> uint16_t { return version_; }
+        // Bytes covered by the version header and the fields this schema knows.
+        auto size() const -> size_t { return size_; }
+
+        template<auto Member>
+        auto get() const -> detail::FieldView<T, Member>;
+
+        // Copies every field into a T; fields the packet lacks keep T's defaults.
+        auto decode() const -> T;
+
+    private:
+        using Traits = detail::SchemaTraits<T>;
+        static constexpr size_t headerSize = sizeof(uint16_t);
+
+        template<size_t I>
+        auto measure(Span<const uint8_t> packetData, size_t& cursor) -> bool;
+        template<size_t I>
+        auto fieldData() const -> const uint8_t*;
+
+        const uint8_t* data_ = nullptr;
+        uint16_t version_ = 0;
+        size_t present_ = 0;
+        size_t size_ = 0;
+        std::array<size_t, Traits::fixed ? 0 : Traits::count> offsets_{};
+    };
+
+    struct PeerHandle {
+        static constexpr PeerIdT invalidSlot = 0xFFFF;
+
+        PeerIdT slot = invalidSlot;
+        uint32_t generation = 0;
+
+        auto valid() const -> bool { return slot != invalidSlot; }
+        auto operator==(const PeerHandle& other) const -> bool = default;
+    };
+
+    struct StreamOptions {
+        uint32_t tag = 0;                       // passed to the receiver with every chunk
+        size_t chunkSize = 16 * 1024;           // payload bytes per reliable packet
+        size_t window = 256 * 1024;             // unacknowledged bytes before the stream pauses
+        std::function<void(bool)> onComplete;   // servicing thread; true once all was acknowledged
+    };
+
+    // One piece of an incoming stream, in order. data points into the received packet
+    // and is only valid during the handler call.
+    struct StreamChunk {
+        PeerHandle peer{};
+        uint32_t streamId = 0;
+        uint32_t tag = 0;
+        uint64_t offset = 0;
+        uint64_t totalSize = 0;
+        Span<const uint8_t> data{nullptr, 0};
+
+        auto last() const -> bool { return offset + data.size() == totalSize; }
+    };
+
+    using StreamHandler = std::function<void(const StreamChunk&)>;
+
     class Host;
+    class PeerRegistry;
+    struct PeerMetrics;
+
+    namespace detail {
+        struct PeerAwaitState;
+        class Strand;
+        class Coalescer;
+    }
+
+    namespace async {
+        class ConnectAwaiter;
+        class ReceiveAwaiter;
+    }
+
     class Peer {
     public:
         Peer(ENetPeer* nativePeer, std::shared_ptr<Host> hostPtr);
@@ -228,10 +890,37 @@ namespace icelander {
         template<typename T>
         auto send(const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> bool;
 
+        // On a latest-value-wins channel, replaces this peer's unsent unreliable packet with
+        // the same key (e.g. an entity id). Plain send() uses key 0; elsewhere it is send().
+        auto sendLatest(ChannelIdT channel, uint32_t key, std::unique_ptr<Packet> pkt) -> bool;
+
+        // Opt-in coalescing for small messages. Messages queued with the same channel and
+        // flags are packed into one packet (read back with SubMessages) that goes out on
+        // flushQueued(), or as soon as it reaches HostConfig::coalesceLimit. Ordering is
+        // only kept among queued messages, not against send(). Use from one thread.
+        auto queueMessage(ChannelIdT channel, const void* message, size_t size, PacketFlagsT flags = DEFAULT_FLAGS) -> bool;
+
+        template<Serializable T>
+        auto queueMessage(ChannelIdT channel, const T& message, PacketFlagsT flags = DEFAULT_FLAGS) -> bool;
+
+        auto flushQueued() -> size_t;
+        auto queuedMessages() const -> size_t;
+
+        // Sends a large payload as reliable chunks on one channel, keeping at most
+        // options.window bytes unacknowledged, so memory stays bounded by the window. The
+        // span must stay valid until onComplete runs; sendFile maps the file instead of
+        // reading it. Returns the id the receiver's chunks carry, or 0 without a host or
+        // when the connection is known to be gone.
+        auto sendStream(ChannelIdT channel, Span<const uint8_t> data, StreamOptions options = {}) -> uint32_t;
+        auto sendFile(ChannelIdT channel, const std::string& path, StreamOptions options = {}) -> uint32_t;
+
         auto disconnect(uint32_t disconnectData = 0) -> void;
         auto disconnectNow(uint32_t disconnectData = 0) -> void;
         auto disconnectLater(uint32_t disconnectData = 0) -> void;
 
+        // Awaitable; once used, packets on that channel go to receive() instead of the dispatcher.
+        auto receive(ChannelIdT channel = 0) -> async::ReceiveAwaiter;
+
         auto ping() -> void;
         auto timeout(TimeoutMs timeoutLimit, TimeoutMs timeoutMinimum, TimeoutMs timeoutMaximum) -> void;
         auto reset() -> void;
@@ -239,6 +928,7 @@ namespace icelander {
         auto state() const -> PeerState;
         auto endpoint() const -> icelander::Endpoint;
         auto roundTripTime() const -> std::chrono::milliseconds;
+        auto metrics() const -> PeerMetrics;
 
         auto isConnected() const -> bool;
         auto isConnecting() const -> bool;
@@ -247,13 +937,63 @@ namespace icelander {
 
         auto nativeHandle() const -> ENetPeer*;
         auto hostHandle() const -> std::shared_ptr<Host>;
+        auto handle() const -> PeerHandle;
 
         static auto fromNative(ENetPeer* nativePeer, std::shared_ptr<Host> hostPtr) -> std::shared_ptr<Peer>;
 
     private:
+        friend class PeerRegistry;
+        friend class Host;
+
+        // Readies a recycled wrapper for a new connection; only safe while nothing else holds it.
+        auto rebind(ENetPeer* nativePeer, std::shared_ptr<Host> hostPtr) -> void;
+
         ENetPeer* nativePeer_;
         std::weak_ptr<Host> host_;
         void* userData_;
+        PeerHandle handle_;
+        uint32_t connectId_;
+        std::shared_ptr<detail::PeerAwaitState> awaitState_;
+        std::shared_ptr<detail::Strand> strand_;    // created by the host in parallel dispatch
+        std::unique_ptr<detail::Coalescer> coalescer_;  // created by the first queueMessage()
+    };
+
+    // Peers indexed by their ENet slot (ENetPeer::incomingPeerID), so lookups from
+    // native events are O(1) and allocation-free. Not synchronized; Host guards it.
+    class PeerRegistry {
+    public:
+        explicit PeerRegistry(size_t capacity = 0);
+
+        auto insert(std::shared_ptr<Peer> peer) -> PeerHandle;
+        auto remove(ENetPeer* nativePeer) -> std::shared_ptr<Peer>;
+
+        auto find(ENetPeer* nativePeer) const -> std::shared_ptr<Peer>;
+        auto find(PeerHandle handle) const -> std::shared_ptr<Peer>;
+        auto find(const Endpoint& remoteEndpoint) const -> std::shared_ptr<Peer>;
+        auto findConnection(ENetPeer* nativePeer) const -> std::shared_ptr<Peer>;
+        // Non-owning lookups for hot loops; valid while the registry lock is held.
+        auto get(PeerHandle handle) const -> Peer*;
+        auto get(ENetPeer* nativePeer) const -> Peer*;
+
+        auto size() const -> size_t;
+        auto capacity() const -> size_t;
+        auto snapshot() const -> std::vector<std::shared_ptr<Peer>>;
+        void clear();
+
+    private:
+        struct Slot {
+            std::shared_ptr<Peer> peer;
+            Endpoint remoteEndpoint;
+            uint32_t connectId = 0;
+            uint32_t generation = 0;
+        };
+
+        auto slotFor(ENetPeer* nativePeer) const -> const Slot*;
+        void unindex(size_t index);
+
+        std::vector<Slot> slots_;
+        std::unordered_map<Endpoint, PeerIdT, EndpointHash> endpointIndex_;
+        size_t activeCount_ = 0;
     };
 
     struct ConnectEvent {
@@ -274,12 +1014,44 @@ namespace icelander {
         ChannelIdT channel;
     };
 
+    // Owning, undispatched event as returned by Host::serviceBatch.
+    struct Event {
+        EventType type = EventType::none;
+        std::shared_ptr<Peer> peerHandle;
+        std::unique_ptr<Packet> packetData;
+        Endpoint remoteEndpoint{};
+        ChannelIdT channel = 0;
+        uint32_t data = 0;
+    };
+
+    // One event as Host::serviceEvents delivers it: no Peer reference and no Packet
+    // wrapper, so receiving allocates nothing. Resolve the peer with Host::findPeer.
+    struct EventRef {
+        EventType type = EventType::none;
+        PeerHandle peer{};
+        PacketRef packet{};
+        Endpoint remoteEndpoint{};
+        ChannelIdT channel = 0;
+        uint32_t data = 0;
+    };
+
+    static_assert(std::is_trivially_copyable_v<EventRef>);
+
     using ConnectHandler = std::function<void(const ConnectEvent&)>;
     using DisconnectHandler = std::function<void(const DisconnectEvent&)>;
     using ReceiveHandler = std::function<void(const ReceiveEvent&)>;
 
+    // Handlers live in an immutable table that each registration replaces (copy-on-write),
+    // so handlers can be added while another thread dispatches. Replaced tables are kept
+    // until the dispatcher is destroyed, which keeps dispatch to a single atomic load.
     class EventDispatcher {
     public:
+        EventDispatcher();
+        ~EventDispatcher();
+
+        EventDispatcher(const EventDispatcher&) = delete;
+        EventDispatcher& operator=(const EventDispatcher&) = delete;
+
         void onConnect(ConnectHandler handler);
         void onDisconnect(DisconnectHandler handler);
         void onReceive(ReceiveHandler handler);
@@ -291,127 +1063,1221 @@ namespace icelander {
         void dispatchReceive(const ReceiveEvent& event);
 
     private:
-        std::vector<ConnectHandler> connectHandlers_;
-        std::vector<DisconnectHandler> disconnectHandlers_;
-        std::vector<ReceiveHandler> receiveHandlers_;
-        std::unordered_map<ChannelIdT, std::vector<ReceiveHandler>> channelHandlers_;
+        struct HandlerTable {
+            std::vector<ConnectHandler> connect;
+            std::vector<DisconnectHandler> disconnect;
+            std::vector<ReceiveHandler> receive;
+            std::array<std::vector<ReceiveHandler>, MAX_CHANNELS> channels;
+        };
+
+        template<typename Change>
+        void update(Change&& change);
+
+        std::atomic<const HandlerTable*> table_;
+        std::vector<std::unique_ptr<HandlerTable>> tables_;
+        std::mutex updateMutex_;
     };
 
-    struct HostConfig {
-        size_t maxPeers = 32;
-        size_t maxChannels = 1;
-        uint32_t incomingBandwidth = 0;
-        uint32_t outgoingBandwidth = 0;
-        bool enableCompression = false;
-        TimeoutMs serviceTimeout = TimeoutMs{10};
+    // Receive handler that only sees one channel; for StaticDispatcher.
+    template<ChannelIdT Channel, typename Handler>
+    struct OnChannel {
+        Handler handler;
+
+        void operator()(const ReceiveEvent& event) {
+            if (event.channel == Channel) {
+                handler(event);
+            }
+        }
     };
 
-    class Host : public std::enable_shared_from_this<Host> {
+    template<ChannelIdT Channel, typename Handler>
+    auto onChannel(Handler handler) -> OnChannel<Channel, std::decay_t<Handler>> {
+        return {std::move(handler)};
+    }
+
+    // Dispatcher whose handler set is fixed at compile time. Each event goes to every
+    // handler invocable with it, as direct (inlinable) calls. Use with Host::serviceWith.
+    template<typename... Handlers>
+    class StaticDispatcher {
     public:
-        static auto createServer(const Endpoint& bindEndpoint, const HostConfig& config = {}) -> std::shared_ptr<Host>;
-        static auto createClient(const HostConfig& config = {}) -> std::shared_ptr<Host>;
+        explicit StaticDispatcher(Handlers... handlers) : handlers_(std::move(handlers)...) {}
 
-        ~Host();
+        void dispatchConnect(const ConnectEvent& event) { dispatch(event); }
+        void dispatchDisconnect(const DisconnectEvent& event) { dispatch(event); }
+        void dispatchReceive(const ReceiveEvent& event) { dispatch(event); }
 
-        Host(const Host&) = delete;
-        Host& operator=(const Host&) = delete;
+    private:
+        template<typename E>
+        void dispatch(const E& event) {
+            std::apply([&event](auto&... handler) { (invokeIfAccepted(handler, event), ...); }, handlers_);
+        }
 
-        auto connect(const Endpoint& remoteEndpoint, size_t channels = 1, uint32_t connectData = 0) -> std::shared_ptr<Peer>;
-        auto service(TimeoutMs timeout = DEFAULT_TIMEOUT) -> int;
-        auto flush() -> void;
+        template<typename Handler, typename E>
+        static void invokeIfAccepted(Handler& handler, const E& event) {
+            if constexpr (std::is_invocable_v<Handler&, const E&>) {
+                handler(event);
+            }
+        }
 
-        auto broadcast(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void;
-        auto broadcast(std::unique_ptr<Packet> pkt) -> void;
+        std::tuple<Handlers...> handlers_;
+    };
 
-        template<typename T>
-        auto broadcast(ChannelIdT channel, const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> void;
+    template<typename D>
+    concept EventSink = requires(D& dispatcher, ConnectEvent&& connect, DisconnectEvent&& disconnect,
+                                 ReceiveEvent&& receive) {
+        dispatcher.dispatchConnect(std::move(connect));
+        dispatcher.dispatchDisconnect(std::move(disconnect));
+        dispatcher.dispatchReceive(std::move(receive));
+    };
 
-        template<typename T>
-        auto broadcast(const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> void;
+    struct CompressorConfig {
+        CompressionAlgorithm algorithm = CompressionAlgorithm::none;
+        int level = 0;                      // zstd level or LZ4 acceleration; 0 = library default
+        size_t minimumSize = 64;            // datagrams smaller than this are sent as-is
+        double maximumRatio = 0.9;          // send as-is unless it shrinks to at most this fraction
+        size_t backoffDatagrams = 64;       // after 8 poor results in a row, skip this many; 0 = never
+        std::vector<uint8_t> dictionary;    // pre-trained dictionary (lz4/zstd); both ends must match
+    };
 
-        auto startServiceThread() -> void;
-        auto stopServiceThread() -> void;
-        auto isServiceThreadRunning() const -> bool;
+    struct CompressionStats {
+        uint64_t datagramsCompressed = 0;
+        uint64_t datagramsSkipped = 0;      // too small, compressed poorly, or backing off
+        uint64_t bytesIn = 0;               // over compressed datagrams only
+        uint64_t bytesOut = 0;
+        uint64_t datagramsDecompressed = 0;
+        uint64_t decompressFailures = 0;
+        std::chrono::nanoseconds compressTime{0};
+        std::chrono::nanoseconds decompressTime{0};
+
+        auto ratio() const -> double {
+            return bytesIn ? static_cast<double>(bytesOut) / static_cast<double>(bytesIn) : 1.0;
+        }
+    };
 
-        auto peerCount() const -> size_t;
-        auto isServer() const -> bool;
-        auto isClient() const -> bool;
+    // Screening of connection attempts on a server, applied before ENet commits a peer slot.
+    struct AcceptConfig {
+        bool validateHandshake = true;          // drop CONNECT datagrams no ENet client sends
+        double connectsPerSecond = 0;           // host-wide accept rate; 0 = unlimited
+        double connectBurst = 64;
+        double connectsPerSecondPerAddress = 0; // per source IP; 0 = unlimited
+        double connectBurstPerAddress = 4;
+        size_t addressSlots = 4096;             // hashed per-address buckets; collisions evict
+    };
 
-        auto getPeers() -> std::vector<std::shared_ptr<Peer>>;
+    struct AcceptStats {
+        uint64_t accepted = 0;      // CONNECT datagrams handed on to ENet
+        uint64_t rateLimited = 0;
+        uint64_t malformed = 0;
+    };
+
+    struct ChannelMetrics {
+        uint64_t packetsIn = 0;
+        uint64_t bytesIn = 0;
+        uint64_t packetsOut = 0;
+        uint64_t bytesOut = 0;
+    };
+
+    // Log2 buckets over microseconds: bucket 0 counts samples under 1 us, bucket i those in
+    // [2^(i-1), 2^i) us, and the last bucket everything longer.
+    struct LatencyHistogram {
+        static constexpr size_t bucketCount = 24;
+
+        std::array<uint64_t, bucketCount> buckets{};
+        uint64_t count = 0;
+        std::chrono::nanoseconds total{0};
+
+        static auto upperBound(size_t bucket) -> std::chrono::microseconds {
+            return bucket + 1 < bucketCount ? std::chrono::microseconds(int64_t{1} << bucket)
+                                             : std::chrono::microseconds::max();
+        }
+
+        auto mean() const -> std::chrono::nanoseconds {
+            return count ? total / static_cast<int64_t>(count) : std::chrono::nanoseconds{0};
+        }
+
+        void record(std::chrono::nanoseconds elapsed) {
+            auto micros = static_cast<uint64_t>(std::max<int64_t>(elapsed.count(), 0)) / 1000;
+            ++buckets[std::min<size_t>(std::bit_width(micros), bucketCount - 1)];
+            ++count;
+            total += elapsed;
+        }
+
+        // Upper bound of the bucket holding quantile q (0-1).
+        auto quantile(double q) const -> std::chrono::microseconds {
+            auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < bucketCount; ++i) {
+                seen += buckets[i];
+                if (seen > rank || seen == count) {
+                    return upperBound(i);
+                }
+            }
+            return upperBound(bucketCount - 1);
+        }
+    };
+
+    struct PeerMetrics {
+        PeerHandle handle;
+        Endpoint endpoint;
+        std::vector<ChannelMetrics> channels;   // since this connection was established
+
+        // Sampled from ENet every HostConfig::metricsInterval by the servicing thread.
+        std::chrono::milliseconds roundTripTime{0};
+        std::chrono::milliseconds roundTripTimeVariance{0};
+        double packetLoss = 0.0;                // fraction of reliable packets lost recently
+        uint32_t packetThrottle = 0;            // out of ENET_PEER_PACKET_THROTTLE_SCALE
+        uint32_t reliableDataInTransit = 0;     // bytes sent reliably and not yet acknowledged
+        size_t queuedCommands = 0;              // outgoing ENet commands not yet sent
+    };
+
+    struct HostMetrics {
+        std::vector<ChannelMetrics> channels;   // all peers since the host was created
+        std::vector<PeerMetrics> peers;
+
+        uint64_t serviceIterations = 0;
+        LatencyHistogram serviceTime;           // one service call, including any socket wait
+        LatencyHistogram dispatchTime;          // running the handlers for one event
+        LatencyHistogram handlerLatency;        // from the service call that produced an event to its handler
+        size_t pendingCommands = 0;             // cross-thread operations queued for the service thread
+
+        // Prometheus text exposition format.
+        auto toPrometheus(std::string_view prefix = "icelander") const -> std::string;
+    };
+
+    // Outgoing scheduling for one channel; see HostConfig::channels.
+    struct ChannelConfig {
+        int priority = 0;               // higher channels reach ENet first in each pass
+        size_t bytesPerFlush = 0;       // per peer and service/flush pass; 0 = unlimited
+        bool latestValueWins = false;   // an unsent unreliable packet with the same key is replaced
+    };
+
+    struct HostConfig {
+        size_t maxPeers = 32;
+        size_t maxChannels = 1;
+        uint32_t incomingBandwidth = 0;
+        uint32_t outgoingBandwidth = 0;
+        bool enableCompression = false;             // legacy switch for ENet's range coder
+        CompressorConfig compressor{};              // takes precedence over enableCompression
+        AcceptConfig accept{};                      // servers only
+        bool preallocatePeers = true;               // servers build every Peer wrapper up front
+        TimeoutMs serviceTimeout = TimeoutMs{10};   // longest the service thread sleeps between passes
+        std::chrono::microseconds spinBudget{0};    // busy-poll this long after activity before sleeping
+        size_t maxEventsPerService = 0;             // events drained per serviceAll(); 0 = all pending
+        bool reusePort = false;                     // bind with SO_REUSEPORT so hosts can share a port
+        int serviceThreadCpu = -1;                  // pin the service thread to this CPU; -1 = unpinned
+        size_t coalesceLimit = 1200;                // size cap of a Peer::queueMessage() batch, below the MTU
+        bool parallelDispatch = false;              // run handlers on TaskScheduler workers, in order per peer
+        SocketBackend socketBackend = SocketBackend::standard;
+        size_t socketBatchSize = 32;                // datagrams per recvmmsg/sendmmsg with the batched backend
+        bool udpOffload = true;                     // let the batched backend use GSO/GRO when the kernel has them
+        std::chrono::milliseconds metricsInterval{100}; // how often ENet's per-peer stats are sampled
+        // Indexed by channel id. Listed channels are held until the next service or flush
+        // pass and scheduled there; the rest, and all stream chunks, go straight to ENet.
+        std::vector<ChannelConfig> channels{};
+    };
+
+    constexpr PeerIdT CAPTURE_ALL_PEERS = 0xFFFF;
+
+    // Record kinds in a capture file. Sends are logged as the application submitted them,
+    // before channel scheduling; a broadcast or group send is one record.
+    enum class CaptureType : uint8_t {
+        padding = 0,    // ring filler, never written to the file
+        connect = 1,
+        disconnect = 2,
+        receive = 3,
+        send = 4,
+        broadcast = 5,
+        groupSend = 6
+    };
+
+    // Little-endian record header, followed by size payload bytes and zero padding to a
+    // multiple of 8. A file is CAPTURE_MAGIC, a u32 version and u32 reserved, then records.
+    struct CaptureRecord {
+        uint32_t length = 0;        // header, payload and padding
+        CaptureType type = CaptureType::padding;
+        ChannelIdT channel = 0;
+        PeerIdT peer = 0;           // ENet peer slot; CAPTURE_ALL_PEERS for broadcasts and group sends
+        int64_t time = 0;           // nanoseconds since the capture started
+        uint32_t data = 0;          // connect/disconnect data; member count for group sends
+        PacketFlagsT flags = 0;
+        uint32_t size = 0;          // payload bytes stored
+        uint32_t packetSize = 0;    // payload bytes on the wire
+    };
+    static_assert(sizeof(CaptureRecord) == 32);
+
+    constexpr std::string_view CAPTURE_MAGIC{"ICECAP\0\0", 8};
+    constexpr uint32_t CAPTURE_VERSION = 1;
+    constexpr size_t CAPTURE_FILE_HEADER_SIZE = 16;
+
+    struct CaptureConfig {
+        size_t ringSize = 8 * 1024 * 1024;          // staging between the servicing thread and the writer
+        size_t maxFileSize = size_t{1} << 30;       // mapped up front; records past it are dropped
+        bool recordSends = true;
+        bool recordPayloads = true;                 // false keeps only headers and packet sizes
+        std::chrono::milliseconds flushInterval{5}; // how often the writer drains the ring
+    };
+
+    struct CaptureStats {
+        uint64_t records = 0;       // written to the file
+        uint64_t bytes = 0;         // file size, header included
+        uint64_t dropped = 0;       // ring or file full
+    };
+
+    namespace detail {
+        class CommandQueue;
+        class Wakeup;
+        class StreamTable;
+        struct OutgoingStream;
+        class ChannelScheduler;
+        struct Command;
+        class Compressor;
+        class HostMetricsStorage;
+        class BatchedSocket;
+        class AcceptGuard;
+        class Recorder;
+        class MappedFile;
+
+        inline auto metricsNow() -> Timestamp {
+            if constexpr (METRICS_ENABLED) {
+                return std::chrono::steady_clock::now();
+            } else {
+                return {};
+            }
+        }
+    }
+
+    struct TickConfig {
+        double rate = 60.0;                         // ticks per second
+        std::chrono::microseconds spin{1000};       // busy-wait this close to each deadline instead of sleeping
+    };
+
+    // Per-tick timings gathered by Host::runTickLoop.
+    struct TickStats {
+        uint64_t ticks = 0;
+        uint64_t overruns = 0;                      // ticks whose update and flush ran past the next deadline
+        uint64_t skippedTicks = 0;                  // deadlines dropped to catch up after an overrun
+        LatencyHistogram networkTime;               // servicing the hosts, without the time spent sleeping
+        LatencyHistogram updateTime;
+        LatencyHistogram flushTime;
+        LatencyHistogram lateness;                  // how far past its deadline each update started
+    };
+
+    struct TickInfo {
+        uint64_t tick = 0;
+        std::chrono::nanoseconds step{0};           // fixed 1 / rate
+        Timestamp deadline{};
+        const TickStats* stats = nullptr;           // so far, excluding this tick
+    };
+
+    // Return false to leave the loop after this tick.
+    using TickFunction = std::function<bool(const TickInfo&)>;
+
+    // Once the service thread runs, calls from other threads that touch the ENet host
+    // (sends, broadcasts, disconnects, connect) are queued and executed by the service
+    // thread before each service/flush. Calls made on the service thread run directly.
+    class Host : public std::enable_shared_from_this<Host> {
+    public:
+        static auto createServer(const Endpoint& bindEndpoint, const HostConfig& config = {}) -> std::shared_ptr<Host>;
+        static auto createClient(const HostConfig& config = {}) -> std::shared_ptr<Host>;
+
+        ~Host();
+
+        Host(const Host&) = delete;
+        Host& operator=(const Host&) = delete;
+
+        auto connect(const Endpoint& remoteEndpoint, size_t channels = 1, uint32_t connectData = 0) -> std::shared_ptr<Peer>;
+        auto connectAsync(const Endpoint& remoteEndpoint, size_t channels = 1, uint32_t connectData = 0) -> async::ConnectAwaiter;
+        // Resolves through Resolver first; the host is only touched once the address is known.
+        auto connectAsync(const std::string& hostName, uint16_t port, size_t channels = 1, uint32_t connectData = 0) -> async::ConnectAwaiter;
+        auto service(TimeoutMs timeout = DEFAULT_TIMEOUT) -> int;
+        auto serviceAll(TimeoutMs timeout = DEFAULT_TIMEOUT) -> int;
+        auto serviceBatch(std::span<Event> events, TimeoutMs timeout = TimeoutMs{0}) -> int;
+        // serviceAll() delivering to a caller-supplied dispatcher, e.g. a StaticDispatcher.
+        template<EventSink Dispatcher>
+        auto serviceWith(Dispatcher& dispatcher, TimeoutMs timeout = DEFAULT_TIMEOUT) -> int;
+        // serviceAll() calling handler(const EventRef&) on this thread, bypassing the
+        // dispatcher. Allocation-free per receive unless a coroutine awaits that channel.
+        template<typename Handler>
+            requires std::invocable<Handler&, const EventRef&>
+        auto serviceEvents(Handler&& handler, TimeoutMs timeout = DEFAULT_TIMEOUT) -> int;
+        auto flush() -> void;
+        // Sends every peer's coalesced messages; call once per tick. Returns packets sent.
+        auto flushQueued() -> size_t;
+
+        auto broadcast(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void;
+        auto broadcast(std::unique_ptr<Packet> pkt) -> void;
+
+        template<typename T>
+        auto broadcast(ChannelIdT channel, const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> void;
+
+        template<typename T>
+        auto broadcast(const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> void;
+
+        // Peer::sendLatest for every connected peer.
+        auto broadcastLatest(ChannelIdT channel, uint32_t key, std::unique_ptr<Packet> pkt) -> void;
+
+        // Packets on this channel are read as Peer::sendStream chunks and handed to the
+        // handler on the servicing thread, never to the dispatcher. An empty handler undoes it.
+        auto onStream(ChannelIdT channel, StreamHandler handler) -> void;
+        auto activeStreams() const -> size_t;   // outgoing streams not yet completed
+
+        // Runs the calling thread as this host's servicing thread at a fixed rate: services
+        // the network until each deadline (sleeping on the socket, then spinning for the
+        // last TickConfig::spin), runs update, then flushes once. After an overrun, missed
+        // deadlines are skipped rather than run back to back. The service thread must be stopped.
+        auto runTickLoop(double rate, TickFunction update) -> TickStats;
+        auto runTickLoop(const TickConfig& config, TickFunction update) -> TickStats;
+        // One loop servicing several hosts; sleeps in slices of at most 1 ms between polls.
+        static auto runTickLoop(std::span<const std::shared_ptr<Host>> hosts, const TickConfig& config, TickFunction update) -> TickStats;
+
+        auto startServiceThread() -> void;
+        auto stopServiceThread() -> void;
+        auto isServiceThreadRunning() const -> bool;
+        auto pendingCommands() const -> size_t;
+        auto compressionStats() const -> CompressionStats;
+        auto socketBackend() const -> SocketBackend;    // the backend in use after any fallback
+        auto acceptStats() const -> AcceptStats;
+        auto metrics() const -> HostMetrics;
+
+        // Appends every event and, unless disabled, every send to a memory-mapped log at
+        // path, replacing any capture in progress. The servicing thread only copies into
+        // a preallocated ring; a background thread moves records into the mapping. Throws
+        // std::runtime_error if the file cannot be created.
+        auto startCapture(const std::string& path, const CaptureConfig& config = {}) -> void;
+        // Waits for the writer, trims the file to its records and returns the totals.
+        auto stopCapture() -> CaptureStats;
+
+        auto peerCount() const -> size_t;
+        auto isServer() const -> bool;
+        auto isClient() const -> bool;
+
+        auto getPeers() -> std::vector<std::shared_ptr<Peer>>;
         auto findPeer(const Endpoint& remoteEndpoint) -> std::shared_ptr<Peer>;
+        auto findPeer(PeerHandle handle) -> std::shared_ptr<Peer>;
 
         auto getDispatcher() -> EventDispatcher&;
         auto nativeHandle() const -> ENetHost*;
 
     protected:
-        explicit Host(ENetHost* nativeHost, bool isServer);
+        explicit Host(ENetHost* nativeHost, bool isServer, const HostConfig& config = {});
 
     private:
+        friend class Peer;
+        friend class async::ConnectAwaiter;
+        friend class PeerGroup;
+        friend class InterestGrid;
+        friend class detail::StreamTable;
+        friend class detail::ChannelScheduler;
+
+        enum class DisconnectMode { graceful, now, later };
+
         void serviceThreadLoop();
+        // Services every host until the deadline; returns the time spent in service calls.
+        static auto serviceUntil(std::span<const std::shared_ptr<Host>> hosts, Timestamp deadline, std::chrono::microseconds spin) -> std::chrono::nanoseconds;
+        auto directAccess() const -> bool;
+        auto sendTo(ENetPeer* nativePeer, uint32_t connectId, ChannelIdT channel, ENetPacket* nativePacket, uint32_t key = 0) -> bool;
+        auto broadcastNow(ChannelIdT channel, uint32_t key, ENetPacket* nativePacket) -> void;
+        auto disconnectPeer(ENetPeer* nativePeer, uint32_t connectId, uint32_t disconnectData, DisconnectMode mode) -> void;
+        auto sendToGroup(std::shared_ptr<const std::vector<PeerHandle>> members, ChannelIdT channel, ENetPacket* nativePacket) -> void;
+        auto sendGroupNow(const std::vector<PeerHandle>& members, ChannelIdT channel, ENetPacket* nativePacket) -> void;
+        auto connectNow(const AddressT& address, size_t channels, uint32_t connectData) -> std::shared_ptr<Peer>;
+        auto connectAwaiting(async::ConnectAwaiter& awaiter) -> void;
+        auto startStream(ENetPeer* nativePeer, uint32_t connectId, ChannelIdT channel, std::unique_ptr<detail::OutgoingStream> stream) -> uint32_t;
+        auto submit(detail::Command* command) -> void;
+        auto drainCommands() -> size_t;
+        auto execute(detail::Command& command) -> void;
         auto processEvent(const ENetEvent& event) -> void;
+        // The service sequence shared by every service call: commands, outgoing queues, one
+        // socket wait, then events ENet already queued until sink(event) has returned true
+        // limit times (0 for no limit). Returns that count, or ENet's result if no event.
+        template<typename Sink>
+        auto serviceLoop(TimeoutMs timeout, size_t limit, Sink&& sink) -> int;
+        template<EventSink Dispatcher>
+        auto routeEvent(const ENetEvent& event, Dispatcher& dispatcher) -> void;
+        template<typename Handler>
+        auto deliverEvent(const ENetEvent& event, Handler& handler) -> void;
+        // deliverEvent halves: prepare returns false if the handler should not see the
+        // event (any packet is then consumed), finish runs after the handler.
+        auto prepareEvent(const ENetEvent& event, EventRef& ref) -> bool;
+        auto finishEvent(const ENetEvent& event, const EventRef& ref) -> void;
+        auto notifyConnected(const std::shared_ptr<Peer>& peer) -> void;
+        auto retirePeer(ENetPeer* nativePeer, const std::shared_ptr<Peer>& peer) -> void;
+        auto captureReceive(Peer& peer, ChannelIdT channel, std::unique_ptr<Packet>& pkt) -> bool;
+        auto sendNative(ENetPeer* nativePeer, ChannelIdT channel, ENetPacket* nativePacket) -> bool;
+        // sendNative, unless the channel is scheduled.
+        auto sendOrSchedule(ENetPeer* nativePeer, ChannelIdT channel, uint32_t key, ENetPacket* nativePacket) -> bool;
+        // Scheduled packets, then stream chunks; runs before ENet sends.
+        auto pumpOutgoing() -> void;
+        // Sends datagrams the batched backend queued during the last ENet call.
+        auto flushSocket() -> void;
+        // Installs recorder, which may be null, on the servicing thread; returns the old one.
+        auto swapRecorder(std::unique_ptr<detail::Recorder> recorder) -> std::unique_ptr<detail::Recorder>;
+        // Capture hooks; callers guard them with if (recorder_).
+        auto recordEvent(const ENetEvent& event) -> void;
+        auto recordSend(CaptureType type, PeerIdT peer, ChannelIdT channel, uint32_t data, const ENetPacket& nativePacket) -> void;
+
+        // Metric hooks; callers guard them with if constexpr (METRICS_ENABLED).
+        auto recordReceive(const ENetPeer& nativePeer, ChannelIdT channel, size_t bytes) -> void;
+        auto recordService(Timestamp started) -> void;
+        auto recordDispatch(Timestamp received, Timestamp started) -> void;
+        auto peerMetrics(const Peer& peer) const -> PeerMetrics;
+        auto fillPeerMetrics(const Peer& peer, PeerMetrics& out) const -> void;
+
+        struct ParallelSink;
+        auto strandOf(Peer& peer) -> detail::Strand&;
+        auto makeEvent(const ENetEvent& nativeEvent) -> Event;
+        auto acceptPeer(ENetPeer* nativePeer) -> std::shared_ptr<Peer>;
+        // Spare wrappers per ENet slot, reused once the application has let go of them.
+        auto takePeer(ENetPeer* nativePeer) -> std::shared_ptr<Peer>;
+        auto recyclePeer(std::shared_ptr<Peer> peer) -> void;
         auto findPeerByNative(ENetPeer* nativePeer) -> std::shared_ptr<Peer>;
 
         ENetHost* nativeHost_;
         bool isServer_;
+        HostConfig config_;
         std::unique_ptr<EventDispatcher> dispatcher_;
-        std::vector<std::weak_ptr<Peer>> peers_;
+        PeerRegistry peers_;
 
+        std::unique_ptr<detail::CommandQueue> commands_;
+        std::unique_ptr<detail::Wakeup> wakeup_;
         std::atomic<bool> serviceThreadRunning_;
+        std::atomic<std::thread::id> serviceThreadId_;
         std::unique_ptr<std::thread> serviceThread_;
 
         mutable std::mutex peersMutex_;
+        detail::Compressor* compressor_;    // owned by the ENet host
+        std::unique_ptr<detail::BatchedSocket> socket_;
+        std::unique_ptr<detail::AcceptGuard> acceptGuard_;
+        std::vector<std::shared_ptr<Peer>> sparePeers_;
+        std::unique_ptr<detail::ChannelScheduler> scheduler_;
+        std::unique_ptr<detail::StreamTable> streams_;  // outlives enet_host_destroy, which frees chunks
+        std::unique_ptr<detail::Recorder> recorder_;
+
+        std::unique_ptr<detail::HostMetricsStorage> metrics_;
+        Timestamp serviceReturned_{};       // when the current batch of events came out of ENet
+    };
+
+    // Persistent set of peers on one host. A group send serializes once and hands the same
+    // ENetPacket to every member; ENet's reference count frees it after the last one.
+    // Members are held by PeerHandle, so disconnected peers are skipped until removed.
+    // Not synchronized: mutate a group from one thread at a time.
+    class PeerGroup {
+    public:
+        explicit PeerGroup(std::shared_ptr<Host> host);
+
+        auto add(const Peer& peer) -> bool;
+        auto add(PeerHandle handle) -> bool;
+        auto remove(const Peer& peer) -> bool;
+        auto remove(PeerHandle handle) -> bool;
+        auto contains(PeerHandle handle) const -> bool;
+        void clear();
+
+        auto size() const -> size_t;
+        auto empty() const -> bool;
+        auto members() const -> const std::vector<PeerHandle>&;
+
+        auto send(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void;
+
+        template<typename T>
+        auto send(ChannelIdT channel, const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> void;
+
+    private:
+        // Copy-on-write so a queued send can keep the member list it was issued with.
+        auto mutableMembers() -> std::vector<PeerHandle>&;
+
+        std::weak_ptr<Host> host_;
+        std::shared_ptr<std::vector<PeerHandle>> members_;
+        std::unordered_map<PeerIdT, size_t> positions_;
+    };
+
+    // Spatial hash of peer positions for interest-managed sends. Peers sit in cubic cells
+    // of cellSize, so a query only visits the cells overlapping its volume and moving
+    // inside a cell just updates the stored position. Sends serialize once and share the
+    // ENetPacket across recipients like PeerGroup. Disconnected peers are skipped until
+    // removed. Not synchronized: use from one thread at a time.
+    class InterestGrid {
+    public:
+        struct Position {
+            float x = 0;
+            float y = 0;
+            float z = 0;    // leave at 0 for 2D worlds
+        };
+
+        explicit InterestGrid(std::shared_ptr<Host> host, float cellSize = 64.0f);
+
+        // Inserts the peer or moves it.
+        auto update(const Peer& peer, const Position& position) -> void;
+        auto update(PeerHandle handle, const Position& position) -> void;
+        auto remove(const Peer& peer) -> bool;
+        auto remove(PeerHandle handle) -> bool;
+        auto contains(PeerHandle handle) const -> bool;
+        auto position(PeerHandle handle) const -> std::optional<Position>;
+        void clear();
+        auto size() const -> size_t;
+
+        // Append matching peers to out and return how many matched. Bounds are inclusive.
+        auto query(const Position& center, float radius, std::vector<PeerHandle>& out) const -> size_t;
+        auto queryRegion(const Position& min, const Position& max, std::vector<PeerHandle>& out) const -> size_t;
+
+        // Return the number of entries the packet was addressed to. That includes peers
+        // that disconnected without being removed, which the send then skips.
+        auto broadcastNear(const Position& center, float radius, ChannelIdT channel, std::unique_ptr<Packet> pkt) -> size_t;
+        auto broadcastRegion(const Position& min, const Position& max, ChannelIdT channel, std::unique_ptr<Packet> pkt) -> size_t;
+
+        template<typename T>
+        auto broadcastNear(const Position& center, float radius, ChannelIdT channel, const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> size_t;
+
+        template<typename T>
+        auto broadcastRegion(const Position& min, const Position& max, ChannelIdT channel, const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> size_t;
+
+    private:
+        using CellKey = uint64_t;
+        using Cell = std::array<int32_t, 3>;
+
+        struct Entry {
+            PeerHandle handle;
+            Position position;
+            CellKey cell;
+            size_t index;   // within cells_[cell]
+        };
+
+        auto cellOf(const Position& position) const -> Cell;
+        static auto keyOf(const Cell& cell) -> CellKey;
+        auto link(PeerIdT slot, Entry& entry) -> void;
+        auto unlink(const Entry& entry) -> void;
+        // Calls visit(entry) for every peer in the cells spanning [low, high].
+        template<typename Visit>
+        auto forEachIn(const Position& low, const Position& high, Visit&& visit) const -> void;
+        auto recipients() -> std::vector<PeerHandle>&;
+        auto sendToRecipients(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> size_t;
+
+        std::weak_ptr<Host> host_;
+        float cellSize_;
+        std::unordered_map<PeerIdT, Entry> entries_;
+        std::unordered_map<CellKey, std::vector<PeerIdT>> cells_;
+        std::shared_ptr<std::vector<PeerHandle>> recipients_;   // copy-on-write, as in PeerGroup
+    };
+
+    // Read-only view of a file written by Host::startCapture. The file is mapped, not
+    // loaded: records are decoded as the iterator reaches them and payload spans point
+    // into the mapping for the life of the log. Iteration stops at a truncated record.
+    class CaptureLog {
+    public:
+        struct Entry {
+            CaptureRecord record;
+            Span<const uint8_t> payload{nullptr, 0};
+        };
+
+        class Iterator {
+        public:
+            using value_type = Entry;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+            explicit Iterator(Span<const uint8_t> records);
+
+            auto operator*() const -> const Entry& { return entry_; }
+            auto operator->() const -> const Entry* { return &entry_; }
+            auto operator++() -> Iterator&;
+            auto operator++(int) -> Iterator;
+            auto operator==(std::default_sentinel_t) const -> bool { return !cursor_; }
+
+        private:
+            void decode();
+
+            const uint8_t* cursor_ = nullptr;
+            const uint8_t* end_ = nullptr;
+            Entry entry_;
+        };
+
+        // Throws std::runtime_error if the file cannot be mapped or is not a capture.
+        explicit CaptureLog(const std::string& path);
+        ~CaptureLog();
+
+        CaptureLog(const CaptureLog&) = delete;
+        CaptureLog& operator=(const CaptureLog&) = delete;
+
+        auto begin() const -> Iterator;
+        auto end() const -> std::default_sentinel_t { return {}; }
+
+    private:
+        std::unique_ptr<detail::MappedFile> file_;
+    };
+
+    struct ReplayConfig {
+        double speed = 1.0;                         // 2 replays twice as fast; 0 sends without pacing
+        bool replaySends = false;                   // resend a client capture's sends instead of a server capture's receives
+        size_t peersPerHost = 64;                   // connections sharing one client host and socket
+        HostConfig host{};                          // for every client host; maxPeers and maxChannels come from the log
+        std::chrono::milliseconds drainTime{1000};  // longest to wait for held records after the last one
+    };
+
+    struct ReplayStats {
+        uint64_t sessions = 0;                      // connections opened
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        uint64_t skipped = 0;                       // records whose connection failed or never completed
+        std::chrono::nanoseconds maxLag{0};         // furthest behind schedule any record went out
+        std::chrono::nanoseconds elapsed{0};
+    };
+
+    // Replays a capture against target from a fleet of client hosts serviced on this
+    // thread. Each recorded peer slot becomes a connection opened at its connect record,
+    // which then sends that peer's records with their channel and flags at the recorded
+    // times divided by speed. Payloads reach ENet straight from the mapping; records
+    // captured without payloads send zeros of the original size. Records due before
+    // their connection completes are held until it does. Returns once every connection
+    // has been disconnected.
+    auto replayCapture(const CaptureLog& log, const Endpoint& target, const ReplayConfig& config = {}) -> ReplayStats;
+
+    // Delta compression for a fixed-size state block. Each snapshot is XORed against the
+    // newest one the receiver acknowledged (zeros until then) in 8-byte words, and only
+    // non-zero words are sent, after a bitmask of which words changed.
+    // Wire format: u16 sequence, u8 hasBaseline, [u16 baseline], mask, changed words.
+    class DeltaEncoder {
+    public:
+        explicit DeltaEncoder(size_t stateSize, size_t history = 32);
+
+        auto encode(const void* state, PacketFlagsT flags = 0) -> std::unique_ptr<Packet>;
+        void acknowledge(uint16_t sequence);
+        auto acknowledge(const Packet& ack) -> bool;
+        void reset();
+
+        auto stateSize() const -> size_t;
+
+    private:
+        size_t stateSize_;
+        std::vector<uint8_t> history_;
+        std::vector<std::optional<uint16_t>> sequences_;
+        std::vector<uint8_t> baseline_;
+        std::optional<uint16_t> baselineSequence_;
+        std::vector<uint8_t> delta_;
+        std::vector<uint8_t> mask_;
+        uint16_t nextSequence_ = 0;
+        PacketBuilder builder_;
+    };
+
+    class DeltaDecoder {
+    public:
+        explicit DeltaDecoder(size_t stateSize, size_t history = 32);
+
+        // False for stale, malformed, or undecodable (baseline no longer held) packets.
+        auto decode(const Packet& pkt, void* state) -> bool;
+        // Acknowledges the newest decoded snapshot; nullptr until one has been decoded.
+        auto makeAck(PacketFlagsT flags = 0) const -> std::unique_ptr<Packet>;
+        auto lastSequence() const -> std::optional<uint16_t>;
+        void reset();
+
+    private:
+        size_t stateSize_;
+        std::vector<uint8_t> history_;
+        std::vector<std::optional<uint16_t>> sequences_;
+        std::vector<uint8_t> scratch_;
+        std::vector<uint8_t> mask_;
+        std::optional<uint16_t> latest_;
+    };
+
+    template<Serializable T>
+    class SnapshotSender {
+    public:
+        explicit SnapshotSender(size_t history = 32) : encoder_(sizeof(T), history) {}
+
+        auto encode(const T& state, PacketFlagsT flags = 0) -> std::unique_ptr<Packet> {
+            return encoder_.encode(&state, flags);
+        }
+        auto acknowledge(const Packet& ack) -> bool { return encoder_.acknowledge(ack); }
+        void reset() { encoder_.reset(); }
+
+    private:
+        DeltaEncoder encoder_;
+    };
+
+    template<Serializable T>
+    class SnapshotReceiver {
+    public:
+        explicit SnapshotReceiver(size_t history = 32) : decoder_(sizeof(T), history) {}
+
+        auto decode(const Packet& pkt) -> std::optional<T> {
+            std::array<std::byte, sizeof(T)> bytes;
+            if (!decoder_.decode(pkt, bytes.data())) {
+                return std::nullopt;
+            }
+            return std::bit_cast<T>(bytes);
+        }
+        auto makeAck(PacketFlagsT flags = 0) const -> std::unique_ptr<Packet> { return decoder_.makeAck(flags); }
+        void reset() { decoder_.reset(); }
+
+    private:
+        DeltaDecoder decoder_;
+    };
+
+    // One replicated state stream sent to many peers, each against its own baseline.
+    // Snapshots go out unreliable on one channel; peers return SnapshotReceiver acks.
+    template<Serializable T>
+    class SnapshotReplicator {
+    public:
+        explicit SnapshotReplicator(ChannelIdT channel, size_t history = 32) : channel_(channel), history_(history) {}
+
+        auto send(Peer& peer, const T& state) -> bool {
+            return peer.send(channel_, streamFor(peer).encoder.encode(&state, 0));
+        }
+
+        auto acknowledge(const Peer& peer, const Packet& ack) -> bool {
+            return streamFor(peer).encoder.acknowledge(ack);
+        }
+
+        void remove(const Peer& peer) { streams_.erase(peer.handle().slot); }
+        auto peerCount() const -> size_t { return streams_.size(); }
+
+    private:
+        struct Stream {
+            uint32_t generation;
+            DeltaEncoder encoder;
+        };
+
+        auto streamFor(const Peer& peer) -> Stream& {
+            auto handle = peer.handle();
+            auto it = streams_.find(handle.slot);
+            if (it == streams_.end()) {
+                it = streams_.emplace(handle.slot, Stream{handle.generation, DeltaEncoder(sizeof(T), history_)}).first;
+            } else if (it->second.generation != handle.generation) {
+                // A new connection took the slot; its receiver holds no baseline yet.
+                it->second.generation = handle.generation;
+                it->second.encoder.reset();
+            }
+            return it->second;
+        }
+
+        ChannelIdT channel_;
+        size_t history_;
+        std::unordered_map<PeerIdT, Stream> streams_;
+    };
+
+    struct ShardConfig {
+        size_t shardCount = 0;  // 0 = one shard per hardware thread
+        bool pinThreads = true; // pin shard i's service thread to CPU i (mod CPU count)
+        HostConfig host;        // applied to every shard; maxPeers is per shard
+    };
+
+    // N server hosts bound to one port with SO_REUSEPORT, each serviced by its own
+    // thread. The kernel keeps every remote address on one shard, so per-peer ordering
+    // holds, but handlers on the shared dispatcher run concurrently from all shards.
+    class ShardedHost {
+    public:
+        static auto create(const Endpoint& bindEndpoint, const ShardConfig& config = {}) -> std::shared_ptr<ShardedHost>;
+
+        ~ShardedHost();
+
+        ShardedHost(const ShardedHost&) = delete;
+        ShardedHost& operator=(const ShardedHost&) = delete;
+
+        auto start() -> void;
+        auto stop() -> void;
+        auto isRunning() const -> bool;
+
+        auto broadcast(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void;
+        auto broadcast(std::unique_ptr<Packet> pkt) -> void;
+
+        template<typename T>
+        auto broadcast(ChannelIdT channel, const T& packetData, PacketFlagsT flags = DEFAULT_FLAGS) -> void;
+
+        auto flush() -> void;
+
+        auto shardCount() const -> size_t;
+        auto shard(size_t index) const -> std::shared_ptr<Host>;
+        auto shardOf(const Peer& peer) const -> size_t;
+
+        auto peerCount() const -> size_t;
+        auto getPeers() -> std::vector<std::shared_ptr<Peer>>;
+        auto findPeer(const Endpoint& remoteEndpoint) -> std::shared_ptr<Peer>;
+
+        auto getDispatcher() -> EventDispatcher&;
+
+    private:
+        ShardedHost() = default;
+
+        std::vector<std::shared_ptr<Host>> shards_;
+        std::shared_ptr<EventDispatcher> dispatcher_;
+        bool running_ = false;
     };
 
+    namespace detail {
+        // Coroutine frames come from the packet pool.
+        auto allocateFrame(size_t size) -> void*;
+        void freeFrame(void* frame) noexcept;
+        // Resumes on the TaskScheduler when it is running, otherwise inline.
+        void resumeLater(std::coroutine_handle<> handle);
+        void resumeAt(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle);
+
+        struct TaskPromiseBase {
+            struct FinalAwaiter {
+                auto await_ready() const noexcept -> bool { return false; }
+
+                template<typename Promise>
+                auto await_suspend(std::coroutine_handle<Promise> handle) noexcept -> std::coroutine_handle<> {
+                    auto& promise = handle.promise();
+                    if (promise.continuation) {
+                        promise.finish();
+                        return promise.continuation;
+                    }
+                    if (promise.detached) {
+                        handle.destroy();
+                    } else if (auto waiter = promise.finish()) {
+                        waiter->notify();
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            // Lets Task::get() block on a task that finishes on another thread.
+            struct SyncWaiter {
+                std::mutex mutex;
+                std::condition_variable cv;
+                bool finished = false;
+
+                void notify() {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished = true;
+                    cv.notify_all();
+                }
+            };
+
+            static auto operator new(size_t size) -> void* { return allocateFrame(size); }
+            static void operator delete(void* frame) noexcept { freeFrame(frame); }
+
+            auto initial_suspend() const noexcept -> std::suspend_always { return {}; }
+            auto final_suspend() const noexcept -> FinalAwaiter { return {}; }
+
+            void unhandled_exception() {
+                if (detached) {
+                    std::terminate();
+                }
+                exception = std::current_exception();
+            }
+
+            // True for the one caller that gets to resume the task from its initial suspend.
+            auto claimStart() -> bool {
+                std::lock_guard<std::mutex> lock(mutex);
+                return !std::exchange(started, true);
+            }
+
+            // Installs a waiter for a task some other thread may be running; false once it
+            // has finished.
+            auto wait(SyncWaiter& syncWaiter) -> bool {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished) {
+                    return false;
+                }
+                waiter = &syncWaiter;
+                return true;
+            }
+
+            auto finish() -> SyncWaiter* {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+                return waiter;
+            }
+
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+            bool detached = false;
+
+        private:
+            std::mutex mutex;
+            SyncWaiter* waiter = nullptr;
+            bool started = false;
+            bool finished = false;
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase {
+            template<typename U = T>
+            void return_value(U&& value) {
+                result.emplace(std::forward<U>(value));
+            }
+
+            auto take() -> T {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+                return std::move(*result);
+            }
+
+            std::optional<T> result;
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase {
+            void return_void() const noexcept {}
+
+            void take() {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+        };
+    }
+
     namespace async {
+        // Lazily started coroutine. co_await it from another coroutine, hand it to
+        // TaskScheduler::scheduleTask, or block on get().
         template<typename T = void>
-        struct Task {
+        class [[nodiscard]] Task {
+        public:
+            struct promise_type : detail::TaskPromise<T> {
+                auto get_return_object() -> Task {
+                    return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+            };
+
             Task() = default;
-            ~Task() = default;
+            ~Task() {
+                if (handle_) {
+                    handle_.destroy();
+                }
+            }
 
             Task(const Task&) = delete;
             Task& operator=(const Task&) = delete;
-            Task(Task&& other) noexcept = default;
-            Task& operator=(Task&& other) noexcept = default;
+            Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+            Task& operator=(Task&& other) noexcept {
+                if (this != &other) {
+                    if (handle_) {
+                        handle_.destroy();
+                    }
+                    handle_ = std::exchange(other.handle_, {});
+                }
+                return *this;
+            }
 
-            template<typename U = T>
-            auto get() -> typename std::enable_if<!std::is_void_v<U>, U>::type {
-                return result_;
+            // Runs the task to completion if needed, blocking the caller, and returns its result.
+            // A task already started elsewhere is only waited for, never resumed again.
+            auto get() -> T {
+                if (!handle_) {
+                    throw std::runtime_error("Task has no coroutine");
+                }
+                auto& promise = handle_.promise();
+                detail::TaskPromiseBase::SyncWaiter waiter;
+                if (promise.wait(waiter)) {
+                    if (promise.claimStart()) {
+                        handle_.resume();
+                    }
+                    std::unique_lock<std::mutex> lock(waiter.mutex);
+                    waiter.cv.wait(lock, [&waiter] { return waiter.finished; });
+                }
+                return promise.take();
             }
 
-            template<typename U = T>
-            typename std::enable_if<std::is_void_v<U>, void>::type get() {
+            bool done() const { return !handle_ || handle_.done(); }
+
+            // Starts the task; does nothing once it has been started.
+            void resume() {
+                if (handle_ && handle_.promise().claimStart()) {
+                    handle_.resume();
+                }
+            }
+
+            auto operator co_await() && noexcept {
+                struct Awaiter {
+                    std::coroutine_handle<promise_type> handle;
+
+                    auto await_ready() const noexcept -> bool { return !handle || handle.done(); }
+
+                    auto await_suspend(std::coroutine_handle<> continuation) noexcept -> std::coroutine_handle<> {
+                        handle.promise().continuation = continuation;
+                        handle.promise().claimStart();
+                        return handle;
+                    }
+
+                    auto await_resume() -> T {
+                        if (!handle) {
+                            throw std::runtime_error("Task has no coroutine");
+                        }
+                        return handle.promise().take();
+                    }
+                };
+                return Awaiter{handle_};
+            }
+
+            // Gives up ownership; the frame destroys itself when the coroutine finishes.
+            auto detach() -> std::coroutine_handle<promise_type> {
+                if (handle_) {
+                    handle_.promise().detached = true;
+                }
+                return std::exchange(handle_, {});
             }
 
-            bool done() const { return true; }
-            void resume() {}
+        private:
+            explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+            std::coroutine_handle<promise_type> handle_;
+        };
+
+        struct SchedulerConfig {
+            size_t threadCount = 0;     // 0 = hardware_concurrency()
+            bool pinThreads = false;    // pin worker i to CPU (firstCpu + i) % cpuCount
+            size_t firstCpu = 0;
+        };
+
+        // Totals since the last start().
+        struct SchedulerMetrics {
+            size_t workers = 0;
+            size_t pendingTasks = 0;
+            uint64_t tasksExecuted = 0;
+            uint64_t tasksStolen = 0;       // taken from another worker's deque or inbox
+            uint64_t parks = 0;             // times a worker went to sleep for lack of work
+
+            auto toPrometheus(std::string_view prefix = "icelander") const -> std::string;
+        };
+
+        // Type-erased unit of work for the scheduler. Callables up to inlineSize bytes are
+        // stored in the node itself; nodes come from the packet pool.
+        class TaskNode {
+        public:
+            // Room for a parallel-dispatch event with its owning host and receive timestamp.
+            static constexpr size_t inlineSize = 64;
+
+            TaskNode() = default;
+            TaskNode(const TaskNode&) = delete;
+            TaskNode& operator=(const TaskNode&) = delete;
+
+            template<typename F>
+            static auto make(F&& fn) -> TaskNode*;
+
+            // Invokes the callable, then destroys the node.
+            static void run(TaskNode* node);
+            static void discard(TaskNode* node) noexcept;
+
+            std::atomic<TaskNode*> next{nullptr};
 
         private:
-            T result_{};
+            static auto allocate() -> TaskNode*;
+            static void release(TaskNode* node) noexcept;
+
+            void (*invoke_)(TaskNode&) = nullptr;
+            void (*destroy_)(TaskNode&) noexcept = nullptr;
+            alignas(std::max_align_t) unsigned char storage_[inlineSize];
         };
 
+        // Work-stealing pool. Tasks scheduled from a worker go to that worker's deque; tasks
+        // from other threads are handed round-robin to a worker inbox. Tasks scheduled
+        // while stopped are kept and run on the next start().
         class TaskScheduler {
         public:
             static auto instance() -> TaskScheduler&;
 
-            void schedule(std::function<void()> task);
+            template<typename F>
+            void schedule(F&& task);
             template<typename T>
             void scheduleTask(Task<T>&& t);
 
             void start();
+            void start(const SchedulerConfig& config);
+            // Runs every task already queued (including ones they schedule), then joins.
             void stop();
             bool isRunning() const;
 
+            auto workerCount() const -> size_t;
+            auto pendingTasks() const -> size_t;
+            auto metrics() const -> SchedulerMetrics;
+
         private:
+            struct Worker;
+
             TaskScheduler() = default;
-            void workerLoop();
+            ~TaskScheduler();
+
+            void submit(TaskNode* task);
+            void workerLoop(size_t index);
+            auto findTask(size_t index) -> TaskNode*;
+            void park();
+            void wakeOne();
 
             std::atomic<bool> running_{false};
-            std::vector<std::unique_ptr<std::thread>> workerThreads_;
-            std::queue<std::function<void()>> taskQueue_;
-            std::mutex queueMutex_;
-            std::condition_variable queueCv_;
+            std::atomic<bool> accepting_{false};
+            std::atomic<size_t> submitting_{0};
+            std::atomic<size_t> queued_{0};
+            std::atomic<size_t> sleepers_{0};
+            std::atomic<size_t> nextInbox_{0};
+            std::atomic<size_t> workerCount_{0};
+            std::vector<std::unique_ptr<Worker>> workers_;
+            std::vector<TaskNode*> backlog_;
+            mutable std::mutex lifecycleMutex_;
+            mutable std::mutex backlogMutex_;
+            std::mutex parkMutex_;
+            std::condition_variable parkCv_;
+        };
+
+        class SleepAwaiter {
+        public:
+            explicit SleepAwaiter(std::chrono::steady_clock::time_point deadline) : deadline_(deadline) {}
+
+            auto await_ready() const -> bool { return deadline_ <= std::chrono::steady_clock::now(); }
+            void await_suspend(std::coroutine_handle<> handle) const { detail::resumeAt(deadline_, handle); }
+            void await_resume() const noexcept {}
+
+        private:
+            std::chrono::steady_clock::time_point deadline_;
+        };
+
+        // Completes with the peer once ENet reports CONNECT, or nullptr if the attempt fails.
+        // Throws from co_await if a hostname does not resolve.
+        class ConnectAwaiter {
+        public:
+            ConnectAwaiter(std::shared_ptr<Host> host, const Endpoint& remoteEndpoint, size_t channels, uint32_t connectData)
+                : host_(std::move(host)), remoteEndpoint_(remoteEndpoint), channels_(channels), connectData_(connectData) {}
+            ConnectAwaiter(std::shared_ptr<Host> host, std::string hostName, uint16_t port, size_t channels, uint32_t connectData)
+                : host_(std::move(host)), hostName_(std::move(hostName)), remoteEndpoint_{ENET_HOST_ANY, port}
+                , channels_(channels), connectData_(connectData) {}
+
+            auto await_ready() const noexcept -> bool { return false; }
+            auto await_suspend(std::coroutine_handle<> handle) -> bool;
+            auto await_resume() -> std::shared_ptr<Peer>;
+
+        private:
+            friend class icelander::Host;
+            friend struct detail::PeerAwaitState;
+
+            auto resolved(std::optional<Endpoint> endpoint) -> void;
+            auto submitConnect() -> void;
+
+            std::shared_ptr<Host> host_;
+            std::string hostName_;
+            Endpoint remoteEndpoint_;
+            size_t channels_;
+            uint32_t connectData_;
+            std::coroutine_handle<> handle_;
+            std::shared_ptr<Peer> result_;
+            std::exception_ptr error_;
         };
 
+        // Completes with the next packet on the channel, or nullptr once the peer disconnects.
+        class ReceiveAwaiter {
+        public:
+            ReceiveAwaiter(std::shared_ptr<detail::PeerAwaitState> state, ChannelIdT channel)
+                : state_(std::move(state)), channel_(channel) {}
+
+            auto await_ready() const noexcept -> bool { return false; }
+            auto await_suspend(std::coroutine_handle<> handle) -> bool;
+            auto await_resume() -> std::unique_ptr<Packet> { return std::move(result_); }
+
+        private:
+            friend struct detail::PeerAwaitState;
+
+            std::shared_ptr<detail::PeerAwaitState> state_;
+            ChannelIdT channel_;
+            std::coroutine_handle<> handle_;
+            std::unique_ptr<Packet> result_;
+        };
+
+        template<typename Rep, typename Period>
+        auto sleepFor(std::chrono::duration<Rep, Period> duration) -> SleepAwaiter {
+            return SleepAwaiter(std::chrono::steady_clock::now() +
+                                std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+        }
+
         auto sleepMs(int milliseconds) -> void;
     }
 
@@ -431,6 +2297,14 @@ namespace icelander {
         return *reinterpret_cast<const T*>(data().data());
     }
 
+    template<Serializable T>
+    auto PacketRef::as() const -> const T& {
+        if (size() < sizeof(T)) {
+            throw std::runtime_error("Packet too small for requested type");
+        }
+        return *reinterpret_cast<const T*>(data().data());
+    }
+
     template<Serializable T>
     auto PacketBuilder::write(const T& value) -> PacketBuilder& {
         return write(&value, sizeof(T));
@@ -445,6 +2319,161 @@ namespace icelander {
         return value;
     }
 
+    template<WireScalar T>
+    auto PacketBuilder::writeArray(const T* values, size_t count) -> PacketBuilder& {
+        if (count == 0) {
+            return *this;
+        }
+        auto bytes = append(count * sizeof(T));
+        std::memcpy(bytes, values, count * sizeof(T));
+        if constexpr (std::endian::native != std::endian::little && sizeof(T) > 1) {
+            detail::swapElementBytes(bytes, count, sizeof(T));
+        }
+        return *this;
+    }
+
+    template<WireScalar T>
+    auto PacketReader::readArray(T* values, size_t count) -> bool {
+        if (count > remaining() / sizeof(T) || !read(values, count * sizeof(T))) {
+            return false;
+        }
+        if constexpr (std::endian::native != std::endian::little && sizeof(T) > 1) {
+            detail::swapElementBytes(reinterpret_cast<uint8_t*>(values), count, sizeof(T));
+        }
+        return true;
+    }
+
+    template<WireScalar T>
+    auto PacketReader::readArray(size_t count) -> std::vector<T> {
+        if (count > remaining() / sizeof(T)) {
+            throw std::runtime_error("Not enough data to read array");
+        }
+        std::vector<T> values(count);
+        readArray(values.data(), count);
+        return values;
+    }
+
+    template<HasSchema T>
+    auto PacketBuilder::writeSchema(const T& value) -> PacketBuilder& {
+        using Traits = detail::SchemaTraits<T>;
+        if constexpr (Traits::fixed) {
+            reserve(size_ + sizeof(uint16_t) + Traits::offsets[Traits::count]);
+        }
+        writeUint16(Traits::version);
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (Traits::template CodecAt<I>::write(*this, value.*(Traits::template FieldAt<I>::member)), ...);
+        }(std::make_index_sequence<Traits::count>{});
+        return *this;
+    }
+
+    template<HasSchema T>
+    auto PacketReader::readSchema() -> std::optional<T> {
+        PacketView<T> view(Span<const uint8_t>(data_.data() + position_, remaining()));
+        if (!view) {
+            return std::nullopt;
+        }
+        position_ += view.version() > Schema<T>::version ? remaining() : view.size();
+        return view.decode();
+    }
+
+    template<WireScalar T>
+    auto WireArray<T>::operator[](size_t index) const -> T {
+        return detail::loadScalar<T>(data_ + index * sizeof(T));
+    }
+
+    template<WireScalar T>
+    auto WireArray<T>::toVector() const -> std::vector<T> {
+        std::vector<T> values(count_);
+        if (count_ > 0) {
+            std::memcpy(values.data(), data_, count_ * sizeof(T));
+            if constexpr (std::endian::native != std::endian::little && sizeof(T) > 1) {
+                detail::swapElementBytes(reinterpret_cast<uint8_t*>(values.data()), count_, sizeof(T));
+            }
+        }
+        return values;
+    }
+
+    template<HasSchema T>
+    PacketView<T>::PacketView(Span<const uint8_t> packetData) {
+        if (packetData.size() < headerSize) {
+            return;
+        }
+
+        uint16_t packetVersion = detail::loadScalar<uint16_t>(packetData.data());
+        size_t present = Traits::presentFields(packetVersion);
+        size_t end = headerSize;
+
+        if constexpr (Traits::fixed) {
+            end += Traits::offsets[present];
+            if (packetData.size() < end) {
+                return;
+            }
+        } else {
+            bool complete = [&]<size_t... I>(std::index_sequence<I...>) {
+                return ((I >= present || measure<I>(packetData, end)) && ...);
+            }(std::make_index_sequence<Traits::count>{});
+            if (!complete) {
+                return;
+            }
+        }
+
+        data_ = packetData.data();
+        version_ = packetVersion;
+        present_ = present;
+        size_ = end;
+    }
+
+    template<HasSchema T>
+    template<size_t I>
+    auto PacketView<T>::measure(Span<const uint8_t> packetData, size_t& cursor) -> bool {
+        using Codec = typename Traits::template CodecAt<I>;
+        size_t available = packetData.size() - cursor;
+        size_t length;
+        if constexpr (Codec::fixed) {
+            length = Codec::wireSize <= available ? Codec::wireSize : 0;
+        } else {
+            length = Codec::measure(packetData.data() + cursor, available);
+        }
+        if (length == 0) {
+            return false;
+        }
+        offsets_[I] = cursor;
+        cursor += length;
+        return true;
+    }
+
+    template<HasSchema T>
+    template<size_t I>
+    auto PacketView<T>::fieldData() const -> const uint8_t* {
+        if constexpr (Traits::fixed) {
+            return data_ + headerSize + Traits::offsets[I];
+        } else {
+            return data_ + offsets_[I];
+        }
+    }
+
+    template<HasSchema T>
+    template<auto Member>
+    auto PacketView<T>::get() const -> detail::FieldView<T, Member> {
+        constexpr size_t index = Traits::template indexOf<Member>();
+        static_assert(index < Traits::count, "Member is not part of the schema");
+        if (index >= present_) {
+            return {};
+        }
+        return Traits::template CodecAt<index>::view(fieldData<index>());
+    }
+
+    template<HasSchema T>
+    auto PacketView<T>::decode() const -> T {
+        T value{};
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            ((I < present_ ? void(value.*(Traits::template FieldAt<I>::member) =
+                                  Traits::template CodecAt<I>::decode(fieldData<I>()))
+                           : void()), ...);
+        }(std::make_index_sequence<Traits::count>{});
+        return value;
+    }
+
     template<typename T>
     auto Peer::send(ChannelIdT channel, const T& packetData, PacketFlagsT flags) -> bool {
         auto pkt = Packet::create(packetData, flags);
@@ -456,6 +2485,11 @@ namespace icelander {
         return send(0, packetData, flags);
     }
 
+    template<Serializable T>
+    auto Peer::queueMessage(ChannelIdT channel, const T& message, PacketFlagsT flags) -> bool {
+        return queueMessage(channel, &message, sizeof(T), flags);
+    }
+
     template<typename T>
     auto Host::broadcast(ChannelIdT channel, const T& packetData, PacketFlagsT flags) -> void {
         auto pkt = Packet::create(packetData, flags);
@@ -467,10 +2501,202 @@ namespace icelander {
         broadcast(0, packetData, flags);
     }
 
+    template<typename Sink>
+    auto Host::serviceLoop(TimeoutMs timeout, size_t limit, Sink&& sink) -> int {
+        auto started = detail::metricsNow();
+        drainCommands();
+        pumpOutgoing();
+
+        ENetEvent event;
+        int result = enet_host_service(nativeHost_, &event, static_cast<uint32_t>(timeout.count()));
+        serviceReturned_ = detail::metricsNow();
+        flushSocket();
+        if (result > 0) {
+            size_t counted = 0;
+            do {
+                counted += sink(std::as_const(event)) ? 1 : 0;
+            } while ((limit == 0 || counted < limit) && enet_host_check_events(nativeHost_, &event) > 0);
+            result = static_cast<int>(counted);
+        }
+
+        if constexpr (METRICS_ENABLED) {
+            recordService(started);
+        }
+        return result;
+    }
+
+    template<EventSink Dispatcher>
+    auto Host::serviceWith(Dispatcher& dispatcher, TimeoutMs timeout) -> int {
+        if (!nativeHost_) {
+            return 0;
+        }
+        return serviceLoop(timeout, config_.maxEventsPerService, [this, &dispatcher](const ENetEvent& event) {
+            routeEvent(event, dispatcher);
+            return true;
+        });
+    }
+
+    template<typename Handler>
+        requires std::invocable<Handler&, const EventRef&>
+    auto Host::serviceEvents(Handler&& handler, TimeoutMs timeout) -> int {
+        if (!nativeHost_) {
+            return 0;
+        }
+        return serviceLoop(timeout, config_.maxEventsPerService, [this, &handler](const ENetEvent& event) {
+            deliverEvent(event, handler);
+            return true;
+        });
+    }
+
+    template<typename Handler>
+    auto Host::deliverEvent(const ENetEvent& event, Handler& handler) -> void {
+        auto started = detail::metricsNow();
+        if (recorder_) {
+            recordEvent(event);
+        }
+
+        EventRef ref;
+        if (!prepareEvent(event, ref)) {
+            return;
+        }
+
+        detail::PacketLoan loan;
+        if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+            loan.packet = event.packet;
+            ref.packet = PacketRef(event.packet, &loan);
+        }
+        handler(std::as_const(ref));
+        finishEvent(event, ref);
+
+        if constexpr (METRICS_ENABLED) {
+            recordDispatch(serviceReturned_, started);
+        }
+    }
+
+    template<EventSink Dispatcher>
+    auto Host::routeEvent(const ENetEvent& event, Dispatcher& dispatcher) -> void {
+        // ParallelSink times the handlers on the strand instead.
+        constexpr bool timed = METRICS_ENABLED && !std::is_same_v<Dispatcher, ParallelSink>;
+        auto started = timed ? std::chrono::steady_clock::now() : Timestamp{};
+        if (recorder_) {
+            recordEvent(event);
+        }
+
+        switch (event.type) {
+            case ENET_EVENT_TYPE_CONNECT: {
+                ConnectEvent connectEvt;
+                connectEvt.peerHandle = acceptPeer(event.peer);
+                connectEvt.remoteEndpoint = Endpoint::fromEnetAddress(event.peer->address);
+                connectEvt.data = event.data;
+                auto peerWrapper = connectEvt.peerHandle;
+                dispatcher.dispatchConnect(std::move(connectEvt));
+                notifyConnected(peerWrapper);
+                break;
+            }
+
+            case ENET_EVENT_TYPE_DISCONNECT: {
+                // Handlers can still look the peer up; it leaves the registry afterwards.
+                auto peerWrapper = findPeerByNative(event.peer);
+                if (peerWrapper) {
+                    DisconnectEvent disconnectEvt;
+                    disconnectEvt.peerHandle = peerWrapper;
+                    disconnectEvt.remoteEndpoint = Endpoint::fromEnetAddress(event.peer->address);
+                    disconnectEvt.data = event.data;
+                    dispatcher.dispatchDisconnect(std::move(disconnectEvt));
+                    retirePeer(event.peer, peerWrapper);
+                }
+                break;
+            }
+
+            case ENET_EVENT_TYPE_RECEIVE: {
+                if constexpr (METRICS_ENABLED) {
+                    recordReceive(*event.peer, event.channelID, event.packet->dataLength);
+                }
+                // Wrapped first so the packet is freed even if the peer is unknown.
+                auto packetWrapper = Packet::fromNative(event.packet);
+                auto peerWrapper = findPeerByNative(event.peer);
+                if (peerWrapper && packetWrapper && !captureReceive(*peerWrapper, event.channelID, packetWrapper)) {
+                    ReceiveEvent receiveEvt;
+                    receiveEvt.peerHandle = std::move(peerWrapper);
+                    receiveEvt.packetData = std::move(packetWrapper);
+                    receiveEvt.channel = event.channelID;
+                    dispatcher.dispatchReceive(std::move(receiveEvt));
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        if constexpr (timed) {
+            recordDispatch(serviceReturned_, started);
+        }
+    }
+
+    template<typename T>
+    auto PeerGroup::send(ChannelIdT channel, const T& packetData, PacketFlagsT flags) -> void {
+        send(channel, Packet::create(packetData, flags));
+    }
+
+    template<typename T>
+    auto InterestGrid::broadcastNear(const InterestGrid::Position& center, float radius, ChannelIdT channel, const T& packetData, PacketFlagsT flags) -> size_t {
+        return broadcastNear(center, radius, channel, Packet::create(packetData, flags));
+    }
+
+    template<typename T>
+    auto InterestGrid::broadcastRegion(const InterestGrid::Position& min, const InterestGrid::Position& max, ChannelIdT channel, const T& packetData, PacketFlagsT flags) -> size_t {
+        return broadcastRegion(min, max, channel, Packet::create(packetData, flags));
+    }
+
+    template<typename T>
+    auto ShardedHost::broadcast(ChannelIdT channel, const T& packetData, PacketFlagsT flags) -> void {
+        broadcast(channel, Packet::create(packetData, flags));
+    }
+
+    template<typename F>
+    auto async::TaskNode::make(F&& fn) -> TaskNode* {
+        using Fn = std::decay_t<F>;
+        auto node = allocate();
+
+        try {
+            if constexpr (sizeof(Fn) <= inlineSize && alignof(Fn) <= alignof(std::max_align_t)) {
+                new (node->storage_) Fn(std::forward<F>(fn));
+                node->invoke_ = [](TaskNode& self) {
+                    (*std::launder(reinterpret_cast<Fn*>(self.storage_)))();
+                };
+                node->destroy_ = [](TaskNode& self) noexcept {
+                    std::launder(reinterpret_cast<Fn*>(self.storage_))->~Fn();
+                };
+            } else {
+                new (node->storage_) Fn*(new Fn(std::forward<F>(fn)));
+                node->invoke_ = [](TaskNode& self) {
+                    (**std::launder(reinterpret_cast<Fn**>(self.storage_)))();
+                };
+                node->destroy_ = [](TaskNode& self) noexcept {
+                    delete *std::launder(reinterpret_cast<Fn**>(self.storage_));
+                };
+            }
+        } catch (...) {
+            release(node);
+            throw;
+        }
+        return node;
+    }
+
+    template<typename F>
+    void async::TaskScheduler::schedule(F&& task) {
+        submit(TaskNode::make(std::forward<F>(task)));
+    }
+
     template<typename T>
     void async::TaskScheduler::scheduleTask(Task<T>&& t) {
-        schedule([task = std::move(t)]() mutable {
-            task.resume();
-        });
+        auto handle = t.detach();
+        if (handle && handle.promise().claimStart()) {
+            schedule([handle] { handle.resume(); });
+        }
     }
-}
\ No newline at end of file
+}
+
+template<>
+struct std::hash<icelander::Endpoint> : icelander::EndpointHash {};
\ No newline at end of file
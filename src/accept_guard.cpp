@@ -0,0 +1,175 @@
+#include "accept_guard.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace icelander::detail {
+    namespace {
+        // The intercept hook only receives the ENetHost, so guards are found by scanning a
+        // small table. Only datagrams from addresses without a peer get that far.
+        constexpr size_t MAX_GUARDED_HOSTS = 64;
+
+        struct GuardEntry {
+            std::atomic<ENetHost*> host{nullptr};
+            std::atomic<AcceptGuard*> guard{nullptr};
+        };
+
+        std::array<GuardEntry, MAX_GUARDED_HOSTS> guards;
+        std::mutex guardsMutex;
+
+        auto findGuard(const ENetHost* host) -> AcceptGuard* {
+            for (auto& entry : guards) {
+                if (entry.host.load(std::memory_order_acquire) == host) {
+                    return entry.guard.load(std::memory_order_acquire);
+                }
+            }
+            return nullptr;
+        }
+
+        constexpr uint16_t PEER_ID_MASK = static_cast<uint16_t>(~(ENET_PROTOCOL_HEADER_FLAG_MASK | ENET_PROTOCOL_HEADER_SESSION_MASK));
+    }
+
+    auto AcceptGuard::install(ENetHost* host, const AcceptConfig& config) -> std::unique_ptr<AcceptGuard> {
+        bool enforcing = config.validateHandshake || config.connectsPerSecond > 0 || config.connectsPerSecondPerAddress > 0;
+        if (!host || !enforcing || host->intercept) {
+            return nullptr;
+        }
+
+        std::unique_ptr<AcceptGuard> guard(new AcceptGuard(host, config));
+        std::lock_guard<std::mutex> lock(guardsMutex);
+        for (auto& entry : guards) {
+            if (!entry.host.load(std::memory_order_relaxed)) {
+                entry.guard.store(guard.get(), std::memory_order_relaxed);
+                entry.host.store(host, std::memory_order_release);
+                host->intercept = &AcceptGuard::intercept;
+                return guard;
+            }
+        }
+        return nullptr;
+    }
+
+    AcceptGuard::AcceptGuard(ENetHost* host, const AcceptConfig& config)
+        : host_(host)
+        , config_(config) {
+        if (config_.connectsPerSecondPerAddress > 0) {
+            addresses_.resize(std::bit_ceil(std::max<size_t>(config_.addressSlots, 2)));
+        }
+    }
+
+    AcceptGuard::~AcceptGuard() {
+        std::lock_guard<std::mutex> lock(guardsMutex);
+        host_->intercept = nullptr;
+        for (auto& entry : guards) {
+            if (entry.host.load(std::memory_order_relaxed) == host_) {
+                entry.host.store(nullptr, std::memory_order_release);
+                entry.guard.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    auto AcceptGuard::stats() const -> AcceptStats {
+        AcceptStats result;
+        result.accepted = accepted_.load();
+        result.rateLimited = rateLimited_.load();
+        result.malformed = malformed_.load();
+        return result;
+    }
+
+    int ENET_CALLBACK AcceptGuard::intercept(ENetHost* host, ENetEvent*) {
+        uint16_t peerId;
+        if (host->receivedDataLength < sizeof(peerId)) {
+            return 0;   // ENet drops it
+        }
+        std::memcpy(&peerId, host->receivedData, sizeof(peerId));
+        if ((ENET_NET_TO_HOST_16(peerId) & PEER_ID_MASK) != ENET_PROTOCOL_MAXIMUM_PEER_ID) {
+            return 0;
+        }
+
+        // 1 with no event tells ENet the datagram was consumed.
+        auto guard = findGuard(host);
+        return guard && !guard->screen(*host) ? 1 : 0;
+    }
+
+    auto AcceptGuard::screen(const ENetHost& host) -> bool {
+        if (config_.validateHandshake && !validConnect(host)) {
+            malformed_.add();
+            return false;
+        }
+
+        // Per address first, so one noisy source cannot drain the host-wide bucket.
+        auto now = std::chrono::steady_clock::now();
+        if (config_.connectsPerSecondPerAddress > 0 &&
+            !bucketFor(host.receivedAddress.host).take(config_.connectsPerSecondPerAddress, config_.connectBurstPerAddress, now)) {
+            rateLimited_.add();
+            return false;
+        }
+        if (config_.connectsPerSecond > 0 && !global_.take(config_.connectsPerSecond, config_.connectBurst, now)) {
+            rateLimited_.add();
+            return false;
+        }
+
+        accepted_.add();
+        return true;
+    }
+
+    auto AcceptGuard::validConnect(const ENetHost& host) const -> bool {
+        uint16_t peerId;
+        std::memcpy(&peerId, host.receivedData, sizeof(peerId));
+        peerId = ENET_NET_TO_HOST_16(peerId);
+
+        // The body of a compressed datagram cannot be read before ENet decompresses it.
+        if (peerId & ENET_PROTOCOL_HEADER_FLAG_COMPRESSED) {
+            return true;
+        }
+
+        size_t headerSize = (peerId & ENET_PROTOCOL_HEADER_FLAG_SENT_TIME) ? sizeof(ENetProtocolHeader) : offsetof(ENetProtocolHeader, sentTime);
+        if (host.checksum) {
+            headerSize += sizeof(enet_uint32);
+        }
+        if (host.receivedDataLength < headerSize + sizeof(ENetProtocolConnect)) {
+            return false;
+        }
+
+        ENetProtocolConnect connect;
+        std::memcpy(&connect, host.receivedData + headerSize, sizeof(connect));
+        if ((connect.header.command & ENET_PROTOCOL_COMMAND_MASK) != ENET_PROTOCOL_COMMAND_CONNECT) {
+            return false;
+        }
+
+        // enet_host_connect clamps all three into these ranges before sending.
+        auto channelCount = ENET_NET_TO_HOST_32(connect.channelCount);
+        auto mtu = ENET_NET_TO_HOST_32(connect.mtu);
+        auto windowSize = ENET_NET_TO_HOST_32(connect.windowSize);
+        return channelCount >= ENET_PROTOCOL_MINIMUM_CHANNEL_COUNT && channelCount <= ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT &&
+               mtu >= ENET_PROTOCOL_MINIMUM_MTU && mtu <= ENET_PROTOCOL_MAXIMUM_MTU &&
+               windowSize >= ENET_PROTOCOL_MINIMUM_WINDOW_SIZE && windowSize <= ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE;
+    }
+
+    auto AcceptGuard::bucketFor(uint32_t address) -> Bucket& {
+        // Fibonacci hashing; the high bits mix every octet of the address.
+        auto bits = std::countr_zero(addresses_.size());
+        auto index = static_cast<size_t>((static_cast<uint64_t>(address) * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+        auto& entry = addresses_[index];
+        if (!entry.used || entry.address != address) {
+            entry = AddressBucket{address, true, {}};
+        }
+        return entry.bucket;
+    }
+
+    auto AcceptGuard::Bucket::take(double rate, double burst, Timestamp now) -> bool {
+        if (updated == Timestamp{}) {
+            tokens = burst;
+        } else {
+            auto elapsed = std::chrono::duration<double>(now - updated).count();
+            tokens = std::min(burst, tokens + elapsed * rate);
+        }
+        updated = now;
+
+        if (tokens < 1.0) {
+            return false;
+        }
+        tokens -= 1.0;
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "icelander.hpp"
+#include "metrics.hpp"
+
+namespace icelander::detail {
+    // Screens connection attempts from ENet's intercept hook, before ENet commits a peer
+    // slot to them. CONNECT datagrams that no ENet client would send are dropped, and the
+    // rest must pass a per-address and then a host-wide token bucket. Datagrams for peers
+    // ENet already knows return after reading their header. Runs on the servicing thread.
+    class AcceptGuard {
+    public:
+        // nullptr when the config enforces nothing or the socket cannot be registered.
+        static auto install(ENetHost* host, const AcceptConfig& config) -> std::unique_ptr<AcceptGuard>;
+
+        ~AcceptGuard();
+
+        AcceptGuard(const AcceptGuard&) = delete;
+        AcceptGuard& operator=(const AcceptGuard&) = delete;
+
+        auto stats() const -> AcceptStats;
+
+    private:
+        struct Bucket {
+            double tokens = 0;
+            Timestamp updated{};
+
+            auto take(double rate, double burst, Timestamp now) -> bool;
+        };
+
+        struct AddressBucket {
+            uint32_t address = 0;
+            bool used = false;
+            Bucket bucket;
+        };
+
+        AcceptGuard(ENetHost* host, const AcceptConfig& config);
+
+        static int ENET_CALLBACK intercept(ENetHost* host, ENetEvent* event);
+        // False drops the datagram.
+        auto screen(const ENetHost& host) -> bool;
+        auto validConnect(const ENetHost& host) const -> bool;
+        auto bucketFor(uint32_t address) -> Bucket&;
+
+        ENetHost* host_;
+        AcceptConfig config_;
+        Bucket global_;
+        std::vector<AddressBucket> addresses_;
+        Counter accepted_;
+        Counter rateLimited_;
+        Counter malformed_;
+    };
+}
\ No newline at end of file
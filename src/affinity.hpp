@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace icelander::detail {
+    // Pins a running thread to one logical CPU. Returns false where unsupported.
+    inline auto pinThread(std::thread& thread, size_t cpu) -> bool {
+#ifdef _WIN32
+        if (cpu >= sizeof(DWORD_PTR) * 8) {
+            return false;
+        }
+        return SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+        if (cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+        (void)thread;
+        (void)cpu;
+        return false;
+#endif
+    }
+}
\ No newline at end of file
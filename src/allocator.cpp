@@ -0,0 +1,276 @@
+#include "allocator.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace icelander::detail {
+    namespace {
+        constexpr size_t SMALLEST_CLASS = 16;
+        constexpr size_t CLASS_COUNT = 13; // 16 B .. 64 KiB
+        constexpr size_t SLAB_BLOCKS = 32;
+        constexpr uint32_t OVERSIZED_CLASS = 0xFFFFFFFFu;
+
+        struct alignas(16) BlockHeader {
+            uint32_t sizeClass;
+        };
+
+        struct FreeNode {
+            FreeNode* next;
+        };
+
+        constexpr auto classSize(size_t sizeClass) -> size_t {
+            return SMALLEST_CLASS << sizeClass;
+        }
+
+        auto classFor(size_t size) -> size_t {
+            size_t sizeClass = 0;
+            while (classSize(sizeClass) < size) {
+                ++sizeClass;
+            }
+            return sizeClass;
+        }
+
+        struct alignas(64) CentralList {
+            std::mutex mutex;
+            FreeNode* head = nullptr;
+            size_t count = 0;
+        };
+
+        struct alignas(64) CacheCounters {
+            std::atomic<uint64_t> hits{0};
+            std::atomic<uint64_t> misses{0};
+            std::atomic<uint64_t> oversized{0};
+            std::atomic<uint64_t> frees{0};
+
+            // Only the owning thread writes, so a plain load/store avoids a locked RMW.
+            static void bump(std::atomic<uint64_t>& counter) {
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        };
+
+        struct ThreadCache;
+
+        struct Pool {
+            std::atomic<bool> enabled{false};
+            std::atomic<size_t> classLimit{0};
+            std::atomic<size_t> threadCacheLimit{0};
+            std::atomic<uint64_t> bytesReserved{0};
+            CentralList central[CLASS_COUNT];
+
+            std::mutex cachesMutex;
+            std::vector<ThreadCache*> caches;
+            AllocatorStats retired;
+        };
+
+        // Leaked on purpose: ENet may free blocks during static destruction.
+        auto pool() -> Pool& {
+            static Pool* instance = new Pool();
+            return *instance;
+        }
+
+        // Trivially destructible, so it stays readable after the cache itself is destroyed.
+        thread_local bool cacheDestroyed = false;
+
+        struct ThreadCache {
+            FreeNode* heads[CLASS_COUNT] = {};
+            size_t counts[CLASS_COUNT] = {};
+            CacheCounters counters;
+
+            ThreadCache() {
+                auto& shared = pool();
+                std::lock_guard<std::mutex> lock(shared.cachesMutex);
+                shared.caches.push_back(this);
+            }
+
+            ~ThreadCache() {
+                cacheDestroyed = true;
+                auto& shared = pool();
+                for (size_t sizeClass = 0; sizeClass < CLASS_COUNT; ++sizeClass) {
+                    release(sizeClass, counts[sizeClass]);
+                }
+
+                std::lock_guard<std::mutex> lock(shared.cachesMutex);
+                shared.retired.hits += counters.hits.load(std::memory_order_relaxed);
+                shared.retired.misses += counters.misses.load(std::memory_order_relaxed);
+                shared.retired.oversized += counters.oversized.load(std::memory_order_relaxed);
+                shared.retired.frees += counters.frees.load(std::memory_order_relaxed);
+                std::erase(shared.caches, this);
+            }
+
+            // Moves `count` cached blocks of a class back to the shared free list.
+            void release(size_t sizeClass, size_t count) {
+                if (count == 0) {
+                    return;
+                }
+
+                FreeNode* first = heads[sizeClass];
+                FreeNode* last = first;
+                for (size_t i = 1; i < count; ++i) {
+                    last = last->next;
+                }
+                heads[sizeClass] = last->next;
+                counts[sizeClass] -= count;
+
+                auto& list = pool().central[sizeClass];
+                std::lock_guard<std::mutex> lock(list.mutex);
+                last->next = list.head;
+                list.head = first;
+                list.count += count;
+            }
+
+            enum class Refill { failed, shared, slab };
+
+            // Refills from the shared list, carving a fresh slab only when that is empty too.
+            auto refill(size_t sizeClass) -> Refill {
+                auto& list = pool().central[sizeClass];
+                {
+                    std::lock_guard<std::mutex> lock(list.mutex);
+                    size_t take = list.count < SLAB_BLOCKS ? list.count : SLAB_BLOCKS;
+                    for (size_t i = 0; i < take; ++i) {
+                        FreeNode* node = list.head;
+                        list.head = node->next;
+                        node->next = heads[sizeClass];
+                        heads[sizeClass] = node;
+                    }
+                    list.count -= take;
+                    counts[sizeClass] += take;
+                    if (take > 0) {
+                        return Refill::shared;
+                    }
+                }
+
+                size_t blockSize = sizeof(BlockHeader) + classSize(sizeClass);
+                auto slab = static_cast<uint8_t*>(std::malloc(blockSize * SLAB_BLOCKS));
+                if (!slab) {
+                    return Refill::failed;
+                }
+                pool().bytesReserved.fetch_add(blockSize * SLAB_BLOCKS, std::memory_order_relaxed);
+
+                for (size_t i = 0; i < SLAB_BLOCKS; ++i) {
+                    auto header = reinterpret_cast<BlockHeader*>(slab + i * blockSize);
+                    header->sizeClass = static_cast<uint32_t>(sizeClass);
+
+                    auto node = reinterpret_cast<FreeNode*>(header + 1);
+                    node->next = heads[sizeClass];
+                    heads[sizeClass] = node;
+                }
+                counts[sizeClass] += SLAB_BLOCKS;
+                return Refill::slab;
+            }
+        };
+
+        // nullptr once this thread's cache is gone, e.g. for blocks freed by thread_local
+        // destructors that run after it.
+        auto threadCache() -> ThreadCache* {
+            if (cacheDestroyed) {
+                return nullptr;
+            }
+            thread_local ThreadCache cache;
+            return &cache;
+        }
+
+        void releaseToCentral(size_t sizeClass, FreeNode* node) {
+            auto& list = pool().central[sizeClass];
+            std::lock_guard<std::mutex> lock(list.mutex);
+            node->next = list.head;
+            list.head = node;
+            ++list.count;
+        }
+
+        auto allocateOversized(size_t size) -> void* {
+            auto header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+            if (!header) {
+                return nullptr;
+            }
+            header->sizeClass = OVERSIZED_CLASS;
+            return header + 1;
+        }
+    }
+
+    void configurePool(const AllocatorConfig& config) {
+        auto& shared = pool();
+        size_t limit = config.maxPooledSize < classSize(CLASS_COUNT - 1) ? config.maxPooledSize : classSize(CLASS_COUNT - 1);
+
+        shared.classLimit.store(config.enablePooling && limit > 0 ? classFor(limit) + 1 : 0, std::memory_order_relaxed);
+        shared.threadCacheLimit.store(config.threadCacheLimit, std::memory_order_relaxed);
+        shared.enabled.store(config.enablePooling, std::memory_order_release);
+    }
+
+    auto poolAllocate(size_t size) -> void* {
+        auto& shared = pool();
+        if (!shared.enabled.load(std::memory_order_acquire)) {
+            return allocateOversized(size);
+        }
+
+        auto cache = threadCache();
+        if (!cache) {
+            return allocateOversized(size);
+        }
+
+        size_t sizeClass = classFor(size > 0 ? size : 1);
+        if (sizeClass >= shared.classLimit.load(std::memory_order_relaxed)) {
+            CacheCounters::bump(cache->counters.oversized);
+            return allocateOversized(size);
+        }
+
+        if (!cache->heads[sizeClass]) {
+            auto refilled = cache->refill(sizeClass);
+            if (refilled == ThreadCache::Refill::failed) {
+                return nullptr;
+            }
+            CacheCounters::bump(refilled == ThreadCache::Refill::shared ? cache->counters.hits : cache->counters.misses);
+        } else {
+            CacheCounters::bump(cache->counters.hits);
+        }
+
+        FreeNode* node = cache->heads[sizeClass];
+        cache->heads[sizeClass] = node->next;
+        --cache->counts[sizeClass];
+        return node;
+    }
+
+    void poolFree(void* memory) noexcept {
+        if (!memory) {
+            return;
+        }
+
+        auto header = static_cast<BlockHeader*>(memory) - 1;
+        if (header->sizeClass == OVERSIZED_CLASS) {
+            std::free(header);
+            return;
+        }
+
+        // Pooled blocks always go back to a free list, even if pooling was since disabled.
+        size_t sizeClass = header->sizeClass;
+        auto node = static_cast<FreeNode*>(memory);
+        auto cache = threadCache();
+        if (!cache) {
+            releaseToCentral(sizeClass, node);
+            return;
+        }
+
+        node->next = cache->heads[sizeClass];
+        cache->heads[sizeClass] = node;
+        ++cache->counts[sizeClass];
+        CacheCounters::bump(cache->counters.frees);
+
+        size_t limit = pool().threadCacheLimit.load(std::memory_order_relaxed);
+        if (cache->counts[sizeClass] > limit) {
+            cache->release(sizeClass, cache->counts[sizeClass] - limit / 2);
+        }
+    }
+
+    auto poolStats() -> AllocatorStats {
+        auto& shared = pool();
+        std::lock_guard<std::mutex> lock(shared.cachesMutex);
+
+        AllocatorStats stats = shared.retired;
+        for (const auto* cache : shared.caches) {
+            stats.hits += cache->counters.hits.load(std::memory_order_relaxed);
+            stats.misses += cache->counters.misses.load(std::memory_order_relaxed);
+            stats.oversized += cache->counters.oversized.load(std::memory_order_relaxed);
+            stats.frees += cache->counters.frees.load(std::memory_order_relaxed);
+        }
+        stats.bytesReserved = shared.bytesReserved.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
\ No newline at end of file
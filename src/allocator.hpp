@@ -0,0 +1,13 @@
+#pragma once
+
+#include "icelander.hpp"
+
+namespace icelander::detail {
+    // Size-classed, thread-cached block allocator behind Library::initialize(AllocatorConfig).
+    // Every block carries a small header, so poolFree() works whether or not pooling was
+    // enabled when the block was allocated.
+    void configurePool(const AllocatorConfig& config);
+    auto poolAllocate(size_t size) -> void*;
+    void poolFree(void* memory) noexcept;
+    auto poolStats() -> AllocatorStats;
+}
\ No newline at end of file
@@ -1,78 +1,404 @@
 #include "icelander.hpp"
+#include "affinity.hpp"
+#include "allocator.hpp"
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
+#include "work_deque.hpp"
+#include <algorithm>
+#include <queue>
 #include <stdexcept>
 
 namespace icelander {
+    namespace {
+        // One thread parks every sleeping coroutine and hands it back when due.
+        class TimerQueue {
+        public:
+            static auto instance() -> TimerQueue& {
+                static TimerQueue queue;
+                return queue;
+            }
+
+            ~TimerQueue() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                cv_.notify_all();
+                if (thread_.joinable()) {
+                    thread_.join();
+                }
+            }
+
+            void add(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!thread_.joinable()) {
+                        thread_ = std::thread(&TimerQueue::run, this);
+                    }
+                    timers_.push(Timer{deadline, handle});
+                }
+                cv_.notify_one();
+            }
+
+        private:
+            struct Timer {
+                std::chrono::steady_clock::time_point deadline;
+                std::coroutine_handle<> handle;
+
+                auto operator>(const Timer& other) const -> bool { return deadline > other.deadline; }
+            };
+
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stopping_) {
+                    if (timers_.empty()) {
+                        cv_.wait(lock);
+                        continue;
+                    }
+
+                    auto next = timers_.top();
+                    if (std::chrono::steady_clock::now() < next.deadline) {
+                        cv_.wait_until(lock, next.deadline);
+                        continue;
+                    }
+
+                    timers_.pop();
+                    lock.unlock();
+                    detail::resumeLater(next.handle);
+                    lock.lock();
+                }
+            }
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+            std::thread thread_;
+            bool stopping_ = false;
+        };
+    }
+
+    namespace detail {
+        auto allocateFrame(size_t size) -> void* {
+            auto memory = poolAllocate(size);
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+            return memory;
+        }
+
+        void freeFrame(void* frame) noexcept {
+            poolFree(frame);
+        }
+
+        void resumeLater(std::coroutine_handle<> handle) {
+            auto& scheduler = async::TaskScheduler::instance();
+            if (scheduler.isRunning()) {
+                scheduler.schedule([handle] { handle.resume(); });
+            } else {
+                handle.resume();
+            }
+        }
+
+        void resumeAt(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle) {
+            TimerQueue::instance().add(deadline, handle);
+        }
+    }
+
     namespace async {
+        namespace {
+            constexpr size_t IDLE_SPINS = 64;
+
+            struct WorkerContext {
+                const TaskScheduler* scheduler = nullptr;
+                size_t index = 0;
+            };
+
+            thread_local WorkerContext currentWorker;
+
+            auto nextVictim(size_t bound) -> size_t {
+                thread_local uint32_t state = static_cast<uint32_t>(
+                    std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return state % bound;
+            }
+        }
+
+        struct TaskScheduler::Worker {
+            detail::WorkDeque<TaskNode> deque;
+            detail::MpscQueue<TaskNode> inbox;
+            std::atomic<bool> inboxClaimed{false};  // the inbox has one consumer at a time
+            std::thread thread;
+
+            // Written only by this worker's thread.
+            detail::Counter executed;
+            detail::Counter stolen;
+            detail::Counter parks;
+
+            auto popInbox() -> TaskNode* {
+                if (inboxClaimed.exchange(true, std::memory_order_acquire)) {
+                    return nullptr;
+                }
+                auto task = inbox.pop();
+                inboxClaimed.store(false, std::memory_order_release);
+                return task;
+            }
+        };
+
+        auto TaskNode::allocate() -> TaskNode* {
+            auto memory = detail::poolAllocate(sizeof(TaskNode));
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+            return new (memory) TaskNode();
+        }
+
+        void TaskNode::release(TaskNode* node) noexcept {
+            node->~TaskNode();
+            detail::poolFree(node);
+        }
+
+        void TaskNode::run(TaskNode* node) {
+            struct Cleanup {
+                TaskNode* node;
+                ~Cleanup() { discard(node); }
+            } cleanup{node};
+
+            node->invoke_(*node);
+        }
+
+        void TaskNode::discard(TaskNode* node) noexcept {
+            if (node->destroy_) {
+                node->destroy_(*node);
+            }
+            release(node);
+        }
+
         auto TaskScheduler::instance() -> TaskScheduler& {
             static TaskScheduler instance;
             return instance;
         }
 
-        void TaskScheduler::schedule(std::function<void()> task) {
-            {
-                std::lock_guard<std::mutex> lock(queueMutex_);
-                taskQueue_.push(std::move(task));
+        TaskScheduler::~TaskScheduler() {
+            stop();
+            for (auto task : backlog_) {
+                TaskNode::discard(task);
+            }
+        }
+
+        void TaskScheduler::submit(TaskNode* task) {
+            if (currentWorker.scheduler == this) {
+                queued_.fetch_add(1);
+                workers_[currentWorker.index]->deque.push(task);
+                wakeOne();
+                return;
+            }
+
+            while (true) {
+                // stop() waits for submitting_ to reach zero before retiring the workers.
+                submitting_.fetch_add(1);
+                if (accepting_.load()) {
+                    queued_.fetch_add(1);
+                    auto index = nextInbox_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+                    workers_[index]->inbox.push(task);
+                    submitting_.fetch_sub(1);
+                    wakeOne();
+                    return;
+                }
+                submitting_.fetch_sub(1);
+
+                std::lock_guard<std::mutex> lock(backlogMutex_);
+                if (!accepting_.load()) {
+                    backlog_.push_back(task);
+                    return;
+                }
             }
-            queueCv_.notify_one();
         }
 
         void TaskScheduler::start() {
+            start(SchedulerConfig{});
+        }
+
+        void TaskScheduler::start(const SchedulerConfig& config) {
+            std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
             if (running_) {
                 return;
             }
 
-            running_ = true;
+            auto cpuCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            size_t threadCount = config.threadCount ? config.threadCount : cpuCount;
 
-            auto hwThreads = std::thread::hardware_concurrency();
-            size_t threadCount = hwThreads > 1 ? hwThreads : 1;
-            workerThreads_.reserve(threadCount);
+            workers_.clear();
+            workers_.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; ++i) {
+                workers_.push_back(std::make_unique<Worker>());
+            }
+
+            std::lock_guard<std::mutex> lock(backlogMutex_);
+            // Queue the backlog before any worker can look at its inbox.
+            for (size_t i = 0; i < backlog_.size(); ++i) {
+                workers_[i % threadCount]->inbox.push(backlog_[i]);
+            }
+            queued_.fetch_add(backlog_.size());
+            backlog_.clear();
 
+            running_ = true;
             for (size_t i = 0; i < threadCount; ++i) {
-                workerThreads_.emplace_back(std::make_unique<std::thread>(&TaskScheduler::workerLoop, this));
+                auto& worker = *workers_[i];
+                worker.thread = std::thread(&TaskScheduler::workerLoop, this, i);
+                if (config.pinThreads) {
+                    detail::pinThread(worker.thread, (config.firstCpu + i) % cpuCount);
+                }
             }
+            workerCount_ = threadCount;
+            accepting_ = true;
         }
 
         void TaskScheduler::stop() {
+            std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
             if (!running_) {
                 return;
             }
 
-            running_ = false;
-            queueCv_.notify_all();
+            {
+                std::lock_guard<std::mutex> lock(backlogMutex_);
+                accepting_ = false;
+            }
+            while (submitting_.load() != 0) {
+                std::this_thread::yield();
+            }
+
+            {
+                std::lock_guard<std::mutex> parkLock(parkMutex_);
+                running_ = false;
+            }
+            parkCv_.notify_all();
 
-            for (auto& thread : workerThreads_) {
-                if (thread && thread->joinable()) {
-                    thread->join();
+            for (auto& worker : workers_) {
+                if (worker->thread.joinable()) {
+                    worker->thread.join();
                 }
             }
-            workerThreads_.clear();
+            workers_.clear();
+            workerCount_ = 0;
         }
 
         bool TaskScheduler::isRunning() const {
             return running_;
         }
 
-        void TaskScheduler::workerLoop() {
-            while (running_) {
-                std::function<void()> task;
-                {
-                    std::unique_lock<std::mutex> lock(queueMutex_);
-                    queueCv_.wait(lock, [this] { return !taskQueue_.empty() || !running_; });
+        auto TaskScheduler::workerCount() const -> size_t {
+            return workerCount_.load();
+        }
 
-                    if (!running_) {
-                        break;
-                    }
+        auto TaskScheduler::pendingTasks() const -> size_t {
+            std::lock_guard<std::mutex> lock(backlogMutex_);
+            return queued_.load() + backlog_.size();
+        }
+
+        auto TaskScheduler::metrics() const -> SchedulerMetrics {
+            SchedulerMetrics result;
+            result.pendingTasks = pendingTasks();
 
-                    if (!taskQueue_.empty()) {
-                        task = std::move(taskQueue_.front());
-                        taskQueue_.pop();
+            std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+            result.workers = workers_.size();
+            for (const auto& worker : workers_) {
+                result.tasksExecuted += worker->executed.load();
+                result.tasksStolen += worker->stolen.load();
+                result.parks += worker->parks.load();
+            }
+            return result;
+        }
+
+        void TaskScheduler::workerLoop(size_t index) {
+            currentWorker = WorkerContext{this, index};
+            auto& self = *workers_[index];
+            size_t idleRounds = 0;
+
+            while (true) {
+                if (auto task = findTask(index)) {
+                    TaskNode::run(task);
+                    if constexpr (METRICS_ENABLED) {
+                        self.executed.add();
                     }
+                    idleRounds = 0;
+                    continue;
+                }
+
+                // Submissions are closed once running_ is false, so an empty count is final.
+                if (!running_.load() && queued_.load() == 0) {
+                    break;
+                }
+
+                if (++idleRounds < IDLE_SPINS) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                if constexpr (METRICS_ENABLED) {
+                    self.parks.add();
+                }
+                park();
+                idleRounds = 0;
+            }
+
+            currentWorker = WorkerContext{};
+        }
+
+        auto TaskScheduler::findTask(size_t index) -> TaskNode* {
+            auto& self = *workers_[index];
+
+            auto task = self.deque.pop();
+            if (!task) {
+                // Move the inbox onto the deque so idle workers can steal from it.
+                while (auto incoming = self.popInbox()) {
+                    self.deque.push(incoming);
                 }
+                task = self.deque.pop();
+            }
 
-                if (task) {
-                    task();
+            if (!task && workers_.size() > 1) {
+                size_t start = nextVictim(workers_.size());
+                for (size_t i = 0; i < workers_.size() && !task; ++i) {
+                    size_t victim = (start + i) % workers_.size();
+                    if (victim != index) {
+                        task = workers_[victim]->deque.steal();
+                    }
+                }
+                // A busy worker may not get to its inbox for a while.
+                for (size_t i = 0; i < workers_.size() && !task; ++i) {
+                    size_t victim = (start + i) % workers_.size();
+                    if (victim != index) {
+                        task = workers_[victim]->popInbox();
+                    }
+                }
+                if constexpr (METRICS_ENABLED) {
+                    if (task) {
+                        self.stolen.add();
+                    }
                 }
             }
+
+            if (task) {
+                queued_.fetch_sub(1);
+            }
+            return task;
+        }
+
+        void TaskScheduler::park() {
+            std::unique_lock<std::mutex> lock(parkMutex_);
+            sleepers_.fetch_add(1);
+            parkCv_.wait(lock, [this] { return queued_.load() > 0 || !running_.load(); });
+            sleepers_.fetch_sub(1);
+        }
+
+        void TaskScheduler::wakeOne() {
+            // Pairs with park(): queued_ is raised before sleepers_ is read.
+            if (sleepers_.load() > 0) {
+                std::lock_guard<std::mutex> lock(parkMutex_);
+                parkCv_.notify_one();
+            }
         }
 
         auto sleepMs(int milliseconds) -> void {
@@ -0,0 +1,39 @@
+#include "batched_socket.hpp"
+
+#ifdef ICELANDER_HAVE_BATCHED_IO
+// Linked into an executable through IcelanderBatchedIO, which also adds -Wl,--wrap for
+// these three symbols. ENet's protocol code then calls these, and the originals stay
+// reachable as __real_*.
+extern "C" {
+    int __real_enet_socket_receive(ENetSocket, ENetAddress*, ENetBuffer*, size_t);
+    int __real_enet_socket_send(ENetSocket, const ENetAddress*, const ENetBuffer*, size_t);
+    int __real_enet_socket_wait(ENetSocket, enet_uint32*, enet_uint32);
+
+    int __wrap_enet_socket_receive(ENetSocket socket, ENetAddress* address, ENetBuffer* buffers, size_t bufferCount) {
+        if (auto batched = icelander::detail::BatchedSocket::find(socket)) {
+            return batched->receive(address, buffers, bufferCount);
+        }
+        return __real_enet_socket_receive(socket, address, buffers, bufferCount);
+    }
+
+    int __wrap_enet_socket_send(ENetSocket socket, const ENetAddress* address, const ENetBuffer* buffers, size_t bufferCount) {
+        if (auto batched = icelander::detail::BatchedSocket::find(socket)) {
+            return batched->send(address, buffers, bufferCount);
+        }
+        return __real_enet_socket_send(socket, address, buffers, bufferCount);
+    }
+
+    // ENet waits after sending; queued datagrams must leave first, and datagrams already
+    // in the ring count as readable.
+    int __wrap_enet_socket_wait(ENetSocket socket, enet_uint32* condition, enet_uint32 timeout) {
+        if (auto batched = icelander::detail::BatchedSocket::find(socket)) {
+            batched->flush();
+            if ((*condition & ENET_SOCKET_WAIT_RECEIVE) && batched->pending()) {
+                *condition = ENET_SOCKET_WAIT_RECEIVE;
+                return 0;
+            }
+        }
+        return __real_enet_socket_wait(socket, condition, timeout);
+    }
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "batched_socket.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef ICELANDER_HAVE_BATCHED_IO
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+#ifdef ICELANDER_HAVE_BATCHED_IO
+// Defined in batched_io_wrap.cpp, which is linked only into executables that opt in to
+// the --wrap options; without it ENet's calls never reach this backend.
+extern "C" __attribute__((weak)) int __wrap_enet_socket_send(ENetSocket, const ENetAddress*, const ENetBuffer*, size_t);
+#endif
+
+namespace icelander::detail {
+#ifdef ICELANDER_HAVE_BATCHED_IO
+    namespace {
+        // Sockets at or above this descriptor stay on ENet's own calls.
+        constexpr size_t MAX_SOCKETS = 4096;
+        constexpr size_t MAX_GSO_SEGMENTS = 64;
+        constexpr size_t MAX_GSO_BYTES = 65507;
+        constexpr size_t GRO_SLOT_SIZE = 65536;
+        constexpr size_t MAX_DATAGRAM = ENET_PROTOCOL_MAXIMUM_MTU;
+
+        std::array<std::atomic<BatchedSocket*>, MAX_SOCKETS> sockets{};
+
+        auto toSockaddr(const ENetAddress& address) -> sockaddr_in {
+            sockaddr_in result{};
+            result.sin_family = AF_INET;
+            result.sin_port = htons(address.port);
+            result.sin_addr.s_addr = address.host;
+            return result;
+        }
+
+        auto sameAddress(const sockaddr_in& a, const sockaddr_in& b) -> bool {
+            return a.sin_port == b.sin_port && a.sin_addr.s_addr == b.sin_addr.s_addr;
+        }
+    }
+
+    struct BatchedSocket::Rings {
+        struct Datagram {
+            const uint8_t* data = nullptr;
+            size_t length = 0;
+            sockaddr_in address{};
+            bool truncated = false;
+        };
+
+        // UDP_SEGMENT takes a uint16_t, UDP_GRO reports an int.
+        union Control {
+            char buffer[CMSG_SPACE(sizeof(int))];
+            cmsghdr align;
+        };
+
+        size_t batch = 0;
+        bool gso = false;
+        bool gro = false;
+
+        // Receive side: one slot per recvmmsg entry, split into datagrams after GRO.
+        size_t receiveSlotSize = 0;
+        std::vector<uint8_t> receiveBuffer;
+        std::vector<mmsghdr> receiveHeaders;
+        std::vector<iovec> receiveVectors;
+        std::vector<sockaddr_in> receiveAddresses;
+        std::vector<Control> receiveControls;
+        std::vector<Datagram> received;
+        size_t nextReceived = 0;
+
+        // Send side: one slot per queued datagram; runs to the same peer share a header.
+        std::vector<uint8_t> sendBuffer;
+        std::vector<iovec> sendVectors;
+        std::vector<sockaddr_in> sendAddresses;
+        std::vector<mmsghdr> sendHeaders;
+        std::vector<Control> sendControls;
+        size_t queued = 0;
+
+        // Drops the datagrams before first and moves the rest to the front of the ring.
+        auto keepFrom(size_t first) -> void {
+            if (first == 0) {
+                return;
+            }
+            size_t count = queued - first;
+            for (size_t i = 0; i < count; ++i) {
+                auto slot = sendBuffer.data() + i * MAX_DATAGRAM;
+                std::memcpy(slot, sendVectors[first + i].iov_base, sendVectors[first + i].iov_len);
+                sendVectors[i] = iovec{slot, sendVectors[first + i].iov_len};
+                sendAddresses[i] = sendAddresses[first + i];
+            }
+            queued = count;
+        }
+    };
+
+    auto BatchedSocket::supported() -> bool {
+        return &__wrap_enet_socket_send != nullptr;
+    }
+
+    auto BatchedSocket::create(ENetSocket socket, const HostConfig& config) -> std::unique_ptr<BatchedSocket> {
+        if (config.socketBackend != SocketBackend::batched || !supported() || socket < 0 ||
+            static_cast<size_t>(socket) >= MAX_SOCKETS || sockets[static_cast<size_t>(socket)].load()) {
+            return nullptr;
+        }
+
+        auto rings = std::make_unique<Rings>();
+        rings->batch = std::clamp<size_t>(config.socketBatchSize, 1, 1024);
+
+        if (config.udpOffload) {
+            int segment = 0;
+            socklen_t length = sizeof(segment);
+            rings->gso = getsockopt(socket, SOL_UDP, UDP_SEGMENT, &segment, &length) == 0;
+            int enable = 1;
+            rings->gro = setsockopt(socket, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == 0;
+        }
+
+        size_t batch = rings->batch;
+        rings->receiveSlotSize = rings->gro ? GRO_SLOT_SIZE : MAX_DATAGRAM;
+        rings->receiveBuffer.resize(batch * rings->receiveSlotSize);
+        rings->receiveHeaders.resize(batch);
+        rings->receiveVectors.resize(batch);
+        rings->receiveAddresses.resize(batch);
+        rings->receiveControls.resize(batch);
+        // GRO can split one slot into this many datagrams.
+        rings->received.reserve(rings->gro ? batch * MAX_GSO_SEGMENTS : batch);
+
+        rings->sendBuffer.resize(batch * MAX_DATAGRAM);
+        rings->sendVectors.resize(batch);
+        rings->sendAddresses.resize(batch);
+        rings->sendHeaders.resize(batch);
+        rings->sendControls.resize(batch);
+
+        auto batched = std::unique_ptr<BatchedSocket>(new BatchedSocket(socket, std::move(rings)));
+        sockets[static_cast<size_t>(socket)].store(batched.get(), std::memory_order_release);
+        return batched;
+    }
+
+    auto BatchedSocket::find(ENetSocket socket) -> BatchedSocket* {
+        if (socket < 0 || static_cast<size_t>(socket) >= MAX_SOCKETS) {
+            return nullptr;
+        }
+        return sockets[static_cast<size_t>(socket)].load(std::memory_order_acquire);
+    }
+
+    BatchedSocket::BatchedSocket(ENetSocket socket, std::unique_ptr<Rings> rings)
+        : socket_(socket), rings_(std::move(rings)) {}
+
+    BatchedSocket::~BatchedSocket() {
+        flush();
+        sockets[static_cast<size_t>(socket_)].store(nullptr, std::memory_order_release);
+    }
+
+    auto BatchedSocket::pending() const -> bool {
+        return rings_->nextReceived < rings_->received.size();
+    }
+
+    auto BatchedSocket::refill() -> int {
+        auto& rings = *rings_;
+        rings.received.clear();
+        rings.nextReceived = 0;
+
+        for (size_t i = 0; i < rings.batch; ++i) {
+            auto& vector = rings.receiveVectors[i];
+            vector.iov_base = rings.receiveBuffer.data() + i * rings.receiveSlotSize;
+            vector.iov_len = rings.receiveSlotSize;
+
+            auto& header = rings.receiveHeaders[i].msg_hdr;
+            header = msghdr{};
+            header.msg_name = &rings.receiveAddresses[i];
+            header.msg_namelen = sizeof(sockaddr_in);
+            header.msg_iov = &vector;
+            header.msg_iovlen = 1;
+            if (rings.gro) {
+                header.msg_control = rings.receiveControls[i].buffer;
+                header.msg_controllen = sizeof(rings.receiveControls[i].buffer);
+            }
+        }
+
+        int count = recvmmsg(socket_, rings.receiveHeaders.data(), static_cast<unsigned>(rings.batch), MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            return errno == EWOULDBLOCK || errno == EAGAIN ? 0 : -1;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            auto& message = rings.receiveHeaders[i];
+            auto data = static_cast<const uint8_t*>(rings.receiveVectors[i].iov_base);
+            size_t length = message.msg_len;
+
+            size_t segment = length;
+            for (auto control = CMSG_FIRSTHDR(&message.msg_hdr); control; control = CMSG_NXTHDR(&message.msg_hdr, control)) {
+                if (control->cmsg_level == SOL_UDP && control->cmsg_type == UDP_GRO) {
+                    int groSize;
+                    std::memcpy(&groSize, CMSG_DATA(control), sizeof(groSize));
+                    segment = groSize > 0 ? static_cast<size_t>(groSize) : length;
+                }
+            }
+
+            bool truncated = (message.msg_hdr.msg_flags & MSG_TRUNC) != 0;
+            size_t offset = 0;
+            do {
+                Rings::Datagram datagram;
+                datagram.data = data + offset;
+                datagram.length = std::min(segment, length - offset);
+                datagram.address = rings.receiveAddresses[i];
+                datagram.truncated = truncated;
+                rings.received.push_back(datagram);
+                offset += segment;
+            } while (offset < length);
+        }
+        return count;
+    }
+
+    auto BatchedSocket::receive(ENetAddress* address, ENetBuffer* buffers, size_t bufferCount) -> int {
+        auto& rings = *rings_;
+        if (!pending()) {
+            int result = refill();
+            if (result <= 0) {
+                return result;
+            }
+        }
+
+        const auto& datagram = rings.received[rings.nextReceived++];
+        if (address) {
+            address->host = datagram.address.sin_addr.s_addr;
+            address->port = ntohs(datagram.address.sin_port);
+        }
+        if (datagram.truncated) {
+            return -2;
+        }
+
+        size_t copied = 0;
+        for (size_t i = 0; i < bufferCount && copied < datagram.length; ++i) {
+            size_t length = std::min(buffers[i].dataLength, datagram.length - copied);
+            std::memcpy(buffers[i].data, datagram.data + copied, length);
+            copied += length;
+        }
+        // Too big for ENet's buffers counts as truncated, as with recvmsg.
+        return copied < datagram.length ? -2 : static_cast<int>(copied);
+    }
+
+    auto BatchedSocket::send(const ENetAddress* address, const ENetBuffer* buffers, size_t bufferCount) -> int {
+        auto& rings = *rings_;
+        size_t total = 0;
+        for (size_t i = 0; i < bufferCount; ++i) {
+            total += buffers[i].dataLength;
+        }
+        if (total > MAX_DATAGRAM || !address) {
+            flush();
+            msghdr header{};
+            sockaddr_in destination{};
+            if (address) {
+                destination = toSockaddr(*address);
+                header.msg_name = &destination;
+                header.msg_namelen = sizeof(destination);
+            }
+            header.msg_iov = reinterpret_cast<iovec*>(const_cast<ENetBuffer*>(buffers));
+            header.msg_iovlen = bufferCount;
+            auto sent = sendmsg(socket_, &header, MSG_NOSIGNAL);
+            if (sent < 0) {
+                return errno == EWOULDBLOCK || errno == EAGAIN ? 0 : -1;
+            }
+            return static_cast<int>(sent);
+        }
+
+        if (rings.queued == rings.batch) {
+            flush();
+            // Still full: the socket buffer is too, so this one is dropped like a lost datagram.
+            if (rings.queued == rings.batch) {
+                return 0;
+            }
+        }
+
+        // ENet reuses its buffers as soon as this returns, so the datagram is copied.
+        auto slot = rings.sendBuffer.data() + rings.queued * MAX_DATAGRAM;
+        size_t offset = 0;
+        for (size_t i = 0; i < bufferCount; ++i) {
+            std::memcpy(slot + offset, buffers[i].data, buffers[i].dataLength);
+            offset += buffers[i].dataLength;
+        }
+        rings.sendVectors[rings.queued] = iovec{slot, total};
+        rings.sendAddresses[rings.queued] = toSockaddr(*address);
+        ++rings.queued;
+        return static_cast<int>(total);
+    }
+
+    auto BatchedSocket::flush() -> void {
+        auto& rings = *rings_;
+        if (rings.queued == 0) {
+            return;
+        }
+
+        // GSO needs equal-sized segments to one destination; only the last may be shorter.
+        size_t messages = 0;
+        for (size_t first = 0; first < rings.queued;) {
+            size_t segment = rings.sendVectors[first].iov_len;
+            size_t last = first + 1;
+            size_t bytes = segment;
+            if (rings.gso) {
+                while (last < rings.queued && last - first < MAX_GSO_SEGMENTS &&
+                       rings.sendVectors[last - 1].iov_len == segment &&
+                       rings.sendVectors[last].iov_len <= segment &&
+                       bytes + rings.sendVectors[last].iov_len <= MAX_GSO_BYTES &&
+                       sameAddress(rings.sendAddresses[last], rings.sendAddresses[first])) {
+                    bytes += rings.sendVectors[last].iov_len;
+                    ++last;
+                }
+            }
+
+            auto& header = rings.sendHeaders[messages].msg_hdr;
+            header = msghdr{};
+            header.msg_name = &rings.sendAddresses[first];
+            header.msg_namelen = sizeof(sockaddr_in);
+            header.msg_iov = &rings.sendVectors[first];
+            header.msg_iovlen = last - first;
+            if (last - first > 1) {
+                auto& control = rings.sendControls[messages];
+                header.msg_control = control.buffer;
+                header.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                auto message = CMSG_FIRSTHDR(&header);
+                message->cmsg_level = SOL_UDP;
+                message->cmsg_type = UDP_SEGMENT;
+                message->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                auto segmentSize = static_cast<uint16_t>(segment);
+                std::memcpy(CMSG_DATA(message), &segmentSize, sizeof(segmentSize));
+            }
+            ++messages;
+            first = last;
+        }
+
+        // First queued datagram of a message; merged messages cover several.
+        auto unsentFrom = [&rings](size_t message) {
+            return static_cast<size_t>(rings.sendHeaders[message].msg_hdr.msg_iov - rings.sendVectors.data());
+        };
+
+        size_t sent = 0;
+        while (sent < messages) {
+            int result = sendmmsg(socket_, rings.sendHeaders.data() + sent, static_cast<unsigned>(messages - sent), MSG_NOSIGNAL);
+            if (result > 0) {
+                sent += static_cast<size_t>(result);
+                continue;
+            }
+            if (errno == EIO && rings.gso && rings.sendHeaders[sent].msg_hdr.msg_iovlen > 1) {
+                // The device cannot segment; send the rest as plain datagrams from now on.
+                rings.gso = false;
+                rings.keepFrom(unsentFrom(sent));
+                flush();
+                return;
+            }
+            // The socket buffer is full; the rest goes out on the next flush.
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                rings.keepFrom(unsentFrom(sent));
+                return;
+            }
+            // UDP gives no delivery guarantee; ENet resends reliable data on its own.
+            ++sent;
+        }
+        rings.queued = 0;
+    }
+#else
+    struct BatchedSocket::Rings {};
+
+    auto BatchedSocket::supported() -> bool {
+        return false;
+    }
+
+    auto BatchedSocket::create(ENetSocket, const HostConfig&) -> std::unique_ptr<BatchedSocket> {
+        return nullptr;
+    }
+
+    auto BatchedSocket::find(ENetSocket) -> BatchedSocket* {
+        return nullptr;
+    }
+
+    BatchedSocket::BatchedSocket(ENetSocket socket, std::unique_ptr<Rings> rings)
+        : socket_(socket), rings_(std::move(rings)) {}
+
+    BatchedSocket::~BatchedSocket() = default;
+
+    auto BatchedSocket::receive(ENetAddress*, ENetBuffer*, size_t) -> int {
+        return -1;
+    }
+
+    auto BatchedSocket::send(const ENetAddress*, const ENetBuffer*, size_t) -> int {
+        return -1;
+    }
+
+    auto BatchedSocket::flush() -> void {}
+
+    auto BatchedSocket::pending() const -> bool {
+        return false;
+    }
+
+    auto BatchedSocket::refill() -> int {
+        return -1;
+    }
+#endif
+}
\ No newline at end of file
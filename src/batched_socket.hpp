@@ -0,0 +1,44 @@
+#pragma once
+
+#include "icelander.hpp"
+
+namespace icelander::detail {
+    // Batched replacement for ENet's per-datagram socket calls on one host socket.
+    // ENet reaches it through link-time wrappers of enet_socket_receive/send/wait, which
+    // look the socket up here; sockets without a BatchedSocket use ENet's own calls.
+    // Receives fill a ring with one recvmmsg and hand datagrams to ENet one at a time;
+    // sends are copied into a ring and go out in one sendmmsg, with consecutive datagrams
+    // to the same peer merged into GSO super-datagrams. Used only from the thread that
+    // services the host.
+    class BatchedSocket {
+    public:
+        // nullptr when batching is unavailable on this platform or for this socket, or the
+        // executable was linked without the wrappers in batched_io_wrap.cpp.
+        static auto create(ENetSocket socket, const HostConfig& config) -> std::unique_ptr<BatchedSocket>;
+        static auto supported() -> bool;
+        static auto find(ENetSocket socket) -> BatchedSocket*;
+
+        ~BatchedSocket();
+
+        BatchedSocket(const BatchedSocket&) = delete;
+        BatchedSocket& operator=(const BatchedSocket&) = delete;
+
+        // Same contracts as enet_socket_receive and enet_socket_send.
+        auto receive(ENetAddress* address, ENetBuffer* buffers, size_t bufferCount) -> int;
+        auto send(const ENetAddress* address, const ENetBuffer* buffers, size_t bufferCount) -> int;
+
+        auto flush() -> void;
+        // Datagrams already read from the kernel that ENet has not taken yet.
+        auto pending() const -> bool;
+
+    private:
+        struct Rings;
+
+        BatchedSocket(ENetSocket socket, std::unique_ptr<Rings> rings);
+
+        auto refill() -> int;
+
+        ENetSocket socket_;
+        std::unique_ptr<Rings> rings_;
+    };
+}
\ No newline at end of file
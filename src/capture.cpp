@@ -0,0 +1,177 @@
+#include "capture.hpp"
+#include "command_queue.hpp"
+#include <cstring>
+
+namespace icelander::detail {
+    namespace {
+        constexpr size_t MIN_RING_SIZE = 64 * 1024;
+
+        auto paddedLength(size_t size) -> size_t {
+            return (sizeof(CaptureRecord) + size + 7) & ~size_t{7};
+        }
+    }
+
+    Recorder::Recorder(const std::string& path, const CaptureConfig& config)
+        : config_(config)
+        , started_(std::chrono::steady_clock::now())
+        , log_(std::make_unique<MappedLog>(path, std::max(config.maxFileSize, CAPTURE_FILE_HEADER_SIZE + MIN_RING_SIZE)))
+        , written_(CAPTURE_FILE_HEADER_SIZE)
+        , ring_(std::bit_ceil(std::max(config.ringSize, MIN_RING_SIZE))) {
+        auto header = log_->data();
+        std::memcpy(header, CAPTURE_MAGIC.data(), CAPTURE_MAGIC.size());
+        auto version = littleEndian(CAPTURE_VERSION);
+        std::memcpy(header + CAPTURE_MAGIC.size(), &version, sizeof(version));
+        writer_ = std::thread([this] { writerLoop(); });
+    }
+
+    Recorder::~Recorder() {
+        close();
+    }
+
+    auto Recorder::record(CaptureType type, PeerIdT peer, ChannelIdT channel, uint32_t data, PacketFlagsT flags, Span<const uint8_t> payload) -> void {
+        size_t stored = config_.recordPayloads ? payload.size() : 0;
+        size_t length = paddedLength(stored);
+        auto head = head_.load(std::memory_order_relaxed);
+        size_t offset = head & (ring_.size() - 1);
+        size_t tailRoom = ring_.size() - offset;
+
+        // Records never wrap; a short tail of the ring becomes padding instead. Lengths
+        // are multiples of 8, so the padding always has room for its length and type.
+        size_t needed = length <= tailRoom ? length : tailRoom + length;
+        if (needed > ring_.size() - (head - tail_.load(std::memory_order_acquire))) {
+            ringDropped_.add();
+            return;
+        }
+        if (length > tailRoom) {
+            auto paddingLength = littleEndian(static_cast<uint32_t>(tailRoom));
+            std::memcpy(&ring_[offset], &paddingLength, sizeof(paddingLength));
+            ring_[offset + sizeof(paddingLength)] = static_cast<uint8_t>(CaptureType::padding);
+            head += tailRoom;
+            offset = 0;
+        }
+
+        CaptureRecord header;
+        header.length = static_cast<uint32_t>(length);
+        header.type = type;
+        header.channel = channel;
+        header.peer = peer;
+        header.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started_).count();
+        header.data = data;
+        header.flags = flags;
+        header.size = static_cast<uint32_t>(stored);
+        header.packetSize = static_cast<uint32_t>(payload.size());
+        header = littleEndianRecord(header);
+
+        auto out = &ring_[offset];
+        std::memcpy(out, &header, sizeof(header));
+        if (stored > 0) {
+            std::memcpy(out + sizeof(header), payload.data(), stored);
+        }
+        std::memset(out + sizeof(header) + stored, 0, length - sizeof(header) - stored);
+        head_.store(head + length, std::memory_order_release);
+    }
+
+    auto Recorder::close() -> CaptureStats {
+        if (writer_.joinable()) {
+            running_.store(false, std::memory_order_release);
+            writer_.join();
+            log_->setLength(written_);
+            log_.reset();
+        }
+
+        CaptureStats result;
+        result.records = records_.load();
+        result.bytes = written_;
+        result.dropped = ringDropped_.load() + fileDropped_.load();
+        return result;
+    }
+
+    void Recorder::writerLoop() {
+        while (running_.load(std::memory_order_acquire)) {
+            drain();
+            std::this_thread::sleep_for(config_.flushInterval);
+        }
+        drain();
+    }
+
+    void Recorder::drain() {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        auto head = head_.load(std::memory_order_acquire);
+        while (tail != head) {
+            size_t offset = tail & (ring_.size() - 1);
+            uint32_t length;
+            std::memcpy(&length, &ring_[offset], sizeof(length));
+            length = littleEndian(length);
+
+            if (static_cast<CaptureType>(ring_[offset + sizeof(length)]) != CaptureType::padding) {
+                if (written_ + length <= log_->capacity()) {
+                    std::memcpy(log_->data() + written_, &ring_[offset], length);
+                    written_ += length;
+                    records_.add();
+                } else {
+                    fileDropped_.add();
+                }
+            }
+            tail += length;
+        }
+        tail_.store(tail, std::memory_order_release);
+    }
+}
+
+namespace icelander {
+    auto Host::startCapture(const std::string& path, const CaptureConfig& config) -> void {
+        // The previous file is closed first, in case path names it again.
+        stopCapture();
+        swapRecorder(std::make_unique<detail::Recorder>(path, config));
+    }
+
+    auto Host::stopCapture() -> CaptureStats {
+        // Closed here rather than on the servicing thread, which would wait on the writer.
+        auto previous = swapRecorder(nullptr);
+        return previous ? previous->close() : CaptureStats{};
+    }
+
+    auto Host::swapRecorder(std::unique_ptr<detail::Recorder> recorder) -> std::unique_ptr<detail::Recorder> {
+        if (directAccess()) {
+            std::swap(recorder_, recorder);
+            return recorder;
+        }
+
+        detail::RecorderSwap request{std::move(recorder), {}};
+        auto result = request.previous.get_future();
+
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::swapRecorder;
+        command->recorderSwap = &request;
+        submit(command);
+
+        return result.get();
+    }
+
+    auto Host::recordEvent(const ENetEvent& event) -> void {
+        auto slot = static_cast<PeerIdT>(event.peer->incomingPeerID);
+        switch (event.type) {
+            case ENET_EVENT_TYPE_CONNECT:
+                recorder_->record(CaptureType::connect, slot, 0, event.data, 0, {nullptr, 0});
+                break;
+
+            case ENET_EVENT_TYPE_DISCONNECT:
+                recorder_->record(CaptureType::disconnect, slot, 0, event.data, 0, {nullptr, 0});
+                break;
+
+            case ENET_EVENT_TYPE_RECEIVE:
+                recorder_->record(CaptureType::receive, slot, event.channelID, 0, event.packet->flags,
+                                  {event.packet->data, event.packet->dataLength});
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    auto Host::recordSend(CaptureType type, PeerIdT peer, ChannelIdT channel, uint32_t data, const ENetPacket& nativePacket) -> void {
+        if (recorder_->recordsSends()) {
+            recorder_->record(type, peer, channel, data, nativePacket.flags, {nativePacket.data, nativePacket.dataLength});
+        }
+    }
+}
\ No newline at end of file
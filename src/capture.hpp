@@ -0,0 +1,54 @@
+#pragma once
+
+#include "icelander.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
+
+namespace icelander::detail {
+    // Byte swapping is its own inverse, so this encodes and decodes.
+    inline auto littleEndianRecord(CaptureRecord record) -> CaptureRecord {
+        record.length = littleEndian(record.length);
+        record.peer = littleEndian(record.peer);
+        record.time = static_cast<int64_t>(littleEndian(static_cast<uint64_t>(record.time)));
+        record.data = littleEndian(record.data);
+        record.flags = littleEndian(record.flags);
+        record.size = littleEndian(record.size);
+        record.packetSize = littleEndian(record.packetSize);
+        return record;
+    }
+
+    // Writer behind Host::startCapture. record() runs on the servicing thread and only
+    // copies into a single-producer ring; a background thread drains the ring into the
+    // mapped file every flushInterval. A full ring or file drops the record.
+    class Recorder {
+    public:
+        // Throws std::runtime_error if the file cannot be created or mapped.
+        Recorder(const std::string& path, const CaptureConfig& config);
+        ~Recorder();
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        auto recordsSends() const -> bool { return config_.recordSends; }
+        auto record(CaptureType type, PeerIdT peer, ChannelIdT channel, uint32_t data, PacketFlagsT flags, Span<const uint8_t> payload) -> void;
+        // Stops the writer after it drains the ring and trims the file; idempotent.
+        auto close() -> CaptureStats;
+
+    private:
+        void writerLoop();
+        void drain();
+
+        CaptureConfig config_;
+        Timestamp started_;
+        std::unique_ptr<MappedLog> log_;
+        size_t written_;
+        std::vector<uint8_t> ring_;
+        alignas(CACHE_LINE) std::atomic<uint64_t> head_{0};    // advanced by record()
+        alignas(CACHE_LINE) std::atomic<uint64_t> tail_{0};    // advanced by the writer
+        Counter records_;
+        Counter ringDropped_;
+        Counter fileDropped_;
+        std::atomic<bool> running_{true};
+        std::thread writer_;
+    };
+}
\ No newline at end of file
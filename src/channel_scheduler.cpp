@@ -0,0 +1,151 @@
+#include "channel_scheduler.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+
+namespace icelander::detail {
+    auto ChannelScheduler::create(const std::vector<ChannelConfig>& channels, size_t peerCount) -> std::unique_ptr<ChannelScheduler> {
+        if (channels.empty()) {
+            return nullptr;
+        }
+        return std::unique_ptr<ChannelScheduler>(new ChannelScheduler(channels, peerCount));
+    }
+
+    ChannelScheduler::ChannelScheduler(const std::vector<ChannelConfig>& channels, size_t peerCount)
+        : configs_(channels.begin(), channels.begin() + static_cast<std::ptrdiff_t>(std::min(channels.size(), MAX_CHANNELS)))
+        , peers_(peerCount) {
+        for (size_t channel = 0; channel < configs_.size(); ++channel) {
+            order_.push_back(static_cast<ChannelIdT>(channel));
+        }
+        std::stable_sort(order_.begin(), order_.end(), [this](ChannelIdT a, ChannelIdT b) {
+            return configs_[a].priority > configs_[b].priority;
+        });
+        for (auto& slot : peers_) {
+            slot.channels.resize(configs_.size());
+        }
+        dirty_.reserve(peerCount);
+    }
+
+    ChannelScheduler::~ChannelScheduler() {
+        for (auto& slot : peers_) {
+            drop(slot);
+        }
+    }
+
+    auto ChannelScheduler::enqueue(ENetPeer* nativePeer, ChannelIdT channel, uint32_t key, ENetPacket* nativePacket) -> void {
+        ++nativePacket->referenceCount;
+        if (nativePeer->incomingPeerID >= peers_.size()) {
+            unref(nativePacket);
+            return;
+        }
+
+        auto index = nativePeer->incomingPeerID;
+        auto& slot = peers_[index];
+        if (slot.peer != nativePeer || slot.connectId != nativePeer->connectID) {
+            drop(slot);
+            slot.peer = nativePeer;
+            slot.connectId = nativePeer->connectID;
+        }
+
+        // Reliable packets are never replaced, even on a latest-value-wins channel.
+        auto& queue = slot.channels[channel];
+        bool keyed = configs_[channel].latestValueWins && !(nativePacket->flags & ENET_PACKET_FLAG_RELIABLE);
+        if (keyed) {
+            auto it = queue.latest.find(key);
+            if (it != queue.latest.end()) {
+                auto& entry = queue.entries[static_cast<size_t>(it->second - queue.head)];
+                unref(entry.packet);
+                entry.packet = nativePacket;
+                return;
+            }
+            queue.latest.emplace(key, queue.head + queue.entries.size());
+        }
+
+        queue.entries.push_back({key, keyed, nativePacket});
+        ++queued_;
+        if (!slot.dirty) {
+            slot.dirty = true;
+            dirty_.push_back(index);
+        }
+    }
+
+    auto ChannelScheduler::release(Host& host) -> void {
+        size_t kept = 0;
+        for (auto index : dirty_) {
+            auto& slot = peers_[index];
+            auto nativePeer = slot.peer;
+            // ENet would refuse these sends too.
+            if (nativePeer->connectID != slot.connectId || nativePeer->state != ENET_PEER_STATE_CONNECTED) {
+                drop(slot);
+                slot.dirty = false;
+                continue;
+            }
+
+            // Unreliable packets ENet has not sent yet sit in outgoingCommands.
+            bool backlog = !enet_list_empty(&nativePeer->outgoingCommands);
+            bool pending = false;
+            for (auto channel : order_) {
+                auto& queue = slot.channels[channel];
+                const auto& config = configs_[channel];
+                if (queue.entries.empty()) {
+                    continue;
+                }
+                if (config.latestValueWins && backlog) {
+                    pending = true;
+                    continue;
+                }
+
+                // A packet over the budget still goes out alone.
+                size_t spent = 0;
+                while (!queue.entries.empty()) {
+                    size_t bytes = queue.entries.front().packet->dataLength;
+                    if (config.bytesPerFlush > 0 && spent > 0 && spent + bytes > config.bytesPerFlush) {
+                        break;
+                    }
+                    auto nativePacket = pop(queue);
+                    if (enet_peer_send(nativePeer, channel, nativePacket) == 0) {
+                        if constexpr (METRICS_ENABLED) {
+                            if (host.metrics_) {
+                                host.metrics_->recordSend(*nativePeer, channel, bytes);
+                            }
+                        }
+                    }
+                    unref(nativePacket);
+                    spent += bytes;
+                }
+                pending = pending || !queue.entries.empty();
+            }
+
+            if (pending) {
+                dirty_[kept++] = index;
+            } else {
+                slot.dirty = false;
+            }
+        }
+        dirty_.resize(kept);
+    }
+
+    auto ChannelScheduler::pop(Queue& queue) -> ENetPacket* {
+        auto entry = queue.entries.front();
+        if (entry.keyed) {
+            queue.latest.erase(entry.key);
+        }
+        queue.entries.pop_front();
+        ++queue.head;
+        --queued_;
+        return entry.packet;
+    }
+
+    auto ChannelScheduler::drop(PeerQueues& slot) -> void {
+        for (auto& queue : slot.channels) {
+            while (!queue.entries.empty()) {
+                unref(pop(queue));
+            }
+        }
+    }
+
+    auto ChannelScheduler::unref(ENetPacket* nativePacket) -> void {
+        if (--nativePacket->referenceCount == 0) {
+            enet_packet_destroy(nativePacket);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "icelander.hpp"
+#include <deque>
+
+namespace icelander::detail {
+    // Holds packets for the channels in HostConfig::channels until the next service or
+    // flush pass, then hands them to ENet highest priority first, each channel within its
+    // byte budget. Latest-value-wins channels keep one unsent unreliable packet per key,
+    // replaced in place, and wait while ENet still has older commands queued for the peer.
+    // Servicing thread only.
+    class ChannelScheduler {
+    public:
+        // nullptr when no channel is configured.
+        static auto create(const std::vector<ChannelConfig>& channels, size_t peerCount) -> std::unique_ptr<ChannelScheduler>;
+
+        ~ChannelScheduler();
+
+        ChannelScheduler(const ChannelScheduler&) = delete;
+        ChannelScheduler& operator=(const ChannelScheduler&) = delete;
+
+        auto schedules(ChannelIdT channel) const -> bool { return channel < configs_.size(); }
+        // Holds a reference on the packet until it is released or replaced.
+        auto enqueue(ENetPeer* nativePeer, ChannelIdT channel, uint32_t key, ENetPacket* nativePacket) -> void;
+        auto release(Host& host) -> void;
+        auto queued() const -> size_t { return queued_; }
+
+    private:
+        struct Entry {
+            uint32_t key;
+            bool keyed;
+            ENetPacket* packet;
+        };
+
+        struct Queue {
+            std::deque<Entry> entries;
+            uint64_t head = 0;                              // sequence number of entries.front()
+            std::unordered_map<uint32_t, uint64_t> latest;  // key -> sequence of its unsent packet
+        };
+
+        struct PeerQueues {
+            ENetPeer* peer = nullptr;
+            uint32_t connectId = 0;
+            bool dirty = false;
+            std::vector<Queue> channels;
+        };
+
+        ChannelScheduler(const std::vector<ChannelConfig>& channels, size_t peerCount);
+
+        auto pop(Queue& queue) -> ENetPacket*;
+        auto drop(PeerQueues& slot) -> void;
+        static auto unref(ENetPacket* nativePacket) -> void;
+
+        std::vector<ChannelConfig> configs_;
+        std::vector<ChannelIdT> order_;     // configured channels by descending priority
+        std::vector<PeerQueues> peers_;
+        std::vector<PeerIdT> dirty_;
+        size_t queued_ = 0;
+    };
+}
\ No newline at end of file
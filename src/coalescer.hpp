@@ -0,0 +1,85 @@
+#pragma once
+
+#include "icelander.hpp"
+#include <limits>
+
+namespace icelander::detail {
+    // Per-peer batches of length-prefixed messages, one per channel and flag set.
+    // Not synchronized; the owning Peer is driven from one thread.
+    class Coalescer {
+    public:
+        explicit Coalescer(size_t limit) : limit_(limit) {}
+
+        // Appends a message; returns a batch that is ready to send, if any.
+        auto append(ChannelIdT channel, PacketFlagsT flags, const void* message, size_t size)
+            -> std::pair<ChannelIdT, std::unique_ptr<Packet>> {
+            if (size > std::numeric_limits<uint16_t>::max()) {
+                throw std::runtime_error("Coalesced message exceeds 65535 bytes");
+            }
+
+            Batch& batch = batchFor(channel, flags);
+            std::unique_ptr<Packet> ready;
+            if (batch.messages > 0 && batch.builder.size() + sizeof(uint16_t) + size > limit_) {
+                ready = take(batch);
+            }
+
+            batch.builder.writeUint16(static_cast<uint16_t>(size));
+            batch.builder.write(message, size);
+            ++batch.messages;
+            ++queued_;
+
+            if (!ready && batch.builder.size() >= limit_) {
+                ready = take(batch);
+            }
+            return {channel, std::move(ready)};
+        }
+
+        template<typename Send>
+        auto flush(Send&& send) -> size_t {
+            size_t sent = 0;
+            for (auto& batch : batches_) {
+                if (batch.messages > 0) {
+                    send(batch.channel, take(batch));
+                    ++sent;
+                }
+            }
+            return sent;
+        }
+
+        auto queued() const -> size_t {
+            return queued_;
+        }
+
+    private:
+        struct Batch {
+            ChannelIdT channel;
+            PacketFlagsT flags;
+            size_t messages = 0;
+            PacketBuilder builder;
+        };
+
+        auto batchFor(ChannelIdT channel, PacketFlagsT flags) -> Batch& {
+            // A peer rarely uses more than a handful of channel/flag pairs.
+            for (auto& batch : batches_) {
+                if (batch.channel == channel && batch.flags == flags) {
+                    return batch;
+                }
+            }
+            auto& batch = batches_.emplace_back();
+            batch.channel = channel;
+            batch.flags = flags;
+            batch.builder = PacketBuilder(limit_);
+            return batch;
+        }
+
+        auto take(Batch& batch) -> std::unique_ptr<Packet> {
+            queued_ -= batch.messages;
+            batch.messages = 0;
+            return batch.builder.build(batch.flags);
+        }
+
+        size_t limit_;
+        size_t queued_ = 0;
+        std::vector<Batch> batches_;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "icelander.hpp"
+#include "allocator.hpp"
+#include "mpsc_queue.hpp"
+#include <future>
+
+namespace icelander::detail {
+    enum class CommandType : uint8_t {
+        send,
+        broadcast,
+        groupSend,
+        disconnect,
+        disconnectNow,
+        disconnectLater,
+        connect,
+        connectAsync,
+        startStream,
+        swapRecorder,
+        flush
+    };
+
+    struct ConnectRequest {
+        AddressT address;
+        size_t channels;
+        uint32_t connectData;
+        std::promise<std::shared_ptr<Peer>> result;
+    };
+
+    struct RecorderSwap {
+        std::unique_ptr<Recorder> recorder;
+        std::promise<std::unique_ptr<Recorder>> previous;
+    };
+
+    // enet_peer_send leaves the packet with the caller on failure.
+    inline auto sendNow(ENetPeer* nativePeer, ChannelIdT channel, ENetPacket* nativePacket) -> bool {
+        if (enet_peer_send(nativePeer, channel, nativePacket) == 0) {
+            return true;
+        }
+        if (nativePacket->referenceCount == 0) {
+            enet_packet_destroy(nativePacket);
+        }
+        return false;
+    }
+
+    struct Command {
+        std::atomic<Command*> next{nullptr};
+        CommandType type = CommandType::send;
+        ChannelIdT channel = 0;
+        uint32_t data = 0;
+        uint32_t connectId = 0;
+        ENetPeer* peer = nullptr;
+        ENetPacket* packet = nullptr;
+        ConnectRequest* request = nullptr;
+        async::ConnectAwaiter* connectAwaiter = nullptr;
+        OutgoingStream* stream = nullptr;       // owned until executed
+        RecorderSwap* recorderSwap = nullptr;
+        std::shared_ptr<const std::vector<PeerHandle>> members;
+
+        static auto make() -> Command* {
+            auto memory = poolAllocate(sizeof(Command));
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+            return new (memory) Command();
+        }
+
+        static void destroy(Command* command) noexcept {
+            command->~Command();
+            poolFree(command);
+        }
+    };
+
+    // Producers are any thread; only the service thread pops.
+    class CommandQueue : public MpscQueue<Command> {};
+}
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "compressor.hpp"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef ICELANDER_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef ICELANDER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace icelander::detail {
+    namespace {
+        constexpr size_t POOR_STREAK_LIMIT = 8;
+
+        auto compressCallback(void* context, const ENetBuffer* inBuffers, size_t inBufferCount, size_t inLimit,
+                              enet_uint8* outData, size_t outLimit) -> size_t {
+            return static_cast<Compressor*>(context)->compress(inBuffers, inBufferCount, inLimit, outData, outLimit);
+        }
+
+        auto decompressCallback(void* context, const enet_uint8* inData, size_t inLimit,
+                                enet_uint8* outData, size_t outLimit) -> size_t {
+            return static_cast<Compressor*>(context)->decompress(inData, inLimit, outData, outLimit);
+        }
+
+        void destroyCallback(void* context) {
+            delete static_cast<Compressor*>(context);
+        }
+
+        class RangeCoderCompressor : public Compressor {
+        public:
+            explicit RangeCoderCompressor(const CompressorConfig& config)
+                : Compressor(config), coder_(enet_range_coder_create()) {
+                if (!coder_) {
+                    throw std::runtime_error("Failed to create range coder");
+                }
+            }
+
+            ~RangeCoderCompressor() override {
+                enet_range_coder_destroy(coder_);
+            }
+
+        protected:
+            auto compressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t override {
+                ENetBuffer buffer;
+                buffer.data = const_cast<uint8_t*>(in);
+                buffer.dataLength = size;
+                return enet_range_coder_compress(coder_, &buffer, 1, size, out, outLimit);
+            }
+
+            auto decompressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t override {
+                return enet_range_coder_decompress(coder_, in, size, out, outLimit);
+            }
+
+        private:
+            void* coder_;
+        };
+
+#ifdef ICELANDER_HAVE_LZ4
+        class Lz4Compressor : public Compressor {
+        public:
+            explicit Lz4Compressor(const CompressorConfig& config)
+                : Compressor(config), stream_(LZ4_createStream()) {
+                if (!stream_) {
+                    throw std::runtime_error("Failed to create LZ4 stream");
+                }
+            }
+
+            ~Lz4Compressor() override {
+                LZ4_freeStream(stream_);
+            }
+
+        protected:
+            auto compressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t override {
+                auto source = reinterpret_cast<const char*>(in);
+                auto destination = reinterpret_cast<char*>(out);
+                int acceleration = config_.level > 0 ? config_.level : 1;
+
+                int written;
+                if (config_.dictionary.empty()) {
+                    written = LZ4_compress_fast(source, destination, static_cast<int>(size),
+                                                static_cast<int>(outLimit), acceleration);
+                } else {
+                    // Each datagram stands alone, so the dictionary is the only history.
+                    LZ4_resetStream_fast(stream_);
+                    LZ4_loadDict(stream_, reinterpret_cast<const char*>(config_.dictionary.data()),
+                                 static_cast<int>(config_.dictionary.size()));
+                    written = LZ4_compress_fast_continue(stream_, source, destination, static_cast<int>(size),
+                                                         static_cast<int>(outLimit), acceleration);
+                }
+                return written > 0 ? static_cast<size_t>(written) : 0;
+            }
+
+            auto decompressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t override {
+                int read = LZ4_decompress_safe_usingDict(
+                    reinterpret_cast<const char*>(in), reinterpret_cast<char*>(out),
+                    static_cast<int>(size), static_cast<int>(outLimit),
+                    reinterpret_cast<const char*>(config_.dictionary.data()),
+                    static_cast<int>(config_.dictionary.size()));
+                return read > 0 ? static_cast<size_t>(read) : 0;
+            }
+
+        private:
+            LZ4_stream_t* stream_;
+        };
+#endif
+
+#ifdef ICELANDER_HAVE_ZSTD
+        class ZstdCompressor : public Compressor {
+        public:
+            explicit ZstdCompressor(const CompressorConfig& config)
+                : Compressor(config)
+                , cctx_(ZSTD_createCCtx())
+                , dctx_(ZSTD_createDCtx()) {
+                int level = config.level != 0 ? config.level : ZSTD_CLEVEL_DEFAULT;
+                if (!config.dictionary.empty()) {
+                    cdict_ = ZSTD_createCDict(config.dictionary.data(), config.dictionary.size(), level);
+                    ddict_ = ZSTD_createDDict(config.dictionary.data(), config.dictionary.size());
+                }
+                if (!cctx_ || !dctx_ || (!config.dictionary.empty() && (!cdict_ || !ddict_))) {
+                    release();
+                    throw std::runtime_error("Failed to create zstd context");
+                }
+                level_ = level;
+            }
+
+            ~ZstdCompressor() override {
+                release();
+            }
+
+        protected:
+            auto compressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t override {
+                size_t written = cdict_
+                    ? ZSTD_compress_usingCDict(cctx_, out, outLimit, in, size, cdict_)
+                    : ZSTD_compressCCtx(cctx_, out, outLimit, in, size, level_);
+                return ZSTD_isError(written) ? 0 : written;
+            }
+
+            auto decompressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t override {
+                size_t read = ddict_
+                    ? ZSTD_decompress_usingDDict(dctx_, out, outLimit, in, size, ddict_)
+                    : ZSTD_decompressDCtx(dctx_, out, outLimit, in, size);
+                return ZSTD_isError(read) ? 0 : read;
+            }
+
+        private:
+            void release() {
+                ZSTD_freeCDict(cdict_);
+                ZSTD_freeDDict(ddict_);
+                ZSTD_freeCCtx(cctx_);
+                ZSTD_freeDCtx(dctx_);
+            }
+
+            ZSTD_CCtx* cctx_;
+            ZSTD_DCtx* dctx_;
+            ZSTD_CDict* cdict_ = nullptr;
+            ZSTD_DDict* ddict_ = nullptr;
+            int level_ = 0;
+        };
+#endif
+    }
+
+    Compressor::Compressor(const CompressorConfig& config) : config_(config) {}
+
+    auto Compressor::create(const CompressorConfig& config) -> std::unique_ptr<Compressor> {
+        switch (config.algorithm) {
+            case CompressionAlgorithm::none:
+                return nullptr;
+
+            case CompressionAlgorithm::rangeCoder:
+                return std::make_unique<RangeCoderCompressor>(config);
+
+            case CompressionAlgorithm::lz4:
+#ifdef ICELANDER_HAVE_LZ4
+                return std::make_unique<Lz4Compressor>(config);
+#else
+                throw std::runtime_error("Icelander was built without LZ4 support");
+#endif
+
+            case CompressionAlgorithm::zstd:
+#ifdef ICELANDER_HAVE_ZSTD
+                return std::make_unique<ZstdCompressor>(config);
+#else
+                throw std::runtime_error("Icelander was built without zstd support");
+#endif
+        }
+        throw std::runtime_error("Unknown compression algorithm");
+    }
+
+    auto Compressor::supports(CompressionAlgorithm algorithm) -> bool {
+        switch (algorithm) {
+            case CompressionAlgorithm::none:
+            case CompressionAlgorithm::rangeCoder:
+                return true;
+            case CompressionAlgorithm::lz4:
+#ifdef ICELANDER_HAVE_LZ4
+                return true;
+#else
+                return false;
+#endif
+            case CompressionAlgorithm::zstd:
+#ifdef ICELANDER_HAVE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    void Compressor::install(ENetHost* nativeHost, std::unique_ptr<Compressor> compressor) {
+        ENetCompressor callbacks;
+        callbacks.context = compressor.release();
+        callbacks.compress = compressCallback;
+        callbacks.decompress = decompressCallback;
+        callbacks.destroy = destroyCallback;
+        enet_host_compress(nativeHost, &callbacks);
+    }
+
+    auto Compressor::fromHost(ENetHost* nativeHost) -> Compressor* {
+        if (!nativeHost || nativeHost->compressor.compress != compressCallback) {
+            return nullptr;
+        }
+        return static_cast<Compressor*>(nativeHost->compressor.context);
+    }
+
+    auto Compressor::compress(const ENetBuffer* inBuffers, size_t inBufferCount, size_t inLimit,
+                              uint8_t* outData, size_t outLimit) -> size_t {
+        // Returning 0 tells ENet to send the datagram uncompressed.
+        if (inLimit < config_.minimumSize || backoffRemaining_ > 0) {
+            if (backoffRemaining_ > 0) {
+                --backoffRemaining_;
+            }
+            bump(counters_.skipped);
+            return 0;
+        }
+
+        scratch_.resize(inLimit);
+        size_t gathered = 0;
+        for (size_t i = 0; i < inBufferCount && gathered < inLimit; ++i) {
+            size_t length = std::min(inBuffers[i].dataLength, inLimit - gathered);
+            std::memcpy(scratch_.data() + gathered, inBuffers[i].data, length);
+            gathered += length;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t written = compressBlock(scratch_.data(), gathered, outData, outLimit);
+        bump(counters_.compressNanos, (std::chrono::steady_clock::now() - start).count());
+
+        if (written == 0 || static_cast<double>(written) > static_cast<double>(gathered) * config_.maximumRatio) {
+            if (config_.backoffDatagrams > 0 && ++poorStreak_ >= POOR_STREAK_LIMIT) {
+                poorStreak_ = 0;
+                backoffRemaining_ = config_.backoffDatagrams;
+            }
+            bump(counters_.skipped);
+            return 0;
+        }
+
+        poorStreak_ = 0;
+        bump(counters_.compressed);
+        bump(counters_.bytesIn, gathered);
+        bump(counters_.bytesOut, written);
+        return written;
+    }
+
+    auto Compressor::decompress(const uint8_t* inData, size_t inLimit, uint8_t* outData, size_t outLimit) -> size_t {
+        auto start = std::chrono::steady_clock::now();
+        size_t read = decompressBlock(inData, inLimit, outData, outLimit);
+        bump(counters_.decompressNanos, (std::chrono::steady_clock::now() - start).count());
+
+        bump(read ? counters_.decompressed : counters_.failures);
+        return read;
+    }
+
+    auto Compressor::stats() const -> CompressionStats {
+        CompressionStats result;
+        result.datagramsCompressed = counters_.compressed.load(std::memory_order_relaxed);
+        result.datagramsSkipped = counters_.skipped.load(std::memory_order_relaxed);
+        result.bytesIn = counters_.bytesIn.load(std::memory_order_relaxed);
+        result.bytesOut = counters_.bytesOut.load(std::memory_order_relaxed);
+        result.datagramsDecompressed = counters_.decompressed.load(std::memory_order_relaxed);
+        result.decompressFailures = counters_.failures.load(std::memory_order_relaxed);
+        result.compressTime = std::chrono::nanoseconds(counters_.compressNanos.load(std::memory_order_relaxed));
+        result.decompressTime = std::chrono::nanoseconds(counters_.decompressNanos.load(std::memory_order_relaxed));
+        return result;
+    }
+
+    void Compressor::bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void Compressor::bump(std::atomic<int64_t>& counter, int64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+}
\ No newline at end of file
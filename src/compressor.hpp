@@ -0,0 +1,55 @@
+#pragma once
+
+#include "icelander.hpp"
+
+namespace icelander::detail {
+    // ENetCompressor backend. The base class applies the size threshold, ratio check,
+    // backoff and statistics; subclasses only transform one contiguous block.
+    class Compressor {
+    public:
+        static auto create(const CompressorConfig& config) -> std::unique_ptr<Compressor>;
+        static auto supports(CompressionAlgorithm algorithm) -> bool;
+
+        // Hands ownership to the ENet host, which destroys it with the host.
+        static void install(ENetHost* nativeHost, std::unique_ptr<Compressor> compressor);
+        // The compressor installed on a host, or nullptr if it is not one of ours.
+        static auto fromHost(ENetHost* nativeHost) -> Compressor*;
+
+        virtual ~Compressor() = default;
+
+        auto compress(const ENetBuffer* inBuffers, size_t inBufferCount, size_t inLimit,
+                      uint8_t* outData, size_t outLimit) -> size_t;
+        auto decompress(const uint8_t* inData, size_t inLimit, uint8_t* outData, size_t outLimit) -> size_t;
+        auto stats() const -> CompressionStats;
+
+    protected:
+        explicit Compressor(const CompressorConfig& config);
+
+        // Return 0 when the output does not fit or the input is invalid.
+        virtual auto compressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t = 0;
+        virtual auto decompressBlock(const uint8_t* in, size_t size, uint8_t* out, size_t outLimit) -> size_t = 0;
+
+        CompressorConfig config_;
+
+    private:
+        // Written only by the servicing thread; atomics so stats() is safe from others.
+        struct Counters {
+            std::atomic<uint64_t> compressed{0};
+            std::atomic<uint64_t> skipped{0};
+            std::atomic<uint64_t> bytesIn{0};
+            std::atomic<uint64_t> bytesOut{0};
+            std::atomic<uint64_t> decompressed{0};
+            std::atomic<uint64_t> failures{0};
+            std::atomic<int64_t> compressNanos{0};
+            std::atomic<int64_t> decompressNanos{0};
+        };
+
+        static void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1);
+        static void bump(std::atomic<int64_t>& counter, int64_t amount);
+
+        std::vector<uint8_t> scratch_;
+        size_t poorStreak_ = 0;
+        size_t backoffRemaining_ = 0;
+        Counters counters_;
+    };
+}
\ No newline at end of file
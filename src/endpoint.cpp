@@ -2,24 +2,64 @@
 #include <stdexcept>
 
 namespace icelander {
-    auto Endpoint::toEnetAddress() const -> AddressT {
+    auto Endpoint::resolve(const std::string& hostName, uint16_t port) -> Endpoint {
         AddressT addr;
 
-        if (enet_address_set_host(&addr, host.c_str()) != 0) {
-            throw std::runtime_error("Failed to resolve hostname: " + host);
+        if (enet_address_set_host(&addr, hostName.c_str()) != 0) {
+            throw std::runtime_error("Failed to resolve hostname: " + hostName);
         }
 
+        return Endpoint{addr.host, port};
+    }
+
+    auto Endpoint::parse(const std::string& address, uint16_t port) -> Endpoint {
+        AddressT addr;
+
+        if (enet_address_set_host_ip(&addr, address.c_str()) != 0) {
+            throw std::runtime_error("Invalid numeric address: " + address);
+        }
+
+        return Endpoint{addr.host, port};
+    }
+
+    auto Endpoint::any(uint16_t port) -> Endpoint {
+        return Endpoint{ENET_HOST_ANY, port};
+    }
+
+    auto Endpoint::toEnetAddress() const -> AddressT {
+        AddressT addr;
+        addr.host = host;
         addr.port = port;
         return addr;
     }
 
     auto Endpoint::fromEnetAddress(const AddressT& addr) -> Endpoint {
+        return Endpoint{addr.host, addr.port};
+    }
+
+    auto Endpoint::hostString() const -> std::string {
+        char ip[64];
+        AddressT addr = toEnetAddress();
+
+        if (enet_address_get_host_ip(&addr, ip, sizeof(ip)) != 0) {
+            throw std::runtime_error("Failed to format address");
+        }
+
+        return std::string(ip);
+    }
+
+    auto Endpoint::toString() const -> std::string {
+        return hostString() + ":" + std::to_string(port);
+    }
+
+    auto Endpoint::lookupHostName() const -> std::string {
         char hostname[256];
+        AddressT addr = toEnetAddress();
 
         if (enet_address_get_host(&addr, hostname, sizeof(hostname)) != 0) {
             throw std::runtime_error("Failed to get hostname from address");
         }
 
-        return Endpoint{std::string(hostname), addr.port};
+        return std::string(hostname);
     }
 }
\ No newline at end of file
@@ -1,49 +1,66 @@
 #include "icelander.hpp"
+#include <stdexcept>
 
 namespace icelander {
+    EventDispatcher::EventDispatcher() {
+        tables_.push_back(std::make_unique<HandlerTable>());
+        table_.store(tables_.back().get(), std::memory_order_release);
+    }
+
+    EventDispatcher::~EventDispatcher() = default;
+
+    template<typename Change>
+    void EventDispatcher::update(Change&& change) {
+        std::lock_guard<std::mutex> lock(updateMutex_);
+        auto next = std::make_unique<HandlerTable>(*table_.load(std::memory_order_relaxed));
+        change(*next);
+        table_.store(next.get(), std::memory_order_release);
+        tables_.push_back(std::move(next));
+    }
+
     void EventDispatcher::onConnect(ConnectHandler handler) {
-        connectHandlers_.push_back(std::move(handler));
+        update([&handler](HandlerTable& table) { table.connect.push_back(std::move(handler)); });
     }
 
     void EventDispatcher::onDisconnect(DisconnectHandler handler) {
-        disconnectHandlers_.push_back(std::move(handler));
+        update([&handler](HandlerTable& table) { table.disconnect.push_back(std::move(handler)); });
     }
 
     void EventDispatcher::onReceive(ReceiveHandler handler) {
-        receiveHandlers_.push_back(std::move(handler));
+        update([&handler](HandlerTable& table) { table.receive.push_back(std::move(handler)); });
     }
 
     void EventDispatcher::onReceive(ChannelIdT channel, ReceiveHandler handler) {
-        channelHandlers_[channel].push_back(std::move(handler));
+        if (channel >= MAX_CHANNELS) {
+            throw std::runtime_error("Channel out of range");
+        }
+        update([&handler, channel](HandlerTable& table) { table.channels[channel].push_back(std::move(handler)); });
     }
 
     void EventDispatcher::clearHandlers() {
-        connectHandlers_.clear();
-        disconnectHandlers_.clear();
-        receiveHandlers_.clear();
-        channelHandlers_.clear();
+        update([](HandlerTable& table) { table = HandlerTable{}; });
     }
 
     void EventDispatcher::dispatchConnect(const ConnectEvent& event) {
-        for (const auto& handler : connectHandlers_) {
+        for (const auto& handler : table_.load(std::memory_order_acquire)->connect) {
             handler(event);
         }
     }
 
     void EventDispatcher::dispatchDisconnect(const DisconnectEvent& event) {
-        for (const auto& handler : disconnectHandlers_) {
+        for (const auto& handler : table_.load(std::memory_order_acquire)->disconnect) {
             handler(event);
         }
     }
 
     void EventDispatcher::dispatchReceive(const ReceiveEvent& event) {
-        for (const auto& handler : receiveHandlers_) {
+        const auto& table = *table_.load(std::memory_order_acquire);
+        for (const auto& handler : table.receive) {
             handler(event);
         }
 
-        auto channelIt = channelHandlers_.find(event.channel);
-        if (channelIt != channelHandlers_.end()) {
-            for (const auto& handler : channelIt->second) {
+        if (event.channel < MAX_CHANNELS) {
+            for (const auto& handler : table.channels[event.channel]) {
                 handler(event);
             }
         }
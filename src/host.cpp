@@ -1,27 +1,104 @@
 #include "icelander.hpp"
+#include "accept_guard.hpp"
+#include "batched_socket.hpp"
+#include "capture.hpp"
+#include "channel_scheduler.hpp"
+#include "command_queue.hpp"
+#include "compressor.hpp"
+#include "metrics.hpp"
+#include "peer_await.hpp"
+#include "strand.hpp"
+#include "stream.hpp"
+#include "wakeup.hpp"
+#include "affinity.hpp"
 #include <stdexcept>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
 namespace icelander {
+    namespace {
+        // enet_host_create binds before we could set socket options, so create the host
+        // unbound and bind it ourselves once SO_REUSEPORT is set.
+        auto createReusePortHost(const ENetAddress& address, const HostConfig& config) -> ENetHost* {
+#if defined(_WIN32) || !defined(SO_REUSEPORT)
+            (void)address;
+            (void)config;
+            throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#else
+            ENetHost* nativeHost = enet_host_create(
+                nullptr,
+                config.maxPeers,
+                config.maxChannels,
+                config.incomingBandwidth,
+                config.outgoingBandwidth
+            );
+
+            if (!nativeHost) {
+                return nullptr;
+            }
+
+            int enable = 1;
+            if (setsockopt(nativeHost->socket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0 ||
+                enet_socket_bind(nativeHost->socket, &address) != 0) {
+                enet_host_destroy(nativeHost);
+                return nullptr;
+            }
+
+            if (enet_socket_get_address(nativeHost->socket, &nativeHost->address) != 0) {
+                nativeHost->address = address;
+            }
+            return nativeHost;
+#endif
+        }
+
+        void installCompressor(ENetHost* nativeHost, const HostConfig& config) {
+            if (config.compressor.algorithm != CompressionAlgorithm::none) {
+                try {
+                    detail::Compressor::install(nativeHost, detail::Compressor::create(config.compressor));
+                } catch (...) {
+                    enet_host_destroy(nativeHost);
+                    throw;
+                }
+            } else if (config.enableCompression) {
+                enet_host_compress_with_range_coder(nativeHost);
+            }
+        }
+
+        // enet_host_broadcast queues the packet for every connected peer.
+        void recordBroadcast(detail::HostMetricsStorage* metrics, ENetHost* nativeHost, ChannelIdT channel, size_t bytes) {
+            if (!metrics) {
+                return;
+            }
+            for (size_t i = 0; i < nativeHost->peerCount; ++i) {
+                if (nativeHost->peers[i].state == ENET_PEER_STATE_CONNECTED) {
+                    metrics->recordSend(nativeHost->peers[i], channel, bytes);
+                }
+            }
+        }
+    }
+
     auto Host::createServer(const Endpoint& bindEndpoint, const HostConfig& config) -> std::shared_ptr<Host> {
         ENetAddress address = bindEndpoint.toEnetAddress();
 
-        ENetHost* nativeHost = enet_host_create(
-            &address,
-            config.maxPeers,
-            config.maxChannels,
-            config.incomingBandwidth,
-            config.outgoingBandwidth
-        );
+        ENetHost* nativeHost = config.reusePort
+            ? createReusePortHost(address, config)
+            : enet_host_create(
+                &address,
+                config.maxPeers,
+                config.maxChannels,
+                config.incomingBandwidth,
+                config.outgoingBandwidth
+            );
 
         if (!nativeHost) {
             throw std::runtime_error("Failed to create ENet server host");
         }
 
-        if (config.enableCompression) {
-            enet_host_compress_with_range_coder(nativeHost);
-        }
+        installCompressor(nativeHost, config);
 
-        return std::shared_ptr<Host>(new Host(nativeHost, true));
+        return std::shared_ptr<Host>(new Host(nativeHost, true, config));
     }
 
     auto Host::createClient(const HostConfig& config) -> std::shared_ptr<Host> {
@@ -37,21 +114,50 @@ namespace icelander {
             throw std::runtime_error("Failed to create ENet client host");
         }
 
-        if (config.enableCompression) {
-            enet_host_compress_with_range_coder(nativeHost);
-        }
+        installCompressor(nativeHost, config);
 
-        return std::shared_ptr<Host>(new Host(nativeHost, false));
+        return std::shared_ptr<Host>(new Host(nativeHost, false, config));
     }
 
-    Host::Host(ENetHost* nativeHost, bool isServer)
+    Host::Host(ENetHost* nativeHost, bool isServer, const HostConfig& config)
         : nativeHost_(nativeHost)
         , isServer_(isServer)
+        , config_(config)
         , dispatcher_(std::make_unique<EventDispatcher>())
-        , serviceThreadRunning_(false) {}
+        , peers_(nativeHost ? nativeHost->peerCount : 0)
+        , commands_(std::make_unique<detail::CommandQueue>())
+        , wakeup_(std::make_unique<detail::Wakeup>())
+        , serviceThreadRunning_(false)
+        , compressor_(detail::Compressor::fromHost(nativeHost))
+        , streams_(std::make_unique<detail::StreamTable>()) {
+        if (METRICS_ENABLED && nativeHost) {
+            metrics_ = std::make_unique<detail::HostMetricsStorage>(nativeHost->peerCount, nativeHost->channelLimit);
+        }
+        if (nativeHost) {
+            socket_ = detail::BatchedSocket::create(nativeHost->socket, config);
+            scheduler_ = detail::ChannelScheduler::create(config.channels, nativeHost->peerCount);
+            sparePeers_.resize(nativeHost->peerCount);
+        }
+        if (nativeHost && isServer) {
+            acceptGuard_ = detail::AcceptGuard::install(nativeHost, config.accept);
+            // Connect storms then cost no allocation beyond the endpoint index entry.
+            if (config.preallocatePeers) {
+                for (auto& spare : sparePeers_) {
+                    spare = std::make_shared<Peer>(nullptr, nullptr);
+                }
+            }
+        }
+    }
 
     Host::~Host() {
         stopServiceThread();
+        drainCommands();
+        for (const auto& peerWrapper : peers_.snapshot()) {
+            peerWrapper->awaitState_->close();
+        }
+        // Sends what is still queued and unhooks the socket before ENet closes it.
+        socket_.reset();
+        acceptGuard_.reset();
         if (nativeHost_) {
             enet_host_destroy(nativeHost_);
         }
@@ -63,41 +169,96 @@ namespace icelander {
         }
 
         ENetAddress address = remoteEndpoint.toEnetAddress();
-        ENetPeer* nativePeer = enet_host_connect(nativeHost_, &address, channels, connectData);
-
-        if (!nativePeer) {
-            throw std::runtime_error("Failed to initiate connection");
+        if (directAccess()) {
+            return connectNow(address, channels, connectData);
         }
 
-        auto peerWrapper = std::make_shared<Peer>(nativePeer, shared_from_this());
+        // The wrapper is registered on the service thread so a CONNECT event cannot race it.
+        detail::ConnectRequest request{address, channels, connectData, {}};
+        auto result = request.result.get_future();
 
-        {
-            std::lock_guard<std::mutex> lock(peersMutex_);
-            peers_.push_back(peerWrapper);
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::connect;
+        command->request = &request;
+        submit(command);
+
+        return result.get();
+    }
+
+    auto Host::connectAsync(const Endpoint& remoteEndpoint, size_t channels, uint32_t connectData) -> async::ConnectAwaiter {
+        if (!nativeHost_) {
+            throw std::runtime_error("Invalid host");
         }
+        return async::ConnectAwaiter(shared_from_this(), remoteEndpoint, channels, connectData);
+    }
 
-        return peerWrapper;
+    auto Host::connectAsync(const std::string& hostName, uint16_t port, size_t channels, uint32_t connectData) -> async::ConnectAwaiter {
+        if (!nativeHost_) {
+            throw std::runtime_error("Invalid host");
+        }
+        return async::ConnectAwaiter(shared_from_this(), hostName, port, channels, connectData);
     }
 
     auto Host::service(TimeoutMs timeout) -> int {
         if (!nativeHost_) {
             return 0;
         }
-
-        ENetEvent event;
-        int result = enet_host_service(nativeHost_, &event, static_cast<uint32_t>(timeout.count()));
-
-        if (result > 0) {
+        return serviceLoop(timeout, 1, [this](const ENetEvent& event) {
             processEvent(event);
+            return true;
+        });
+    }
+
+    auto Host::serviceAll(TimeoutMs timeout) -> int {
+        if (!nativeHost_) {
+            return 0;
         }
+        return serviceLoop(timeout, config_.maxEventsPerService, [this](const ENetEvent& event) {
+            processEvent(event);
+            return true;
+        });
+    }
 
-        return result;
+    auto Host::serviceBatch(std::span<Event> events, TimeoutMs timeout) -> int {
+        if (!nativeHost_ || events.empty()) {
+            return 0;
+        }
+        size_t count = 0;
+        return serviceLoop(timeout, events.size(), [this, events, &count](const ENetEvent& nativeEvent) {
+            // Stream chunks were consumed and come back as no event.
+            auto event = makeEvent(nativeEvent);
+            if (event.type == EventType::none) {
+                return false;
+            }
+            events[count++] = std::move(event);
+            return true;
+        });
     }
 
     auto Host::flush() -> void {
-        if (nativeHost_) {
-            enet_host_flush(nativeHost_);
+        if (!nativeHost_) {
+            return;
+        }
+
+        if (!directAccess()) {
+            auto command = detail::Command::make();
+            command->type = detail::CommandType::flush;
+            submit(command);
+            return;
+        }
+
+        drainCommands();
+        pumpOutgoing();
+        enet_host_flush(nativeHost_);
+        flushSocket();
+    }
+
+    auto Host::flushQueued() -> size_t {
+        size_t sent = 0;
+        for (const auto& peerWrapper : getPeers()) {
+            sent += peerWrapper->flushQueued();
         }
+        return sent;
     }
 
     auto Host::broadcast(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void {
@@ -105,50 +266,98 @@ namespace icelander {
             return;
         }
 
-        auto nativePacket = pkt->nativeHandle();
-        pkt.release();
-
-        enet_host_broadcast(nativeHost_, channel, nativePacket);
+        broadcastLatest(channel, 0, std::move(pkt));
     }
 
     auto Host::broadcast(std::unique_ptr<Packet> pkt) -> void {
         broadcast(0, std::move(pkt));
     }
 
+    auto Host::broadcastLatest(ChannelIdT channel, uint32_t key, std::unique_ptr<Packet> pkt) -> void {
+        if (!nativeHost_ || !pkt) {
+            return;
+        }
+
+        auto nativePacket = pkt->release();
+        if (directAccess()) {
+            broadcastNow(channel, key, nativePacket);
+            return;
+        }
+
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::broadcast;
+        command->channel = channel;
+        command->data = key;
+        command->packet = nativePacket;
+        submit(command);
+    }
+
+    auto Host::onStream(ChannelIdT channel, StreamHandler handler) -> void {
+        streams_->onStream(channel, std::move(handler));
+    }
+
+    auto Host::activeStreams() const -> size_t {
+        return streams_->active();
+    }
+
     auto Host::startServiceThread() -> void {
         if (serviceThreadRunning_) {
             return;
         }
 
+        if (!nativeHost_) {
+            return;
+        }
+
         serviceThreadRunning_ = true;
         serviceThread_ = std::make_unique<std::thread>(&Host::serviceThreadLoop, this);
+
+        if (config_.serviceThreadCpu >= 0) {
+            detail::pinThread(*serviceThread_, static_cast<size_t>(config_.serviceThreadCpu));
+        }
     }
 
     auto Host::stopServiceThread() -> void {
-        if (!serviceThreadRunning_) {
+        // A running tick loop has no thread to join; it hands the host back when it returns.
+        if (!serviceThreadRunning_ || !serviceThread_) {
             return;
         }
 
         serviceThreadRunning_ = false;
+        wakeup_->signal();
         if (serviceThread_ && serviceThread_->joinable()) {
             serviceThread_->join();
         }
         serviceThread_.reset();
+        serviceThreadId_ = std::thread::id();
+
+        // Anything queued while the thread was shutting down now runs on this thread.
+        drainCommands();
     }
 
     auto Host::isServiceThreadRunning() const -> bool {
         return serviceThreadRunning_;
     }
 
+    auto Host::pendingCommands() const -> size_t {
+        return commands_->size();
+    }
+
     auto Host::peerCount() const -> size_t {
         std::lock_guard<std::mutex> lock(peersMutex_);
-        size_t count = 0;
-        for (const auto& weakPeer : peers_) {
-            if (!weakPeer.expired()) {
-                ++count;
-            }
-        }
-        return count;
+        return peers_.size();
+    }
+
+    auto Host::compressionStats() const -> CompressionStats {
+        return compressor_ ? compressor_->stats() : CompressionStats{};
+    }
+
+    auto Host::acceptStats() const -> AcceptStats {
+        return acceptGuard_ ? acceptGuard_->stats() : AcceptStats{};
+    }
+
+    auto Host::socketBackend() const -> SocketBackend {
+        return socket_ ? SocketBackend::batched : SocketBackend::standard;
     }
 
     auto Host::isServer() const -> bool {
@@ -161,29 +370,17 @@ namespace icelander {
 
     auto Host::getPeers() -> std::vector<std::shared_ptr<Peer>> {
         std::lock_guard<std::mutex> lock(peersMutex_);
-        std::vector<std::shared_ptr<Peer>> activePeers;
-
-        for (auto it = peers_.begin(); it != peers_.end();) {
-            if (auto peerPtr = it->lock()) {
-                activePeers.push_back(peerPtr);
-                ++it;
-            } else {
-                it = peers_.erase(it);
-            }
-        }
+        return peers_.snapshot();
+    }
 
-        return activePeers;
+    auto Host::findPeer(PeerHandle handle) -> std::shared_ptr<Peer> {
+        std::lock_guard<std::mutex> lock(peersMutex_);
+        return peers_.find(handle);
     }
 
     auto Host::findPeer(const Endpoint& remoteEndpoint) -> std::shared_ptr<Peer> {
-        auto peers = getPeers();
-        for (const auto& peerPtr : peers) {
-            if (peerPtr->endpoint().host == remoteEndpoint.host &&
-                peerPtr->endpoint().port == remoteEndpoint.port) {
-                return peerPtr;
-            }
-        }
-        return nullptr;
+        std::lock_guard<std::mutex> lock(peersMutex_);
+        return peers_.find(remoteEndpoint);
     }
 
     auto Host::getDispatcher() -> EventDispatcher& {
@@ -195,69 +392,678 @@ namespace icelander {
     }
 
     void Host::serviceThreadLoop() {
+        serviceThreadId_ = std::this_thread::get_id();
+
+        auto waitMs = static_cast<uint32_t>(config_.serviceTimeout.count());
+        auto lastActivity = std::chrono::steady_clock::now();
+
         while (serviceThreadRunning_) {
-            service(std::chrono::milliseconds(10));
+            // Consume the wakeup before draining so a send racing with us re-arms it.
+            wakeup_->clear();
+            if (serviceAll(TimeoutMs{0}) > 0) {
+                lastActivity = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            if (config_.spinBudget.count() > 0 &&
+                std::chrono::steady_clock::now() - lastActivity < config_.spinBudget) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Datagrams the batched backend already read never wake the socket, and a
+            // stream whose window the last pass reopened should not wait for the timeout.
+            if ((socket_ && socket_->pending()) || streams_->ready()) {
+                continue;
+            }
+
+            // Sleep on the socket and the wakeup handle; ENet timers only need serviceTimeout.
+            wakeup_->wait(nativeHost_->socket, waitMs);
+            lastActivity = std::chrono::steady_clock::now();
+        }
+    }
+
+    auto Host::submit(detail::Command* command) -> void {
+        commands_->push(command);
+        wakeup_->signal();
+    }
+
+    auto Host::directAccess() const -> bool {
+        return !serviceThreadRunning_.load(std::memory_order_acquire) ||
+               serviceThreadId_.load(std::memory_order_acquire) == std::this_thread::get_id();
+    }
+
+    auto Host::sendTo(ENetPeer* nativePeer, uint32_t connectId, ChannelIdT channel, ENetPacket* nativePacket, uint32_t key) -> bool {
+        if (directAccess()) {
+            // The slot may already belong to a newer connection.
+            if (nativePeer->connectID != connectId) {
+                enet_packet_destroy(nativePacket);
+                return false;
+            }
+            return sendOrSchedule(nativePeer, channel, key, nativePacket);
+        }
+
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::send;
+        command->peer = nativePeer;
+        command->connectId = connectId;
+        command->channel = channel;
+        command->data = key;
+        command->packet = nativePacket;
+        submit(command);
+        return true;
+    }
+
+    auto Host::disconnectPeer(ENetPeer* nativePeer, uint32_t connectId, uint32_t disconnectData, DisconnectMode mode) -> void {
+        if (directAccess()) {
+            if (nativePeer->connectID != connectId) {
+                return;
+            }
+            switch (mode) {
+                case DisconnectMode::graceful: enet_peer_disconnect(nativePeer, disconnectData); break;
+                case DisconnectMode::now:
+                    enet_peer_disconnect_now(nativePeer, disconnectData);
+                    flushSocket();
+                    break;
+                case DisconnectMode::later: enet_peer_disconnect_later(nativePeer, disconnectData); break;
+            }
+            return;
+        }
+
+        auto command = detail::Command::make();
+        command->type = mode == DisconnectMode::now ? detail::CommandType::disconnectNow
+                      : mode == DisconnectMode::later ? detail::CommandType::disconnectLater
+                      : detail::CommandType::disconnect;
+        command->peer = nativePeer;
+        command->connectId = connectId;
+        command->data = disconnectData;
+        submit(command);
+    }
+
+    auto Host::broadcastNow(ChannelIdT channel, uint32_t key, ENetPacket* nativePacket) -> void {
+        if (recorder_) {
+            recordSend(CaptureType::broadcast, CAPTURE_ALL_PEERS, channel, 0, *nativePacket);
+        }
+        if (!scheduler_ || !scheduler_->schedules(channel)) {
+            size_t bytes = nativePacket->dataLength;
+            enet_host_broadcast(nativeHost_, channel, nativePacket);
+            if constexpr (METRICS_ENABLED) {
+                recordBroadcast(metrics_.get(), nativeHost_, channel, bytes);
+            }
+            return;
+        }
+
+        // Each peer's queue holds its own reference to the one packet.
+        for (size_t i = 0; i < nativeHost_->peerCount; ++i) {
+            if (nativeHost_->peers[i].state == ENET_PEER_STATE_CONNECTED) {
+                scheduler_->enqueue(&nativeHost_->peers[i], channel, key, nativePacket);
+            }
+        }
+        if (nativePacket->referenceCount == 0) {
+            enet_packet_destroy(nativePacket);
+        }
+    }
+
+    auto Host::sendToGroup(std::shared_ptr<const std::vector<PeerHandle>> members, ChannelIdT channel, ENetPacket* nativePacket) -> void {
+        if (directAccess()) {
+            sendGroupNow(*members, channel, nativePacket);
+            return;
+        }
+
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::groupSend;
+        command->channel = channel;
+        command->packet = nativePacket;
+        command->members = std::move(members);
+        submit(command);
+    }
+
+    auto Host::sendGroupNow(const std::vector<PeerHandle>& members, ChannelIdT channel, ENetPacket* nativePacket) -> void {
+        if (nativeHost_) {
+            if (recorder_) {
+                recordSend(CaptureType::groupSend, CAPTURE_ALL_PEERS, channel, static_cast<uint32_t>(members.size()), *nativePacket);
+            }
+            bool scheduled = scheduler_ && scheduler_->schedules(channel);
+            std::lock_guard<std::mutex> lock(peersMutex_);
+            for (auto handle : members) {
+                auto member = peers_.get(handle);
+                if (!member || member->nativePeer_->connectID != member->connectId_) {
+                    continue;
+                }
+                if (scheduled) {
+                    scheduler_->enqueue(member->nativePeer_, channel, 0, nativePacket);
+                    continue;
+                }
+                // Each queued send takes a reference; failures leave the count untouched.
+                if (enet_peer_send(member->nativePeer_, channel, nativePacket) == 0) {
+                    if constexpr (METRICS_ENABLED) {
+                        if (metrics_) {
+                            metrics_->recordSend(*member->nativePeer_, channel, nativePacket->dataLength);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (nativePacket->referenceCount == 0) {
+            enet_packet_destroy(nativePacket);
+        }
+    }
+
+    auto Host::connectNow(const AddressT& address, size_t channels, uint32_t connectData) -> std::shared_ptr<Peer> {
+        ENetPeer* nativePeer = enet_host_connect(nativeHost_, &address, channels, connectData);
+
+        if (!nativePeer) {
+            throw std::runtime_error("Failed to initiate connection");
+        }
+
+        auto peerWrapper = takePeer(nativePeer);
+
+        {
+            std::lock_guard<std::mutex> lock(peersMutex_);
+            peers_.insert(peerWrapper);
+        }
+
+        return peerWrapper;
+    }
+
+    auto Host::connectAwaiting(async::ConnectAwaiter& awaiter) -> void {
+        auto peerWrapper = connectNow(awaiter.remoteEndpoint_.toEnetAddress(), awaiter.channels_, awaiter.connectData_);
+        auto& state = *peerWrapper->awaitState_;
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.connectWaiter = &awaiter;
+    }
+
+    auto Host::startStream(ENetPeer* nativePeer, uint32_t connectId, ChannelIdT channel, std::unique_ptr<detail::OutgoingStream> stream) -> uint32_t {
+        stream->peer = nativePeer;
+        stream->connectId = connectId;
+        stream->channel = channel;
+        stream->id = streams_->nextId();
+        auto id = stream->id;
+
+        if (directAccess()) {
+            if (nativePeer->connectID != connectId) {
+                return 0;
+            }
+            streams_->start(std::move(stream));
+            return id;
+        }
+
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::startStream;
+        command->stream = stream.release();
+        submit(command);
+        return id;
+    }
+
+    auto Host::drainCommands() -> size_t {
+        size_t drained = 0;
+        while (auto command = commands_->pop()) {
+            execute(*command);
+            detail::Command::destroy(command);
+            ++drained;
         }
+        return drained;
     }
 
+    auto Host::execute(detail::Command& command) -> void {
+        // Commands aimed at a connection that has since gone away are dropped.
+        bool peerCurrent = command.peer && command.peer->connectID == command.connectId;
+
+        switch (command.type) {
+            case detail::CommandType::send:
+                if (!nativeHost_ || !peerCurrent) {
+                    enet_packet_destroy(command.packet);
+                } else {
+                    sendOrSchedule(command.peer, command.channel, command.data, command.packet);
+                }
+                break;
+
+            case detail::CommandType::broadcast:
+                if (nativeHost_) {
+                    broadcastNow(command.channel, command.data, command.packet);
+                } else {
+                    enet_packet_destroy(command.packet);
+                }
+                break;
+
+            case detail::CommandType::groupSend:
+                sendGroupNow(*command.members, command.channel, command.packet);
+                break;
+
+            case detail::CommandType::disconnect:
+                if (peerCurrent) {
+                    enet_peer_disconnect(command.peer, command.data);
+                }
+                break;
+
+            case detail::CommandType::disconnectNow:
+                if (peerCurrent) {
+                    enet_peer_disconnect_now(command.peer, command.data);
+                    flushSocket();
+                }
+                break;
+
+            case detail::CommandType::disconnectLater:
+                if (peerCurrent) {
+                    enet_peer_disconnect_later(command.peer, command.data);
+                }
+                break;
+
+            case detail::CommandType::connect: {
+                auto& request = *command.request;
+                try {
+                    request.result.set_value(connectNow(request.address, request.channels, request.connectData));
+                } catch (...) {
+                    request.result.set_exception(std::current_exception());
+                }
+                break;
+            }
+
+            case detail::CommandType::connectAsync: {
+                auto& awaiter = *command.connectAwaiter;
+                try {
+                    connectAwaiting(awaiter);
+                } catch (...) {
+                    awaiter.error_ = std::current_exception();
+                    detail::resumeLater(awaiter.handle_);
+                }
+                break;
+            }
+
+            case detail::CommandType::startStream:
+                // A stale peer fails the stream on the next pump.
+                streams_->start(std::unique_ptr<detail::OutgoingStream>(command.stream));
+                break;
+
+            case detail::CommandType::swapRecorder: {
+                auto& request = *command.recorderSwap;
+                std::swap(recorder_, request.recorder);
+                request.previous.set_value(std::move(request.recorder));
+                break;
+            }
+
+            case detail::CommandType::flush:
+                if (nativeHost_) {
+                    pumpOutgoing();
+                    enet_host_flush(nativeHost_);
+                    flushSocket();
+                }
+                break;
+        }
+    }
+
+    // Hands each event to its peer's strand, so handlers for one peer run in order on the
+    // scheduler while different peers run in parallel. Holds the host until they finish.
+    struct Host::ParallelSink {
+        Host& host;
+
+        template<auto Dispatch, typename E>
+        void post(E&& event) {
+            auto& strand = host.strandOf(*event.peerHandle);
+            strand.post([owner = host.shared_from_this(), event = std::forward<E>(event),
+                         received = host.serviceReturned_]() {
+                auto started = detail::metricsNow();
+                (owner->dispatcher_.get()->*Dispatch)(event);
+                if constexpr (METRICS_ENABLED) {
+                    owner->recordDispatch(received, started);
+                }
+            });
+        }
+
+        void dispatchConnect(ConnectEvent&& event) { post<&EventDispatcher::dispatchConnect>(std::move(event)); }
+        void dispatchDisconnect(DisconnectEvent&& event) { post<&EventDispatcher::dispatchDisconnect>(std::move(event)); }
+        void dispatchReceive(ReceiveEvent&& event) { post<&EventDispatcher::dispatchReceive>(std::move(event)); }
+    };
+
     auto Host::processEvent(const ENetEvent& event) -> void {
         if (!dispatcher_) {
             return;
         }
 
+        if (config_.parallelDispatch && async::TaskScheduler::instance().isRunning()) {
+            ParallelSink sink{*this};
+            routeEvent(event, sink);
+        } else {
+            routeEvent(event, *dispatcher_);
+        }
+    }
+
+    auto Host::strandOf(Peer& peer) -> detail::Strand& {
+        // Only the thread servicing the host posts, so lazy creation needs no lock.
+        if (!peer.strand_) {
+            peer.strand_ = std::make_shared<detail::Strand>();
+        }
+        return *peer.strand_;
+    }
+
+    auto Host::notifyConnected(const std::shared_ptr<Peer>& peer) -> void {
+        peer->awaitState_->connected(peer);
+    }
+
+    auto Host::retirePeer(ENetPeer* nativePeer, const std::shared_ptr<Peer>& peer) -> void {
+        {
+            std::lock_guard<std::mutex> lock(peersMutex_);
+            peers_.remove(nativePeer);
+        }
+        peer->awaitState_->close();
+        recyclePeer(peer);
+    }
+
+    auto Host::captureReceive(Peer& peer, ChannelIdT channel, std::unique_ptr<Packet>& pkt) -> bool {
+        // A consumed stream chunk is freed by the caller's wrapper.
+        return streams_->deliver(peer.handle(), channel, pkt->data()) || peer.awaitState_->deliver(channel, pkt);
+    }
+
+    auto Host::prepareEvent(const ENetEvent& event, EventRef& ref) -> bool {
+        ref.type = static_cast<EventType>(event.type);
+        ref.remoteEndpoint = Endpoint::fromEnetAddress(event.peer->address);
+        ref.channel = event.channelID;
+        ref.data = event.data;
+
         switch (event.type) {
-            case ENET_EVENT_TYPE_CONNECT: {
-                auto peerWrapper = std::make_shared<Peer>(event.peer, shared_from_this());
+            case ENET_EVENT_TYPE_CONNECT:
+                ref.peer = acceptPeer(event.peer)->handle();
+                return true;
+
+            case ENET_EVENT_TYPE_DISCONNECT: {
+                std::lock_guard<std::mutex> lock(peersMutex_);
+                auto peer = peers_.get(event.peer);
+                if (peer) {
+                    ref.peer = peer->handle();
+                }
+                return peer != nullptr;
+            }
+
+            case ENET_EVENT_TYPE_RECEIVE: {
+                if constexpr (METRICS_ENABLED) {
+                    recordReceive(*event.peer, event.channelID, event.packet->dataLength);
+                }
+                // Raw pointers are enough: only the thread servicing the host retires peers.
+                detail::PeerAwaitState* awaitState = nullptr;
                 {
                     std::lock_guard<std::mutex> lock(peersMutex_);
-                    peers_.push_back(peerWrapper);
+                    if (auto peer = peers_.get(event.peer)) {
+                        ref.peer = peer->handle();
+                        awaitState = peer->awaitState_.get();
+                    }
+                }
+                if (!awaitState || streams_->deliver(ref.peer, event.channelID, Span<const uint8_t>(event.packet->data, event.packet->dataLength))) {
+                    enet_packet_destroy(event.packet);
+                    return false;
                 }
 
-                ConnectEvent connectEvt;
-                connectEvt.peerHandle = peerWrapper;
-                connectEvt.remoteEndpoint = Endpoint::fromEnetAddress(event.peer->address);
-                connectEvt.data = event.data;
-                dispatcher_->dispatchConnect(connectEvt);
-                break;
+                // Only channels a coroutine receives on pay for a Packet wrapper.
+                if (awaitState->captures(event.channelID)) {
+                    auto packetWrapper = Packet::fromNative(event.packet);
+                    if (awaitState->deliver(event.channelID, packetWrapper)) {
+                        return false;
+                    }
+                    packetWrapper->release();
+                }
+                return true;
             }
 
+            default:
+                return false;
+        }
+    }
+
+    auto Host::finishEvent(const ENetEvent& event, const EventRef& ref) -> void {
+        if (event.type == ENET_EVENT_TYPE_CONNECT) {
+            if (auto peer = findPeer(ref.peer)) {
+                notifyConnected(peer);
+            }
+        } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            if (auto peer = findPeerByNative(event.peer)) {
+                retirePeer(event.peer, peer);
+            }
+        }
+    }
+
+    auto Host::makeEvent(const ENetEvent& nativeEvent) -> Event {
+        if (recorder_) {
+            recordEvent(nativeEvent);
+        }
+
+        Event event;
+        event.type = static_cast<EventType>(nativeEvent.type);
+        event.channel = nativeEvent.channelID;
+        event.data = nativeEvent.data;
+
+        switch (nativeEvent.type) {
+            case ENET_EVENT_TYPE_CONNECT:
+                event.peerHandle = acceptPeer(nativeEvent.peer);
+                event.remoteEndpoint = Endpoint::fromEnetAddress(nativeEvent.peer->address);
+                notifyConnected(event.peerHandle);
+                break;
+
             case ENET_EVENT_TYPE_DISCONNECT: {
-                auto peerWrapper = findPeerByNative(event.peer);
-                if (peerWrapper) {
-                    DisconnectEvent disconnectEvt;
-                    disconnectEvt.peerHandle = peerWrapper;
-                    disconnectEvt.remoteEndpoint = Endpoint::fromEnetAddress(event.peer->address);
-                    disconnectEvt.data = event.data;
-                    dispatcher_->dispatchDisconnect(disconnectEvt);
+                {
+                    std::lock_guard<std::mutex> lock(peersMutex_);
+                    event.peerHandle = peers_.remove(nativeEvent.peer);
+                }
+                event.remoteEndpoint = Endpoint::fromEnetAddress(nativeEvent.peer->address);
+                if (event.peerHandle) {
+                    event.peerHandle->awaitState_->close();
+                    recyclePeer(event.peerHandle);
                 }
                 break;
             }
 
-            case ENET_EVENT_TYPE_RECEIVE: {
-                auto peerWrapper = findPeerByNative(event.peer);
-                if (peerWrapper && event.packet) {
-                    auto packetWrapper = Packet::fromNative(event.packet);
-                    ReceiveEvent receiveEvt;
-                    receiveEvt.peerHandle = peerWrapper;
-                    receiveEvt.packetData = std::move(packetWrapper);
-                    receiveEvt.channel = event.channelID;
-                    dispatcher_->dispatchReceive(receiveEvt);
+            case ENET_EVENT_TYPE_RECEIVE:
+                if constexpr (METRICS_ENABLED) {
+                    recordReceive(*nativeEvent.peer, nativeEvent.channelID, nativeEvent.packet->dataLength);
+                }
+                event.packetData = Packet::fromNative(nativeEvent.packet);
+                event.peerHandle = findPeerByNative(nativeEvent.peer);
+                if (event.peerHandle && streams_->deliver(event.peerHandle->handle(), event.channel, event.packetData->data())) {
+                    return {};
                 }
                 break;
-            }
 
             default:
                 break;
         }
+
+        return event;
+    }
+
+    auto Host::acceptPeer(ENetPeer* nativePeer) -> std::shared_ptr<Peer> {
+        // Outgoing connections were registered by connect(); incoming ones are new.
+        std::lock_guard<std::mutex> lock(peersMutex_);
+        auto peerWrapper = peers_.findConnection(nativePeer);
+        if (!peerWrapper) {
+            peerWrapper = takePeer(nativePeer);
+            peers_.insert(peerWrapper);
+        }
+        if (metrics_) {
+            metrics_->resetSlot(*nativePeer);
+        }
+        return peerWrapper;
+    }
+
+    auto Host::takePeer(ENetPeer* nativePeer) -> std::shared_ptr<Peer> {
+        // Only the servicing thread touches the spares, and a spare nobody else holds
+        // cannot gain new references, so use_count() is exact here.
+        auto& spare = sparePeers_[nativePeer->incomingPeerID];
+        if (spare && spare.use_count() == 1) {
+            auto peerWrapper = std::move(spare);
+            peerWrapper->rebind(nativePeer, shared_from_this());
+            return peerWrapper;
+        }
+        // Still held by the application; let the new wrapper become the spare instead.
+        spare.reset();
+        return std::make_shared<Peer>(nativePeer, shared_from_this());
+    }
+
+    auto Host::recyclePeer(std::shared_ptr<Peer> peer) -> void {
+        auto nativePeer = peer->nativeHandle();
+        if (nativePeer && nativePeer->incomingPeerID < sparePeers_.size()) {
+            auto& spare = sparePeers_[nativePeer->incomingPeerID];
+            if (!spare) {
+                spare = std::move(peer);
+            }
+        }
     }
 
     auto Host::findPeerByNative(ENetPeer* nativePeer) -> std::shared_ptr<Peer> {
-        auto peers = getPeers();
-        for (const auto& peerPtr : peers) {
-            if (peerPtr->nativeHandle() == nativePeer) {
-                return peerPtr;
+        std::lock_guard<std::mutex> lock(peersMutex_);
+        return peers_.find(nativePeer);
+    }
+
+    auto Host::sendNative(ENetPeer* nativePeer, ChannelIdT channel, ENetPacket* nativePacket) -> bool {
+        if (recorder_) {
+            recordSend(CaptureType::send, nativePeer->incomingPeerID, channel, 0, *nativePacket);
+        }
+        size_t bytes = nativePacket->dataLength;
+        bool sent = detail::sendNow(nativePeer, channel, nativePacket);
+        if constexpr (METRICS_ENABLED) {
+            if (sent && metrics_) {
+                metrics_->recordSend(*nativePeer, channel, bytes);
+            }
+        }
+        return sent;
+    }
+
+    auto Host::sendOrSchedule(ENetPeer* nativePeer, ChannelIdT channel, uint32_t key, ENetPacket* nativePacket) -> bool {
+        if (scheduler_ && scheduler_->schedules(channel)) {
+            if (recorder_) {
+                recordSend(CaptureType::send, nativePeer->incomingPeerID, channel, 0, *nativePacket);
+            }
+            scheduler_->enqueue(nativePeer, channel, key, nativePacket);
+            return true;
+        }
+        return sendNative(nativePeer, channel, nativePacket);
+    }
+
+    auto Host::pumpOutgoing() -> void {
+        if (scheduler_) {
+            scheduler_->release(*this);
+        }
+        streams_->pump(*this);
+    }
+
+    auto Host::flushSocket() -> void {
+        if (socket_) {
+            socket_->flush();
+        }
+    }
+
+    auto Host::recordReceive(const ENetPeer& nativePeer, ChannelIdT channel, size_t bytes) -> void {
+        if (metrics_) {
+            metrics_->recordReceive(nativePeer, channel, bytes);
+        }
+    }
+
+    auto Host::recordService(Timestamp started) -> void {
+        if (!metrics_) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        metrics_->serviceIterations.add();
+        metrics_->serviceTime.record(now - started);
+        metrics_->sample(*nativeHost_, now, config_.metricsInterval);
+    }
+
+    auto Host::recordDispatch(Timestamp received, Timestamp started) -> void {
+        if (!metrics_) {
+            return;
+        }
+        metrics_->handlerLatency.record(started - received);
+        metrics_->dispatchTime.record(std::chrono::steady_clock::now() - started);
+    }
+
+    auto Host::metrics() const -> HostMetrics {
+        HostMetrics result;
+        result.pendingCommands = pendingCommands();
+        if (metrics_ && directAccess()) {
+            metrics_->sample(*nativeHost_, std::chrono::steady_clock::now(), config_.metricsInterval);
+        }
+        if (metrics_) {
+            metrics_->fillHost(result);
+        }
+
+        std::lock_guard<std::mutex> lock(peersMutex_);
+        for (const auto& peerWrapper : peers_.snapshot()) {
+            fillPeerMetrics(*peerWrapper, result.peers.emplace_back());
+        }
+        return result;
+    }
+
+    auto Host::peerMetrics(const Peer& peer) const -> PeerMetrics {
+        if (metrics_ && directAccess()) {
+            metrics_->sample(*nativeHost_, std::chrono::steady_clock::now(), config_.metricsInterval);
+        }
+
+        PeerMetrics result;
+        std::lock_guard<std::mutex> lock(peersMutex_);
+        fillPeerMetrics(peer, result);
+        return result;
+    }
+
+    auto Host::fillPeerMetrics(const Peer& peer, PeerMetrics& out) const -> void {
+        out.handle = peer.handle_;
+        out.endpoint = peer.endpoint();
+        // Slot counters belong to whichever registered peer holds the slot now.
+        if (metrics_ && peer.nativePeer_ && peers_.get(peer.handle_) == &peer) {
+            metrics_->fillPeer(*peer.nativePeer_, out);
+        }
+    }
+
+    auto async::ConnectAwaiter::await_suspend(std::coroutine_handle<> handle) -> bool {
+        handle_ = handle;
+
+        if (!hostName_.empty()) {
+            auto status = Resolver::instance().lookup(hostName_, remoteEndpoint_.port, remoteEndpoint_,
+                                                      [this](std::optional<Endpoint> endpoint) { resolved(endpoint); });
+            if (status == Resolver::Lookup::pending) {
+                return true;
+            }
+            if (status == Resolver::Lookup::failed) {
+                error_ = std::make_exception_ptr(std::runtime_error("Failed to resolve hostname: " + hostName_));
+                return false;
+            }
+        }
+
+        if (host_->directAccess()) {
+            try {
+                host_->connectAwaiting(*this);
+            } catch (...) {
+                error_ = std::current_exception();
+                return false;
             }
+            return true;
+        }
+
+        submitConnect();
+        return true;
+    }
+
+    auto async::ConnectAwaiter::resolved(std::optional<Endpoint> endpoint) -> void {
+        if (!endpoint) {
+            error_ = std::make_exception_ptr(std::runtime_error("Failed to resolve hostname: " + hostName_));
+            detail::resumeLater(handle_);
+            return;
+        }
+
+        // On a resolver worker: whichever thread services the host makes the connection.
+        remoteEndpoint_ = *endpoint;
+        submitConnect();
+    }
+
+    auto async::ConnectAwaiter::submitConnect() -> void {
+        // The service thread may resume us before submit() returns; touch nothing after it.
+        auto command = detail::Command::make();
+        command->type = detail::CommandType::connectAsync;
+        command->connectAwaiter = this;
+        host_->submit(command);
+    }
+
+    auto async::ConnectAwaiter::await_resume() -> std::shared_ptr<Peer> {
+        if (error_) {
+            std::rethrow_exception(error_);
         }
-        return nullptr;
+        return std::move(result_);
     }
 }
\ No newline at end of file
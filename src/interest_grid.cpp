@@ -0,0 +1,226 @@
+#include "icelander.hpp"
+#include <cmath>
+#include <stdexcept>
+
+namespace icelander {
+    namespace {
+        // Cell coordinates are packed into 21 bits each.
+        constexpr int32_t CELL_LIMIT = 1 << 20;
+        constexpr uint64_t CELL_MASK = (uint64_t{1} << 21) - 1;
+    }
+
+    InterestGrid::InterestGrid(std::shared_ptr<Host> host, float cellSize)
+        : host_(host)
+        , cellSize_(cellSize)
+        , recipients_(std::make_shared<std::vector<PeerHandle>>()) {
+        if (!host) {
+            throw std::runtime_error("Interest grid needs a host");
+        }
+        if (!(cellSize > 0.0f)) {
+            throw std::runtime_error("Interest grid cell size must be positive");
+        }
+    }
+
+    auto InterestGrid::update(const Peer& peer, const Position& position) -> void {
+        update(peer.handle(), position);
+    }
+
+    auto InterestGrid::update(PeerHandle handle, const Position& position) -> void {
+        if (!handle.valid()) {
+            return;
+        }
+
+        auto cell = keyOf(cellOf(position));
+        auto it = entries_.find(handle.slot);
+        if (it == entries_.end()) {
+            auto& entry = entries_.emplace(handle.slot, Entry{handle, position, cell, 0}).first->second;
+            link(handle.slot, entry);
+            return;
+        }
+
+        // A newer connection on the same slot takes the entry over.
+        auto& entry = it->second;
+        entry.handle = handle;
+        entry.position = position;
+        if (entry.cell != cell) {
+            unlink(entry);
+            entry.cell = cell;
+            link(handle.slot, entry);
+        }
+    }
+
+    auto InterestGrid::remove(const Peer& peer) -> bool {
+        return remove(peer.handle());
+    }
+
+    auto InterestGrid::remove(PeerHandle handle) -> bool {
+        auto it = entries_.find(handle.slot);
+        if (it == entries_.end() || it->second.handle != handle) {
+            return false;
+        }
+        unlink(it->second);
+        entries_.erase(it);
+        return true;
+    }
+
+    auto InterestGrid::contains(PeerHandle handle) const -> bool {
+        auto it = entries_.find(handle.slot);
+        return it != entries_.end() && it->second.handle == handle;
+    }
+
+    auto InterestGrid::position(PeerHandle handle) const -> std::optional<Position> {
+        auto it = entries_.find(handle.slot);
+        if (it == entries_.end() || it->second.handle != handle) {
+            return std::nullopt;
+        }
+        return it->second.position;
+    }
+
+    void InterestGrid::clear() {
+        entries_.clear();
+        cells_.clear();
+    }
+
+    auto InterestGrid::size() const -> size_t {
+        return entries_.size();
+    }
+
+    auto InterestGrid::query(const Position& center, float radius, std::vector<PeerHandle>& out) const -> size_t {
+        if (!(radius >= 0.0f)) {
+            return 0;
+        }
+
+        size_t found = 0;
+        float limit = radius * radius;
+        Position low{center.x - radius, center.y - radius, center.z - radius};
+        Position high{center.x + radius, center.y + radius, center.z + radius};
+        forEachIn(low, high, [&](const Entry& entry) {
+            float dx = entry.position.x - center.x;
+            float dy = entry.position.y - center.y;
+            float dz = entry.position.z - center.z;
+            if (dx * dx + dy * dy + dz * dz <= limit) {
+                out.push_back(entry.handle);
+                ++found;
+            }
+        });
+        return found;
+    }
+
+    auto InterestGrid::queryRegion(const Position& min, const Position& max, std::vector<PeerHandle>& out) const -> size_t {
+        size_t found = 0;
+        forEachIn(min, max, [&](const Entry& entry) {
+            const auto& p = entry.position;
+            if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z) {
+                out.push_back(entry.handle);
+                ++found;
+            }
+        });
+        return found;
+    }
+
+    auto InterestGrid::broadcastNear(const Position& center, float radius, ChannelIdT channel, std::unique_ptr<Packet> pkt) -> size_t {
+        auto& targets = recipients();
+        query(center, radius, targets);
+        return sendToRecipients(channel, std::move(pkt));
+    }
+
+    auto InterestGrid::broadcastRegion(const Position& min, const Position& max, ChannelIdT channel, std::unique_ptr<Packet> pkt) -> size_t {
+        auto& targets = recipients();
+        queryRegion(min, max, targets);
+        return sendToRecipients(channel, std::move(pkt));
+    }
+
+    auto InterestGrid::cellOf(const Position& position) const -> Cell {
+        auto coordinate = [this](float value) {
+            float cell = std::floor(value / cellSize_);
+            if (std::isnan(cell)) {
+                return int32_t{0};
+            }
+            // Far-off coordinates share the border cells; queries still check exact bounds.
+            return static_cast<int32_t>(std::clamp(cell, static_cast<float>(-CELL_LIMIT), static_cast<float>(CELL_LIMIT - 1)));
+        };
+        return Cell{coordinate(position.x), coordinate(position.y), coordinate(position.z)};
+    }
+
+    auto InterestGrid::keyOf(const Cell& cell) -> CellKey {
+        return ((static_cast<uint64_t>(static_cast<uint32_t>(cell[0])) & CELL_MASK) << 42) |
+               ((static_cast<uint64_t>(static_cast<uint32_t>(cell[1])) & CELL_MASK) << 21) |
+               (static_cast<uint64_t>(static_cast<uint32_t>(cell[2])) & CELL_MASK);
+    }
+
+    auto InterestGrid::link(PeerIdT slot, Entry& entry) -> void {
+        auto& members = cells_[entry.cell];
+        entry.index = members.size();
+        members.push_back(slot);
+    }
+
+    auto InterestGrid::unlink(const Entry& entry) -> void {
+        auto it = cells_.find(entry.cell);
+        auto& members = it->second;
+        // Swap-remove; order within a cell is not meaningful.
+        auto moved = members.back();
+        members[entry.index] = moved;
+        if (moved != entry.handle.slot) {
+            entries_.find(moved)->second.index = entry.index;
+        }
+        members.pop_back();
+        if (members.empty()) {
+            cells_.erase(it);
+        }
+    }
+
+    template<typename Visit>
+    auto InterestGrid::forEachIn(const Position& low, const Position& high, Visit&& visit) const -> void {
+        auto from = cellOf(low);
+        auto to = cellOf(high);
+        uint64_t span = 1;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            if (to[axis] < from[axis]) {
+                return;
+            }
+            span *= static_cast<uint64_t>(to[axis] - from[axis]) + 1;
+        }
+
+        // A volume spanning more cells than are occupied is cheaper to answer by scanning them.
+        if (span > cells_.size()) {
+            for (const auto& [key, members] : cells_) {
+                for (auto slot : members) {
+                    visit(entries_.find(slot)->second);
+                }
+            }
+            return;
+        }
+
+        for (int32_t x = from[0]; x <= to[0]; ++x) {
+            for (int32_t y = from[1]; y <= to[1]; ++y) {
+                for (int32_t z = from[2]; z <= to[2]; ++z) {
+                    auto it = cells_.find(keyOf(Cell{x, y, z}));
+                    if (it == cells_.end()) {
+                        continue;
+                    }
+                    for (auto slot : it->second) {
+                        visit(entries_.find(slot)->second);
+                    }
+                }
+            }
+        }
+    }
+
+    auto InterestGrid::recipients() -> std::vector<PeerHandle>& {
+        // Only this thread adds references, so a count of one cannot grow underneath us.
+        if (recipients_.use_count() > 1) {
+            recipients_ = std::make_shared<std::vector<PeerHandle>>();
+        }
+        recipients_->clear();
+        return *recipients_;
+    }
+
+    auto InterestGrid::sendToRecipients(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> size_t {
+        auto host = host_.lock();
+        if (!host || !pkt || recipients_->empty()) {
+            return 0;
+        }
+        host->sendToGroup(recipients_, channel, pkt->release());
+        return recipients_->size();
+    }
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "icelander.hpp"
+#include "allocator.hpp"
+#include "batched_socket.hpp"
+#include "compressor.hpp"
 #include <stdexcept>
 
 namespace icelander {
@@ -15,6 +18,25 @@ namespace icelander {
         return false;
     }
 
+    bool Library::initialize(const AllocatorConfig& config) {
+        if (initialized_) {
+            return true;
+        }
+
+        detail::configurePool(config);
+
+        ENetCallbacks callbacks{};
+        callbacks.malloc = detail::poolAllocate;
+        callbacks.free = detail::poolFree;
+
+        if (enet_initialize_with_callbacks(ENET_VERSION, &callbacks) == 0) {
+            initialized_ = true;
+            return true;
+        }
+
+        return false;
+    }
+
     void Library::deinitialize() {
         if (initialized_) {
             enet_deinitialize();
@@ -30,5 +52,17 @@ namespace icelander {
         return initialized_;
     }
 
+    auto Library::allocatorStats() -> AllocatorStats {
+        return detail::poolStats();
+    }
+
+    auto Library::supportsCompression(CompressionAlgorithm algorithm) -> bool {
+        return detail::Compressor::supports(algorithm);
+    }
+
+    auto Library::supportsSocketBackend(SocketBackend backend) -> bool {
+        return backend == SocketBackend::standard || detail::BatchedSocket::supported();
+    }
+
     // Static member definition - remove since it's inline in header
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace icelander::detail {
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string& path) {
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            file_ = nullptr;
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file_, &fileSize)) {
+            CloseHandle(file_);
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        size_ = static_cast<size_t>(fileSize.QuadPart);
+        if (size_ == 0) {
+            return;
+        }
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        auto view = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            if (mapping_) {
+                CloseHandle(mapping_);
+            }
+            CloseHandle(file_);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        data_ = static_cast<const uint8_t*>(view);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        if (file_) {
+            CloseHandle(file_);
+        }
+    }
+
+    MappedLog::MappedLog(const std::string& path, size_t capacity) : capacity_(capacity) {
+        file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            file_ = nullptr;
+            throw std::runtime_error("Failed to create file: " + path);
+        }
+
+        // Mapping past the end grows the file to capacity.
+        auto size = static_cast<uint64_t>(capacity_);
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                      static_cast<DWORD>(size), nullptr);
+        auto view = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+        if (!view) {
+            if (mapping_) {
+                CloseHandle(mapping_);
+            }
+            CloseHandle(file_);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        data_ = static_cast<uint8_t*>(view);
+    }
+
+    MappedLog::~MappedLog() {
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        LARGE_INTEGER length;
+        length.QuadPart = static_cast<LONGLONG>(length_);
+        SetFilePointerEx(file_, length, nullptr, FILE_BEGIN);
+        SetEndOfFile(file_);
+        CloseHandle(file_);
+    }
+#else
+    MappedFile::MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            return;
+        }
+
+        // The mapping outlives the descriptor.
+        void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        madvise(mapped, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t*>(mapped);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+    }
+
+    MappedLog::MappedLog(const std::string& path, size_t capacity) : capacity_(capacity) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Failed to create file: " + path);
+        }
+
+        void* mapped = MAP_FAILED;
+        if (ftruncate(fd_, static_cast<off_t>(capacity_)) == 0) {
+            mapped = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        }
+        if (mapped == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+        data_ = static_cast<uint8_t*>(mapped);
+    }
+
+    MappedLog::~MappedLog() {
+        munmap(data_, capacity_);
+        if (ftruncate(fd_, static_cast<off_t>(length_)) != 0) {
+            // Leaves the file at capacity; readers stop at the first empty record.
+        }
+        ::close(fd_);
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "icelander.hpp"
+
+namespace icelander::detail {
+    // Read-only mapping of a whole file; POSIX mmap or a Windows file mapping.
+    class MappedFile {
+    public:
+        // Throws std::runtime_error if the file cannot be opened or mapped.
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        auto data() const -> const uint8_t* { return data_; }
+        auto size() const -> size_t { return size_; }
+
+    private:
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+#ifdef _WIN32
+        void* file_ = nullptr;
+        void* mapping_ = nullptr;
+#endif
+    };
+
+    // Writable shared mapping of a new file, sized to capacity up front (sparse where the
+    // filesystem allows) and cut back to the bytes actually used when closed.
+    class MappedLog {
+    public:
+        // Throws std::runtime_error if the file cannot be created or mapped.
+        MappedLog(const std::string& path, size_t capacity);
+        ~MappedLog();
+
+        MappedLog(const MappedLog&) = delete;
+        MappedLog& operator=(const MappedLog&) = delete;
+
+        auto data() -> uint8_t* { return data_; }
+        auto capacity() const -> size_t { return capacity_; }
+        // Bytes to keep when the file is closed.
+        void setLength(size_t length) { length_ = std::min(length, capacity_); }
+
+    private:
+        uint8_t* data_ = nullptr;
+        size_t capacity_ = 0;
+        size_t length_ = 0;
+#ifdef _WIN32
+        void* file_ = nullptr;
+        void* mapping_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+    };
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "metrics.hpp"
+#include <bit>
+#include <sstream>
+
+namespace icelander {
+    namespace detail {
+        void Histogram::record(std::chrono::nanoseconds elapsed) {
+            auto micros = static_cast<uint64_t>(std::max<int64_t>(elapsed.count(), 0)) / 1000;
+            size_t bucket = std::min<size_t>(std::bit_width(micros), LatencyHistogram::bucketCount - 1);
+            buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            totalNanos_.fetch_add(elapsed.count(), std::memory_order_relaxed);
+        }
+
+        auto Histogram::snapshot() const -> LatencyHistogram {
+            LatencyHistogram result;
+            for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) {
+                result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+                result.count += result.buckets[i];
+            }
+            result.total = std::chrono::nanoseconds(totalNanos_.load(std::memory_order_relaxed));
+            return result;
+        }
+
+        auto ChannelCounters::snapshot() const -> ChannelMetrics {
+            return ChannelMetrics{packetsIn.load(), bytesIn.load(), packetsOut.load(), bytesOut.load()};
+        }
+
+        HostMetricsStorage::HostMetricsStorage(size_t peerCount, size_t channelLimit)
+            : channels_(std::make_unique<ChannelCounters[]>(channelLimit))
+            , channelLimit_(channelLimit)
+            , slots_(peerCount) {}
+
+        void HostMetricsStorage::resetSlot(const ENetPeer& nativePeer) {
+            if (nativePeer.incomingPeerID >= slots_.size()) {
+                return;
+            }
+
+            auto& slot = slots_[nativePeer.incomingPeerID];
+            // Grown only here, under the peer lock, so snapshots never see a stale array.
+            if (nativePeer.channelCount > slot.capacity) {
+                slot.channels = std::make_unique<ChannelCounters[]>(nativePeer.channelCount);
+                slot.capacity = nativePeer.channelCount;
+            } else {
+                for (size_t i = 0; i < slot.channelCount; ++i) {
+                    auto& counters = slot.channels[i];
+                    counters.packetsIn.set(0);
+                    counters.bytesIn.set(0);
+                    counters.packetsOut.set(0);
+                    counters.bytesOut.set(0);
+                }
+            }
+            slot.channelCount = nativePeer.channelCount;
+        }
+
+        void HostMetricsStorage::recordReceive(const ENetPeer& nativePeer, ChannelIdT channel, size_t bytes) {
+            if (channel < channelLimit_) {
+                channels_[channel].packetsIn.add();
+                channels_[channel].bytesIn.add(bytes);
+            }
+            if (nativePeer.incomingPeerID < slots_.size()) {
+                auto& slot = slots_[nativePeer.incomingPeerID];
+                if (channel < slot.channelCount) {
+                    slot.channels[channel].packetsIn.add();
+                    slot.channels[channel].bytesIn.add(bytes);
+                }
+            }
+        }
+
+        void HostMetricsStorage::recordSend(const ENetPeer& nativePeer, ChannelIdT channel, size_t bytes) {
+            if (channel < channelLimit_) {
+                channels_[channel].packetsOut.add();
+                channels_[channel].bytesOut.add(bytes);
+            }
+            if (nativePeer.incomingPeerID < slots_.size()) {
+                auto& slot = slots_[nativePeer.incomingPeerID];
+                if (channel < slot.channelCount) {
+                    slot.channels[channel].packetsOut.add();
+                    slot.channels[channel].bytesOut.add(bytes);
+                }
+            }
+        }
+
+        void HostMetricsStorage::sample(ENetHost& nativeHost, Timestamp now, std::chrono::milliseconds interval) {
+            if (now - lastSample_ < interval) {
+                return;
+            }
+            lastSample_ = now;
+
+            for (size_t i = 0; i < nativeHost.peerCount && i < slots_.size(); ++i) {
+                auto& nativePeer = nativeHost.peers[i];
+                if (nativePeer.state != ENET_PEER_STATE_CONNECTED) {
+                    continue;
+                }
+                auto& slot = slots_[i];
+                slot.roundTripTime.set(nativePeer.roundTripTime);
+                slot.roundTripTimeVariance.set(nativePeer.roundTripTimeVariance);
+                slot.packetLoss.set(nativePeer.packetLoss);
+                slot.packetThrottle.set(nativePeer.packetThrottle);
+                slot.reliableDataInTransit.set(nativePeer.reliableDataInTransit);
+                slot.queuedCommands.set(enet_list_size(&nativePeer.outgoingCommands) +
+                                        enet_list_size(&nativePeer.outgoingSendReliableCommands));
+            }
+        }
+
+        void HostMetricsStorage::fillHost(HostMetrics& out) const {
+            out.channels.resize(channelLimit_);
+            for (size_t i = 0; i < channelLimit_; ++i) {
+                out.channels[i] = channels_[i].snapshot();
+            }
+            out.serviceIterations = serviceIterations.load();
+            out.serviceTime = serviceTime.snapshot();
+            out.dispatchTime = dispatchTime.snapshot();
+            out.handlerLatency = handlerLatency.snapshot();
+        }
+
+        void HostMetricsStorage::fillPeer(const ENetPeer& nativePeer, PeerMetrics& out) const {
+            if (nativePeer.incomingPeerID >= slots_.size()) {
+                return;
+            }
+
+            const auto& slot = slots_[nativePeer.incomingPeerID];
+            out.channels.resize(slot.channelCount);
+            for (size_t i = 0; i < slot.channelCount; ++i) {
+                out.channels[i] = slot.channels[i].snapshot();
+            }
+            out.roundTripTime = std::chrono::milliseconds(slot.roundTripTime.load());
+            out.roundTripTimeVariance = std::chrono::milliseconds(slot.roundTripTimeVariance.load());
+            out.packetLoss = static_cast<double>(slot.packetLoss.load()) / static_cast<double>(ENET_PEER_PACKET_LOSS_SCALE);
+            out.packetThrottle = static_cast<uint32_t>(slot.packetThrottle.load());
+            out.reliableDataInTransit = static_cast<uint32_t>(slot.reliableDataInTransit.load());
+            out.queuedCommands = static_cast<size_t>(slot.queuedCommands.load());
+        }
+    }
+
+    namespace {
+        void writeHistogram(std::ostringstream& out, const std::string& name, const LatencyHistogram& histogram) {
+            out << "# TYPE " << name << " histogram\n";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i + 1 < LatencyHistogram::bucketCount; ++i) {
+                cumulative += histogram.buckets[i];
+                out << name << "_bucket{le=\"" << LatencyHistogram::upperBound(i).count() * 1e-6 << "\"} "
+                    << cumulative << "\n";
+            }
+            out << name << "_bucket{le=\"+Inf\"} " << histogram.count << "\n";
+            out << name << "_sum " << std::chrono::duration<double>(histogram.total).count() << "\n";
+            out << name << "_count " << histogram.count << "\n";
+        }
+    }
+
+    auto HostMetrics::toPrometheus(std::string_view prefix) const -> std::string {
+        std::ostringstream out;
+        std::string base(prefix);
+
+        const std::pair<const char*, uint64_t ChannelMetrics::*> channelSeries[] = {
+            {"_packets_received_total", &ChannelMetrics::packetsIn},
+            {"_bytes_received_total", &ChannelMetrics::bytesIn},
+            {"_packets_sent_total", &ChannelMetrics::packetsOut},
+            {"_bytes_sent_total", &ChannelMetrics::bytesOut},
+        };
+        for (const auto& [suffix, member] : channelSeries) {
+            out << "# TYPE " << base << suffix << " counter\n";
+            for (size_t channel = 0; channel < channels.size(); ++channel) {
+                if (channels[channel].packetsIn || channels[channel].packetsOut) {
+                    out << base << suffix << "{channel=\"" << channel << "\"} " << channels[channel].*member << "\n";
+                }
+            }
+        }
+
+        out << "# TYPE " << base << "_service_iterations_total counter\n";
+        out << base << "_service_iterations_total " << serviceIterations << "\n";
+        out << "# TYPE " << base << "_pending_commands gauge\n";
+        out << base << "_pending_commands " << pendingCommands << "\n";
+        out << "# TYPE " << base << "_peers gauge\n";
+        out << base << "_peers " << peers.size() << "\n";
+
+        writeHistogram(out, base + "_service_seconds", serviceTime);
+        writeHistogram(out, base + "_dispatch_seconds", dispatchTime);
+        writeHistogram(out, base + "_handler_latency_seconds", handlerLatency);
+
+        const std::pair<const char*, const char*> peerSeries[] = {
+            {"_peer_round_trip_seconds", "gauge"},
+            {"_peer_packet_loss_ratio", "gauge"},
+            {"_peer_packet_throttle", "gauge"},
+            {"_peer_reliable_in_transit_bytes", "gauge"},
+            {"_peer_queued_commands", "gauge"},
+        };
+        for (size_t series = 0; series < std::size(peerSeries); ++series) {
+            out << "# TYPE " << base << peerSeries[series].first << " " << peerSeries[series].second << "\n";
+            for (const auto& peer : peers) {
+                out << base << peerSeries[series].first << "{peer=\"" << peer.handle.slot << "\",endpoint=\""
+                    << peer.endpoint.toString() << "\"} ";
+                switch (series) {
+                    case 0: out << std::chrono::duration<double>(peer.roundTripTime).count(); break;
+                    case 1: out << peer.packetLoss; break;
+                    case 2: out << peer.packetThrottle; break;
+                    case 3: out << peer.reliableDataInTransit; break;
+                    default: out << peer.queuedCommands; break;
+                }
+                out << "\n";
+            }
+        }
+
+        return out.str();
+    }
+
+    auto async::SchedulerMetrics::toPrometheus(std::string_view prefix) const -> std::string {
+        std::ostringstream out;
+        std::string base(prefix);
+        out << "# TYPE " << base << "_scheduler_workers gauge\n" << base << "_scheduler_workers " << workers << "\n";
+        out << "# TYPE " << base << "_scheduler_pending_tasks gauge\n"
+            << base << "_scheduler_pending_tasks " << pendingTasks << "\n";
+        out << "# TYPE " << base << "_scheduler_tasks_executed_total counter\n"
+            << base << "_scheduler_tasks_executed_total " << tasksExecuted << "\n";
+        out << "# TYPE " << base << "_scheduler_tasks_stolen_total counter\n"
+            << base << "_scheduler_tasks_stolen_total " << tasksStolen << "\n";
+        out << "# TYPE " << base << "_scheduler_parks_total counter\n"
+            << base << "_scheduler_parks_total " << parks << "\n";
+        return out.str();
+    }
+}
\ No newline at end of file
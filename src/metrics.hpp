@@ -0,0 +1,90 @@
+#pragma once
+
+#include "icelander.hpp"
+
+namespace icelander::detail {
+    constexpr size_t CACHE_LINE = 64;
+
+    // Counter with one writer at a time: a plain load/store instead of a locked add, still
+    // safe to read from any thread.
+    class Counter {
+    public:
+        void add(uint64_t amount = 1) {
+            value_.store(value_.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        void set(uint64_t value) {
+            value_.store(value, std::memory_order_relaxed);
+        }
+
+        auto load() const -> uint64_t {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    // Recorded from any thread; parallel dispatch times handlers on scheduler workers.
+    class alignas(CACHE_LINE) Histogram {
+    public:
+        void record(std::chrono::nanoseconds elapsed);
+        auto snapshot() const -> LatencyHistogram;
+
+    private:
+        std::array<std::atomic<uint64_t>, LatencyHistogram::bucketCount> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<int64_t> totalNanos_{0};
+    };
+
+    struct ChannelCounters {
+        Counter packetsIn;
+        Counter bytesIn;
+        Counter packetsOut;
+        Counter bytesOut;
+
+        auto snapshot() const -> ChannelMetrics;
+    };
+
+    // Per-host storage, written by the thread servicing the host. Peer counters live in
+    // ENet slots and restart when a new connection takes the slot.
+    class HostMetricsStorage {
+    public:
+        HostMetricsStorage(size_t peerCount, size_t channelLimit);
+
+        // Call with the host's peer lock held, which snapshots also take.
+        void resetSlot(const ENetPeer& nativePeer);
+
+        void recordReceive(const ENetPeer& nativePeer, ChannelIdT channel, size_t bytes);
+        void recordSend(const ENetPeer& nativePeer, ChannelIdT channel, size_t bytes);
+        // Copies ENet's peer statistics once per interval.
+        void sample(ENetHost& nativeHost, Timestamp now, std::chrono::milliseconds interval);
+
+        void fillHost(HostMetrics& out) const;
+        void fillPeer(const ENetPeer& nativePeer, PeerMetrics& out) const;
+
+        Counter serviceIterations;
+        Histogram serviceTime;
+        Histogram dispatchTime;
+        Histogram handlerLatency;
+
+    private:
+        struct alignas(CACHE_LINE) Slot {
+            std::unique_ptr<ChannelCounters[]> channels;
+            size_t channelCount = 0;
+            size_t capacity = 0;
+
+            Counter roundTripTime;
+            Counter roundTripTimeVariance;
+            Counter packetLoss;
+            Counter packetThrottle;
+            Counter reliableDataInTransit;
+            Counter queuedCommands;
+        };
+
+        std::unique_ptr<ChannelCounters[]> channels_;
+        size_t channelLimit_;
+        std::vector<Slot> slots_;
+        Timestamp lastSample_{};
+    };
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace icelander::detail {
+    // Intrusive multi-producer/single-consumer queue (Vyukov). push() is wait-free for
+    // producers; only one consumer thread may pop(). Node needs an
+    // std::atomic<Node*> next member and a default constructor for the stub.
+    template<typename Node>
+    class MpscQueue {
+    public:
+        MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        void push(Node* node) noexcept {
+            size_.fetch_add(1, std::memory_order_relaxed);
+            link(node);
+        }
+
+        auto pop() noexcept -> Node* {
+            Node* tail = tail_;
+            Node* next = tail->next.load(std::memory_order_acquire);
+
+            if (tail == &stub_) {
+                if (!next) {
+                    return nullptr;
+                }
+                tail_ = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+
+            if (next) {
+                tail_ = next;
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return tail;
+            }
+
+            // A producer is between its exchange and its link; pick it up next drain.
+            if (tail != head_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+
+            link(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next) {
+                tail_ = next;
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return tail;
+            }
+            return nullptr;
+        }
+
+        auto size() const noexcept -> size_t {
+            return size_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void link(Node* node) noexcept {
+            node->next.store(nullptr, std::memory_order_relaxed);
+            Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_release);
+        }
+
+        Node stub_;
+        alignas(64) std::atomic<Node*> head_;
+        alignas(64) Node* tail_;
+        std::atomic<size_t> size_{0};
+    };
+}
\ No newline at end of file
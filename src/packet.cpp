@@ -1,9 +1,18 @@
 #include "icelander.hpp"
+#include "allocator.hpp"
 #include <stdexcept>
 #include <cstring>
 #include <algorithm>
+#include <new>
+#include <cmath>
 
 namespace icelander {
+    void detail::swapElementBytes(uint8_t* data, size_t count, size_t width) {
+        for (size_t i = 0; i < count; ++i, data += width) {
+            std::reverse(data, data + width);
+        }
+    }
+
     Packet::Packet(Span<const uint8_t> packetData, PacketFlagsT flags)
         : Packet(packetData.data(), packetData.size(), flags) {}
 
@@ -95,6 +104,10 @@ namespace icelander {
         return nativePacket_;
     }
 
+    auto Packet::release() -> ENetPacket* {
+        return std::exchange(nativePacket_, nullptr);
+    }
+
     auto Packet::fromNative(ENetPacket* nativePacket) -> std::unique_ptr<Packet> {
         if (!nativePacket) {
             return nullptr;
@@ -104,80 +117,216 @@ namespace icelander {
 
     Packet::Packet(ENetPacket* nativePacket) : nativePacket_(nativePacket) {}
 
+    // PacketRef implementation
+    auto PacketRef::data() const -> Span<const uint8_t> {
+        if (!nativePacket_) {
+            return Span<const uint8_t>(nullptr, 0);
+        }
+        return Span<const uint8_t>(nativePacket_->data, nativePacket_->dataLength);
+    }
+
+    auto PacketRef::size() const -> size_t {
+        return nativePacket_ ? nativePacket_->dataLength : 0;
+    }
+
+    auto PacketRef::flags() const -> PacketFlagsT {
+        return nativePacket_ ? nativePacket_->flags : 0;
+    }
+
+    auto PacketRef::empty() const -> bool {
+        return size() == 0;
+    }
+
+    auto PacketRef::retain() const -> std::unique_ptr<Packet> {
+        if (!loan_ || !loan_->packet) {
+            return nullptr;
+        }
+        return Packet::fromNative(std::exchange(loan_->packet, nullptr));
+    }
+
+    auto PacketRef::nativeHandle() const -> ENetPacket* {
+        return nativePacket_;
+    }
+
+    auto Packet::operator new(size_t size) -> void* {
+        if (auto memory = detail::poolAllocate(size)) {
+            return memory;
+        }
+        throw std::bad_alloc();
+    }
+
+    void Packet::operator delete(void* memory) noexcept {
+        detail::poolFree(memory);
+    }
+
     // PacketBuilder implementation
     PacketBuilder::PacketBuilder() = default;
 
-    PacketBuilder::PacketBuilder(size_t initialCapacity) {
-        buffer_.reserve(initialCapacity);
+    PacketBuilder::PacketBuilder(size_t initialCapacity) : nextCapacity_(initialCapacity) {}
+
+    PacketBuilder::~PacketBuilder() {
+        if (packet_) {
+            enet_packet_destroy(packet_);
+        }
     }
 
-    auto PacketBuilder::write(Span<const uint8_t> packetData) -> PacketBuilder& {
-        buffer_.insert(buffer_.end(), packetData.begin(), packetData.end());
+    PacketBuilder::PacketBuilder(PacketBuilder&& other) noexcept
+        : packet_(std::exchange(other.packet_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+        , capacity_(std::exchange(other.capacity_, 0))
+        , nextCapacity_(other.nextCapacity_) {}
+
+    PacketBuilder& PacketBuilder::operator=(PacketBuilder&& other) noexcept {
+        if (this != &other) {
+            if (packet_) {
+                enet_packet_destroy(packet_);
+            }
+            packet_ = std::exchange(other.packet_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+            nextCapacity_ = other.nextCapacity_;
+        }
         return *this;
     }
 
+    auto PacketBuilder::write(Span<const uint8_t> packetData) -> PacketBuilder& {
+        return write(packetData.data(), packetData.size());
+    }
+
     auto PacketBuilder::write(const std::string& packetData) -> PacketBuilder& {
-        auto bytes = reinterpret_cast<const uint8_t*>(packetData.data());
-        buffer_.insert(buffer_.end(), bytes, bytes + packetData.size());
-        return *this;
+        return write(packetData.data(), packetData.size());
     }
 
     auto PacketBuilder::write(const void* packetData, size_t size) -> PacketBuilder& {
-        auto bytes = static_cast<const uint8_t*>(packetData);
-        buffer_.insert(buffer_.end(), bytes, bytes + size);
+        if (size > 0) {
+            std::memcpy(append(size), packetData, size);
+        }
         return *this;
     }
 
     auto PacketBuilder::writeUint8(uint8_t value) -> PacketBuilder& {
-        buffer_.push_back(value);
+        *append(1) = value;
         return *this;
     }
 
     auto PacketBuilder::writeUint16(uint16_t value) -> PacketBuilder& {
+        value = detail::littleEndian(value);
         return write(&value, sizeof(value));
     }
 
     auto PacketBuilder::writeUint32(uint32_t value) -> PacketBuilder& {
+        value = detail::littleEndian(value);
         return write(&value, sizeof(value));
     }
 
     auto PacketBuilder::writeUint64(uint64_t value) -> PacketBuilder& {
+        value = detail::littleEndian(value);
         return write(&value, sizeof(value));
     }
 
+    auto PacketBuilder::writeVarUint(uint64_t value) -> PacketBuilder& {
+        uint8_t bytes[10];
+        size_t length = 0;
+        while (value >= 0x80) {
+            bytes[length++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        bytes[length++] = static_cast<uint8_t>(value);
+        return write(bytes, length);
+    }
+
+    auto PacketBuilder::writeVarInt(int64_t value) -> PacketBuilder& {
+        return writeVarUint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
     auto PacketBuilder::writeString(const std::string& str) -> PacketBuilder& {
         writeUint32(static_cast<uint32_t>(str.size()));
         return write(str);
     }
 
+    auto PacketBuilder::writeVarString(const std::string& str) -> PacketBuilder& {
+        writeVarUint(str.size());
+        return write(str);
+    }
+
     auto PacketBuilder::reserve(size_t capacity) -> PacketBuilder& {
-        buffer_.reserve(capacity);
+        if (capacity > capacity_) {
+            grow(capacity);
+        }
         return *this;
     }
 
     auto PacketBuilder::clear() -> PacketBuilder& {
-        buffer_.clear();
+        return reset();
+    }
+
+    auto PacketBuilder::reset() -> PacketBuilder& {
+        size_ = 0;
         return *this;
     }
 
     auto PacketBuilder::size() const -> size_t {
-        return buffer_.size();
+        return size_;
     }
 
     auto PacketBuilder::capacity() const -> size_t {
-        return buffer_.capacity();
+        return packet_ ? capacity_ : nextCapacity_;
     }
 
     auto PacketBuilder::empty() const -> bool {
-        return buffer_.empty();
+        return size_ == 0;
     }
 
     auto PacketBuilder::build(PacketFlagsT flags) -> std::unique_ptr<Packet> {
-        return Packet::create(Span<const uint8_t>(buffer_.data(), buffer_.size()), flags);
+        // The builder owns the packet data, so NO_ALLOCATE would leak it on destroy.
+        flags &= ~static_cast<PacketFlagsT>(ENET_PACKET_FLAG_NO_ALLOCATE);
+
+        if (!packet_) {
+            return Packet::create(nullptr, 0, flags);
+        }
+
+        // Shrinking is free in ENet; the spare capacity simply goes out with the packet.
+        packet_->dataLength = size_;
+        packet_->flags = flags;
+
+        nextCapacity_ = capacity_;
+        size_ = 0;
+        capacity_ = 0;
+        return Packet::fromNative(std::exchange(packet_, nullptr));
     }
 
     auto PacketBuilder::data() const -> Span<const uint8_t> {
-        return Span<const uint8_t>(buffer_.data(), buffer_.size());
+        return Span<const uint8_t>(packet_ ? packet_->data : nullptr, size_);
+    }
+
+    auto PacketBuilder::append(size_t bytes) -> uint8_t* {
+        if (size_ + bytes > capacity_) {
+            grow(size_ + bytes);
+        }
+
+        auto cursor = packet_->data + size_;
+        size_ += bytes;
+        return cursor;
+    }
+
+    void PacketBuilder::grow(size_t required) {
+        size_t newCapacity = std::max({required, capacity_ * 2, nextCapacity_, minimumCapacity});
+
+        if (!packet_) {
+            packet_ = enet_packet_create(nullptr, newCapacity, 0);
+            if (!packet_) {
+                throw std::runtime_error("Failed to allocate packet buffer");
+            }
+        } else {
+            // Only the written prefix needs to survive the reallocation.
+            packet_->dataLength = size_;
+            if (enet_packet_resize(packet_, newCapacity) != 0) {
+                packet_->dataLength = capacity_;
+                throw std::runtime_error("Failed to grow packet buffer");
+            }
+        }
+
+        capacity_ = newCapacity;
     }
 
     // PacketReader implementation
@@ -206,7 +355,7 @@ namespace icelander {
         if (!read(&value, sizeof(value))) {
             throw std::runtime_error("Not enough data to read uint16");
         }
-        return value;
+        return detail::littleEndian(value);
     }
 
     auto PacketReader::readUint32() -> uint32_t {
@@ -214,7 +363,7 @@ namespace icelander {
         if (!read(&value, sizeof(value))) {
             throw std::runtime_error("Not enough data to read uint32");
         }
-        return value;
+        return detail::littleEndian(value);
     }
 
     auto PacketReader::readUint64() -> uint64_t {
@@ -222,7 +371,31 @@ namespace icelander {
         if (!read(&value, sizeof(value))) {
             throw std::runtime_error("Not enough data to read uint64");
         }
-        return value;
+        return detail::littleEndian(value);
+    }
+
+    auto PacketReader::readVarUint() -> uint64_t {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (position_ >= data_.size()) {
+                throw std::runtime_error("Not enough data to read varint");
+            }
+            uint8_t byte = data_[position_++];
+            // The tenth byte may only carry the top bit of a 64-bit value.
+            if (shift == 63 && byte > 1) {
+                throw std::runtime_error("Varint overflows 64 bits");
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Varint overflows 64 bits");
+    }
+
+    auto PacketReader::readVarInt() -> int64_t {
+        uint64_t value = readVarUint();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
     }
 
     auto PacketReader::readString(size_t length) -> std::string {
@@ -234,6 +407,14 @@ namespace icelander {
         return result;
     }
 
+    auto PacketReader::readVarString() -> std::string {
+        uint64_t length = readVarUint();
+        if (length > remaining()) {
+            throw std::runtime_error("Not enough data to read string");
+        }
+        return readString(static_cast<size_t>(length));
+    }
+
     auto PacketReader::remaining() const -> size_t {
         return data_.size() - position_;
     }
@@ -266,4 +447,145 @@ namespace icelander {
     auto PacketReader::asString() const -> std::string {
         return std::string(reinterpret_cast<const char*>(data_.data()), data_.size());
     }
+
+    auto PacketReader::readView(size_t size) -> std::optional<Span<const uint8_t>> {
+        if (size > remaining()) {
+            return std::nullopt;
+        }
+        Span<const uint8_t> view(data_.data() + position_, size);
+        position_ += size;
+        return view;
+    }
+
+    auto BitWriter::writeBits(uint64_t value, unsigned bits) -> BitWriter& {
+        if (bits > 64) {
+            throw std::runtime_error("Cannot write more than 64 bits at once");
+        }
+
+        while (bits > 0) {
+            // Fewer than 8 bits are ever pending, so a 56-bit chunk always fits the scratch word.
+            unsigned chunk = std::min(bits, 56u);
+            scratch_ |= (value & ((uint64_t{1} << chunk) - 1)) << pending_;
+            pending_ += chunk;
+            bitsWritten_ += chunk;
+            value >>= chunk;
+            bits -= chunk;
+
+            unsigned whole = pending_ / 8;
+            if (whole > 0) {
+                uint8_t bytes[8];
+                for (unsigned i = 0; i < whole; ++i) {
+                    bytes[i] = static_cast<uint8_t>(scratch_ >> (8 * i));
+                }
+                builder_.write(bytes, whole);
+                scratch_ >>= 8 * whole;
+                pending_ -= 8 * whole;
+            }
+        }
+        return *this;
+    }
+
+    auto BitWriter::writeBool(bool value) -> BitWriter& {
+        return writeBits(value ? 1 : 0, 1);
+    }
+
+    auto BitWriter::writeQuantized(float value, float minimum, float maximum, unsigned bits) -> BitWriter& {
+        if (bits == 0 || bits > 32 || !(maximum > minimum)) {
+            throw std::runtime_error("Invalid quantization range");
+        }
+
+        uint64_t steps = (uint64_t{1} << bits) - 1;
+        double clamped = value >= minimum ? std::min(value, maximum) : minimum;  // NaN maps to minimum
+        double normalized = (clamped - minimum) / (static_cast<double>(maximum) - minimum);
+        return writeBits(static_cast<uint64_t>(std::llround(normalized * static_cast<double>(steps))), bits);
+    }
+
+    auto BitWriter::flush() -> BitWriter& {
+        if (pending_ > 0) {
+            builder_.writeUint8(static_cast<uint8_t>(scratch_));
+            scratch_ = 0;
+            pending_ = 0;
+        }
+        return *this;
+    }
+
+    auto BitWriter::bitsWritten() const -> size_t {
+        return bitsWritten_;
+    }
+
+    auto BitReader::readBits(unsigned bits) -> uint64_t {
+        if (bits > 64) {
+            throw std::runtime_error("Cannot read more than 64 bits at once");
+        }
+
+        uint64_t value = 0;
+        unsigned filled = 0;
+        while (filled < bits) {
+            if (available_ == 0) {
+                uint8_t byte;
+                if (!reader_.read(&byte, sizeof(byte))) {
+                    throw std::runtime_error("Not enough data to read bits");
+                }
+                scratch_ = byte;
+                available_ = 8;
+            }
+
+            unsigned take = std::min(available_, bits - filled);
+            value |= (scratch_ & ((uint64_t{1} << take) - 1)) << filled;
+            scratch_ >>= take;
+            available_ -= take;
+            filled += take;
+        }
+        return value;
+    }
+
+    auto BitReader::readBool() -> bool {
+        return readBits(1) != 0;
+    }
+
+    auto BitReader::readQuantized(float minimum, float maximum, unsigned bits) -> float {
+        if (bits == 0 || bits > 32 || !(maximum > minimum)) {
+            throw std::runtime_error("Invalid quantization range");
+        }
+
+        uint64_t steps = (uint64_t{1} << bits) - 1;
+        double normalized = static_cast<double>(readBits(bits)) / static_cast<double>(steps);
+        return static_cast<float>(minimum + normalized * (static_cast<double>(maximum) - minimum));
+    }
+
+    void BitReader::align() {
+        scratch_ = 0;
+        available_ = 0;
+    }
+
+    SubMessages::Iterator::Iterator(Span<const uint8_t> packetData) : reader_(packetData) {
+        advance();
+    }
+
+    auto SubMessages::Iterator::operator++() -> Iterator& {
+        advance();
+        return *this;
+    }
+
+    auto SubMessages::Iterator::operator++(int) -> Iterator {
+        Iterator previous = *this;
+        advance();
+        return previous;
+    }
+
+    void SubMessages::Iterator::advance() {
+        uint16_t length;
+        if (!reader_.read(&length, sizeof(length))) {
+            current_.reset();
+            return;
+        }
+        length = detail::littleEndian(length);
+
+        auto view = reader_.readView(length);
+        if (!view) {
+            current_.reset();
+            return;
+        }
+        current_.emplace(*view);
+    }
 }
\ No newline at end of file
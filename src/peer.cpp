@@ -1,9 +1,18 @@
 #include "icelander.hpp"
+#include "coalescer.hpp"
+#include "command_queue.hpp"
+#include "peer_await.hpp"
+#include "stream.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 namespace icelander {
     Peer::Peer(ENetPeer* nativePeer, std::shared_ptr<Host> hostPtr)
-        : nativePeer_(nativePeer), host_(hostPtr), userData_(nullptr) {}
+        : nativePeer_(nativePeer)
+        , host_(hostPtr)
+        , userData_(nullptr)
+        , connectId_(nativePeer ? nativePeer->connectID : 0)
+        , awaitState_(std::make_shared<detail::PeerAwaitState>()) {}
 
     Peer::~Peer() {
         userData_ = nullptr;
@@ -12,13 +21,23 @@ namespace icelander {
     Peer::Peer(Peer&& other) noexcept
         : nativePeer_(std::exchange(other.nativePeer_, nullptr))
         , host_(std::move(other.host_))
-        , userData_(std::exchange(other.userData_, nullptr)) {}
+        , userData_(std::exchange(other.userData_, nullptr))
+        , handle_(std::exchange(other.handle_, {}))
+        , connectId_(std::exchange(other.connectId_, 0))
+        , awaitState_(std::move(other.awaitState_))
+        , strand_(std::move(other.strand_))
+        , coalescer_(std::move(other.coalescer_)) {}
 
     Peer& Peer::operator=(Peer&& other) noexcept {
         if (this != &other) {
             nativePeer_ = std::exchange(other.nativePeer_, nullptr);
             host_ = std::move(other.host_);
             userData_ = std::exchange(other.userData_, nullptr);
+            handle_ = std::exchange(other.handle_, {});
+            connectId_ = std::exchange(other.connectId_, 0);
+            awaitState_ = std::move(other.awaitState_);
+            strand_ = std::move(other.strand_);
+            coalescer_ = std::move(other.coalescer_);
         }
         return *this;
     }
@@ -28,30 +47,109 @@ namespace icelander {
             return false;
         }
 
-        auto nativePacket = pkt->nativeHandle();
-        pkt.release();
+        auto nativePacket = pkt->release();
+        if (auto hostPtr = host_.lock()) {
+            return hostPtr->sendTo(nativePeer_, connectId_, channel, nativePacket);
+        }
+        return detail::sendNow(nativePeer_, channel, nativePacket);
+    }
+
+    auto Peer::sendLatest(ChannelIdT channel, uint32_t key, std::unique_ptr<Packet> pkt) -> bool {
+        if (!nativePeer_ || !pkt) {
+            return false;
+        }
 
-        return enet_peer_send(nativePeer_, channel, nativePacket) == 0;
+        auto nativePacket = pkt->release();
+        if (auto hostPtr = host_.lock()) {
+            return hostPtr->sendTo(nativePeer_, connectId_, channel, nativePacket, key);
+        }
+        return detail::sendNow(nativePeer_, channel, nativePacket);
     }
 
     auto Peer::send(std::unique_ptr<Packet> pkt) -> bool {
         return send(0, std::move(pkt));
     }
 
+    auto Peer::queueMessage(ChannelIdT channel, const void* message, size_t size, PacketFlagsT flags) -> bool {
+        if (!nativePeer_) {
+            return false;
+        }
+
+        if (!coalescer_) {
+            auto hostPtr = host_.lock();
+            coalescer_ = std::make_unique<detail::Coalescer>(hostPtr ? hostPtr->config_.coalesceLimit : HostConfig{}.coalesceLimit);
+        }
+
+        auto [batchChannel, ready] = coalescer_->append(channel, flags, message, size);
+        return !ready || send(batchChannel, std::move(ready));
+    }
+
+    auto Peer::flushQueued() -> size_t {
+        if (!coalescer_ || !nativePeer_) {
+            return 0;
+        }
+        return coalescer_->flush([this](ChannelIdT channel, std::unique_ptr<Packet> pkt) {
+            send(channel, std::move(pkt));
+        });
+    }
+
+    auto Peer::queuedMessages() const -> size_t {
+        return coalescer_ ? coalescer_->queued() : 0;
+    }
+
+    auto Peer::sendStream(ChannelIdT channel, Span<const uint8_t> data, StreamOptions options) -> uint32_t {
+        auto hostPtr = host_.lock();
+        if (!nativePeer_ || !hostPtr) {
+            return 0;
+        }
+        return hostPtr->startStream(nativePeer_, connectId_, channel, detail::makeStream(data, std::move(options)));
+    }
+
+    auto Peer::sendFile(ChannelIdT channel, const std::string& path, StreamOptions options) -> uint32_t {
+        auto hostPtr = host_.lock();
+        if (!nativePeer_ || !hostPtr) {
+            return 0;
+        }
+        return hostPtr->startStream(nativePeer_, connectId_, channel, detail::makeFileStream(path, std::move(options)));
+    }
+
     auto Peer::disconnect(uint32_t disconnectData) -> void {
-        if (nativePeer_) {
+        if (!nativePeer_) {
+            return;
+        }
+
+        if (auto hostPtr = host_.lock()) {
+            hostPtr->disconnectPeer(nativePeer_, connectId_, disconnectData, Host::DisconnectMode::graceful);
+        } else {
             enet_peer_disconnect(nativePeer_, disconnectData);
         }
     }
 
     auto Peer::disconnectNow(uint32_t disconnectData) -> void {
-        if (nativePeer_) {
+        if (!nativePeer_) {
+            return;
+        }
+
+        if (auto hostPtr = host_.lock()) {
+            hostPtr->disconnectPeer(nativePeer_, connectId_, disconnectData, Host::DisconnectMode::now);
+        } else {
             enet_peer_disconnect_now(nativePeer_, disconnectData);
         }
+
+        // ENet reports no DISCONNECT for an immediate disconnect.
+        if (awaitState_) {
+            awaitState_->close();
+        }
     }
 
     auto Peer::disconnectLater(uint32_t disconnectData) -> void {
-        if (nativePeer_) {
+        if (!nativePeer_) {
+            return;
+        }
+
+        if (auto hostPtr = host_.lock()) {
+            hostPtr->disconnectPeer(nativePeer_, connectId_, disconnectData, Host::DisconnectMode::later);
+        } else {
             enet_peer_disconnect_later(nativePeer_, disconnectData);
         }
     }
@@ -75,6 +173,16 @@ namespace icelander {
         if (nativePeer_) {
             enet_peer_reset(nativePeer_);
         }
+        if (awaitState_) {
+            awaitState_->close();
+        }
+    }
+
+    auto Peer::receive(ChannelIdT channel) -> async::ReceiveAwaiter {
+        if (!awaitState_) {
+            throw std::runtime_error("Invalid peer");
+        }
+        return async::ReceiveAwaiter(awaitState_, channel);
     }
 
     auto Peer::state() const -> PeerState {
@@ -83,7 +191,7 @@ namespace icelander {
 
     auto Peer::endpoint() const -> icelander::Endpoint {
         if (!nativePeer_) {
-            return {"", 0};
+            return {};
         }
         return icelander::Endpoint::fromEnetAddress(nativePeer_->address);
     }
@@ -92,6 +200,16 @@ namespace icelander {
         return nativePeer_ ? std::chrono::milliseconds(nativePeer_->roundTripTime) : std::chrono::milliseconds{0};
     }
 
+    auto Peer::metrics() const -> PeerMetrics {
+        if (auto hostPtr = host_.lock()) {
+            return hostPtr->peerMetrics(*this);
+        }
+        PeerMetrics result;
+        result.handle = handle_;
+        result.endpoint = endpoint();
+        return result;
+    }
+
     auto Peer::isConnected() const -> bool {
         return state() == PeerState::connected;
     }
@@ -123,10 +241,125 @@ namespace icelander {
         return host_.lock();
     }
 
+    auto Peer::handle() const -> PeerHandle {
+        return handle_;
+    }
+
+    auto Peer::rebind(ENetPeer* nativePeer, std::shared_ptr<Host> hostPtr) -> void {
+        nativePeer_ = nativePeer;
+        host_ = hostPtr;
+        userData_ = nullptr;
+        handle_ = {};
+        connectId_ = nativePeer->connectID;
+        coalescer_.reset();
+        // An old ReceiveAwaiter may still hold the previous connection's state.
+        if (awaitState_.use_count() == 1) {
+            awaitState_->reset();
+        } else {
+            awaitState_ = std::make_shared<detail::PeerAwaitState>();
+        }
+    }
+
     auto Peer::fromNative(ENetPeer* nativePeer, std::shared_ptr<Host> hostPtr) -> std::shared_ptr<Peer> {
         if (!nativePeer) {
             return nullptr;
         }
         return std::make_shared<Peer>(nativePeer, hostPtr);
     }
+
+    auto async::ReceiveAwaiter::await_suspend(std::coroutine_handle<> handle) -> bool {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->capturedChannels.set(channel_);
+
+        auto queued = std::find_if(state_->packets.begin(), state_->packets.end(),
+                                   [this](const auto& entry) { return entry.channel == channel_; });
+        if (queued != state_->packets.end()) {
+            result_ = std::move(queued->packet);
+            state_->packets.erase(queued);
+            return false;
+        }
+
+        if (state_->closed) {
+            return false;
+        }
+
+        handle_ = handle;
+        state_->receivers.push_back(this);
+        return true;
+    }
+
+    namespace detail {
+        auto PeerAwaitState::captures(ChannelIdT channel) -> bool {
+            std::lock_guard<std::mutex> lock(mutex);
+            return capturedChannels.test(channel);
+        }
+
+        auto PeerAwaitState::deliver(ChannelIdT channel, std::unique_ptr<Packet>& packet) -> bool {
+            std::coroutine_handle<> waiting;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!capturedChannels.test(channel)) {
+                    return false;
+                }
+
+                auto receiver = std::find_if(receivers.begin(), receivers.end(),
+                                             [channel](const auto* awaiter) { return awaiter->channel_ == channel; });
+                if (receiver == receivers.end()) {
+                    packets.push_back({channel, std::move(packet)});
+                    return true;
+                }
+
+                (*receiver)->result_ = std::move(packet);
+                waiting = (*receiver)->handle_;
+                receivers.erase(receiver);
+            }
+
+            resumeLater(waiting);
+            return true;
+        }
+
+        void PeerAwaitState::connected(const std::shared_ptr<Peer>& peer) {
+            std::coroutine_handle<> waiting;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!connectWaiter) {
+                    return;
+                }
+                connectWaiter->result_ = peer;
+                waiting = connectWaiter->handle_;
+                connectWaiter = nullptr;
+            }
+
+            resumeLater(waiting);
+        }
+
+        void PeerAwaitState::reset() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = false;
+            capturedChannels.reset();
+            packets.clear();
+            receivers.clear();
+            connectWaiter = nullptr;
+        }
+
+        void PeerAwaitState::close() {
+            std::vector<std::coroutine_handle<>> waiting;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                for (auto receiver : receivers) {
+                    waiting.push_back(receiver->handle_);
+                }
+                receivers.clear();
+                if (connectWaiter) {
+                    waiting.push_back(connectWaiter->handle_);
+                    connectWaiter = nullptr;
+                }
+            }
+
+            for (auto handle : waiting) {
+                resumeLater(handle);
+            }
+        }
+    }
 }
\ No newline at end of file
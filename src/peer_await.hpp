@@ -0,0 +1,33 @@
+#pragma once
+
+#include "icelander.hpp"
+#include <bitset>
+#include <deque>
+
+namespace icelander::detail {
+    // Coroutines suspended on a peer. Written by the host's service thread, read by
+    // whichever thread the awaiting coroutine runs on.
+    struct PeerAwaitState {
+        struct QueuedPacket {
+            ChannelIdT channel;
+            std::unique_ptr<Packet> packet;
+        };
+
+        std::mutex mutex;
+        bool closed = false;
+        // Channels some coroutine has received on; their packets bypass the dispatcher.
+        std::bitset<256> capturedChannels;
+        std::deque<QueuedPacket> packets;
+        std::vector<async::ReceiveAwaiter*> receivers;
+        async::ConnectAwaiter* connectWaiter = nullptr;
+
+        auto captures(ChannelIdT channel) -> bool;
+        // Returns false if the packet should go to the dispatcher instead.
+        auto deliver(ChannelIdT channel, std::unique_ptr<Packet>& packet) -> bool;
+        void connected(const std::shared_ptr<Peer>& peer);
+        // Resumes every waiter with an empty result; later receives complete immediately.
+        void close();
+        // Back to a fresh connection's state, for a recycled Peer.
+        void reset();
+    };
+}
\ No newline at end of file
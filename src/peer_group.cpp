@@ -0,0 +1,97 @@
+#include "icelander.hpp"
+#include <stdexcept>
+
+namespace icelander {
+    PeerGroup::PeerGroup(std::shared_ptr<Host> host)
+        : host_(host)
+        , members_(std::make_shared<std::vector<PeerHandle>>()) {
+        if (!host) {
+            throw std::runtime_error("Peer group needs a host");
+        }
+    }
+
+    auto PeerGroup::add(const Peer& peer) -> bool {
+        return add(peer.handle());
+    }
+
+    auto PeerGroup::add(PeerHandle handle) -> bool {
+        if (!handle.valid()) {
+            return false;
+        }
+
+        auto position = positions_.find(handle.slot);
+        if (position != positions_.end()) {
+            if ((*members_)[position->second] == handle) {
+                return false;
+            }
+            // The slot now belongs to a newer connection; replace the stale entry.
+            mutableMembers()[position->second] = handle;
+            return true;
+        }
+
+        auto& members = mutableMembers();
+        positions_.emplace(handle.slot, members.size());
+        members.push_back(handle);
+        return true;
+    }
+
+    auto PeerGroup::remove(const Peer& peer) -> bool {
+        return remove(peer.handle());
+    }
+
+    auto PeerGroup::remove(PeerHandle handle) -> bool {
+        auto position = positions_.find(handle.slot);
+        if (position == positions_.end() || (*members_)[position->second] != handle) {
+            return false;
+        }
+
+        // Swap-remove keeps removal O(1); member order is not meaningful.
+        auto& members = mutableMembers();
+        size_t index = position->second;
+        positions_.erase(position);
+        if (index != members.size() - 1) {
+            members[index] = members.back();
+            positions_[members[index].slot] = index;
+        }
+        members.pop_back();
+        return true;
+    }
+
+    auto PeerGroup::contains(PeerHandle handle) const -> bool {
+        auto position = positions_.find(handle.slot);
+        return position != positions_.end() && (*members_)[position->second] == handle;
+    }
+
+    void PeerGroup::clear() {
+        members_ = std::make_shared<std::vector<PeerHandle>>();
+        positions_.clear();
+    }
+
+    auto PeerGroup::size() const -> size_t {
+        return members_->size();
+    }
+
+    auto PeerGroup::empty() const -> bool {
+        return members_->empty();
+    }
+
+    auto PeerGroup::members() const -> const std::vector<PeerHandle>& {
+        return *members_;
+    }
+
+    auto PeerGroup::send(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void {
+        auto host = host_.lock();
+        if (!host || !pkt || members_->empty()) {
+            return;
+        }
+        host->sendToGroup(members_, channel, pkt->release());
+    }
+
+    auto PeerGroup::mutableMembers() -> std::vector<PeerHandle>& {
+        // Only this thread adds references, so a count of one cannot grow underneath us.
+        if (members_.use_count() > 1) {
+            members_ = std::make_shared<std::vector<PeerHandle>>(*members_);
+        }
+        return *members_;
+    }
+}
\ No newline at end of file
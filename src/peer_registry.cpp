@@ -0,0 +1,147 @@
+#include "icelander.hpp"
+#include <stdexcept>
+
+namespace icelander {
+    PeerRegistry::PeerRegistry(size_t capacity) : slots_(capacity) {
+        endpointIndex_.reserve(capacity);
+    }
+
+    auto PeerRegistry::insert(std::shared_ptr<Peer> peer) -> PeerHandle {
+        if (!peer || !peer->nativeHandle()) {
+            return {};
+        }
+
+        auto nativePeer = peer->nativeHandle();
+        size_t index = nativePeer->incomingPeerID;
+        if (index >= slots_.size()) {
+            throw std::runtime_error("Peer slot out of range for registry");
+        }
+
+        auto& slot = slots_[index];
+        if (slot.peer) {
+            // ENet reused the slot without reporting a disconnect (reset/disconnectNow).
+            slot.peer->handle_ = {};
+            unindex(index);
+            ++slot.generation;
+        } else {
+            ++activeCount_;
+        }
+
+        slot.peer = std::move(peer);
+        slot.remoteEndpoint = Endpoint::fromEnetAddress(nativePeer->address);
+        slot.connectId = nativePeer->connectID;
+        endpointIndex_[slot.remoteEndpoint] = static_cast<PeerIdT>(index);
+        slot.peer->handle_ = PeerHandle{static_cast<PeerIdT>(index), slot.generation};
+        return slot.peer->handle_;
+    }
+
+    auto PeerRegistry::remove(ENetPeer* nativePeer) -> std::shared_ptr<Peer> {
+        if (!nativePeer || nativePeer->incomingPeerID >= slots_.size()) {
+            return nullptr;
+        }
+
+        auto& slot = slots_[nativePeer->incomingPeerID];
+        if (!slot.peer) {
+            return nullptr;
+        }
+
+        auto removed = std::move(slot.peer);
+        removed->handle_ = {};
+        unindex(nativePeer->incomingPeerID);
+        slot.peer.reset();
+        ++slot.generation;
+        --activeCount_;
+        return removed;
+    }
+
+    auto PeerRegistry::find(ENetPeer* nativePeer) const -> std::shared_ptr<Peer> {
+        auto slot = slotFor(nativePeer);
+        return slot ? slot->peer : nullptr;
+    }
+
+    auto PeerRegistry::find(PeerHandle handle) const -> std::shared_ptr<Peer> {
+        if (!handle.valid() || handle.slot >= slots_.size()) {
+            return nullptr;
+        }
+
+        const auto& slot = slots_[handle.slot];
+        return slot.generation == handle.generation ? slot.peer : nullptr;
+    }
+
+    auto PeerRegistry::get(PeerHandle handle) const -> Peer* {
+        if (!handle.valid() || handle.slot >= slots_.size()) {
+            return nullptr;
+        }
+
+        const auto& slot = slots_[handle.slot];
+        return slot.generation == handle.generation ? slot.peer.get() : nullptr;
+    }
+
+    auto PeerRegistry::get(ENetPeer* nativePeer) const -> Peer* {
+        auto slot = slotFor(nativePeer);
+        return slot ? slot->peer.get() : nullptr;
+    }
+
+    auto PeerRegistry::find(const Endpoint& remoteEndpoint) const -> std::shared_ptr<Peer> {
+        auto it = endpointIndex_.find(remoteEndpoint);
+        return it != endpointIndex_.end() ? slots_[it->second].peer : nullptr;
+    }
+
+    auto PeerRegistry::findConnection(ENetPeer* nativePeer) const -> std::shared_ptr<Peer> {
+        auto slot = slotFor(nativePeer);
+        return slot && slot->connectId == nativePeer->connectID ? slot->peer : nullptr;
+    }
+
+    auto PeerRegistry::size() const -> size_t {
+        return activeCount_;
+    }
+
+    auto PeerRegistry::capacity() const -> size_t {
+        return slots_.size();
+    }
+
+    auto PeerRegistry::snapshot() const -> std::vector<std::shared_ptr<Peer>> {
+        std::vector<std::shared_ptr<Peer>> activePeers;
+        activePeers.reserve(activeCount_);
+
+        for (const auto& slot : slots_) {
+            if (slot.peer) {
+                activePeers.push_back(slot.peer);
+            }
+        }
+
+        return activePeers;
+    }
+
+    void PeerRegistry::clear() {
+        for (auto& slot : slots_) {
+            if (slot.peer) {
+                slot.peer->handle_ = {};
+                slot.peer.reset();
+                ++slot.generation;
+            }
+        }
+        endpointIndex_.clear();
+        activeCount_ = 0;
+    }
+
+    auto PeerRegistry::slotFor(ENetPeer* nativePeer) const -> const Slot* {
+        if (!nativePeer || nativePeer->incomingPeerID >= slots_.size()) {
+            return nullptr;
+        }
+
+        // connectID is not compared here: ENet zeroes it before reporting a disconnect.
+        const auto& slot = slots_[nativePeer->incomingPeerID];
+        if (!slot.peer || slot.peer->nativeHandle() != nativePeer) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    void PeerRegistry::unindex(size_t index) {
+        auto it = endpointIndex_.find(slots_[index].remoteEndpoint);
+        if (it != endpointIndex_.end() && it->second == index) {
+            endpointIndex_.erase(it);
+        }
+    }
+}
\ No newline at end of file
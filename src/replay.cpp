@@ -0,0 +1,328 @@
+#include "capture.hpp"
+#include <deque>
+
+namespace icelander {
+    namespace {
+        constexpr PacketFlagsT REPLAYED_FLAGS = ENET_PACKET_FLAG_RELIABLE | ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT;
+        constexpr auto SERVICE_SLICE = std::chrono::milliseconds(1);
+
+        // Client connections standing in for the peers of a capture, spread over hosts
+        // of ReplayConfig::peersPerHost connections each.
+        class Fleet {
+        public:
+            Fleet(const Endpoint& target, const ReplayConfig& config, size_t channels, size_t largestUnstored)
+                : target_(target)
+                , config_(config)
+                , channels_(channels)
+                , zeros_(largestUnstored) {}
+
+            auto replays(CaptureType type) const -> bool {
+                return type == (config_.replaySends ? CaptureType::send : CaptureType::receive);
+            }
+
+            auto deliver(const CaptureLog::Entry& entry) -> void {
+                const auto& record = entry.record;
+                switch (record.type) {
+                    case CaptureType::connect:
+                        // The slot was reused without a disconnect record.
+                        if (auto it = sessions_.find(record.peer); it != sessions_.end()) {
+                            stats.skipped += it->second.held.size();
+                            retire(it->second, 0);
+                            sessions_.erase(it);
+                        }
+                        open(record.peer, record.data);
+                        break;
+
+                    case CaptureType::disconnect:
+                        close(record.peer, record.data);
+                        break;
+
+                    case CaptureType::broadcast:
+                        if (config_.replaySends) {
+                            for (auto& [slot, session] : sessions_) {
+                                route(session, entry);
+                            }
+                        }
+                        break;
+
+                    case CaptureType::groupSend:
+                        // The members are not in the capture.
+                        if (config_.replaySends) {
+                            ++stats.skipped;
+                        }
+                        break;
+
+                    default:
+                        if (replays(record.type)) {
+                            // A capture started mid-connection has no connect record.
+                            auto it = sessions_.find(record.peer);
+                            route(it != sessions_.end() ? it->second : open(record.peer, 0), entry);
+                        }
+                        break;
+                }
+            }
+
+            auto service() -> void {
+                for (const auto& host : hosts_) {
+                    host->serviceAll(TimeoutMs{0});
+                }
+
+                for (auto it = sessions_.begin(); it != sessions_.end();) {
+                    auto& session = it->second;
+                    if (session.peer->isConnected()) {
+                        while (!session.held.empty()) {
+                            send(session, session.held.front());
+                            session.held.pop_front();
+                        }
+                        if (session.closing) {
+                            retire(session, session.disconnectData);
+                            it = sessions_.erase(it);
+                            continue;
+                        }
+                    } else if (session.peer->isDisconnected()) {
+                        stats.skipped += session.held.size();
+                        --load_[session.host];
+                        it = sessions_.erase(it);
+                        continue;
+                    }
+                    ++it;
+                }
+
+                std::erase_if(closing_, [this](const Closing& closing) {
+                    if (!closing.peer->isDisconnected()) {
+                        return false;
+                    }
+                    --load_[closing.host];
+                    return true;
+                });
+            }
+
+            auto serviceUntil(Timestamp deadline) -> void {
+                // Records already due are sent in bursts, servicing once per slice.
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline && now - serviced_ < SERVICE_SLICE) {
+                    return;
+                }
+                while (true) {
+                    service();
+                    now = serviced_ = std::chrono::steady_clock::now();
+                    if (now >= deadline) {
+                        return;
+                    }
+                    std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(deadline - now, SERVICE_SLICE));
+                }
+            }
+
+            auto holding() const -> bool {
+                return std::any_of(sessions_.begin(), sessions_.end(), [](const auto& item) { return !item.second.held.empty(); });
+            }
+
+            auto disconnectAll() -> void {
+                for (auto& [slot, session] : sessions_) {
+                    stats.skipped += session.held.size();
+                    retire(session, session.disconnectData);
+                }
+                sessions_.clear();
+            }
+
+            auto idle() const -> bool {
+                return sessions_.empty() && closing_.empty();
+            }
+
+            ReplayStats stats;
+
+        private:
+            struct Session {
+                std::shared_ptr<Peer> peer;
+                size_t host = 0;
+                std::deque<CaptureLog::Entry> held;     // due before the connection completed
+                bool closing = false;                   // disconnect once held is empty
+                uint32_t disconnectData = 0;
+            };
+
+            struct Closing {
+                std::shared_ptr<Peer> peer;
+                size_t host = 0;
+            };
+
+            auto open(PeerIdT slot, uint32_t connectData) -> Session& {
+                auto host = std::find_if(load_.begin(), load_.end(), [this](size_t load) { return load < config_.peersPerHost; });
+                if (host == load_.end()) {
+                    auto hostConfig = config_.host;
+                    hostConfig.maxPeers = std::max<size_t>(config_.peersPerHost, 1);
+                    hostConfig.maxChannels = channels_;
+                    hosts_.push_back(Host::createClient(hostConfig));
+                    load_.push_back(0);
+                    host = load_.end() - 1;
+                }
+
+                auto index = static_cast<size_t>(host - load_.begin());
+                auto& session = sessions_[slot];
+                session.peer = hosts_[index]->connect(target_, channels_, connectData);
+                session.host = index;
+                ++load_[index];
+                ++stats.sessions;
+                return session;
+            }
+
+            auto close(PeerIdT slot, uint32_t disconnectData) -> void {
+                auto it = sessions_.find(slot);
+                if (it == sessions_.end()) {
+                    return;
+                }
+
+                auto& session = it->second;
+                if (!session.held.empty() && !session.peer->isDisconnected()) {
+                    session.closing = true;
+                    session.disconnectData = disconnectData;
+                    return;
+                }
+                retire(session, disconnectData);
+                sessions_.erase(it);
+            }
+
+            auto retire(Session& session, uint32_t disconnectData) -> void {
+                // A plain disconnect would discard the packets just handed to ENet.
+                session.peer->disconnectLater(disconnectData);
+                closing_.push_back({std::move(session.peer), session.host});
+            }
+
+            auto route(Session& session, const CaptureLog::Entry& entry) -> void {
+                if (session.closing) {
+                    ++stats.skipped;
+                } else if (session.held.empty() && session.peer->isConnected()) {
+                    send(session, entry);
+                } else {
+                    session.held.push_back(entry);
+                }
+            }
+
+            auto send(Session& session, const CaptureLog::Entry& entry) -> void {
+                const auto& record = entry.record;
+                // The packet borrows the mapping; ENet never writes to packet data.
+                auto payload = entry.payload.size() == record.packetSize ? entry.payload.data() : zeros_.data();
+                auto nativePacket = enet_packet_create(payload, record.packetSize, (record.flags & REPLAYED_FLAGS) | ENET_PACKET_FLAG_NO_ALLOCATE);
+                if (nativePacket && session.peer->send(record.channel, Packet::fromNative(nativePacket))) {
+                    ++stats.packets;
+                    stats.bytes += record.packetSize;
+                } else {
+                    ++stats.skipped;
+                }
+            }
+
+            Endpoint target_;
+            const ReplayConfig& config_;
+            size_t channels_;
+            std::vector<uint8_t> zeros_;    // stands in for payloads the capture left out; never resized
+            std::vector<std::shared_ptr<Host>> hosts_;
+            std::vector<size_t> load_;      // open connections per host
+            std::unordered_map<PeerIdT, Session> sessions_;
+            std::vector<Closing> closing_;
+            Timestamp serviced_{};
+        };
+    }
+
+    CaptureLog::CaptureLog(const std::string& path) : file_(std::make_unique<detail::MappedFile>(path)) {
+        uint32_t version = 0;
+        if (file_->size() >= CAPTURE_FILE_HEADER_SIZE) {
+            std::memcpy(&version, file_->data() + CAPTURE_MAGIC.size(), sizeof(version));
+        }
+        if (file_->size() < CAPTURE_FILE_HEADER_SIZE ||
+            std::memcmp(file_->data(), CAPTURE_MAGIC.data(), CAPTURE_MAGIC.size()) != 0 ||
+            detail::littleEndian(version) != CAPTURE_VERSION) {
+            throw std::runtime_error("Not a capture file: " + path);
+        }
+    }
+
+    CaptureLog::~CaptureLog() = default;
+
+    auto CaptureLog::begin() const -> Iterator {
+        return Iterator(Span<const uint8_t>(file_->data() + CAPTURE_FILE_HEADER_SIZE, file_->size() - CAPTURE_FILE_HEADER_SIZE));
+    }
+
+    CaptureLog::Iterator::Iterator(Span<const uint8_t> records) : cursor_(records.data()), end_(records.data() + records.size()) {
+        decode();
+    }
+
+    auto CaptureLog::Iterator::operator++() -> Iterator& {
+        cursor_ += entry_.record.length;
+        decode();
+        return *this;
+    }
+
+    auto CaptureLog::Iterator::operator++(int) -> Iterator {
+        Iterator previous = *this;
+        ++*this;
+        return previous;
+    }
+
+    void CaptureLog::Iterator::decode() {
+        size_t remaining = static_cast<size_t>(end_ - cursor_);
+        if (remaining < sizeof(CaptureRecord)) {
+            cursor_ = nullptr;
+            return;
+        }
+
+        CaptureRecord record;
+        std::memcpy(&record, cursor_, sizeof(record));
+        record = detail::littleEndianRecord(record);
+        // A zero length is the unwritten tail of a file that could not be trimmed.
+        if (record.length < sizeof(CaptureRecord) || record.length > remaining || (record.length & 7) != 0 ||
+            record.size > record.length - sizeof(CaptureRecord)) {
+            cursor_ = nullptr;
+            return;
+        }
+        entry_ = Entry{record, Span<const uint8_t>(cursor_ + sizeof(CaptureRecord), record.size)};
+    }
+
+    auto replayCapture(const CaptureLog& log, const Endpoint& target, const ReplayConfig& config) -> ReplayStats {
+        size_t channels = 1;
+        size_t largestUnstored = 0;
+        for (const auto& entry : log) {
+            const auto& record = entry.record;
+            if (record.type == CaptureType::receive || record.type == CaptureType::send || record.type == CaptureType::broadcast) {
+                channels = std::max<size_t>(channels, record.channel + 1);
+                if (record.size < record.packetSize) {
+                    largestUnstored = std::max<size_t>(largestUnstored, record.packetSize);
+                }
+            }
+        }
+
+        Fleet fleet(target, config, channels, largestUnstored);
+        auto started = std::chrono::steady_clock::now();
+        std::optional<int64_t> firstTime;
+
+        for (const auto& entry : log) {
+            if (!firstTime) {
+                firstTime = entry.record.time;
+            }
+            auto due = started;
+            if (config.speed > 0) {
+                auto offset = static_cast<double>(entry.record.time - *firstTime) / config.speed;
+                due += std::chrono::nanoseconds(static_cast<int64_t>(offset));
+            }
+            fleet.serviceUntil(due);
+            if (config.speed > 0) {
+                auto lag = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - due);
+                fleet.stats.maxLag = std::max(fleet.stats.maxLag, lag);
+            }
+            fleet.deliver(entry);
+        }
+
+        // Held records wait for their connections, then everything disconnects; each
+        // phase gets at most drainTime.
+        auto deadline = std::chrono::steady_clock::now() + config.drainTime;
+        do {
+            fleet.serviceUntil(std::chrono::steady_clock::now() + SERVICE_SLICE);
+        } while (fleet.holding() && std::chrono::steady_clock::now() < deadline);
+
+        fleet.disconnectAll();
+        deadline = std::chrono::steady_clock::now() + config.drainTime;
+        while (!fleet.idle() && std::chrono::steady_clock::now() < deadline) {
+            fleet.serviceUntil(std::chrono::steady_clock::now() + SERVICE_SLICE);
+        }
+
+        fleet.stats.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+        return fleet.stats;
+    }
+}
\ No newline at end of file
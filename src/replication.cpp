@@ -0,0 +1,234 @@
+#include "icelander.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ICELANDER_DELTA_SSE2 1
+#endif
+
+namespace icelander {
+    namespace {
+        constexpr size_t WORD_SIZE = 8;
+
+        auto wordCount(size_t stateSize) -> size_t {
+            return (stateSize + WORD_SIZE - 1) / WORD_SIZE;
+        }
+
+        auto maskSize(size_t stateSize) -> size_t {
+            return (wordCount(stateSize) + 7) / 8;
+        }
+
+        // Sequence numbers wrap; a is newer if it is less than half the space ahead of b.
+        auto isNewer(uint16_t a, uint16_t b) -> bool {
+            return static_cast<int16_t>(a - b) > 0;
+        }
+
+        // delta = state ^ base, with one mask bit set per 8-byte word that differs.
+        void diffWords(const uint8_t* state, const uint8_t* base, uint8_t* delta, uint8_t* mask, size_t size) {
+            std::memset(mask, 0, maskSize(size));
+            size_t offset = 0;
+
+#ifdef ICELANDER_DELTA_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            for (; offset + 16 <= size; offset += 16) {
+                __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + offset)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + offset)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(delta + offset), x);
+
+                int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(x, zero));
+                size_t word = offset / WORD_SIZE;
+                if ((equal & 0x00FF) != 0x00FF) {
+                    mask[word / 8] |= static_cast<uint8_t>(1u << (word % 8));
+                }
+                if ((equal & 0xFF00) != 0xFF00) {
+                    mask[(word + 1) / 8] |= static_cast<uint8_t>(1u << ((word + 1) % 8));
+                }
+            }
+#endif
+
+            for (; offset < size; offset += WORD_SIZE) {
+                size_t bytes = std::min(WORD_SIZE, size - offset);
+                uint64_t a = 0;
+                uint64_t b = 0;
+                std::memcpy(&a, state + offset, bytes);
+                std::memcpy(&b, base + offset, bytes);
+                uint64_t x = a ^ b;
+                std::memcpy(delta + offset, &x, bytes);
+                if (x) {
+                    size_t word = offset / WORD_SIZE;
+                    mask[word / 8] |= static_cast<uint8_t>(1u << (word % 8));
+                }
+            }
+        }
+    }
+
+    DeltaEncoder::DeltaEncoder(size_t stateSize, size_t history)
+        : stateSize_(stateSize)
+        , history_(stateSize * history)
+        , sequences_(history)
+        , baseline_(stateSize)
+        , delta_(stateSize)
+        , mask_(maskSize(stateSize)) {
+        if (stateSize == 0 || history == 0) {
+            throw std::runtime_error("Delta encoder needs a state size and history");
+        }
+    }
+
+    auto DeltaEncoder::encode(const void* state, PacketFlagsT flags) -> std::unique_ptr<Packet> {
+        auto bytes = static_cast<const uint8_t*>(state);
+        uint16_t sequence = nextSequence_++;
+
+        diffWords(bytes, baseline_.data(), delta_.data(), mask_.data(), stateSize_);
+
+        builder_.reset();
+        builder_.writeUint16(sequence);
+        builder_.writeUint8(baselineSequence_ ? 1 : 0);
+        if (baselineSequence_) {
+            builder_.writeUint16(*baselineSequence_);
+        }
+        builder_.write(mask_.data(), mask_.size());
+
+        for (size_t word = 0; word < wordCount(stateSize_); ++word) {
+            if (mask_[word / 8] & (1u << (word % 8))) {
+                size_t offset = word * WORD_SIZE;
+                builder_.write(delta_.data() + offset, std::min(WORD_SIZE, stateSize_ - offset));
+            }
+        }
+
+        size_t slot = sequence % sequences_.size();
+        std::memcpy(history_.data() + slot * stateSize_, bytes, stateSize_);
+        sequences_[slot] = sequence;
+
+        return builder_.build(flags);
+    }
+
+    void DeltaEncoder::acknowledge(uint16_t sequence) {
+        if (baselineSequence_ && !isNewer(sequence, *baselineSequence_)) {
+            return;
+        }
+
+        size_t slot = sequence % sequences_.size();
+        if (sequences_[slot] != sequence) {
+            return;
+        }
+
+        std::memcpy(baseline_.data(), history_.data() + slot * stateSize_, stateSize_);
+        baselineSequence_ = sequence;
+    }
+
+    auto DeltaEncoder::acknowledge(const Packet& ack) -> bool {
+        PacketReader reader(ack);
+        uint16_t sequence;
+        if (!reader.read(&sequence, sizeof(sequence))) {
+            return false;
+        }
+        acknowledge(detail::littleEndian(sequence));
+        return true;
+    }
+
+    void DeltaEncoder::reset() {
+        std::fill(sequences_.begin(), sequences_.end(), std::nullopt);
+        std::fill(baseline_.begin(), baseline_.end(), 0);
+        baselineSequence_.reset();
+    }
+
+    auto DeltaEncoder::stateSize() const -> size_t {
+        return stateSize_;
+    }
+
+    DeltaDecoder::DeltaDecoder(size_t stateSize, size_t history)
+        : stateSize_(stateSize)
+        , history_(stateSize * history)
+        , sequences_(history)
+        , scratch_(stateSize)
+        , mask_(maskSize(stateSize)) {
+        if (stateSize == 0 || history == 0) {
+            throw std::runtime_error("Delta decoder needs a state size and history");
+        }
+    }
+
+    auto DeltaDecoder::decode(const Packet& pkt, void* state) -> bool {
+        PacketReader reader(pkt);
+        uint16_t sequence;
+        uint8_t hasBaseline;
+        if (!reader.read(&sequence, sizeof(sequence)) || !reader.read(&hasBaseline, sizeof(hasBaseline))) {
+            return false;
+        }
+        sequence = detail::littleEndian(sequence);
+
+        if (latest_ && !isNewer(sequence, *latest_)) {
+            return false;
+        }
+
+        const uint8_t* base = nullptr;
+        if (hasBaseline) {
+            uint16_t baseline;
+            if (!reader.read(&baseline, sizeof(baseline))) {
+                return false;
+            }
+            baseline = detail::littleEndian(baseline);
+            size_t slot = baseline % sequences_.size();
+            if (sequences_[slot] != baseline) {
+                return false;
+            }
+            base = history_.data() + slot * stateSize_;
+        }
+
+        if (!reader.read(mask_.data(), mask_.size())) {
+            return false;
+        }
+
+        for (size_t word = 0; word < wordCount(stateSize_); ++word) {
+            size_t offset = word * WORD_SIZE;
+            size_t bytes = std::min(WORD_SIZE, stateSize_ - offset);
+            uint8_t* out = scratch_.data() + offset;
+
+            if (base) {
+                std::memcpy(out, base + offset, bytes);
+            } else {
+                std::memset(out, 0, bytes);
+            }
+
+            if (mask_[word / 8] & (1u << (word % 8))) {
+                uint8_t delta[WORD_SIZE];
+                if (!reader.read(delta, bytes)) {
+                    return false;
+                }
+                for (size_t i = 0; i < bytes; ++i) {
+                    out[i] ^= delta[i];
+                }
+            }
+        }
+
+        if (!reader.atEnd()) {
+            return false;
+        }
+
+        size_t slot = sequence % sequences_.size();
+        std::memcpy(history_.data() + slot * stateSize_, scratch_.data(), stateSize_);
+        sequences_[slot] = sequence;
+        latest_ = sequence;
+
+        std::memcpy(state, scratch_.data(), stateSize_);
+        return true;
+    }
+
+    auto DeltaDecoder::makeAck(PacketFlagsT flags) const -> std::unique_ptr<Packet> {
+        if (!latest_) {
+            return nullptr;
+        }
+        uint16_t sequence = detail::littleEndian(*latest_);
+        return Packet::create(&sequence, sizeof(sequence), flags);
+    }
+
+    auto DeltaDecoder::lastSequence() const -> std::optional<uint16_t> {
+        return latest_;
+    }
+
+    void DeltaDecoder::reset() {
+        std::fill(sequences_.begin(), sequences_.end(), std::nullopt);
+        latest_.reset();
+    }
+}
\ No newline at end of file
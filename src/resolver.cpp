@@ -0,0 +1,151 @@
+#include "icelander.hpp"
+#include <algorithm>
+
+namespace icelander {
+    auto Resolver::instance() -> Resolver& {
+        static Resolver resolver;
+        return resolver;
+    }
+
+    void Resolver::configure(const ResolverConfig& config) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = config;
+    }
+
+    auto Resolver::lookup(const std::string& hostName, uint16_t port, Endpoint& endpoint, Callback done) -> Lookup {
+        AddressT address;
+        if (enet_address_set_host_ip(&address, hostName.c_str()) == 0) {
+            endpoint = Endpoint{address.host, port};
+            return Lookup::resolved;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool onCaller = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(hostName);
+            if (it != entries_.end() && !it->second.pending && now < it->second.expires) {
+                if (!it->second.resolved) {
+                    return Lookup::failed;
+                }
+                endpoint = Endpoint{it->second.host, port};
+                return Lookup::resolved;
+            }
+
+            if (it == entries_.end()) {
+                evict(now);
+                it = entries_.emplace(hostName, Entry{}).first;
+            }
+            auto& entry = it->second;
+
+            onCaller = !async::TaskScheduler::instance().isRunning();
+            if (!onCaller) {
+                entry.waiters.push_back({port, std::move(done)});
+                if (entry.pending) {
+                    return Lookup::pending;
+                }
+            }
+            entry.pending = true;
+        }
+
+        if (!onCaller) {
+            async::TaskScheduler::instance().schedule([this, hostName] { query(hostName); });
+            return Lookup::pending;
+        }
+
+        auto host = query(hostName);
+        if (!host) {
+            return Lookup::failed;
+        }
+        endpoint = Endpoint{*host, port};
+        return Lookup::resolved;
+    }
+
+    auto Resolver::resolve(const std::string& hostName, uint16_t port) -> std::future<Endpoint> {
+        auto promise = std::make_shared<std::promise<Endpoint>>();
+        auto result = promise->get_future();
+        auto fail = [message = "Failed to resolve hostname: " + hostName](std::promise<Endpoint>& target) {
+            target.set_exception(std::make_exception_ptr(std::runtime_error(message)));
+        };
+
+        Endpoint endpoint;
+        switch (lookup(hostName, port, endpoint, [promise, fail](std::optional<Endpoint> resolved) {
+            if (resolved) {
+                promise->set_value(*resolved);
+            } else {
+                fail(*promise);
+            }
+        })) {
+            case Lookup::resolved: promise->set_value(endpoint); break;
+            case Lookup::failed: fail(*promise); break;
+            case Lookup::pending: break;
+        }
+        return result;
+    }
+
+    auto Resolver::cached(const std::string& hostName, uint16_t port) const -> std::optional<Endpoint> {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(hostName);
+        if (it == entries_.end() || it->second.pending || !it->second.resolved ||
+            std::chrono::steady_clock::now() >= it->second.expires) {
+            return std::nullopt;
+        }
+        return Endpoint{it->second.host, port};
+    }
+
+    void Resolver::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::erase_if(entries_, [](const auto& item) { return !item.second.pending; });
+    }
+
+    auto Resolver::query(const std::string& hostName) -> std::optional<uint32_t> {
+        // Blocks this thread for as long as the DNS server takes.
+        AddressT address;
+        std::optional<uint32_t> host;
+        if (enet_address_set_host(&address, hostName.c_str()) == 0) {
+            host = address.host;
+        }
+        finish(hostName, host);
+        return host;
+    }
+
+    auto Resolver::finish(const std::string& hostName, std::optional<uint32_t> host) -> void {
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& entry = entries_[hostName];
+            entry.pending = false;
+            entry.resolved = host.has_value();
+            entry.host = host.value_or(0);
+            entry.expires = std::chrono::steady_clock::now() + (host ? config_.ttl : config_.negativeTtl);
+            waiters = std::move(entry.waiters);
+            entry.waiters.clear();
+        }
+
+        for (auto& waiter : waiters) {
+            waiter.done(host ? std::optional<Endpoint>(Endpoint{*host, waiter.port}) : std::nullopt);
+        }
+    }
+
+    auto Resolver::evict(Timestamp now) -> void {
+        size_t limit = std::max<size_t>(config_.maxEntries, 1);
+        if (entries_.size() < limit) {
+            return;
+        }
+
+        std::erase_if(entries_, [now](const auto& item) { return !item.second.pending && now >= item.second.expires; });
+        if (entries_.size() < limit) {
+            return;
+        }
+
+        auto oldest = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (!it->second.pending && (oldest == entries_.end() || it->second.expires < oldest->second.expires)) {
+                oldest = it;
+            }
+        }
+        if (oldest != entries_.end()) {
+            entries_.erase(oldest);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "icelander.hpp"
+#include <stdexcept>
+
+namespace icelander {
+    auto ShardedHost::create(const Endpoint& bindEndpoint, const ShardConfig& config) -> std::shared_ptr<ShardedHost> {
+        auto hwThreads = std::thread::hardware_concurrency();
+        size_t cpuCount = hwThreads > 1 ? hwThreads : 1;
+        size_t shardCount = config.shardCount > 0 ? config.shardCount : cpuCount;
+
+        auto sharded = std::shared_ptr<ShardedHost>(new ShardedHost());
+        sharded->dispatcher_ = std::make_shared<EventDispatcher>();
+        sharded->shards_.reserve(shardCount);
+
+        HostConfig shardConfig = config.host;
+        shardConfig.reusePort = shardCount > 1 || config.host.reusePort;
+
+        Endpoint endpoint = bindEndpoint;
+        for (size_t i = 0; i < shardCount; ++i) {
+            if (config.pinThreads) {
+                shardConfig.serviceThreadCpu = static_cast<int>(i % cpuCount);
+            }
+
+            auto shardHost = Host::createServer(endpoint, shardConfig);
+
+            // An ephemeral bind picks the port once; the remaining shards join it.
+            if (endpoint.port == 0) {
+                endpoint.port = shardHost->nativeHandle()->address.port;
+            }
+
+            // Capture the dispatcher, not the facade, so shards can outlive it safely.
+            auto& shardDispatcher = shardHost->getDispatcher();
+            shardDispatcher.onConnect([dispatcher = sharded->dispatcher_](const ConnectEvent& event) {
+                dispatcher->dispatchConnect(event);
+            });
+            shardDispatcher.onDisconnect([dispatcher = sharded->dispatcher_](const DisconnectEvent& event) {
+                dispatcher->dispatchDisconnect(event);
+            });
+            shardDispatcher.onReceive([dispatcher = sharded->dispatcher_](const ReceiveEvent& event) {
+                dispatcher->dispatchReceive(event);
+            });
+
+            sharded->shards_.push_back(std::move(shardHost));
+        }
+
+        return sharded;
+    }
+
+    ShardedHost::~ShardedHost() {
+        stop();
+    }
+
+    auto ShardedHost::start() -> void {
+        if (running_) {
+            return;
+        }
+
+        for (auto& shardHost : shards_) {
+            shardHost->startServiceThread();
+        }
+        running_ = true;
+    }
+
+    auto ShardedHost::stop() -> void {
+        if (!running_) {
+            return;
+        }
+
+        for (auto& shardHost : shards_) {
+            shardHost->stopServiceThread();
+        }
+        running_ = false;
+    }
+
+    auto ShardedHost::isRunning() const -> bool {
+        return running_;
+    }
+
+    auto ShardedHost::broadcast(ChannelIdT channel, std::unique_ptr<Packet> pkt) -> void {
+        if (!pkt || shards_.empty()) {
+            return;
+        }
+
+        // ENet reference counts are not atomic, so every shard gets its own copy.
+        for (size_t i = 1; i < shards_.size(); ++i) {
+            shards_[i]->broadcast(channel, Packet::create(pkt->data(), pkt->flags()));
+        }
+        shards_[0]->broadcast(channel, std::move(pkt));
+    }
+
+    auto ShardedHost::broadcast(std::unique_ptr<Packet> pkt) -> void {
+        broadcast(0, std::move(pkt));
+    }
+
+    auto ShardedHost::flush() -> void {
+        for (auto& shardHost : shards_) {
+            shardHost->flush();
+        }
+    }
+
+    auto ShardedHost::shardCount() const -> size_t {
+        return shards_.size();
+    }
+
+    auto ShardedHost::shard(size_t index) const -> std::shared_ptr<Host> {
+        if (index >= shards_.size()) {
+            throw std::out_of_range("Shard index out of range");
+        }
+        return shards_[index];
+    }
+
+    auto ShardedHost::shardOf(const Peer& peer) const -> size_t {
+        auto owner = peer.hostHandle();
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (shards_[i] == owner) {
+                return i;
+            }
+        }
+        throw std::invalid_argument("Peer does not belong to this sharded host");
+    }
+
+    auto ShardedHost::peerCount() const -> size_t {
+        size_t count = 0;
+        for (const auto& shardHost : shards_) {
+            count += shardHost->peerCount();
+        }
+        return count;
+    }
+
+    auto ShardedHost::getPeers() -> std::vector<std::shared_ptr<Peer>> {
+        std::vector<std::shared_ptr<Peer>> allPeers;
+        allPeers.reserve(peerCount());
+
+        for (auto& shardHost : shards_) {
+            auto shardPeers = shardHost->getPeers();
+            allPeers.insert(allPeers.end(), shardPeers.begin(), shardPeers.end());
+        }
+        return allPeers;
+    }
+
+    auto ShardedHost::findPeer(const Endpoint& remoteEndpoint) -> std::shared_ptr<Peer> {
+        for (auto& shardHost : shards_) {
+            if (auto peerPtr = shardHost->findPeer(remoteEndpoint)) {
+                return peerPtr;
+            }
+        }
+        return nullptr;
+    }
+
+    auto ShardedHost::getDispatcher() -> EventDispatcher& {
+        return *dispatcher_;
+    }
+}
\ No newline at end of file
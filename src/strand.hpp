@@ -0,0 +1,56 @@
+#pragma once
+
+#include "icelander.hpp"
+#include "mpsc_queue.hpp"
+
+namespace icelander::detail {
+    // Serial executor on the TaskScheduler: tasks posted to one strand run one at a time
+    // in posting order, while different strands run on different workers.
+    class Strand : public std::enable_shared_from_this<Strand> {
+    public:
+        Strand() = default;
+        Strand(const Strand&) = delete;
+        Strand& operator=(const Strand&) = delete;
+
+        ~Strand() {
+            while (auto task = queue_.pop()) {
+                async::TaskNode::discard(task);
+            }
+        }
+
+        template<typename F>
+        void post(F&& fn) {
+            queue_.push(async::TaskNode::make(std::forward<F>(fn)));
+            if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+                scheduleDrain();
+            }
+        }
+
+    private:
+        // Tasks run per turn before the strand hands its worker to other strands.
+        static constexpr size_t BATCH_LIMIT = 32;
+
+        void scheduleDrain() {
+            async::TaskScheduler::instance().schedule([self = shared_from_this()] { self->drain(); });
+        }
+
+        void drain() {
+            for (size_t ran = 0; ran < BATCH_LIMIT; ++ran) {
+                async::TaskNode* task;
+                // pending_ already counts a task whose producer has not linked it yet.
+                while (!(task = queue_.pop())) {
+                    std::this_thread::yield();
+                }
+
+                async::TaskNode::run(task);
+                if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    return;
+                }
+            }
+            scheduleDrain();
+        }
+
+        MpscQueue<async::TaskNode> queue_;
+        std::atomic<size_t> pending_{0};
+    };
+}
\ No newline at end of file
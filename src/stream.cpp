@@ -0,0 +1,161 @@
+#include "stream.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace icelander::detail {
+    namespace {
+        template<typename T>
+        void store(uint8_t* out, T value) {
+            value = littleEndian(value);
+            std::memcpy(out, &value, sizeof(value));
+        }
+
+        template<typename T>
+        auto load(const uint8_t* in) -> T {
+            T value;
+            std::memcpy(&value, in, sizeof(value));
+            return littleEndian(value);
+        }
+    }
+
+    auto makeStream(Span<const uint8_t> data, StreamOptions options) -> std::unique_ptr<OutgoingStream> {
+        auto stream = std::make_unique<OutgoingStream>();
+        stream->options = std::move(options);
+        stream->data = data.data();
+        stream->size = data.size();
+        return stream;
+    }
+
+    auto makeFileStream(const std::string& path, StreamOptions options) -> std::unique_ptr<OutgoingStream> {
+        auto stream = std::make_unique<OutgoingStream>();
+        stream->options = std::move(options);
+        stream->file = std::make_unique<MappedFile>(path);
+        stream->data = stream->file->data();
+        stream->size = stream->file->size();
+        return stream;
+    }
+
+    auto StreamTable::nextId() -> uint32_t {
+        auto id = nextId_.fetch_add(1, std::memory_order_relaxed);
+        return id != 0 ? id : nextId_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto StreamTable::start(std::unique_ptr<OutgoingStream> stream) -> void {
+        active_.fetch_add(1, std::memory_order_relaxed);
+        outgoing_.push_back(std::move(stream));
+    }
+
+    auto StreamTable::pump(Host& host) -> void {
+        if (outgoing_.empty()) {
+            return;
+        }
+
+        std::vector<std::unique_ptr<OutgoingStream>> finished;
+        for (auto it = outgoing_.begin(); it != outgoing_.end();) {
+            auto& stream = **it;
+            auto state = stream.peer->state;
+            if (stream.peer->connectID != stream.connectId || state == ENET_PEER_STATE_DISCONNECTED ||
+                state > ENET_PEER_STATE_CONNECTED) {
+                stream.failed = true;
+            }
+            while (!stream.failed && stream.pending() && canSend(stream)) {
+                stream.failed = !sendChunk(host, stream);
+            }
+
+            // A failed stream waits for ENet to free its packets when the peer is reset.
+            if (stream.inFlight == 0 && (stream.failed || !stream.pending())) {
+                finished.push_back(std::move(*it));
+                it = outgoing_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Callbacks may start new streams, so they run once the table is consistent.
+        for (auto& stream : finished) {
+            active_.fetch_sub(1, std::memory_order_relaxed);
+            if (stream->options.onComplete) {
+                stream->options.onComplete(!stream->failed);
+            }
+        }
+    }
+
+    auto StreamTable::ready() const -> bool {
+        return std::any_of(outgoing_.begin(), outgoing_.end(), [this](const auto& stream) {
+            return stream->pending() ? !stream->failed && canSend(*stream) : stream->inFlight == 0;
+        });
+    }
+
+    void StreamTable::onStream(ChannelIdT channel, StreamHandler handler) {
+        std::lock_guard<std::mutex> lock(handlersMutex_);
+        enabled_[channel].store(static_cast<bool>(handler), std::memory_order_release);
+        handlers_[channel] = handler ? std::make_shared<const StreamHandler>(std::move(handler)) : nullptr;
+    }
+
+    auto StreamTable::deliver(PeerHandle peer, ChannelIdT channel, Span<const uint8_t> packetData) -> bool {
+        if (!enabled_[channel].load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        std::shared_ptr<const StreamHandler> handler;
+        {
+            std::lock_guard<std::mutex> lock(handlersMutex_);
+            handler = handlers_[channel];
+        }
+        if (!handler || packetData.size() < STREAM_HEADER_SIZE) {
+            return true;
+        }
+
+        const uint8_t* header = packetData.data();
+        StreamChunk chunk;
+        chunk.peer = peer;
+        chunk.streamId = load<uint32_t>(header);
+        chunk.tag = load<uint32_t>(header + 4);
+        chunk.totalSize = load<uint64_t>(header + 8);
+        chunk.offset = load<uint64_t>(header + 16);
+        chunk.data = Span<const uint8_t>(header + STREAM_HEADER_SIZE, packetData.size() - STREAM_HEADER_SIZE);
+        if (chunk.offset > chunk.totalSize || chunk.data.size() > chunk.totalSize - chunk.offset) {
+            return true;
+        }
+
+        (*handler)(chunk);
+        return true;
+    }
+
+    void ENET_CALLBACK StreamTable::chunkFreed(ENetPacket* packet) {
+        // ENet frees a reliable packet once every fragment is acknowledged, or on reset.
+        static_cast<OutgoingStream*>(packet->userData)->inFlight -= packet->dataLength;
+    }
+
+    auto StreamTable::canSend(const OutgoingStream& stream) const -> bool {
+        // Other channels' reliable data counts against the window too, so a stream never
+        // queues more than one window ahead of them.
+        auto window = std::max<size_t>(stream.options.window, 1);
+        return stream.peer->state == ENET_PEER_STATE_CONNECTED && stream.inFlight < window &&
+               stream.peer->reliableDataInTransit < window;
+    }
+
+    auto StreamTable::sendChunk(Host& host, OutgoingStream& stream) -> bool {
+        auto chunkSize = std::max<size_t>(stream.options.chunkSize, 1);
+        auto length = static_cast<size_t>(std::min<uint64_t>(chunkSize, stream.size - stream.sent));
+        ENetPacket* packet = enet_packet_create(nullptr, STREAM_HEADER_SIZE + length, ENET_PACKET_FLAG_RELIABLE);
+        if (!packet) {
+            return false;
+        }
+
+        store(packet->data, stream.id);
+        store(packet->data + 4, stream.options.tag);
+        store(packet->data + 8, stream.size);
+        store(packet->data + 16, stream.sent);
+        if (length > 0) {
+            std::memcpy(packet->data + STREAM_HEADER_SIZE, stream.data + stream.sent, length);
+        }
+
+        packet->userData = &stream;
+        packet->freeCallback = &StreamTable::chunkFreed;
+        stream.inFlight += packet->dataLength;
+        stream.sent += length;
+        ++stream.chunks;
+        return host.sendNative(stream.peer, stream.channel, packet);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "icelander.hpp"
+#include "mapped_file.hpp"
+
+namespace icelander::detail {
+    // Every chunk starts with u32 stream id, u32 tag, u64 total size, u64 offset, all
+    // little-endian. Chunks of one stream share a reliable channel, so they arrive in order.
+    constexpr size_t STREAM_HEADER_SIZE = 24;
+
+    struct OutgoingStream {
+        ENetPeer* peer = nullptr;
+        uint32_t connectId = 0;
+        ChannelIdT channel = 0;
+        uint32_t id = 0;
+        StreamOptions options;
+        const uint8_t* data = nullptr;
+        uint64_t size = 0;
+        std::unique_ptr<MappedFile> file;     // keeps data mapped for sendFile
+        uint64_t sent = 0;                    // bytes handed to ENet
+        size_t inFlight = 0;                  // of those, in packets ENet still holds
+        size_t chunks = 0;
+        bool failed = false;
+
+        auto pending() const -> bool { return sent < size || chunks == 0; }
+    };
+
+    // Both directions of Peer::sendStream for one host. Outgoing streams are only touched
+    // by the servicing thread; receive handlers can be registered from any thread.
+    class StreamTable {
+    public:
+        StreamTable() = default;
+
+        StreamTable(const StreamTable&) = delete;
+        StreamTable& operator=(const StreamTable&) = delete;
+
+        auto nextId() -> uint32_t;
+        auto start(std::unique_ptr<OutgoingStream> stream) -> void;
+        // Queues chunks while each stream is inside its window, then retires finished
+        // streams and runs their callbacks.
+        auto pump(Host& host) -> void;
+        // True if pump() would send or retire something now.
+        auto ready() const -> bool;
+        auto active() const -> size_t { return active_.load(std::memory_order_relaxed); }
+
+        void onStream(ChannelIdT channel, StreamHandler handler);
+        // False if the channel carries no streams; otherwise the packet was consumed.
+        auto deliver(PeerHandle peer, ChannelIdT channel, Span<const uint8_t> packetData) -> bool;
+
+    private:
+        static void ENET_CALLBACK chunkFreed(ENetPacket* packet);
+        auto canSend(const OutgoingStream& stream) const -> bool;
+        auto sendChunk(Host& host, OutgoingStream& stream) -> bool;
+
+        std::vector<std::unique_ptr<OutgoingStream>> outgoing_;
+        std::atomic<size_t> active_{0};
+        std::atomic<uint32_t> nextId_{1};
+
+        std::array<std::atomic<bool>, MAX_CHANNELS> enabled_{};
+        std::array<std::shared_ptr<const StreamHandler>, MAX_CHANNELS> handlers_;
+        std::mutex handlersMutex_;
+    };
+
+    // A span the caller keeps alive, or a file mapped for the lifetime of the stream.
+    auto makeStream(Span<const uint8_t> data, StreamOptions options) -> std::unique_ptr<OutgoingStream>;
+    auto makeFileStream(const std::string& path, StreamOptions options) -> std::unique_ptr<OutgoingStream>;
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "icelander.hpp"
+#include "batched_socket.hpp"
+#include "stream.hpp"
+#include "wakeup.hpp"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+namespace icelander {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+    }
+
+    auto Host::runTickLoop(double rate, TickFunction update) -> TickStats {
+        TickConfig config;
+        config.rate = rate;
+        return runTickLoop(config, std::move(update));
+    }
+
+    auto Host::runTickLoop(const TickConfig& config, TickFunction update) -> TickStats {
+        std::shared_ptr<Host> self = shared_from_this();
+        return runTickLoop(std::span<const std::shared_ptr<Host>>(&self, 1), config, std::move(update));
+    }
+
+    auto Host::runTickLoop(std::span<const std::shared_ptr<Host>> hosts, const TickConfig& config, TickFunction update) -> TickStats {
+        if (!(config.rate > 0)) {
+            throw std::runtime_error("Tick rate must be positive");
+        }
+        for (const auto& host : hosts) {
+            if (!host || !host->nativeHost_) {
+                throw std::runtime_error("Tick loop needs valid hosts");
+            }
+            if (host->isServiceThreadRunning()) {
+                throw std::runtime_error("Tick loop cannot run while the service thread is running");
+            }
+        }
+
+        // The looping thread stands in for a service thread, so calls from other threads are
+        // queued and wake its socket wait. Whatever is still queued at the end runs here.
+        struct Ownership {
+            std::span<const std::shared_ptr<Host>> hosts;
+
+            ~Ownership() {
+#ifdef _WIN32
+                timeEndPeriod(1);
+#endif
+                for (const auto& host : hosts) {
+                    host->serviceThreadRunning_.store(false, std::memory_order_release);
+                    host->serviceThreadId_.store(std::thread::id(), std::memory_order_release);
+                    host->flush();
+                }
+            }
+        };
+
+        for (const auto& host : hosts) {
+            host->serviceThreadId_.store(std::this_thread::get_id(), std::memory_order_release);
+            host->serviceThreadRunning_.store(true, std::memory_order_release);
+        }
+#ifdef _WIN32
+        timeBeginPeriod(1);     // sleeps otherwise round up to the 15.6 ms timer tick
+#endif
+        Ownership ownership{hosts};
+
+        auto step = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(1.0 / config.rate));
+        step = std::max(step, std::chrono::nanoseconds{1});
+
+        TickStats stats;
+        TickInfo info;
+        info.step = step;
+        info.stats = &stats;
+
+        auto deadline = Clock::now();
+        for (;;) {
+            stats.networkTime.record(serviceUntil(hosts, deadline, config.spin));
+
+            auto updateStarted = Clock::now();
+            stats.lateness.record(updateStarted - deadline);
+            info.tick = stats.ticks;
+            info.deadline = deadline;
+            bool keepRunning = update(info);
+
+            auto flushStarted = Clock::now();
+            stats.updateTime.record(flushStarted - updateStarted);
+            for (const auto& host : hosts) {
+                host->flushQueued();
+                host->flush();
+            }
+            auto finished = Clock::now();
+            stats.flushTime.record(finished - flushStarted);
+            ++stats.ticks;
+
+            if (!keepRunning) {
+                break;
+            }
+
+            // Late by less than a step: the next tick starts at once to get back on schedule.
+            deadline += step;
+            if (finished > deadline) {
+                ++stats.overruns;
+                auto missed = static_cast<uint64_t>((finished - deadline) / step);
+                stats.skippedTicks += missed;
+                deadline += step * static_cast<int64_t>(missed);
+            }
+        }
+        return stats;
+    }
+
+    auto Host::serviceUntil(std::span<const std::shared_ptr<Host>> hosts, Timestamp deadline, std::chrono::microseconds spin) -> std::chrono::nanoseconds {
+        std::chrono::nanoseconds busy{0};
+        auto servicePass = [&hosts, &busy]() {
+            auto started = Clock::now();
+            int events = 0;
+            for (const auto& host : hosts) {
+                // Consume the wakeup before draining so a send racing with us re-arms it.
+                host->wakeup_->clear();
+                events += std::max(host->serviceAll(TimeoutMs{0}), 0);
+            }
+            busy += Clock::now() - started;
+            return events;
+        };
+
+        for (;;) {
+            bool active = servicePass() > 0;
+            auto remaining = deadline - Clock::now();
+            if (remaining <= spin) {
+                break;
+            }
+            for (const auto& host : hosts) {
+                active = active || (host->socket_ && host->socket_->pending()) || host->streams_->ready();
+            }
+            if (active) {
+                continue;
+            }
+
+            // The socket wait only has millisecond resolution; finer gaps are plain sleeps.
+            auto sleep = std::chrono::duration_cast<std::chrono::milliseconds>(remaining - spin);
+            if (hosts.size() == 1 && sleep.count() > 0) {
+                hosts[0]->wakeup_->wait(hosts[0]->nativeHost_->socket, static_cast<uint32_t>(sleep.count()));
+            } else {
+                std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(remaining - spin, std::chrono::milliseconds(1)));
+            }
+        }
+
+        // The OS wakes us late by up to a scheduler quantum; spin out the rest.
+        while (Clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        return busy;
+    }
+}
\ No newline at end of file
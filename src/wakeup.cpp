@@ -0,0 +1,138 @@
+#include "wakeup.hpp"
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#endif
+
+namespace icelander::detail {
+#ifdef _WIN32
+    Wakeup::Wakeup() {
+        socket_ = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+        if (socket_ == ENET_SOCKET_NULL) {
+            throw std::runtime_error("Failed to create wakeup socket");
+        }
+
+        ENetAddress loopback{};
+        enet_address_set_host_ip(&loopback, "127.0.0.1");
+        loopback.port = ENET_PORT_ANY;
+
+        if (enet_socket_bind(socket_, &loopback) != 0 || enet_socket_get_address(socket_, &address_) != 0) {
+            enet_socket_destroy(socket_);
+            throw std::runtime_error("Failed to bind wakeup socket");
+        }
+        enet_socket_set_option(socket_, ENET_SOCKOPT_NONBLOCK, 1);
+    }
+
+    Wakeup::~Wakeup() {
+        enet_socket_destroy(socket_);
+    }
+
+    void Wakeup::signal() noexcept {
+        if (pending_.exchange(true)) {
+            return;
+        }
+
+        uint8_t byte = 1;
+        ENetBuffer buffer{};
+        buffer.data = &byte;
+        buffer.dataLength = sizeof(byte);
+        enet_socket_send(socket_, &address_, &buffer, 1);
+    }
+
+    void Wakeup::clear() noexcept {
+        if (!pending_.load()) {
+            return;
+        }
+
+        uint8_t scratch[16];
+        ENetBuffer buffer{};
+        buffer.data = scratch;
+        buffer.dataLength = sizeof(scratch);
+        ENetAddress sender;
+        while (enet_socket_receive(socket_, &sender, &buffer, 1) > 0) {
+        }
+        pending_.store(false);
+    }
+
+    auto Wakeup::wait(ENetSocket socket, uint32_t timeoutMs) -> bool {
+        ENetSocketSet readSet;
+        ENET_SOCKETSET_EMPTY(readSet);
+        ENET_SOCKETSET_ADD(readSet, socket);
+        ENET_SOCKETSET_ADD(readSet, socket_);
+
+        if (enet_socketset_select(socket > socket_ ? socket : socket_, &readSet, nullptr, timeoutMs) <= 0) {
+            return false;
+        }
+        return ENET_SOCKETSET_CHECK(readSet, socket);
+    }
+#else
+    Wakeup::Wakeup() {
+#ifdef __linux__
+        readFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        writeFd_ = readFd_;
+        if (readFd_ < 0) {
+            throw std::runtime_error("Failed to create wakeup eventfd");
+        }
+#else
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw std::runtime_error("Failed to create wakeup pipe");
+        }
+        for (int fd : fds) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        readFd_ = fds[0];
+        writeFd_ = fds[1];
+#endif
+    }
+
+    Wakeup::~Wakeup() {
+        close(readFd_);
+        if (writeFd_ != readFd_) {
+            close(writeFd_);
+        }
+    }
+
+    void Wakeup::signal() noexcept {
+        if (pending_.exchange(true)) {
+            return;
+        }
+
+        uint64_t one = 1;
+        // A full pipe or saturated eventfd is already readable, so a failed write is fine.
+        [[maybe_unused]] auto written = write(writeFd_, &one, writeFd_ == readFd_ ? sizeof(one) : 1);
+    }
+
+    void Wakeup::clear() noexcept {
+        if (!pending_.load()) {
+            return;
+        }
+
+        uint64_t scratch[8];
+        while (read(readFd_, scratch, sizeof(scratch)) > 0) {
+        }
+        pending_.store(false);
+    }
+
+    auto Wakeup::wait(ENetSocket socket, uint32_t timeoutMs) -> bool {
+        pollfd fds[2] = {};
+        fds[0].fd = socket;
+        fds[0].events = POLLIN;
+        fds[1].fd = readFd_;
+        fds[1].events = POLLIN;
+
+        int result = poll(fds, 2, static_cast<int>(timeoutMs));
+        if (result <= 0) {
+            return false;
+        }
+        return (fds[0].revents & POLLIN) != 0;
+    }
+#endif
+}
\ No newline at end of file
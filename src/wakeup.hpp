@@ -0,0 +1,36 @@
+#pragma once
+
+#include "icelander.hpp"
+
+namespace icelander::detail {
+    // Lets other threads interrupt a service thread that is blocked on the host socket.
+    // Linux uses an eventfd, other POSIX systems a pipe, Windows a loopback UDP socket.
+    class Wakeup {
+    public:
+        Wakeup();
+        ~Wakeup();
+
+        Wakeup(const Wakeup&) = delete;
+        Wakeup& operator=(const Wakeup&) = delete;
+
+        // Safe from any thread; only the first signal after clear() reaches the kernel.
+        void signal() noexcept;
+
+        // Service thread only: consumes a pending signal before commands are drained.
+        void clear() noexcept;
+
+        // Blocks until the socket is readable, signal() is called or the timeout expires.
+        // Returns true when the host socket has data.
+        auto wait(ENetSocket socket, uint32_t timeoutMs) -> bool;
+
+    private:
+        std::atomic<bool> pending_{false};
+#ifdef _WIN32
+        ENetSocket socket_ = ENET_SOCKET_NULL;
+        ENetAddress address_{};
+#else
+        int readFd_ = -1;
+        int writeFd_ = -1;
+#endif
+    };
+}
\ No newline at end of file
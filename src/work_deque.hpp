@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace icelander::detail {
+    // Chase-Lev work-stealing deque of pointers. The owning thread push()es and pop()s at
+    // the bottom; any thread may steal() from the top. Grows on demand; retired rings are
+    // kept until destruction because a thief may still be reading one.
+    template<typename T>
+    class WorkDeque {
+    public:
+        explicit WorkDeque(size_t capacity = 256) {
+            size_t size = 1;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            rings_.push_back(std::make_unique<Ring>(size));
+            ring_.store(rings_.back().get(), std::memory_order_relaxed);
+        }
+
+        WorkDeque(const WorkDeque&) = delete;
+        WorkDeque& operator=(const WorkDeque&) = delete;
+
+        void push(T* item) {
+            int64_t bottom = bottom_.load(std::memory_order_relaxed);
+            int64_t top = top_.load(std::memory_order_acquire);
+            Ring* ring = ring_.load(std::memory_order_relaxed);
+
+            if (bottom - top >= static_cast<int64_t>(ring->capacity())) {
+                ring = grow(ring, top, bottom);
+            }
+
+            ring->put(bottom, item);
+            bottom_.store(bottom + 1, std::memory_order_release);
+        }
+
+        auto pop() -> T* {
+            int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            Ring* ring = ring_.load(std::memory_order_relaxed);
+            bottom_.store(bottom, std::memory_order_seq_cst);
+            int64_t top = top_.load(std::memory_order_seq_cst);
+
+            if (top > bottom) {
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            T* item = ring->get(bottom);
+            if (top == bottom) {
+                // Last element: race the thieves for it.
+                if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        // Returns nullptr when empty or when another thread won the race.
+        auto steal() -> T* {
+            int64_t top = top_.load(std::memory_order_seq_cst);
+            int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+            if (top >= bottom) {
+                return nullptr;
+            }
+
+            Ring* ring = ring_.load(std::memory_order_acquire);
+            T* item = ring->get(top);
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return item;
+        }
+
+        auto empty() const -> bool {
+            return top_.load(std::memory_order_acquire) >= bottom_.load(std::memory_order_acquire);
+        }
+
+    private:
+        class Ring {
+        public:
+            explicit Ring(size_t capacity)
+                : mask_(capacity - 1), slots_(std::make_unique<std::atomic<T*>[]>(capacity)) {}
+
+            auto capacity() const -> size_t { return mask_ + 1; }
+
+            auto get(int64_t index) const -> T* {
+                return slots_[static_cast<size_t>(index) & mask_].load(std::memory_order_relaxed);
+            }
+
+            void put(int64_t index, T* item) {
+                slots_[static_cast<size_t>(index) & mask_].store(item, std::memory_order_relaxed);
+            }
+
+        private:
+            size_t mask_;
+            std::unique_ptr<std::atomic<T*>[]> slots_;
+        };
+
+        auto grow(Ring* ring, int64_t top, int64_t bottom) -> Ring* {
+            rings_.push_back(std::make_unique<Ring>(ring->capacity() * 2));
+            Ring* larger = rings_.back().get();
+            for (int64_t i = top; i < bottom; ++i) {
+                larger->put(i, ring->get(i));
+            }
+            ring_.store(larger, std::memory_order_release);
+            return larger;
+        }
+
+        alignas(64) std::atomic<int64_t> top_{0};
+        alignas(64) std::atomic<int64_t> bottom_{0};
+        alignas(64) std::atomic<Ring*> ring_{nullptr};
+        std::vector<std::unique_ptr<Ring>> rings_;
+    };
+}
\ No newline at end of file